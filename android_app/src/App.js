@@ -12,6 +12,8 @@ import {
   RefreshControl,
 } from 'react-native';
 import axios from 'axios';
+import { decodeStatusBatch } from './statusCodec';
+import { openStatusStream } from './statusStream';
 
 // --- Config ---
 // Android emulator typically uses 10.0.2.2 to reach host machine's localhost
@@ -26,6 +28,8 @@ const API_BASE_URL = __DEV__
   : PROD_API_URL;
 
 const DEFAULT_DEVICE_ID = 'RPiStepper_001'; // Could make this configurable
+// 'compact': fetch the device's latest binary status batch (agent StatusFormat = compact) instead of JSON
+const STATUS_FORMAT = 'json';
 
 // --- Helper ---
 const formatTimestamp = (ts) => {
@@ -47,11 +51,12 @@ export default function App() {
   const [isPollingStatus, setIsPollingStatus] = useState(false); // For background polling indicator
   const [error, setError] = useState(null);
   const [refreshing, setRefreshing] = useState(false); // For pull-to-refresh
+  const [isStreaming, setIsStreaming] = useState(false); // Live status stream connected
 
   const [motor1Target, setMotor1Target] = useState('');
   const [motor2Target, setMotor2Target] = useState('');
 
-  const statusIntervalRef = useRef(null);
+  const statusIntervalRef = useRef(null); // Polling fallback while the stream is down
 
   // --- API Call Functions (Similar logic to web app) ---
   const fetchConfig = useCallback(async (showLoading = true) => {
@@ -120,8 +125,15 @@ export default function App() {
       if (showLoading) setIsLoadingStatus(true); else setIsPollingStatus(true);
       // setError(null); // Maybe don't clear error on every poll
       try {
-         const response = await axios.get(`${API_BASE_URL}/devices/${deviceId}/status`);
-         setStatus(response.data || { timestamp: null });
+         if (STATUS_FORMAT === 'compact') {
+           const response = await axios.get(`${API_BASE_URL}/devices/${deviceId}/status/compact`, { responseType: 'arraybuffer' });
+           const samples = decodeStatusBatch(response.data);
+           // Latest sample; keeps fields only the JSON status has (connection_status)
+           if (samples.length) setStatus(prev => ({ ...prev, ...samples[samples.length - 1] }));
+         } else {
+           const response = await axios.get(`${API_BASE_URL}/devices/${deviceId}/status`);
+           setStatus(response.data || { timestamp: null });
+         }
       } catch (err) {
          console.warn("Error fetching status:", err);
          if (err.response?.status !== 404) { // Don't show error if just no status yet
@@ -154,13 +166,28 @@ export default function App() {
     fetchConfig();
     fetchStatus(true); // Show loading indicator on initial status fetch
 
-    // Setup polling interval
-    if (statusIntervalRef.current) clearInterval(statusIntervalRef.current);
-    statusIntervalRef.current = setInterval(() => fetchStatus(false), 3000); // Poll every 3 seconds
+    // Live updates pushed by the backend (see statusStream.js); poll every
+    // 3 seconds only while the stream is not connected
+    const stopPolling = () => {
+      if (statusIntervalRef.current) clearInterval(statusIntervalRef.current);
+      statusIntervalRef.current = null;
+    };
+    const closeStream = openStatusStream(
+      `${API_BASE_URL}/devices/${deviceId}/status/stream`,
+      (update) => setStatus(update),
+      (connected) => {
+        setIsStreaming(connected);
+        if (connected) {
+          stopPolling();
+        } else if (!statusIntervalRef.current) {
+          statusIntervalRef.current = setInterval(() => fetchStatus(false), 3000);
+        }
+      });
 
     // Cleanup on unmount
     return () => {
-      if (statusIntervalRef.current) clearInterval(statusIntervalRef.current);
+      closeStream();
+      stopPolling();
     };
   }, [fetchConfig, fetchStatus, deviceId]); // Re-run if functions or deviceId change
 
@@ -189,7 +216,7 @@ export default function App() {
 
       {/* Status Section */}
       <View style={styles.card}>
-        <Text style={styles.cardTitle}>Device Status</Text>
+        <Text style={styles.cardTitle}>Device Status ({isStreaming ? 'live' : 'polling'})</Text>
         {(isLoadingStatus && !status.timestamp) ? <ActivityIndicator size="large" color="#007AFF" /> : (
             <>
                 {renderStatusValue('Last Update', status.timestamp, formatTimestamp)}
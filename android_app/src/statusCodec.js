@@ -0,0 +1,63 @@
+// --- Compact Status Decoder ---
+// Mirror of rpi_zero_agent/status_codec.py (served raw by GET /api/devices/<id>/status/compact):
+//   [MAGIC] [VERSION] [NUM_AXES] [COUNT] [T0 f64]
+//   COUNT x [DT_MS u16] [STATUS] [SWITCHES] [ERRORS] [POS x NUM_AXES] [SPEED u16 x NUM_AXES]
+// Little endian. Key samples (DT_KEY_FLAG) carry absolute i32 positions, the
+// others i16 deltas to the previous sample.
+export const COMPACT_MAGIC = 0xB5;
+const COMPACT_VERSION = 1;
+const HEADER_LEN = 12;
+const DT_KEY_FLAG = 0x8000;
+
+// Returns the samples as status objects (same keys as the JSON status), oldest first.
+// Throws on a malformed message.
+export const decodeStatusBatch = (buffer) => {
+  const view = new DataView(buffer);
+  if (view.byteLength < HEADER_LEN || view.getUint8(0) !== COMPACT_MAGIC || view.getUint8(1) !== COMPACT_VERSION) {
+    throw new Error('Not a compact status message');
+  }
+  const numAxes = view.getUint8(2);
+  const count = view.getUint8(3);
+  const t0 = view.getFloat64(4, true);
+
+  const samples = [];
+  let offset = HEADER_LEN;
+  let timeMs = 0;
+  let pos = null;
+  for (let i = 0; i < count; i++) {
+    if (offset + 2 > view.byteLength) throw new Error('Compact status truncated');
+    const dt = view.getUint16(offset, true);
+    const key = (dt & DT_KEY_FLAG) !== 0;
+    if (!key && !pos) throw new Error('Compact status starts with a delta sample');
+    const sampleLen = 5 + numAxes * (key ? 4 : 2) + numAxes * 2;
+    if (offset + sampleLen > view.byteLength) throw new Error('Compact status truncated');
+
+    timeMs += dt & ~DT_KEY_FLAG;
+    const sample = {
+      timestamp: t0 + timeMs / 1000,
+      status_flags: view.getUint8(offset + 2),
+      switch_flags: view.getUint8(offset + 3),
+      error_flags: view.getUint8(offset + 4),
+    };
+    let p = offset + 5;
+    const nextPos = [];
+    for (let axis = 0; axis < numAxes; axis++) {
+      if (key) {
+        nextPos.push(view.getInt32(p, true));
+        p += 4;
+      } else {
+        nextPos.push(pos[axis] + view.getInt16(p, true));
+        p += 2;
+      }
+    }
+    pos = nextPos;
+    for (let axis = 0; axis < numAxes; axis++) {
+      sample[`motor${axis + 1}_pos`] = pos[axis];
+      sample[`motor${axis + 1}_speed`] = view.getUint16(p, true);
+      p += 2;
+    }
+    samples.push(sample);
+    offset += sampleLen;
+  }
+  return samples;
+};
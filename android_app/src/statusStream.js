@@ -0,0 +1,75 @@
+// --- Live Status Stream ---
+// Client for GET /api/devices/<id>/status/stream (server-sent events).
+// React Native has no EventSource, so this reads the stream with
+// XMLHttpRequest: with an onprogress handler set, responseText grows as
+// chunks arrive and each complete event ("data: <json>\n\n") is parsed.
+// Reconnects RECONNECT_MS after an error or end of stream, and starts a new
+// request once responseText gets large (it holds the whole stream).
+const RECONNECT_MS = 3000;
+const MAX_RESPONSE_CHARS = 1000000;
+
+// onStatus(status) for each event, onState(connected) on open/close.
+// Returns a function that closes the stream for good.
+export const openStatusStream = (url, onStatus, onState) => {
+  let xhr = null;
+  let parsed = 0; // responseText consumed up to here
+  let reconnectTimer = null;
+  let closed = false;
+
+  const scheduleReconnect = () => {
+    onState(false);
+    if (!closed && !reconnectTimer) {
+      reconnectTimer = setTimeout(() => { reconnectTimer = null; connect(); }, RECONNECT_MS);
+    }
+  };
+
+  const parseEvents = (text) => {
+    let end;
+    while ((end = text.indexOf('\n\n', parsed)) !== -1) {
+      const data = text.slice(parsed, end).split('\n')
+        .filter(line => line.startsWith('data:'))
+        .map(line => line.slice(5).trim())
+        .join('\n');
+      parsed = end + 2;
+      if (!data) continue; // Keepalive comment
+      try {
+        onStatus(JSON.parse(data));
+      } catch (e) {
+        console.warn("Bad status stream event:", e);
+      }
+    }
+  };
+
+  const connect = () => {
+    parsed = 0;
+    const request = new XMLHttpRequest();
+    xhr = request;
+    request.open('GET', url);
+    request.setRequestHeader('Accept', 'text/event-stream');
+    request.onreadystatechange = () => {
+      if (request !== xhr) return;
+      if (request.readyState === 2) onState(request.status === 200);
+    };
+    request.onprogress = () => {
+      if (request !== xhr || request.status !== 200) return;
+      parseEvents(request.responseText);
+      if (parsed > MAX_RESPONSE_CHARS) {
+        xhr = null;
+        request.abort();
+        connect();
+      }
+    };
+    request.onerror = () => { if (request === xhr) scheduleReconnect(); };
+    request.onload = () => { if (request === xhr) scheduleReconnect(); }; // Server closed the stream (or refused it)
+    request.send();
+  };
+
+  connect();
+  return () => {
+    closed = true;
+    if (reconnectTimer) clearTimeout(reconnectTimer);
+    const request = xhr;
+    xhr = null;
+    if (request) request.abort();
+  };
+};
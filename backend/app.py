@@ -3,11 +3,15 @@ import json
 import logging
 import threading
 import time
-from flask import Flask, request, jsonify, current_app
+from flask import Flask, Response, request, jsonify, current_app
 from flask_sqlalchemy import SQLAlchemy
 import paho.mqtt.client as mqtt
 from dotenv import load_dotenv
 
+from status_codec import is_compact_status, decode_status_batch
+from status_store import DeviceStatusStore
+from status_stream import StatusBroadcaster
+
 # --- Load Environment Variables ---
 load_dotenv() # Load .env file if present
 
@@ -32,11 +36,30 @@ app.config['MQTT_PORT'] = int(os.environ.get('MQTT_PORT', 1883))
 app.config['MQTT_USER'] = os.environ.get('MQTT_USER', None)
 app.config['MQTT_PASS'] = os.environ.get('MQTT_PASS', None)
 app.config['MQTT_CLIENT_ID'] = os.environ.get('MQTT_BACKEND_CLIENT_ID', 'backend_server')
-
-# Add a simple in-memory cache for latest device status
-# WARNING: This is lost on restart. For persistent status, use DB or Redis.
-device_status_cache = {}
-status_cache_lock = threading.Lock()
+# Status history: one sample per bucket, ring of HISTORY_LEN buckets per device,
+# closed buckets written to the status_sample table every FLUSH_S in one batch
+app.config['STATUS_HISTORY_BUCKET_S'] = float(os.environ.get('STATUS_HISTORY_BUCKET_S', 1.0))
+app.config['STATUS_HISTORY_LEN'] = int(os.environ.get('STATUS_HISTORY_LEN', 3600))
+app.config['STATUS_HISTORY_FLUSH_S'] = float(os.environ.get('STATUS_HISTORY_FLUSH_S', 10.0))
+app.config['STATUS_HISTORY_FLUSH_BATCH'] = int(os.environ.get('STATUS_HISTORY_FLUSH_BATCH', 5000))
+HISTORY_QUERY_MAX = 10000 # Max samples per history request
+# Live status streams (SSE): open stream limit, keepalive comment period and
+# the default/minimum spacing of events sent to one client
+app.config['STATUS_STREAM_MAX_CLIENTS'] = int(os.environ.get('STATUS_STREAM_MAX_CLIENTS', 100))
+app.config['STATUS_STREAM_KEEPALIVE_S'] = float(os.environ.get('STATUS_STREAM_KEEPALIVE_S', 15.0))
+STREAM_INTERVAL_DEFAULT_MS = 100
+STREAM_INTERVAL_MIN_MS = 20
+
+# Latest status and recent history in memory (see status_store.py); the
+# latest status is lost on restart, the history survives in the database.
+status_store = DeviceStatusStore(bucket_s=app.config['STATUS_HISTORY_BUCKET_S'],
+                                 history_len=app.config['STATUS_HISTORY_LEN'])
+# Fans status updates out to the open /status/stream clients (see status_stream.py)
+status_broadcaster = StatusBroadcaster(max_clients=app.config['STATUS_STREAM_MAX_CLIENTS'])
+
+# Device IDs in the config table, read once and kept up to date by PUT config
+config_device_ids = None
+config_device_ids_lock = threading.Lock()
 
 # --- Database Setup ---
 db = SQLAlchemy(app)
@@ -67,6 +90,15 @@ class DeviceConfig(db.Model):
     def __repr__(self):
         return f'<DeviceConfig {self.id}>'
 
+class StatusSample(db.Model):
+    """Downsampled status history, appended in batches by the flush thread."""
+    __tablename__ = 'status_sample'
+    id = db.Column(db.Integer, primary_key=True)
+    device_id = db.Column(db.String(80), nullable=False)
+    timestamp = db.Column(db.Float, nullable=False) # Device time (seconds since the epoch)
+    status_json = db.Column(db.Text, nullable=False)
+    __table_args__ = (db.Index('ix_status_sample_device_time', 'device_id', 'timestamp'),)
+
 # --- MQTT Client Setup ---
 mqtt_client = None
 mqtt_connected = threading.Event()
@@ -117,6 +149,16 @@ def on_mqtt_message(client, userdata, msg):
             msg_type = topic_parts[2]
 
             try:
+                if msg_type == 'status' and is_compact_status(msg.payload):
+                    # Compact batch (see status_codec.py): latest sample becomes the status
+                    samples = decode_status_batch(msg.payload)
+                    if not samples:
+                        return
+                    logger.debug(f"Received {len(samples)} compact status samples for {device_id}")
+                    status_store.update(device_id, samples, batch=bytes(msg.payload))
+                    status_broadcaster.publish(device_id, status_store.latest(device_id))
+                    return
+
                 payload_str = msg.payload.decode('utf-8')
                 if not payload_str:
                     logger.warning(f"Received empty payload on {msg.topic}")
@@ -125,28 +167,22 @@ def on_mqtt_message(client, userdata, msg):
 
                 if msg_type == 'status':
                     logger.debug(f"Received status for {device_id}: {payload}")
-                    # Update in-memory cache
-                    with status_cache_lock:
-                        device_status_cache[device_id] = payload
-                    # Optional: Persist to database or time-series DB if needed
-                    # Optional: Forward to WebSockets for real-time UI updates
+                    # Latest status and history (persisted by the flush thread)
+                    status_store.update(device_id, [payload])
+                    status_broadcaster.publish(device_id, status_store.latest(device_id))
 
                 elif msg_type == 'connection':
                     conn_status = payload.get("status", "unknown")
                     logger.info(f"Device connection update for {device_id}: {conn_status}")
-                    # Update cache or DB with connection status
-                    with status_cache_lock:
-                         # Ensure status entry exists
-                         if device_id not in device_status_cache:
-                              device_status_cache[device_id] = {}
-                         device_status_cache[device_id]['connection_status'] = conn_status
-                         device_status_cache[device_id]['connection_updated_at'] = time.time()
-                    # Optional: Forward to WebSockets
+                    status_store.set_connection(device_id, conn_status, time.time())
+                    status_broadcaster.publish(device_id, status_store.latest(device_id))
 
             except json.JSONDecodeError:
                 logger.warning(f"Received non-JSON MQTT message on {msg.topic}: {msg.payload}")
             except UnicodeDecodeError:
                  logger.warning(f"Received non-UTF8 MQTT message on {msg.topic}: {msg.payload}")
+            except ValueError as e: # After its subclasses above
+                logger.warning(f"Received malformed compact status on {msg.topic}: {e}")
             except Exception as e:
                 logger.error(f"Error processing MQTT message from {msg.topic}: {e}", exc_info=True)
         else:
@@ -185,6 +221,61 @@ def setup_mqtt(flask_app):
 
     return mqtt_client
 
+# --- Status History Flush ---
+history_flush_thread = None
+
+def flush_status_history(flask_app):
+    """Writes the closed history buckets to the database in batches; returns the count."""
+    written = 0
+    batch_size = flask_app.config['STATUS_HISTORY_FLUSH_BATCH']
+    while True:
+        rows = status_store.take_unflushed(batch_size)
+        if not rows:
+            return written
+        with flask_app.app_context():
+            try:
+                db.session.bulk_insert_mappings(StatusSample, [
+                    {"device_id": device_id, "timestamp": sample["timestamp"], "status_json": json.dumps(sample)}
+                    for device_id, sample in rows])
+                db.session.commit()
+                written += len(rows)
+            except Exception as e:
+                db.session.rollback()
+                logger.error(f"Failed to write {len(rows)} status history samples: {e}")
+                return written # Those samples are lost; try again with the next ones later
+
+def history_flush_loop(flask_app):
+    interval = flask_app.config['STATUS_HISTORY_FLUSH_S']
+    while True:
+        time.sleep(interval)
+        written = flush_status_history(flask_app)
+        if written:
+            logger.debug(f"Flushed {written} status history samples.")
+        if status_store.dropped:
+            logger.warning(f"{status_store.dropped} status history samples dropped so far (flush too slow).")
+
+def start_history_flush(flask_app):
+    global history_flush_thread
+    if history_flush_thread:
+        return history_flush_thread
+    history_flush_thread = threading.Thread(target=history_flush_loop, args=(flask_app,),
+                                            name="HistoryFlush", daemon=True)
+    history_flush_thread.start()
+    logger.info(f"Status history flush every {flask_app.config['STATUS_HISTORY_FLUSH_S']} s started.")
+    return history_flush_thread
+
+def known_config_device_ids():
+    """Device IDs with a stored config (the table is read on the first call only)."""
+    global config_device_ids
+    with config_device_ids_lock:
+        if config_device_ids is None:
+            try:
+                config_device_ids = {d.id for d in db.session.query(DeviceConfig.id).all()}
+            except Exception as e:
+                logger.error(f"Error querying devices from DB: {e}")
+                return set() # Don't fail the request, try again next time
+        return set(config_device_ids)
+
 # --- API Routes ---
 @app.route('/api/health', methods=['GET'])
 def health_check():
@@ -239,6 +330,9 @@ def update_device_config(device_id):
         device.set_config(data) # This also validates basic JSON serialization
         db.session.commit()
         logger.info(f"Successfully updated config for device {device_id}")
+        with config_device_ids_lock:
+            if config_device_ids is not None:
+                config_device_ids.add(device_id)
 
         # Optional: Publish a notification that config was updated?
         # if mqtt_connected.is_set():
@@ -299,14 +393,13 @@ def send_device_command(device_id):
 def get_device_status(device_id):
     """Returns the latest cached status for the device."""
     logger.info(f"GET /api/devices/{device_id}/status")
-    with status_cache_lock:
-        status = device_status_cache.get(device_id)
+    status = status_store.latest(device_id)
 
     if status:
         return jsonify(status), 200
     else:
         # Check if device config exists as indicator device is known
-        device_exists = DeviceConfig.query.get(device_id) is not None
+        device_exists = device_id in known_config_device_ids()
         if device_exists:
              logger.warning(f"Status requested for known device {device_id}, but no status cached.")
              return jsonify({"error": "Device status not available yet"}), 404 # Or 200 with empty body?
@@ -315,28 +408,113 @@ def get_device_status(device_id):
              return jsonify({"error": "Device not found"}), 404
 
 
+@app.route('/api/devices/<string:device_id>/status/compact', methods=['GET'])
+def get_device_status_batch(device_id):
+    """Returns the latest compact status batch as received (application/octet-stream)."""
+    logger.info(f"GET /api/devices/{device_id}/status/compact")
+    batch = status_store.latest_batch(device_id)
+
+    if batch:
+        return current_app.response_class(batch, mimetype='application/octet-stream'), 200
+    logger.warning(f"Compact status requested for {device_id}, but none received.")
+    return jsonify({"error": "No compact status received from this device"}), 404
+
+
+@app.route('/api/devices/<string:device_id>/status/history', methods=['GET'])
+def get_device_status_history(device_id):
+    """
+    Downsampled status samples with from <= timestamp < to (seconds, default:
+    the last hour), oldest first, at most 'limit'. Recent samples come from
+    memory; the database is only read for what is older than that.
+    """
+    logger.info(f"GET /api/devices/{device_id}/status/history")
+    now = time.time()
+    try:
+        end = float(request.args.get('to', now))
+        start = float(request.args.get('from', end - 3600.0))
+        limit = min(int(request.args.get('limit', 1000)), HISTORY_QUERY_MAX)
+    except ValueError:
+        return jsonify({"error": "from and to must be numbers (seconds), limit an integer"}), 400
+    if limit <= 0 or start >= end:
+        return jsonify({"error": "Empty range"}), 400
+
+    samples, oldest_in_memory = status_store.history(device_id, start, end, limit)
+    if oldest_in_memory is None or start < oldest_in_memory:
+        # Older part from the database, then the samples held in memory
+        db_end = end if oldest_in_memory is None else min(end, oldest_in_memory)
+        try:
+            rows = (StatusSample.query
+                    .filter(StatusSample.device_id == device_id,
+                            StatusSample.timestamp >= start, StatusSample.timestamp < db_end)
+                    .order_by(StatusSample.timestamp)
+                    .limit(limit).all())
+        except Exception as e:
+            logger.error(f"Database error reading status history for {device_id}: {e}")
+            return jsonify({"error": "Failed to read status history"}), 500
+        older = [json.loads(row.status_json) for row in rows]
+        samples = (older + samples)[:limit]
+
+    return jsonify({
+        "device_id": device_id,
+        "bucket_s": status_store.bucket_s,
+        "samples": samples,
+    }), 200
+
+
+@app.route('/api/devices/<string:device_id>/status/stream', methods=['GET'])
+def stream_device_status(device_id):
+    """
+    Server-sent events: the latest status (if any), then one 'data:' event per
+    status update, at most one every interval_ms (default 100). Updates that
+    arrive faster than the client takes them are coalesced: only the newest
+    one is sent. A comment line is sent when idle to keep proxies from
+    closing the connection.
+    """
+    logger.info(f"GET /api/devices/{device_id}/status/stream")
+    try:
+        interval_ms = int(request.args.get('interval_ms', STREAM_INTERVAL_DEFAULT_MS))
+    except ValueError:
+        return jsonify({"error": "interval_ms must be an integer"}), 400
+    interval_s = max(interval_ms, STREAM_INTERVAL_MIN_MS) / 1000.0
+    keepalive_s = current_app.config['STATUS_STREAM_KEEPALIVE_S']
+
+    sub = status_broadcaster.subscribe(device_id)
+    if sub is None:
+        logger.warning(f"Status stream for {device_id} refused: {status_broadcaster.max_clients} streams open.")
+        return jsonify({"error": "Too many status streams open"}), 503
+
+    def events():
+        try:
+            status = status_store.latest(device_id)
+            if status:
+                yield f"data: {json.dumps(status)}\n\n"
+            while True:
+                status = sub.next(keepalive_s)
+                if status is None:
+                    yield ": keepalive\n\n"
+                    continue
+                yield f"data: {json.dumps(status)}\n\n"
+                time.sleep(interval_s) # Updates meanwhile coalesce in the subscription
+        finally: # Client gone (generator closed by the server)
+            status_broadcaster.unsubscribe(sub)
+            logger.info(f"Status stream for {device_id} closed ({sub.coalesced} updates coalesced).")
+
+    headers = {'Cache-Control': 'no-cache', 'X-Accel-Buffering': 'no'}
+    return Response(events(), mimetype='text/event-stream', headers=headers)
+
+
 @app.route('/api/devices', methods=['GET'])
 def list_devices():
     """Lists devices known by config and/or cached status."""
     logger.info("GET /api/devices")
-    known_devices = set()
-
-    # Devices from Config DB
-    try:
-        config_devices = db.session.query(DeviceConfig.id).all()
-        known_devices.update([d.id for d in config_devices])
-    except Exception as e:
-         logger.error(f"Error querying devices from DB: {e}")
-         # Don't fail the request, just might miss some devices
-
-    # Devices from Status Cache
-    with status_cache_lock:
-        known_devices.update(device_status_cache.keys())
+    # Devices from the config table (cached) and the status store
+    statuses = status_store.snapshot()
+    known_devices = known_config_device_ids()
+    known_devices.update(statuses.keys())
 
     device_list = []
-    for dev_id in sorted(list(known_devices)):
-         with status_cache_lock:
-              status = device_status_cache.get(dev_id, {})
+    for dev_id in sorted(known_devices):
+         status = statuses.get(dev_id, {})
          device_list.append({
              "id": dev_id,
              "connection_status": status.get("connection_status", "unknown"),
@@ -363,6 +541,7 @@ def initialize_app():
 
         # Setup MQTT client
         setup_mqtt(current_app)
+        start_history_flush(app)
 
 
 # --- Main Entry Point (for development) ---
@@ -378,6 +557,7 @@ if __name__ == '__main__':
          except Exception as e:
               logger.error(f"CRITICAL: Failed to create database tables (main): {e}", exc_info=True)
          setup_mqtt(app)
+         start_history_flush(app)
 
     # Consider using threaded=True for dev server if needed, but be wary of context issues
     app.run(host='0.0.0.0', port=5000, debug=os.environ.get('FLASK_DEBUG', 'False').lower() == 'true')
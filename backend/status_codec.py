@@ -0,0 +1,61 @@
+import struct
+
+# --- Compact Status Format (Mirror from rpi_zero_agent/status_codec.py) ---
+#   [MAGIC] [VERSION] [NUM_AXES] [COUNT] [T0 f64]
+#   COUNT x [DT_MS u16] [STATUS] [SWITCHES] [ERRORS] [POS x NUM_AXES] [SPEED u16 x NUM_AXES]
+# Key samples (DT_KEY_FLAG) carry absolute i32 positions, the others i16 deltas.
+COMPACT_MAGIC = 0xB5
+COMPACT_VERSION = 1
+HEADER_FORMAT = '<BBBBd'
+HEADER_LEN = struct.calcsize(HEADER_FORMAT)
+DT_KEY_FLAG = 0x8000
+
+def is_compact_status(payload):
+    return len(payload) >= 1 and payload[0] == COMPACT_MAGIC
+
+def decode_status_batch(payload):
+    """
+    Unpacks a compact status message into a list of status dicts, with the
+    same keys as the JSON status. Raises ValueError on a malformed message.
+    """
+    if len(payload) < HEADER_LEN:
+        raise ValueError(f"Compact status too short ({len(payload)} bytes)")
+    magic, version, num_axes, count, t0 = struct.unpack_from(HEADER_FORMAT, payload)
+    if magic != COMPACT_MAGIC or version != COMPACT_VERSION:
+        raise ValueError(f"Unsupported compact status (magic {magic:#04x}, version {version})")
+    key_format = '<HBBB' + 'i' * num_axes + 'H' * num_axes
+    delta_format = '<HBBB' + 'h' * num_axes + 'H' * num_axes
+
+    samples = []
+    offset = HEADER_LEN
+    time_ms = 0
+    pos = None
+    for _ in range(count):
+        if offset + 2 > len(payload):
+            raise ValueError("Compact status truncated")
+        dt = struct.unpack_from('<H', payload, offset)[0]
+        key = (dt & DT_KEY_FLAG) != 0
+        if not key and pos is None:
+            raise ValueError("Compact status starts with a delta sample")
+        sample_format = key_format if key else delta_format
+        if offset + struct.calcsize(sample_format) > len(payload):
+            raise ValueError("Compact status truncated")
+        values = struct.unpack_from(sample_format, payload, offset)
+        offset += struct.calcsize(sample_format)
+
+        time_ms += dt & ~DT_KEY_FLAG
+        axis_values = values[4:4 + num_axes]
+        pos = list(axis_values) if key else [p + d for p, d in zip(pos, axis_values)]
+        sample = {
+            "timestamp": t0 + time_ms / 1000.0,
+            "status_flags": values[1],
+            "switch_flags": values[2],
+            "error_flags": values[3],
+        }
+        for axis in range(num_axes):
+            sample[f"motor{axis + 1}_pos"] = pos[axis]
+            sample[f"motor{axis + 1}_speed"] = values[4 + num_axes + axis]
+        samples.append(sample)
+    if offset != len(payload):
+        raise ValueError(f"Compact status has {len(payload) - offset} trailing bytes")
+    return samples
@@ -0,0 +1,106 @@
+import math
+import threading
+from collections import deque
+
+# --- Device Status Store ---
+# Everything the status endpoints serve, kept in memory:
+#  - the latest status per device (O(1) lookup, no database access),
+#  - a downsampled history per device: one sample per bucket_s (the latest
+#    one received in that interval) in a ring buffer of history_len buckets,
+#  - closed buckets not yet written to the database, taken in batches by
+#    the flush thread in app.py (at most max_unflushed, oldest dropped first).
+# Samples are status dicts with a "timestamp" (seconds), as sent by the agent.
+
+class DeviceStatusStore:
+    def __init__(self, bucket_s=1.0, history_len=3600, max_unflushed=100000):
+        self.bucket_s = bucket_s
+        self.history_len = history_len
+        self._lock = threading.Lock()
+        self._latest = {}           # device_id -> status dict
+        self._batches = {}          # device_id -> latest compact status message (raw bytes)
+        self._history = {}          # device_id -> deque of [bucket, sample]
+        self._unflushed = deque(maxlen=max_unflushed) # (device_id, sample) of closed buckets
+        self.dropped = 0            # Closed buckets lost to a full unflushed queue
+
+    def update(self, device_id, samples, batch=None):
+        """Records status samples (oldest first); the last one becomes the latest status."""
+        if not samples:
+            return
+        with self._lock:
+            latest = dict(samples[-1])
+            previous = self._latest.get(device_id, {})
+            for key in ('connection_status', 'connection_updated_at'):
+                if key in previous:
+                    latest[key] = previous[key]
+            self._latest[device_id] = latest
+            if batch is not None:
+                self._batches[device_id] = batch
+
+            history = self._history.get(device_id)
+            if history is None:
+                history = self._history[device_id] = deque(maxlen=self.history_len)
+            for sample in samples:
+                timestamp = sample.get("timestamp")
+                if not isinstance(timestamp, (int, float)):
+                    continue
+                bucket = math.floor(timestamp / self.bucket_s)
+                if history and bucket == history[-1][0]:
+                    history[-1][1] = sample # Latest sample of the bucket wins
+                elif not history or bucket > history[-1][0]:
+                    if history:
+                        self._queue_flush(device_id, history[-1][1])
+                    history.append([bucket, sample])
+                # Older than the open bucket (reordered delivery): dropped
+
+    def _queue_flush(self, device_id, sample):
+        if len(self._unflushed) == self._unflushed.maxlen:
+            self.dropped += 1
+        self._unflushed.append((device_id, sample))
+
+    def set_connection(self, device_id, status, updated_at):
+        with self._lock:
+            latest = dict(self._latest.get(device_id, {}))
+            latest['connection_status'] = status
+            latest['connection_updated_at'] = updated_at
+            self._latest[device_id] = latest
+
+    def latest(self, device_id):
+        with self._lock:
+            return self._latest.get(device_id)
+
+    def latest_batch(self, device_id):
+        with self._lock:
+            return self._batches.get(device_id)
+
+    def snapshot(self):
+        """Latest status of every device (a shallow copy, for listings)."""
+        with self._lock:
+            return dict(self._latest)
+
+    def history(self, device_id, start, end, limit):
+        """
+        Downsampled samples with start <= timestamp < end, oldest first, at
+        most 'limit' (the oldest ones). Also returns the timestamp of the
+        oldest sample still held, or None: anything older must come from the
+        database.
+        """
+        with self._lock:
+            history = self._history.get(device_id)
+            if not history:
+                return [], None
+            oldest = history[0][1]["timestamp"]
+            samples = []
+            for _, sample in history:
+                timestamp = sample["timestamp"]
+                if timestamp < start:
+                    continue
+                if timestamp >= end or len(samples) >= limit:
+                    break
+                samples.append(sample)
+            return samples, oldest
+
+    def take_unflushed(self, max_count):
+        """Removes and returns up to max_count closed buckets, oldest first."""
+        with self._lock:
+            count = min(max_count, len(self._unflushed))
+            return [self._unflushed.popleft() for _ in range(count)]
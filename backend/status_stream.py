@@ -0,0 +1,67 @@
+import threading
+
+# --- Live Status Fan-out (Server-Sent Events) ---
+# The MQTT thread publishes every status update; each stream client has one
+# slot holding the newest update it has not sent yet. Publishing overwrites
+# the slot and never waits, so a slow client (its socket writes block the
+# thread serving it) just skips to the newest status: per-client coalescing
+# with bounded memory, and the MQTT thread is never held up by a client.
+
+class Subscription:
+    def __init__(self, device_id):
+        self.device_id = device_id
+        self._cond = threading.Condition()
+        self._pending = None
+        self.coalesced = 0          # Updates replaced before they were sent
+
+    def offer(self, status):
+        with self._cond:
+            if self._pending is not None:
+                self.coalesced += 1
+            self._pending = status
+            self._cond.notify()
+
+    def next(self, timeout):
+        """Newest unsent status, or None if none arrived within timeout."""
+        with self._cond:
+            if self._pending is None:
+                self._cond.wait(timeout)
+            status, self._pending = self._pending, None
+            return status
+
+
+class StatusBroadcaster:
+    def __init__(self, max_clients=100):
+        self.max_clients = max_clients
+        self._lock = threading.Lock()
+        self._subscribers = {}      # device_id -> set of Subscription
+        self._count = 0
+
+    def subscribe(self, device_id):
+        """Returns a Subscription, or None if max_clients streams are open."""
+        with self._lock:
+            if self._count >= self.max_clients:
+                return None
+            sub = Subscription(device_id)
+            self._subscribers.setdefault(device_id, set()).add(sub)
+            self._count += 1
+            return sub
+
+    def unsubscribe(self, sub):
+        with self._lock:
+            subs = self._subscribers.get(sub.device_id)
+            if subs and sub in subs:
+                subs.discard(sub)
+                self._count -= 1
+                if not subs:
+                    del self._subscribers[sub.device_id]
+
+    def publish(self, device_id, status):
+        with self._lock:
+            subs = list(self._subscribers.get(device_id, ()))
+        for sub in subs:
+            sub.offer(status)
+
+    def client_count(self):
+        with self._lock:
+            return self._count
@@ -1,14 +1,16 @@
 # Entry point for WSGI servers like Gunicorn
 
-from app import app, db, setup_mqtt # Import necessary components from your main app file
+from app import app, db, setup_mqtt, start_history_flush # Import necessary components from your main app file
 
 # It's crucial to initialize MQTT and DB *after* potential forking by Gunicorn workers
 # Gunicorn's post_fork hook is a good place, but for simplicity,
 # we rely on Flask's @before_first_request or explicit calls in __main__ for dev.
 # For Gunicorn, you might configure hooks in its config file instead.
 
-# Example Gunicorn command:
-# gunicorn --bind 0.0.0.0:5000 wsgi:app
+# Example Gunicorn command (each open /status/stream holds a thread, so use
+# threaded or async workers rather than the default sync ones):
+# gunicorn --bind 0.0.0.0:5000 --workers 1 --threads 32 wsgi:app
+# Keep a single worker: the status store and stream clients are per process.
 
 # If you need explicit init here (less common for Flask apps structured this way):
 # with app.app_context():
@@ -18,6 +20,7 @@ from app import app, db, setup_mqtt # Import necessary components from your main
 #     except Exception as e:
 #         print(f"WSGI CRITICAL: Failed to create database tables: {e}")
 #     setup_mqtt(app)
+#     start_history_flush(app)
 #     print("WSGI: MQTT client setup initiated.")
 
 if __name__ == "__main__":
@@ -31,6 +34,7 @@ if __name__ == "__main__":
          except Exception as e:
               print(f"WSGI Dev CRITICAL: Failed to create database tables: {e}")
          setup_mqtt(app)
+         start_history_flush(app)
          print("WSGI Dev: MQTT client setup initiated.")
 
     app.run(host='0.0.0.0', port=5000, debug=True)
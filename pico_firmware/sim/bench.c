@@ -0,0 +1,971 @@
+// --- Firmware Benchmarks on the Host Simulator ---
+// Runs the firmware sources against the simulated HAL (sim_hal.c) and reports:
+//  1. Protocol throughput: frames/s the core 0 loop parses on this host
+//     (legacy READ, framed READ, WRITE, READ_MULTI), that a READ_MULTI with
+//     a bogus range count is rejected whole, that a framed READ is still
+//     found behind garbage full of preambles, and the link-limited
+//     round-trip rate at 115200 and 921600 baud (virtual time).
+//  2. Loop latency: all axes moving, telemetry on, the host polling. Host
+//     time per loop pass (max/avg per core), the longest a pass blocks in
+//     virtual time (SPI, waits) and the worst poll turnaround.
+//  3. Step timing: the pulse times of a trapezoidal move against the ideal
+//     profile (max/RMS error), final position, FIFO underruns. Afterwards
+//     the changed registers are fetched (CMD_READ_CHANGES) until none are left.
+//  4. Config push: every axis' config as one staged write (CMD_STAGE_WRITE +
+//     CMD_STAGE_COMMIT) against one WRITE per register (virtual time), and
+//     that a commit with the wrong CRC writes nothing.
+//  5. Driver monitor: pulses the driver missed are found through MSCNT and
+//     the position corrected; a stall stops the axis (time to standstill),
+//     or stops and re-homes it.
+//  6. Endstops: running into the switch hard-stops the axis with its
+//     position matching the pulses emitted; resting on it,
+//     a move, a queued segment and a coordinated line further in are
+//     refused (REG_ERROR_FLAGS), a move away runs.
+//  7. Coordinated lines: on a 10:1 and a 10:9 line every minor pulse m
+//     falls on major pulse ceil(m * major / minor), so both axes end on
+//     the same pulse.
+// Virtual-time results are deterministic; with --check they are compared to
+// the limits below and the exit status fails the build on a regression.
+// Host-time results vary with the machine and are only checked when a limit
+// is given on the command line.
+//
+// Usage: stepper_bench [--check] [--verbose] [--min-frames-per-sec N] [--max-pass-ns N]
+
+#include "sim_firmware.h"
+#include "registers.h"
+#include "uart_protocol.h"
+#include "motor_control.h"
+#include "telemetry.h"
+#include "tmc2130.h" // TMC_DAISY_CHAIN
+#include "driver_monitor.h"
+#include "homing.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// --- Limits for --check (virtual time, deterministic) ---
+#define LIMIT_LINK_EFFICIENCY_PCT   90.0    // Pipelined READ round trips vs. the wire limit
+#define LIMIT_CORE0_BLOCK_US        600.0   // Longest core 0 pass (blocking SPI config writes)
+#define LIMIT_CORE1_BLOCK_US        50.0    // Core 1 must never wait
+#define LIMIT_POLL_TURNAROUND_US    100.0   // Last request byte in -> first response byte out (idle line)
+#define LIMIT_STALL_STOP_MS         200.0   // Stall -> standstill (detection + ramp down at MONITOR_ACCEL)
+// Pulse times against the ideal trapezoid (planner measures ~35 us max and
+// RMS): 2x margin, still well under one cruise interval (125 us)
+#define LIMIT_RAMP_ERR_MAX_US       75.0    // Accel and cruise
+#define LIMIT_STEP_ERR_MAX_US       75.0    // Whole move, the steps into standstill included
+#define LIMIT_STEP_ERR_RMS_US       75.0
+
+#define PASS_NS             10000ull        // Virtual time between loop passes (both cores)
+#define IDLE_GAP_NS         600000000ull    // Between scenarios: > UART_LEGACY_RESUME_US
+#define THROUGHPUT_FRAMES   20000
+#define LINK_FRAMES         2000
+#define LINK_IN_FLIGHT      4
+#define STEP_MOVE_STEPS     20000
+#define STEP_MOVE_SPEED     8000            // steps/s
+#define STEP_MOVE_ACCEL     20000           // steps/s^2
+#define BAUD_CODE_921600    3               // Index in UART_BAUD_TABLE
+#define MONITOR_DROPPED     3               // Pulses the driver misses
+#define MONITOR_SPEED       3000            // steps/s, above COOLSTEP_MIN_SPEED (StallGuard valid)
+#define MONITOR_ACCEL       20000           // steps/s^2
+#define ENDSTOP_PIN         20              // Switch of axis 0 (switch_pins in sim_firmware.c)
+
+// Registers the benchmark reads back: plain storage nothing else writes
+// (REG_MOTOR_QUEUE_TARGET..QUEUE_ACCEL, only used on a QUEUE_CONTROL push)
+#define BENCH_READ_ADDR     REG_MOTOR_QUEUE_TARGET_L(0)
+#define BENCH_READ_LEN      8
+
+static bool check_mode = false;
+static double min_frames_per_sec = 0;
+static double max_pass_ns = 0;
+static int failures = 0;
+
+// --- Host Time ---
+static inline uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// --- Reporting ---
+static void report(const char *name, double value, const char *unit) {
+    printf("  %-38s %12.2f %s\n", name, value, unit);
+}
+
+static void limit_max(const char *name, double value, double limit) {
+    if (check_mode && value > limit) {
+        printf("  FAIL: %s = %.2f, limit %.2f\n", name, value, limit);
+        failures++;
+    }
+}
+
+static void limit_min(const char *name, double value, double limit) {
+    if (check_mode && value < limit) {
+        printf("  FAIL: %s = %.2f, limit %.2f\n", name, value, limit);
+        failures++;
+    }
+}
+
+// --- Frame Builders (what rpi_zero_agent/serial_handler.py sends) ---
+static size_t add_checksum(uint8_t *buf, size_t len) {
+    buf[len] = calculate_checksum(buf, len);
+    return len + 1;
+}
+
+// Address field: short form below REG_SHORT_ADDR_LIMIT, else CMD_ADDR16_FLAG
+static size_t put_addr(uint8_t *buf, uint8_t cmd, uint16_t addr) {
+    if (addr < REG_SHORT_ADDR_LIMIT) {
+        buf[0] = cmd;
+        buf[1] = (uint8_t)addr;
+        return 2;
+    }
+    buf[0] = cmd | CMD_ADDR16_FLAG;
+    buf[1] = (uint8_t)addr;
+    buf[2] = (uint8_t)(addr >> 8);
+    return 3;
+}
+
+static size_t build_read(uint8_t *buf, uint16_t addr, uint8_t len) {
+    size_t n = put_addr(buf, CMD_READ, addr);
+    buf[n++] = len;
+    return add_checksum(buf, n);
+}
+
+static size_t build_write(uint8_t *buf, uint16_t addr, const uint8_t *data, uint8_t len) {
+    size_t n = put_addr(buf, CMD_WRITE, addr);
+    buf[n++] = len;
+    memcpy(&buf[n], data, len);
+    return add_checksum(buf, n + len);
+}
+
+// Always the 16-bit range form, so every map size works
+static size_t build_read_multi(uint8_t *buf, const uint16_t *addrs, const uint8_t *lens, uint count) {
+    size_t n = 0;
+    uint total = 0;
+    buf[n++] = CMD_READ_MULTI | CMD_ADDR16_FLAG;
+    buf[n++] = (uint8_t)count;
+    n++; // TOTAL_LEN
+    for (uint i = 0; i < count; i++) {
+        buf[n++] = (uint8_t)addrs[i];
+        buf[n++] = (uint8_t)(addrs[i] >> 8);
+        buf[n++] = lens[i];
+        total += lens[i];
+    }
+    buf[2] = (uint8_t)total;
+    return add_checksum(buf, n);
+}
+
+static size_t build_read_changes(uint8_t *buf) {
+    buf[0] = CMD_READ_CHANGES;
+    buf[1] = 0;
+    buf[2] = 0; // Default budget
+    return add_checksum(buf, 3);
+}
+
+static size_t build_stage_write(uint8_t *buf, uint8_t runs_byte, const uint8_t *payload, uint8_t len) {
+    buf[0] = CMD_STAGE_WRITE;
+    buf[1] = runs_byte;
+    buf[2] = len;
+    memcpy(&buf[3], payload, len);
+    return add_checksum(buf, 3 + len);
+}
+
+static size_t build_stage_commit(uint8_t *buf, uint8_t runs, uint16_t crc) {
+    buf[0] = CMD_STAGE_COMMIT;
+    buf[1] = runs;
+    buf[2] = 2;
+    buf[3] = (uint8_t)(crc >> 8);
+    buf[4] = (uint8_t)crc;
+    return add_checksum(buf, 5);
+}
+
+// Legacy frame -> framed (v2): drop the checksum, add preamble, LEN and CRC
+static size_t frame_wrap(uint8_t *out, const uint8_t *legacy, size_t len) {
+    size_t body = len - 1;
+    out[0] = FRAME_SYNC0;
+    out[1] = FRAME_SYNC1;
+    out[2] = (uint8_t)body;
+    memcpy(&out[3], legacy, body);
+    uint16_t crc = frame_crc16(FRAME_CRC_INIT, &out[2], body + 1);
+    out[3 + body] = (uint8_t)(crc >> 8);
+    out[4 + body] = (uint8_t)crc;
+    return body + 5;
+}
+
+// --- Running the Firmware ---
+typedef struct {
+    uint64_t passes;
+    uint64_t host_sum_ns;
+    uint64_t host_max_ns;
+    uint64_t virt_max_ns;   // Virtual time spent inside one pass (blocking calls)
+} pass_stats_t;
+
+static pass_stats_t core_stats[2];
+
+static void reset_pass_stats(void) {
+    memset(core_stats, 0, sizeof(core_stats));
+}
+
+static void timed_pass(uint core) {
+    pass_stats_t *s = &core_stats[core];
+    uint64_t v0 = sim_now_ns();
+    uint64_t h0 = host_ns();
+    if (core == 0) {
+        sim_core0_pass();
+    } else {
+        sim_core1_pass();
+    }
+    uint64_t h = host_ns() - h0;
+    uint64_t v = sim_now_ns() - v0;
+    s->passes++;
+    s->host_sum_ns += h;
+    if (h > s->host_max_ns) s->host_max_ns = h;
+    if (v > s->virt_max_ns) s->virt_max_ns = v;
+}
+
+static void step(void) {
+    timed_pass(1);
+    timed_pass(0);
+    sim_advance(PASS_NS);
+}
+
+static void run_for(uint64_t ns) {
+    uint64_t end = sim_now_ns() + ns;
+    while (sim_now_ns() < end) step();
+}
+
+// Collect firmware output until 'len' bytes have arrived (or the timeout)
+static bool await_bytes(uint8_t *buf, size_t len, uint64_t timeout_ns) {
+    size_t got = 0;
+    uint64_t end = sim_now_ns() + timeout_ns;
+    while (got < len && sim_now_ns() < end) {
+        step();
+        got += sim_uart_receive(&buf[got], len - got);
+    }
+    return got == len;
+}
+
+static bool transact(const uint8_t *req, size_t req_len, uint8_t *resp, size_t resp_len) {
+    sim_uart_send(req, req_len);
+    return await_bytes(resp, resp_len, 50000000ull);
+}
+
+static bool write_registers(uint16_t addr, const uint8_t *data, uint8_t len) {
+    uint8_t req[32], resp[8];
+    size_t resp_len = addr < REG_SHORT_ADDR_LIMIT ? 3 : 5;
+    if (!transact(req, build_write(req, addr, data, len), resp, resp_len)) return false;
+    return resp[resp_len - 2] == RESP_ACK;
+}
+
+static void write_u8(uint16_t addr, uint8_t value) {
+    if (!write_registers(addr, &value, 1)) {
+        printf("  setup write to 0x%03X failed\n", addr);
+        failures++;
+    }
+}
+
+static void write_u16(uint16_t addr, uint16_t value) {
+    uint8_t d[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    if (!write_registers(addr, d, 2)) {
+        printf("  setup write to 0x%03X failed\n", addr);
+        failures++;
+    }
+}
+
+static void write_u32(uint16_t addr, uint32_t value) {
+    uint8_t d[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    if (!write_registers(addr, d, 4)) {
+        printf("  setup write to 0x%03X failed\n", addr);
+        failures++;
+    }
+}
+
+static void boot(void) {
+    sim_firmware_boot();
+    reset_pass_stats();
+    run_for(1000000ull);
+    // Something recognisable to read back
+    for (uint i = 0; i < BENCH_READ_LEN; i++) {
+        uint8_t v = (uint8_t)(0x40 + i);
+        write_registers(BENCH_READ_ADDR + i, &v, 1);
+    }
+}
+
+static void idle_gap(void) {
+    sim_advance(IDLE_GAP_NS); // Loops not needed: nothing happens on the link
+    sim_uart_receive((uint8_t[256]){0}, 256);
+}
+
+static bool read_response_ok(const uint8_t *resp, uint16_t addr, uint8_t len, bool framed) {
+    const uint8_t *body = framed ? &resp[3] : resp;
+    size_t body_len = (size_t)len + 2;
+    if (framed) {
+        if (resp[0] != FRAME_SYNC0 || resp[1] != FRAME_SYNC1 || resp[2] != body_len) return false;
+        uint16_t crc = frame_crc16(FRAME_CRC_INIT, &resp[2], body_len + 1);
+        if (resp[3 + body_len] != (uint8_t)(crc >> 8) || resp[4 + body_len] != (uint8_t)crc) return false;
+    } else if (calculate_checksum(resp, body_len) != resp[body_len]) {
+        return false;
+    }
+    if (body[0] != (uint8_t)addr || body[1] != len) return false;
+    for (uint i = 0; i < len; i++) {
+        if (body[2 + i] != (uint8_t)(0x40 + i)) return false;
+    }
+    return true;
+}
+
+// --- 1. Protocol Throughput ---
+// One frame at a time; only the core 0 pass that handles it is timed
+static void bench_frames(const char *name, const uint8_t *req, size_t req_len, size_t resp_len,
+                         bool check_read, bool framed) {
+    uint8_t resp[64];
+    uint64_t host_total = 0;
+    uint bad = 0;
+    for (uint i = 0; i < THROUGHPUT_FRAMES; i++) {
+        sim_uart_send(req, req_len);
+        sim_advance_to(sim_uart_rx_done_ns());
+        uint64_t h0 = host_ns();
+        sim_core0_pass();
+        host_total += host_ns() - h0;
+        sim_core1_pass(); // Consumes forwarded writes
+        size_t got = 0;
+        for (uint spin = 0; got < resp_len && spin < 10000; spin++) {
+            uint64_t next = sim_uart_next_tx_ns();
+            if (next == UINT64_MAX) {
+                sim_advance(PASS_NS);
+                sim_core0_pass();
+            } else {
+                sim_advance_to(next);
+            }
+            got += sim_uart_receive(&resp[got], resp_len - got);
+        }
+        if (got != resp_len || (check_read && !read_response_ok(resp, BENCH_READ_ADDR, BENCH_READ_LEN, framed))) bad++;
+    }
+    double fps = host_total ? THROUGHPUT_FRAMES * 1e9 / (double)host_total : 0;
+    report(name, fps, "frames/s (host)");
+    if (bad) {
+        printf("  FAIL: %s: %u of %u responses missing or wrong\n", name, bad, THROUGHPUT_FRAMES);
+        failures++;
+    }
+    if (min_frames_per_sec > 0) limit_min(name, fps, min_frames_per_sec);
+}
+
+// Pipelined READs: LINK_IN_FLIGHT frames outstanding, as fast as the line allows
+static void bench_link(uint32_t baud) {
+    uint8_t req[16], resp[64];
+    size_t req_len = build_read(req, BENCH_READ_ADDR, BENCH_READ_LEN);
+    size_t resp_len = BENCH_READ_LEN + 3;
+    uint sent = 0, done = 0, bad = 0;
+    size_t partial = 0;
+    uint64_t start = sim_now_ns();
+    uint64_t timeout = start + 10000000000ull;
+    while (done < LINK_FRAMES && sim_now_ns() < timeout) {
+        while (sent < LINK_FRAMES && sent - done < LINK_IN_FLIGHT) {
+            sim_uart_send(req, req_len);
+            sent++;
+        }
+        step();
+        size_t n;
+        while ((n = sim_uart_receive(&resp[partial], resp_len - partial)) > 0) {
+            partial += n;
+            if (partial == resp_len) {
+                if (!read_response_ok(resp, BENCH_READ_ADDR, BENCH_READ_LEN, false)) bad++;
+                done++;
+                partial = 0;
+            }
+        }
+    }
+    double elapsed_s = (double)(sim_now_ns() - start) / 1e9;
+    double rate = done / elapsed_s;
+    double wire_limit = baud / (10.0 * (double)(resp_len > req_len ? resp_len : req_len));
+    char name[64];
+    snprintf(name, sizeof(name), "READ round trips @ %u baud", (unsigned)baud);
+    report(name, rate, "frames/s (virtual)");
+    snprintf(name, sizeof(name), "  link efficiency @ %u baud", (unsigned)baud);
+    report(name, 100.0 * rate / wire_limit, "% of wire limit");
+    limit_min(name, 100.0 * rate / wire_limit, LIMIT_LINK_EFFICIENCY_PCT);
+    if (bad || done < LINK_FRAMES) {
+        printf("  FAIL: %u of %u round trips missing or wrong\n", LINK_FRAMES - done + bad, LINK_FRAMES);
+        failures++;
+    }
+}
+
+// Garbage made of back-to-back preambles (each one's CRC check runs into the
+// next), then a valid framed READ: answered once, with nothing else
+#define RESYNC_PREAMBLES    61
+
+static void bench_resync(const uint8_t *framed, size_t framed_len) {
+    uint8_t garbage[3 * RESYNC_PREAMBLES];
+    for (uint i = 0; i < RESYNC_PREAMBLES; i++) {
+        garbage[3 * i] = FRAME_SYNC0;
+        garbage[3 * i + 1] = FRAME_SYNC1;
+        garbage[3 * i + 2] = 1; // LEN
+    }
+    sim_uart_send(garbage, sizeof(garbage));
+    sim_uart_send(framed, framed_len);
+    uint8_t resp[64];
+    size_t resp_len = BENCH_READ_LEN + 2 + 5;
+    bool ok = await_bytes(resp, resp_len, 50000000ull) && read_response_ok(resp, BENCH_READ_ADDR, BENCH_READ_LEN, true);
+    run_for(1000000ull);
+    if (!ok || sim_uart_receive(resp, sizeof(resp)) != 0) {
+        printf("  FAIL: framed READ after %u bad preambles not answered exactly once\n", RESYNC_PREAMBLES);
+        failures++;
+    }
+}
+
+// A wide READ_MULTI with a bogus COUNT (86 ranges, 258 payload bytes: 2 if
+// the length wrapped at 8 bits) carrying READ frames, then a READ: the whole
+// payload is consumed and the frame rejected, only the last READ is answered
+#define BOGUS_MULTI_COUNT   86
+
+static void bench_bogus_multi(const uint8_t *legacy, size_t legacy_len) {
+    uint8_t bogus[3 + 3 * BOGUS_MULTI_COUNT + 1] = { CMD_READ_MULTI | CMD_ADDR16_FLAG, BOGUS_MULTI_COUNT, 1 };
+    for (size_t i = 6; i + legacy_len < sizeof(bogus); i += legacy_len) memcpy(&bogus[i], legacy, legacy_len);
+    sim_uart_send(bogus, add_checksum(bogus, sizeof(bogus) - 1));
+    sim_uart_send(legacy, legacy_len);
+    uint8_t resp[64];
+    bool ok = await_bytes(resp, BENCH_READ_LEN + 3, 50000000ull) && read_response_ok(resp, BENCH_READ_ADDR, BENCH_READ_LEN, false);
+    run_for(1000000ull);
+    if (!ok || sim_uart_receive(resp, sizeof(resp)) != 0) {
+        printf("  FAIL: READ after a READ_MULTI of %u ranges not answered exactly once\n", BOGUS_MULTI_COUNT);
+        failures++;
+    }
+}
+
+// CMD_SET_BAUD handshake: the ACK still comes at the old rate
+static bool switch_baud(uint8_t code) {
+    uint8_t req[4] = { CMD_SET_BAUD, code, 0x00, 0 };
+    uint8_t resp[3];
+    if (!transact(req, add_checksum(req, 3), resp, sizeof(resp)) || resp[1] != RESP_ACK) return false;
+    run_for(1000000ull); // Firmware switches once the ACK is out
+    return true;
+}
+
+static void scenario_throughput(void) {
+    printf("Protocol throughput\n");
+    boot();
+    uint8_t legacy[16], framed[32], write[32], multi[64];
+    size_t legacy_len = build_read(legacy, BENCH_READ_ADDR, BENCH_READ_LEN);
+    bench_frames("READ (legacy, 8 bytes)", legacy, legacy_len, BENCH_READ_LEN + 3, true, false);
+
+    uint8_t speed[2] = { 0x10, 0x27 };
+    size_t write_len = build_write(write, REG_MOTOR_MAX_SPEED_L(1), speed, 2);
+    bench_frames("WRITE (legacy, 2 bytes)", write, write_len, 3, false, false);
+
+    uint16_t addrs[4] = { REG_STATUS, REG_MOTOR_CURRENT_POS_L(0), REG_MOTOR_CURRENT_SPEED_L(0), REG_DIAG_CORE0_LOOP_MAX_L };
+    uint8_t lens[4] = { 3, 4, 2, 4 };
+    size_t multi_len = build_read_multi(multi, addrs, lens, 4);
+    bench_frames("READ_MULTI (4 ranges, 13 bytes)", multi, multi_len, 2 + 13 + 1, false, false);
+    bench_bogus_multi(legacy, legacy_len);
+
+    size_t framed_len = frame_wrap(framed, legacy, legacy_len);
+    bench_frames("READ (framed, 8 bytes)", framed, framed_len, BENCH_READ_LEN + 2 + 5, true, true);
+    bench_resync(framed, framed_len);
+    idle_gap(); // Back to legacy
+
+    bench_link(UART_DEFAULT_BAUD);
+    if (switch_baud(BAUD_CODE_921600)) {
+        bench_link(sim_uart_baud());
+    } else {
+        printf("  FAIL: baud switch not acknowledged\n");
+        failures++;
+    }
+}
+
+// --- 2. Loop Latency Under Load ---
+static void start_move(uint axis, int32_t target, uint16_t speed, uint16_t accel) {
+    write_u32(REG_MOTOR_TARGET_POS_L(axis), (uint32_t)target);
+    write_u16(REG_MOTOR_MAX_SPEED_L(axis), speed);
+    write_u16(REG_MOTOR_ACCEL_L(axis), accel);
+    write_u8(REG_MOTOR_CONTROL(axis), 0x01);
+}
+
+static void scenario_latency(void) {
+    printf("Loop latency (%d axes moving, telemetry, host polling)\n", NUM_MOTORS);
+    boot();
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        write_u16(REG_MOTOR_CONFIG_L(i), 0); // Driver defaults, rewritten over SPI on core 0
+        start_move(i, 40000 + 5000 * (int32_t)i, 12000, 30000);
+    }
+    // Last: setup responses would otherwise interleave with telemetry frames
+    write_u16(REG_TELEMETRY_PERIOD_L, 10);
+    write_u8(REG_TELEMETRY_CONTROL, TELEMETRY_CTRL_PERIODIC | TELEMETRY_CTRL_ON_CHANGE);
+    reset_pass_stats();
+
+    // Poll the status every 2 ms for 500 ms; responses are told apart from
+    // telemetry frames by their first byte (see telemetry.h)
+    uint8_t req[16];
+    size_t req_len = build_read(req, REG_STATUS, 3);
+    const size_t resp_len = 3 + 3;
+    const size_t telemetry_len = 2 + TELEMETRY_PAYLOAD_LEN + 1;
+    size_t rx_len = 0, expect = 0; // Bytes of the frame coming in, and its length
+    uint64_t worst_turnaround = 0, request_in = 0;
+    uint polls = 0, answered = 0, telemetry = 0;
+    bool waiting = false, contended = false;
+    uint64_t end = sim_now_ns() + 500000000ull;
+    uint64_t next_poll = sim_now_ns();
+    while (sim_now_ns() < end) {
+        if (!waiting && sim_now_ns() >= next_poll) {
+            sim_uart_send(req, req_len);
+            request_in = sim_uart_rx_done_ns();
+            waiting = true;
+            contended = rx_len != 0; // A telemetry frame is still coming in
+            polls++;
+            next_poll += 2000000ull;
+        }
+        step();
+        uint8_t byte;
+        while (sim_uart_receive(&byte, 1)) {
+            if (rx_len == 0) {
+                expect = byte == TELEMETRY_FRAME_MARKER ? telemetry_len : resp_len;
+                if (expect == telemetry_len && waiting) contended = true;
+                if (expect == resp_len && waiting && !contended) {
+                    // Only polls that did not queue behind a telemetry frame
+                    // First response byte done: it started one byte time earlier
+                    uint64_t first_out = sim_now_ns() - (10ull * 1000000000ull) / sim_uart_baud();
+                    uint64_t turnaround = first_out > request_in ? first_out - request_in : 0;
+                    if (turnaround > worst_turnaround) worst_turnaround = turnaround;
+                }
+            }
+            if (++rx_len == expect) {
+                if (expect == telemetry_len) {
+                    telemetry++;
+                } else {
+                    answered++;
+                    waiting = false;
+                }
+                rx_len = 0;
+            }
+        }
+    }
+
+    for (uint core = 0; core < 2; core++) {
+        pass_stats_t *s = &core_stats[core];
+        char name[64];
+        snprintf(name, sizeof(name), "core %u pass, host max", core);
+        report(name, (double)s->host_max_ns, "ns");
+        snprintf(name, sizeof(name), "core %u pass, host avg", core);
+        report(name, s->passes ? (double)s->host_sum_ns / s->passes : 0, "ns");
+        snprintf(name, sizeof(name), "core %u pass, longest block (virtual)", core);
+        report(name, s->virt_max_ns / 1000.0, "us");
+        if (max_pass_ns > 0) limit_max(name, (double)s->host_max_ns, max_pass_ns);
+    }
+    limit_max("core 0 longest block", core_stats[0].virt_max_ns / 1000.0, LIMIT_CORE0_BLOCK_US);
+    limit_max("core 1 longest block", core_stats[1].virt_max_ns / 1000.0, LIMIT_CORE1_BLOCK_US);
+    report("poll turnaround, worst idle (virtual)", worst_turnaround / 1000.0, "us");
+    limit_max("poll turnaround", worst_turnaround / 1000.0, LIMIT_POLL_TURNAROUND_US);
+    report("polls answered", answered, "");
+    report("telemetry frames", telemetry, "");
+    if (answered + 1 < polls || telemetry == 0) {
+        printf("  FAIL: %u of %u polls answered, %u telemetry frames\n", answered, polls, telemetry);
+        failures++;
+    }
+}
+
+// --- 3. Step Timing ---
+static uint64_t *pulse_times;
+static uint pulse_count = 0;
+static int32_t pulse_position = 0;
+
+static void record_pulse(uint sm, uint64_t time_ns, bool forward) {
+    if (sm != 0) return;
+    if (pulse_count < STEP_MOVE_STEPS + 16) pulse_times[pulse_count] = time_ns;
+    pulse_count++;
+    pulse_position += forward ? 1 : -1;
+}
+
+// Ideal time (s) of pulse k: constant accel a to v, cruise, mirrored decel.
+// Pulse k is taken as the midpoint of step k, which matches the planner's
+// standstill interval F / sqrt(2a) (step 0 spans t = 0 .. 1/sqrt(2a)).
+static double ideal_time(uint k, uint steps, double v, double a) {
+    double d_acc = v * v / (2.0 * a);
+    if (2.0 * d_acc > steps) {
+        d_acc = steps / 2.0; // Triangle
+        v = sqrt(a * steps);
+    }
+    double t_acc = v / a;
+    double t_total = 2.0 * t_acc + (steps - 2.0 * d_acc) / v;
+    double x = k + 0.5;
+    if (x <= d_acc) return sqrt(2.0 * x / a);
+    if (x <= steps - d_acc) return t_acc + (x - d_acc) / v;
+    return t_total - sqrt(2.0 * (steps - x) / a);
+}
+
+static void scenario_step_timing(void) {
+    printf("Step timing (%d steps, %d steps/s, %d steps/s^2)\n", STEP_MOVE_STEPS, STEP_MOVE_SPEED, STEP_MOVE_ACCEL);
+    boot();
+    pulse_times = calloc(STEP_MOVE_STEPS + 16, sizeof(*pulse_times));
+    pulse_count = 0;
+    pulse_position = 0;
+    sim_set_step_hook(record_pulse);
+    start_move(0, STEP_MOVE_STEPS, STEP_MOVE_SPEED, STEP_MOVE_ACCEL);
+
+    double t_ideal = ideal_time(STEP_MOVE_STEPS - 1, STEP_MOVE_STEPS, STEP_MOVE_SPEED, STEP_MOVE_ACCEL);
+    run_for((uint64_t)((t_ideal + 0.5) * 1e9));
+    sim_set_step_hook(NULL);
+
+    volatile uint8_t *regs = sim_firmware_registers();
+    int32_t reported = (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(0));
+    uint dry = READ_U16_REGISTER(regs, REG_DIAG_STEP_IRQ_DRY_L);
+
+    double err_max = 0, err_sq = 0, ramp_err_max = 0;
+    double d_acc = (double)STEP_MOVE_SPEED * STEP_MOVE_SPEED / (2.0 * STEP_MOVE_ACCEL);
+    uint n = pulse_count < STEP_MOVE_STEPS ? pulse_count : STEP_MOVE_STEPS;
+    double t0 = n ? pulse_times[0] / 1e9 - ideal_time(0, STEP_MOVE_STEPS, STEP_MOVE_SPEED, STEP_MOVE_ACCEL) : 0;
+    for (uint k = 0; k < n; k++) {
+        double err = (pulse_times[k] / 1e9 - t0) - ideal_time(k, STEP_MOVE_STEPS, STEP_MOVE_SPEED, STEP_MOVE_ACCEL);
+        err_sq += err * err;
+        if (fabs(err) > err_max) err_max = fabs(err);
+        if (k + 0.5 <= STEP_MOVE_STEPS - d_acc && fabs(err) > ramp_err_max) ramp_err_max = fabs(err);
+    }
+    double err_rms = n ? sqrt(err_sq / n) : 0;
+    double duration = n ? (pulse_times[n - 1] - pulse_times[0]) / 1e9 : 0;
+    double ideal_duration = t_ideal - ideal_time(0, STEP_MOVE_STEPS, STEP_MOVE_SPEED, STEP_MOVE_ACCEL);
+
+    report("pulses", pulse_count, "");
+    report("final position (PIO / register)", pulse_position, "steps");
+    report("move duration error", (duration - ideal_duration) * 1e6, "us");
+    report("pulse time error, accel/cruise max", ramp_err_max * 1e6, "us");
+    report("pulse time error, max", err_max * 1e6, "us");
+    report("pulse time error, RMS", err_rms * 1e6, "us");
+    report("FIFO underruns (REG_DIAG_STEP_IRQ_DRY)", dry, "");
+    limit_max("pulse time error, accel/cruise max", ramp_err_max * 1e6, LIMIT_RAMP_ERR_MAX_US);
+    limit_max("pulse time error, max", err_max * 1e6, LIMIT_STEP_ERR_MAX_US);
+    limit_max("pulse time error, RMS", err_rms * 1e6, LIMIT_STEP_ERR_RMS_US);
+    if (check_mode && (pulse_count != STEP_MOVE_STEPS || pulse_position != STEP_MOVE_STEPS || reported != STEP_MOVE_STEPS || dry != 0)) {
+        printf("  FAIL: %u pulses, position %ld (register %ld), %u underruns\n",
+               pulse_count, (long)pulse_position, (long)reported, dry);
+        failures++;
+    }
+    free(pulse_times);
+
+    // Fetch changes into a mirror until the firmware reports none left; the
+    // stopped axis must then stay quiet
+    uint8_t mirror[REGISTER_MAP_SIZE] = {0};
+    uint8_t req[8], resp[2 + UART_MAX_CHANGES_LEN + 1];
+    size_t req_len = build_read_changes(req);
+    uint fetches = 0, runs = 0, quiet_runs = 0xFF;
+    bool ok = true;
+    for (uint attempt = 0; attempt < 64 && ok; attempt++) {
+        sim_uart_send(req, req_len);
+        ok = await_bytes(resp, 2, 50000000ull) && resp[1] <= UART_MAX_CHANGES_LEN &&
+             await_bytes(&resp[2], resp[1] + 1u, 50000000ull) && calculate_checksum(resp, resp[1] + 3u) == 0;
+        if (!ok) break;
+        uint n = resp[0] & ~RESP_CHANGES_MORE;
+        if (fetches > 0 && n == 0) {
+            quiet_runs = 0;
+            break;
+        }
+        fetches++;
+        runs += n;
+        for (uint pos = 2, r = 0; r < n; r++) {
+            uint16_t addr = (uint16_t)(resp[pos] | (resp[pos + 1] << 8));
+            uint8_t len = resp[pos + 2];
+            if (addr + len > REGISTER_MAP_SIZE) { ok = false; break; }
+            memcpy(&mirror[addr], &resp[pos + 3], len);
+            pos += CHANGES_RUN_HEADER + len;
+        }
+        if (!(resp[0] & RESP_CHANGES_MORE)) run_for(20000000ull); // Let anything pending settle, then expect silence
+    }
+    int32_t mirrored = (int32_t)READ_U32_REGISTER(mirror, REG_MOTOR_CURRENT_POS_L(0));
+    report("change fetches to drain the map", fetches, "");
+    report("change runs", runs, "");
+    if (check_mode && (!ok || quiet_runs != 0 || mirrored != reported)) {
+        printf("  FAIL: change fetch %s, position %ld in the mirror (register %ld)\n",
+               !ok ? "failed" : quiet_runs ? "never quiet" : "ok", (long)mirrored, (long)reported);
+        failures++;
+    }
+}
+
+// --- 4. Config Push ---
+// The registers apply_config() writes, per axis: MAX_SPEED..CONFIG,
+// JERK_TIME, DRIVER_MODE_CONTROL..COOLSTEP_CONFIG
+#define CONFIG_RUNS_PER_AXIS    3
+
+static void config_run(uint axis, uint run, uint16_t *addr, uint8_t *len) {
+    static const uint8_t lens[CONFIG_RUNS_PER_AXIS] = { 6, 2, 7 };
+    uint16_t addrs[CONFIG_RUNS_PER_AXIS] = {
+        REG_MOTOR_MAX_SPEED_L(axis), REG_MOTOR_JERK_TIME_L(axis), REG_MOTOR_DRIVER_MODE_CONTROL(axis) };
+    *addr = addrs[run];
+    *len = lens[run];
+}
+
+static bool stage_status_ok(const uint8_t *req, size_t req_len, uint8_t runs_byte) {
+    uint8_t resp[3];
+    return transact(req, req_len, resp, sizeof(resp)) && calculate_checksum(resp, 3) == 0 &&
+           resp[0] == runs_byte && resp[1] == RESP_ACK;
+}
+
+static void scenario_config_push(void) {
+    printf("Config push (%d axes)\n", NUM_MOTORS);
+    boot();
+    volatile uint8_t *regs = sim_firmware_registers();
+
+    // One WRITE per register, each waiting for its ACK (the old apply_config())
+    uint64_t t0 = sim_now_ns();
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        write_u16(REG_MOTOR_MAX_SPEED_L(i), 1000);
+        write_u16(REG_MOTOR_ACCEL_L(i), 2000);
+        write_u16(REG_MOTOR_CONFIG_L(i), 0);
+        write_u16(REG_MOTOR_JERK_TIME_L(i), 0);
+        write_u8(REG_MOTOR_DRIVER_MODE_CONTROL(i), 0);
+        write_u16(REG_MOTOR_STEALTH_MAX_SPEED_L(i), 0);
+        write_u16(REG_MOTOR_COOLSTEP_MIN_SPEED_L(i), 0);
+        write_u16(REG_MOTOR_COOLSTEP_CONFIG_L(i), 0);
+    }
+    double single_us = (sim_now_ns() - t0) / 1e3;
+
+    // The same registers as one staged write, new speeds
+    uint8_t payload[UART_MAX_STAGE_LEN];
+    uint8_t len = 0, runs = 0;
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        for (uint r = 0; r < CONFIG_RUNS_PER_AXIS; r++) {
+            uint16_t addr;
+            uint8_t run_len;
+            config_run(i, r, &addr, &run_len);
+            payload[len++] = (uint8_t)addr;
+            payload[len++] = (uint8_t)(addr >> 8);
+            payload[len++] = run_len;
+            memset(&payload[len], 0, run_len);
+            if (r == 0) WRITE_U16_REGISTER(&payload[len], 0, 3000 + i); // MAX_SPEED
+            len += run_len;
+            runs++;
+        }
+    }
+    uint16_t crc = frame_crc16(FRAME_CRC_INIT, payload, len);
+    uint8_t req[8 + UART_MAX_STAGE_LEN];
+
+    // Wrong CRC: NACK and nothing written
+    bool ok = stage_status_ok(req, build_stage_write(req, runs | STAGE_BEGIN, payload, len), runs | STAGE_BEGIN) &&
+              !stage_status_ok(req, build_stage_commit(req, runs, crc ^ 1), runs);
+    for (uint i = 0; i < NUM_MOTORS; i++) ok &= READ_U16_REGISTER(regs, REG_MOTOR_MAX_SPEED_L(i)) == 1000;
+
+    t0 = sim_now_ns();
+    ok &= stage_status_ok(req, build_stage_write(req, runs | STAGE_BEGIN, payload, len), runs | STAGE_BEGIN) &&
+          stage_status_ok(req, build_stage_commit(req, runs, crc), runs);
+    double staged_us = (sim_now_ns() - t0) / 1e3;
+    for (uint i = 0; i < NUM_MOTORS; i++) ok &= (uint)READ_U16_REGISTER(regs, REG_MOTOR_MAX_SPEED_L(i)) == 3000 + i;
+
+    report("one WRITE per register", single_us, "us (virtual)");
+    report("staged write + commit", staged_us, "us (virtual)");
+    if (check_mode && (!ok || staged_us >= single_us)) {
+        printf("  FAIL: staged config push %s\n", ok ? "not faster" : "not applied as a whole");
+        failures++;
+    }
+}
+
+// --- 5. Driver Monitor ---
+// Run until the axis is idle (or the timeout); returns the time taken
+static uint64_t run_until_idle(uint axis, uint64_t timeout_ns) {
+    volatile uint8_t *regs = sim_firmware_registers();
+    uint64_t t0 = sim_now_ns();
+    while (sim_now_ns() - t0 < timeout_ns && (regs[REG_MOTOR_STATUS(axis)] & 0x01)) step();
+    return sim_now_ns() - t0;
+}
+
+static void scenario_driver_monitor(void) {
+    printf("Driver monitor\n");
+    boot();
+    volatile uint8_t *regs = sim_firmware_registers();
+
+    // Lost steps: reference at standstill, a move the driver misses pulses of
+    write_u8(REG_MOTOR_STALL_RECOVERY(0), STALL_RECOVERY_MSCNT | STALL_RECOVERY_STOP);
+    run_for(50000000ull);
+    sim_tmc_drop_pulses(0, MONITOR_DROPPED);
+    start_move(0, 1000, 800, 4000);
+    run_until_idle(0, 3000000000ull);
+    run_for(50000000ull);
+    int32_t pos = (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(0));
+    uint8_t faults = regs[REG_MOTOR_DRIVER_FAULTS(0)];
+    report("position after lost steps", pos, "steps");
+    if (check_mode && (pos != 1000 - MONITOR_DROPPED || !(faults & DRIVER_FAULT_POS_CORRECTED) ||
+                       !(regs[REG_ERROR_FLAGS] & ERROR_FLAGS_DRIVER_FAULT(0)))) {
+        printf("  FAIL: position %ld, faults 0x%02X, error flags 0x%02X\n", (long)pos, faults, regs[REG_ERROR_FLAGS]);
+        failures++;
+    }
+
+    // Stall at cruise speed: stop
+    start_move(0, 100000, MONITOR_SPEED, MONITOR_ACCEL);
+    run_for(300000000ull);
+    sim_tmc_set_stall(0, true);
+    double stop_ms = run_until_idle(0, 1000000000ull) / 1e6;
+    sim_tmc_set_stall(0, false);
+    faults = regs[REG_MOTOR_DRIVER_FAULTS(0)];
+    report("stall to standstill", stop_ms, "ms (virtual)");
+    limit_max("stall to standstill", stop_ms, LIMIT_STALL_STOP_MS);
+    if (check_mode && faults != DRIVER_FAULT_STALL) {
+        printf("  FAIL: faults 0x%02X after a stall\n", faults);
+        failures++;
+    }
+
+    // Stall with re-homing: homing takes the axis over
+    write_u8(REG_MOTOR_STALL_RECOVERY(0), STALL_RECOVERY_REHOME);
+    start_move(0, 0, MONITOR_SPEED, MONITOR_ACCEL);
+    run_for(300000000ull);
+    sim_tmc_set_stall(0, true);
+    run_for(300000000ull);
+    sim_tmc_set_stall(0, false);
+    uint8_t homing = regs[REG_MOTOR_HOMING_STATE(0)];
+    write_u8(REG_MOTOR_CONTROL(0), 0x02); // Abort it (no switch to find)
+    run_until_idle(0, 1000000000ull);
+    if (check_mode && (homing == HOMING_IDLE || homing == HOMING_FAILED || !(regs[REG_MOTOR_DRIVER_FAULTS(0)] & DRIVER_FAULT_STALL))) {
+        printf("  FAIL: homing state %u, faults 0x%02X after a stall with re-homing\n", homing, regs[REG_MOTOR_DRIVER_FAULTS(0)]);
+        failures++;
+    }
+}
+
+// --- 6. Endstops ---
+enum { INTO_MOVE, INTO_QUEUED, INTO_COORD };
+
+// Axis 0 rests on its pressed switch: a start towards it must leave the axis
+// (and for a line, axis 1) where it is and raise its endstop error bit
+static void endstop_refuses(const char *name, int kind) {
+    volatile uint8_t *regs = sim_firmware_registers();
+    int32_t pos0 = (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(0));
+    int32_t pos1 = NUM_MOTORS > 1 ? (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(1)) : 0;
+
+    // Step off first: the error bit is cleared by the next move that runs
+    start_move(0, pos0 + 200, 2000, 20000);
+    run_until_idle(0, 1000000000ull);
+    bool cleared = !(regs[REG_ERROR_FLAGS] & 0x01);
+    pos0 += 200;
+
+    if (kind == INTO_MOVE) {
+        start_move(0, pos0 - 100, 2000, 20000);
+    } else if (kind == INTO_QUEUED) {
+        uint8_t seg[9] = { 0 };
+        int32_t target = pos0 - 100;
+        memcpy(seg, &target, 4);
+        seg[4] = 0xD0; seg[5] = 0x07; // 2000 steps/s
+        seg[6] = 0x20; seg[7] = 0x4E; // 20000 steps/s^2
+        seg[8] = 0x01;                // Push
+        write_registers(REG_MOTOR_QUEUE_TARGET_L(0), seg, sizeof(seg));
+    } else {
+        write_u32(REG_MOTOR_TARGET_POS_L(0), (uint32_t)(pos0 - 100));
+        write_u32(REG_MOTOR_TARGET_POS_L(1), (uint32_t)(pos1 + 50));
+        write_u16(REG_COORD_FEED_RATE_L, 2000);
+        write_u16(REG_COORD_ACCEL_L, 20000);
+        write_u8(REG_COORD_CONTROL, 0x01);
+    }
+    run_for(50000000ull);
+    int32_t now0 = (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(0));
+    int32_t now1 = NUM_MOTORS > 1 ? (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(1)) : 0;
+    bool ok = cleared && now0 == pos0 && now1 == pos1 && (regs[REG_ERROR_FLAGS] & 0x01) &&
+              !(regs[REG_MOTOR_STATUS(0)] & 0x01) && regs[REG_MOTOR_QUEUE_FREE(0)] == MOVE_QUEUE_DEPTH;
+    if (check_mode && !ok) {
+        printf("  FAIL: %s into a pressed endstop: position %ld -> %ld (axis 1 %ld -> %ld), error flags 0x%02X\n",
+               name, (long)pos0, (long)now0, (long)pos1, (long)now1, regs[REG_ERROR_FLAGS]);
+        failures++;
+    }
+}
+
+static int32_t endstop_pulse_position;
+
+static void record_endstop_pulse(uint sm, uint64_t time_ns, bool forward) {
+    (void)time_ns;
+    if (sm == 0) endstop_pulse_position += forward ? 1 : -1;
+}
+
+static void scenario_endstops(void) {
+    printf("Endstops\n");
+    boot();
+    volatile uint8_t *regs = sim_firmware_registers();
+
+    // Run into the switch (the home end, negative by default): hard stop
+    endstop_pulse_position = 0;
+    sim_set_step_hook(record_endstop_pulse);
+    start_move(0, -100000, 2000, 20000);
+    run_for(200000000ull);
+    sim_gpio_set_input(ENDSTOP_PIN, false);
+    run_until_idle(0, 100000000ull);
+    run_for(50000000ull); // Debounced as pressed
+    sim_set_step_hook(NULL);
+    int32_t pos = (int32_t)READ_U32_REGISTER(regs, REG_MOTOR_CURRENT_POS_L(0));
+    report("hard stop position", pos, "steps");
+    if (check_mode && (!(regs[REG_ERROR_FLAGS] & 0x01) || !(regs[REG_SWITCH_STATUS] & 0x01) || pos <= -100000 ||
+                       pos != endstop_pulse_position)) {
+        printf("  FAIL: no hard stop at the endstop (position %ld, %ld pulses, error flags 0x%02X)\n",
+               (long)pos, (long)endstop_pulse_position, regs[REG_ERROR_FLAGS]);
+        failures++;
+    }
+
+    // The switch stays pressed (no new press edge)
+    endstop_refuses("move", INTO_MOVE);
+    endstop_refuses("queued segment", INTO_QUEUED);
+    if (NUM_MOTORS > 1) endstop_refuses("coordinated line", INTO_COORD);
+    sim_gpio_set_input(ENDSTOP_PIN, true);
+}
+
+// --- 7. Coordinated Lines ---
+#define LINE_MAJOR 1000
+
+static uint64_t line_times[2][LINE_MAJOR];
+static uint line_pulses[2];
+
+static void record_line_pulse(uint sm, uint64_t time_ns, bool forward) {
+    (void)forward;
+    if (sm > 1) return;
+    if (line_pulses[sm] < LINE_MAJOR) line_times[sm][line_pulses[sm]] = time_ns;
+    line_pulses[sm]++;
+}
+
+static void line_lands(uint32_t minor) {
+    boot();
+    line_pulses[0] = line_pulses[1] = 0;
+    sim_set_step_hook(record_line_pulse);
+    write_u32(REG_MOTOR_TARGET_POS_L(0), LINE_MAJOR);
+    write_u32(REG_MOTOR_TARGET_POS_L(1), minor);
+    write_u16(REG_COORD_FEED_RATE_L, 2000);
+    write_u16(REG_COORD_ACCEL_L, 20000);
+    write_u8(REG_COORD_CONTROL, 0x01);
+    run_for(100000000ull);
+    run_until_idle(0, 3000000000ull);
+    run_until_idle(1, 100000000ull);
+    sim_set_step_hook(NULL);
+
+    uint misplaced = 0;
+    for (uint m = 1; m <= minor && m <= line_pulses[1]; m++) {
+        uint j = (m * LINE_MAJOR + minor - 1) / minor; // Major pulse, from 1
+        if (j > line_pulses[0] || line_times[1][m - 1] != line_times[0][j - 1]) misplaced++;
+    }
+    if (check_mode && (line_pulses[0] != LINE_MAJOR || line_pulses[1] != minor || misplaced)) {
+        printf("  FAIL: %u:%lu line: %u and %u pulses, %u minor pulse(s) off their major pulse\n",
+               LINE_MAJOR, (unsigned long)minor, line_pulses[0], line_pulses[1], misplaced);
+        failures++;
+    }
+}
+
+static void scenario_coord_lines(void) {
+    printf("Coordinated lines\n");
+    line_lands(LINE_MAJOR / 10);
+    line_lands(LINE_MAJOR * 9 / 10);
+}
+
+// --- Main ---
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--check")) {
+            check_mode = true;
+        } else if (!strcmp(argv[i], "--verbose")) {
+            sim_set_verbose(true);
+        } else if (!strcmp(argv[i], "--min-frames-per-sec") && i + 1 < argc) {
+            min_frames_per_sec = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--max-pass-ns") && i + 1 < argc) {
+            max_pass_ns = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--check] [--verbose] [--min-frames-per-sec N] [--max-pass-ns N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("Stepper firmware bench (%d axes, %s)\n", NUM_MOTORS, TMC_DAISY_CHAIN ? "daisy chain" : "separate CS");
+    scenario_throughput();
+    scenario_latency();
+    scenario_step_timing();
+    scenario_config_push();
+    scenario_driver_monitor();
+    scenario_endstops();
+    if (NUM_MOTORS > 1) scenario_coord_lines();
+
+    if (check_mode) printf(failures ? "%d check(s) FAILED\n" : "All checks passed\n", failures);
+    return failures ? 1 : 0;
+}
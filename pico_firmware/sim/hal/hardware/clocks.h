@@ -0,0 +1,12 @@
+#ifndef SIM_HARDWARE_CLOCKS_H
+#define SIM_HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+#define SIM_CLK_SYS_HZ 125000000u
+
+enum clock_index { clk_ref = 4, clk_sys = 5, clk_peri = 6 };
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#endif // SIM_HARDWARE_CLOCKS_H
@@ -0,0 +1,19 @@
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include "pico/stdlib.h"
+
+#define PIO0_IRQ_0      7
+#define DMA_IRQ_0       11
+#define IO_IRQ_BANK0    13
+#define UART0_IRQ       20
+#define UART1_IRQ       21
+#define SIM_NUM_IRQS    32
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif // SIM_HARDWARE_IRQ_H
@@ -0,0 +1,60 @@
+#ifndef SIM_HARDWARE_PIO_H
+#define SIM_HARDWARE_PIO_H
+
+#include "pico/stdlib.h"
+
+// --- Simulated PIO Block ---
+// Models the stepper program (src/stepper.pio) rather than executing PIO
+// code: each TX FIFO word (delay << 1) | pulse occupies the state machine for
+// delay + STEP_ENGINE_OVERHEAD_TICKS ticks of STEP_ENGINE_TICK_HZ and counts
+// a pulse (Y) at its start. The forced instructions step_engine.c issues are
+// recognised by their encoding (pulse count read-back, Y reset, restart).
+
+typedef struct pio_inst *PIO;
+extern const PIO sim_pio0;
+#define pio0 sim_pio0
+
+#define SIM_PIO_NUM_SMS     4
+#define SIM_PIO_FIFO_DEPTH  4
+
+typedef struct {
+    uint32_t clkdiv;
+} pio_sm_config;
+
+typedef struct {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+enum pio_interrupt_source { pis_sm0_tx_fifo_not_full = 4 };
+enum pio_src_dest { pio_pins = 0, pio_x = 1, pio_y = 2, pio_null = 3, pio_isr = 6, pio_osr = 7 };
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base);
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold);
+void sm_config_set_clkdiv(pio_sm_config *c, float div);
+
+// Instruction encodings (real values, so forced instructions can be told apart)
+static inline uint pio_encode_jmp(uint addr) { return 0x0000u | (addr & 0x1Fu); }
+static inline uint pio_encode_nop(void) { return 0xA042u; } // mov y, y
+static inline uint pio_encode_push(bool if_full, bool block) { return 0x8000u | (if_full ? 0x40u : 0) | (block ? 0x20u : 0); }
+static inline uint pio_encode_mov_not(enum pio_src_dest dest, enum pio_src_dest src) { return 0xA000u | ((uint)dest << 5) | 0x08u | (uint)src; }
+static inline uint pio_encode_sideset_opt(uint sideset_bit_count, uint value) { return 0x1000u | (value << (12u - sideset_bit_count)); }
+
+#endif // SIM_HARDWARE_PIO_H
@@ -0,0 +1,22 @@
+#ifndef SIM_HARDWARE_SPI_H
+#define SIM_HARDWARE_SPI_H
+
+#include "pico/stdlib.h"
+
+typedef struct spi_inst spi_inst_t;
+extern spi_inst_t *const sim_spi0;
+#define spi0 sim_spi0
+
+typedef struct {
+    volatile uint32_t dr;
+} spi_hw_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+uint spi_get_index(spi_inst_t *spi);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+
+// Exchanges with the simulated TMC2130s; advances the virtual clock by the transfer time
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+#endif // SIM_HARDWARE_SPI_H
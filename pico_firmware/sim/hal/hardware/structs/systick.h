@@ -0,0 +1,20 @@
+#ifndef SIM_HARDWARE_STRUCTS_SYSTICK_H
+#define SIM_HARDWARE_STRUCTS_SYSTICK_H
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t rvr;
+    volatile uint32_t cvr;
+    volatile uint32_t calib;
+} systick_hw_t;
+
+#define M0PLUS_SYST_CSR_ENABLE_BITS     0x1u
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS  0x4u
+
+// CVR counts down with the virtual clock at clk_sys; refreshed on every access
+systick_hw_t *sim_systick(void);
+#define systick_hw (sim_systick())
+
+#endif // SIM_HARDWARE_STRUCTS_SYSTICK_H
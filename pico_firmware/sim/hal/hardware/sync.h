@@ -0,0 +1,13 @@
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include "pico/stdlib.h"
+
+// Pending IRQs run when interrupts are restored (see sim_hal.c)
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+// Core the simulation is currently running (loop pass or IRQ owner)
+uint get_core_num(void);
+
+#endif // SIM_HARDWARE_SYNC_H
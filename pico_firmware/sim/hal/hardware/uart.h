@@ -0,0 +1,26 @@
+#ifndef SIM_HARDWARE_UART_H
+#define SIM_HARDWARE_UART_H
+
+#include "pico/stdlib.h"
+
+typedef struct uart_inst uart_inst_t;
+extern uart_inst_t *const sim_uart0;
+#define uart0 sim_uart0
+
+typedef struct {
+    volatile uint32_t dr;
+    volatile uint32_t fr;
+} uart_hw_t;
+
+#define UART_UARTFR_BUSY_BITS 0x08u
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate);
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data);
+uart_hw_t *uart_get_hw(uart_inst_t *uart);     // FR.BUSY reflects the virtual TX line
+uint uart_get_dreq(uart_inst_t *uart, bool is_tx);
+uint uart_get_index(uart_inst_t *uart);
+
+#endif // SIM_HARDWARE_UART_H
@@ -0,0 +1,36 @@
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+// --- Host Stand-in for the Pico SDK ---
+// Just enough of the SDK API for the firmware sources to compile on the host.
+// Everything is backed by sim_hal.c: a virtual clock, fake UART/DMA/GPIO/PIO
+// and a model of the TMC2130 SPI interface. Not a general SDK emulation.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef unsigned int uint;
+
+#define __not_in_flash_func(func) func
+#define __time_critical_func(func) func
+
+// --- Time (virtual clock, see sim_hal.h) ---
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void busy_wait_us_32(uint32_t delay_us);    // Advances the virtual clock
+void sleep_ms(uint32_t ms);
+
+void tight_loop_contents(void);              // Advances the virtual clock (spins wait for an IRQ)
+
+// --- Barriers / Events (single host thread: nothing to order) ---
+#define __dmb() ((void)0)
+#define __wfe() ((void)0)
+#define __wfi() ((void)0)
+#define __sev() ((void)0)
+
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+#endif // SIM_PICO_STDLIB_H
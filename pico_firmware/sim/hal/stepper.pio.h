@@ -0,0 +1,17 @@
+#ifndef SIM_STEPPER_PIO_H
+#define SIM_STEPPER_PIO_H
+
+// Stand-in for the header pico_generate_pio_header() makes from
+// src/stepper.pio. The simulated PIO models the program's timing itself.
+
+#include "hardware/pio.h"
+
+extern const pio_program_t stepper_program;
+
+static inline pio_sm_config stepper_program_get_default_config(uint offset) {
+    pio_sm_config c = { 1 };
+    (void)offset;
+    return c;
+}
+
+#endif // SIM_STEPPER_PIO_H
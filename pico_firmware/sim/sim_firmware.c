@@ -0,0 +1,102 @@
+#include "sim_firmware.h"
+#include "hardware/spi.h"
+#include "registers.h"
+#include "uart_protocol.h"
+#include "tmc2130.h"
+#include "motor_control.h"
+#include "switches.h"
+#include "homing.h"
+#include "telemetry.h"
+#include "driver_monitor.h"
+#include "core_link.h"
+#include "diagnostics.h"
+#include "event_log.h"
+
+// --- Board (same wiring as main.c) ---
+#define UART_ID uart0
+#define BAUD_RATE UART_DEFAULT_BAUD
+#define SPI_PORT spi0
+#define SPI_BAUD 500000
+
+static const uint switch_pins[MOTOR_MAX_AXES] = { 20, 21, 26, 27 };
+static const uint diag1_pins[MOTOR_MAX_AXES] = MOTOR_DIAG1_PINS;
+static const uint dir_pins[MOTOR_MAX_AXES] = MOTOR_DIR_PINS;
+static const uint tmc_cs_pins[2] = { 17, 2 };
+
+static volatile uint8_t virtual_registers[REGISTER_MAP_SIZE];
+static volatile uint8_t motion_registers[REGISTER_MAP_SIZE];
+
+// --- Initialization ---
+void sim_firmware_boot(void) {
+    sim_reset();
+    memset((void *)virtual_registers, 0, sizeof(virtual_registers));
+    memset((void *)motion_registers, 0, sizeof(motion_registers));
+    sim_set_core(0);
+
+    init_diagnostics_core();
+    init_diagnostics(virtual_registers);
+    init_event_log(virtual_registers);
+
+    uart_init(UART_ID, BAUD_RATE);
+    init_uart_protocol(UART_ID);
+
+    spi_init(SPI_PORT, SPI_BAUD);
+    uint cs_count = TMC_DAISY_CHAIN ? 1 : NUM_MOTORS;
+    for (uint i = 0; i < cs_count; i++) {
+        gpio_init(tmc_cs_pins[i]);
+        gpio_set_dir(tmc_cs_pins[i], GPIO_OUT);
+        gpio_put(tmc_cs_pins[i], 1);
+    }
+    if (TMC_DAISY_CHAIN) {
+        uint chain_cs[SIM_MAX_TMC_DRIVERS] = { tmc_cs_pins[0], tmc_cs_pins[0], tmc_cs_pins[0], tmc_cs_pins[0] };
+        sim_tmc_attach(chain_cs, NUM_MOTORS, true);
+    } else {
+        sim_tmc_attach(tmc_cs_pins, NUM_MOTORS, false);
+    }
+    for (uint i = 0; i < NUM_MOTORS; i++) sim_tmc_set_sg_result(i, 300); // Lightly loaded
+    init_tmc_drivers(SPI_PORT, tmc_cs_pins);
+
+    uart_protocol_set_write_hook(core_link_forward_write);
+    uart_protocol_set_batch_hook(core_link_forward_batch);
+
+    // Core 1 (the step engine claims SM n for axis n, see init_step_engine())
+    sim_set_core(1);
+    init_diagnostics_core();
+    init_switches(switch_pins);
+    init_motor_control();
+    init_homing(switch_pins, diag1_pins);
+    for (uint i = 0; i < NUM_MOTORS; i++) sim_pio_set_dir_pin(i, dir_pins[i]);
+    sim_set_core(0);
+
+    init_telemetry(virtual_registers);
+    init_driver_monitor(virtual_registers);
+}
+
+// --- Loop Passes (the bodies of main()'s and core1_main()'s loops) ---
+void sim_core0_pass(void) {
+    sim_set_core(0);
+    handle_uart_rx(UART_ID, virtual_registers);
+    core_link_pull_status(virtual_registers);
+    update_tmc_config_from_registers(virtual_registers);
+    update_tmc_status_scan();
+    update_driver_monitor(virtual_registers);
+    update_telemetry(virtual_registers);
+    update_diagnostics_registers(virtual_registers);
+    update_event_log(virtual_registers);
+    diag_loop_tick(0);
+}
+
+void sim_core1_pass(void) {
+    sim_set_core(1);
+    core_link_apply_writes(motion_registers, motor_control_on_register_write);
+    update_motor_control_from_registers(motion_registers);
+    update_switch_status_registers(motion_registers);
+    update_motor_status_registers(motion_registers);
+    core_link_publish_status(motion_registers);
+    diag_loop_tick(1);
+    sim_set_core(0);
+}
+
+volatile uint8_t *sim_firmware_registers(void) {
+    return virtual_registers;
+}
@@ -0,0 +1,23 @@
+#ifndef SIM_FIRMWARE_H
+#define SIM_FIRMWARE_H
+
+#include "sim_hal.h"
+
+// --- Host Build of the Firmware ---
+// main.c without its endless loops: sim_firmware_boot() runs the same
+// initialisation on the simulated hardware, then the harness interleaves
+// single passes of the two core loops with sim_advance() calls.
+
+// Reset the hardware model and run main()'s initialisation (both cores)
+void sim_firmware_boot(void);
+
+// One pass of the core 0 (communication) loop
+void sim_core0_pass(void);
+
+// One pass of the core 1 (motion) loop
+void sim_core1_pass(void);
+
+// Core 0's register map (what the host reads and writes over the link)
+volatile uint8_t *sim_firmware_registers(void);
+
+#endif // SIM_FIRMWARE_H
@@ -0,0 +1,874 @@
+#include "sim_hal.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/pio.h"
+#include "hardware/spi.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "stepper.pio.h"
+#include "step_engine.h" // STEP_ENGINE_TICK_HZ, STEP_ENGINE_OVERHEAD_TICKS
+#include "tmc2130.h" // Register addresses of the model
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NS_PER_S            1000000000ull
+#define PIO_TICK_NS         (NS_PER_S / STEP_ENGINE_TICK_HZ)
+#define UART_FIFO_DEPTH     32      // DMA finishes once the tail fits in the TX FIFO
+#define SIM_NUM_DMA         12
+#define MAX_IRQ_HANDLERS    8
+#define MAX_IRQ_ROUNDS      100000  // A pending IRQ nobody clears would hang the host
+#define SIM_SPIN_NS         100     // Virtual time per tight_loop_contents()
+
+// --- Clock and Cores ---
+static uint64_t now_ns = 0;
+static uint current_core = 0;
+static bool verbose = false;
+
+// --- Interrupts ---
+typedef struct {
+    irq_handler_t handlers[MAX_IRQ_HANDLERS];
+    uint count;
+    bool enabled;
+    uint core;              // Core that enabled it (each core has its own NVIC)
+} sim_irq_t;
+
+static sim_irq_t irqs[SIM_NUM_IRQS];
+static bool interrupts_disabled = false;
+static bool in_irq = false;
+
+// --- GPIO ---
+typedef struct {
+    bool out_dir;
+    bool out;
+    bool in;                // Level an input reads (pull-ups: high until driven)
+    uint32_t raw_events;    // Latched edges
+    uint32_t irq_mask;      // Enabled edges
+} sim_gpio_t;
+
+static sim_gpio_t gpios[SIM_NUM_GPIOS];
+
+// --- UART ---
+struct uart_inst { int unused; };
+static struct uart_inst uart0_storage;
+uart_inst_t *const sim_uart0 = &uart0_storage;
+
+static uart_hw_t uart_regs;
+static uint32_t uart_baud = 115200;
+static bool uart_rx_irq = false;
+
+static uint8_t rx_bytes[SIM_UART_RX_QUEUE];
+static uint64_t rx_arrival[SIM_UART_RX_QUEUE];
+static uint64_t rx_head = 0;    // Queued by the host
+static uint64_t rx_ready = 0;   // Arrived (readable)
+static uint64_t rx_read = 0;    // Read by the firmware
+static uint64_t rx_line_free = 0;
+
+static uint8_t tx_bytes[SIM_UART_TX_CAPTURE];
+static uint64_t tx_done[SIM_UART_TX_CAPTURE];
+static uint64_t tx_head = 0;    // Put on the line by DMA
+static uint64_t tx_taken = 0;   // Received by the host
+static uint64_t tx_line_free = 0;
+
+// --- DMA ---
+typedef struct {
+    bool claimed;
+    uint dreq;
+    const volatile uint8_t *read_addr;
+    volatile uint8_t *write_addr;
+    uint32_t count;
+    bool busy;
+    uint64_t end_ns;
+    bool irq0_enabled;
+    bool irq0_status;
+} sim_dma_t;
+
+static sim_dma_t dma[SIM_NUM_DMA];
+
+// --- SPI ---
+struct spi_inst { int unused; };
+static struct spi_inst spi0_storage;
+spi_inst_t *const sim_spi0 = &spi0_storage;
+static spi_hw_t spi_regs;
+static uint32_t spi_baud = 1000000;
+
+// --- PIO ---
+struct pio_inst { int unused; };
+static struct pio_inst pio0_storage;
+const PIO sim_pio0 = &pio0_storage;
+const pio_program_t stepper_program = { NULL, 0, -1 };
+
+typedef struct {
+    bool claimed;
+    bool enabled;
+    bool src_enabled;       // TX-not-full IRQ source
+    uint32_t fifo[SIM_PIO_FIFO_DEPTH];
+    uint fifo_head;
+    uint fifo_count;
+    bool busy;              // Word in progress
+    uint64_t word_end_ns;
+    uint64_t remaining_ns;  // Of the word in progress while disabled
+    uint32_t pulses;        // ~Y
+    uint32_t isr;
+    uint32_t rx;
+    int dir_pin;
+} sim_sm_t;
+
+static sim_sm_t sms[SIM_PIO_NUM_SMS];
+static sim_step_hook_t step_hook = NULL;
+
+// --- TMC2130 ---
+typedef struct {
+    uint32_t regs[128];
+    uint8_t last_read;      // Register the next response carries
+    uint16_t sg_result;
+    bool stall;             // DRV_STATUS.stallGuard
+    uint16_t mscnt;         // Advanced by the STEP pulses of SM n = driver n
+    uint32_t drop_pulses;   // Pulses still to be missed
+} sim_tmc_t;
+
+static sim_tmc_t tmc[SIM_MAX_TMC_DRIVERS];
+static uint tmc_cs[SIM_MAX_TMC_DRIVERS];
+static uint tmc_count = 0;
+static bool tmc_daisy = false;
+static uint32_t tmc_datagram_count = 0;
+
+static systick_hw_t systick_regs;
+
+static void run_irqs(void);
+static void tmc_step(uint driver, bool forward);
+
+// --- Reset ---
+void sim_reset(void) {
+    now_ns = 0;
+    current_core = 0;
+    memset(irqs, 0, sizeof(irqs));
+    interrupts_disabled = false;
+    in_irq = false;
+    memset(gpios, 0, sizeof(gpios));
+    for (uint i = 0; i < SIM_NUM_GPIOS; i++) gpios[i].in = true;
+    uart_baud = 115200;
+    uart_rx_irq = false;
+    rx_head = rx_ready = rx_read = rx_line_free = 0;
+    tx_head = tx_taken = tx_line_free = 0;
+    memset(dma, 0, sizeof(dma));
+    memset(sms, 0, sizeof(sms));
+    for (uint i = 0; i < SIM_PIO_NUM_SMS; i++) sms[i].dir_pin = -1;
+    memset(tmc, 0, sizeof(tmc));
+    tmc_count = 0;
+    tmc_datagram_count = 0;
+}
+
+// --- Printf ---
+void sim_set_verbose(bool on) {
+    verbose = on;
+}
+
+int sim_printf(const char *format, ...) {
+    if (!verbose) return 0;
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+// --- Time ---
+static inline uint64_t uart_byte_ns(void) {
+    return (10ull * NS_PER_S) / uart_baud; // 8N1
+}
+
+uint64_t sim_now_ns(void) {
+    return now_ns;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)(now_ns / 1000u);
+}
+
+uint64_t time_us_64(void) {
+    return now_ns / 1000u;
+}
+
+void busy_wait_us_32(uint32_t delay_us) {
+    sim_advance((uint64_t)delay_us * 1000u);
+}
+
+void sleep_ms(uint32_t ms) {
+    sim_advance((uint64_t)ms * 1000000u);
+}
+
+// A spin loop only ends when an IRQ (DMA completion) changes something, so
+// each iteration lets the virtual clock run
+void tight_loop_contents(void) {
+    sim_advance(SIM_SPIN_NS);
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return clk_index == clk_sys ? SIM_CLK_SYS_HZ : 48000000u;
+}
+
+systick_hw_t *sim_systick(void) {
+    uint64_t cycles = now_ns * (SIM_CLK_SYS_HZ / 1000000u) / 1000u;
+    systick_regs.cvr = 0xFFFFFFu - (uint32_t)(cycles & 0xFFFFFFu);
+    return &systick_regs;
+}
+
+void sim_set_core(uint core) {
+    current_core = core;
+}
+
+uint get_core_num(void) {
+    return current_core;
+}
+
+// --- PIO Model ---
+static void start_word(uint sm_id, uint64_t start_ns) {
+    sim_sm_t *sm = &sms[sm_id];
+    uint32_t word = sm->fifo[sm->fifo_head];
+    sm->fifo_head = (sm->fifo_head + 1) % SIM_PIO_FIFO_DEPTH;
+    sm->fifo_count--;
+    uint32_t ticks = (word >> 1) + STEP_ENGINE_OVERHEAD_TICKS;
+    sm->busy = true;
+    sm->word_end_ns = start_ns + (uint64_t)ticks * PIO_TICK_NS;
+    if (word & 1u) {
+        sm->pulses++; // On the rising edge, like stepper.pio
+        bool forward = sm->dir_pin < 0 || gpios[sm->dir_pin].out;
+        tmc_step(sm_id, forward);
+        if (step_hook) step_hook(sm_id, start_ns, forward);
+    }
+}
+
+// Words end on time; the next one starts when the previous ends (or on a put)
+static void service_sm(uint sm_id) {
+    sim_sm_t *sm = &sms[sm_id];
+    while (sm->enabled && sm->busy && sm->word_end_ns <= now_ns) {
+        uint64_t end = sm->word_end_ns;
+        sm->busy = false;
+        if (sm->fifo_count) start_word(sm_id, end);
+    }
+    if (sm->enabled && !sm->busy && sm->fifo_count) start_word(sm_id, now_ns);
+}
+
+void sim_set_step_hook(sim_step_hook_t hook) {
+    step_hook = hook;
+}
+
+void sim_pio_set_dir_pin(uint sm, uint gpio) {
+    if (sm < SIM_PIO_NUM_SMS) sms[sm].dir_pin = (int)gpio;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    (void)pio; (void)program;
+    return 0;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    (void)pio;
+    for (uint i = 0; i < SIM_PIO_NUM_SMS; i++) {
+        if (!sms[i].claimed) {
+            sms[i].claimed = true;
+            return (int)i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "sim: no free PIO state machine\n");
+        abort();
+    }
+    return -1;
+}
+
+void pio_gpio_init(PIO pio, uint pin) { (void)pio; (void)pin; }
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    (void)pio; (void)sm; (void)pin_base; (void)pin_count; (void)is_out;
+    return 0;
+}
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    (void)pio; (void)initial_pc; (void)config;
+    sms[sm].busy = false;
+    sms[sm].fifo_count = 0;
+}
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base) { (void)c; (void)sideset_base; }
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+    (void)c; (void)shift_right; (void)autopull; (void)pull_threshold;
+}
+void sm_config_set_clkdiv(pio_sm_config *c, float div) { (void)c; (void)div; } // Ticks are STEP_ENGINE_TICK_HZ
+
+void pio_sm_set_enabled(PIO pio, uint sm_id, bool enabled) {
+    (void)pio;
+    sim_sm_t *sm = &sms[sm_id];
+    service_sm(sm_id);
+    if (!enabled && sm->enabled && sm->busy) {
+        sm->remaining_ns = sm->word_end_ns - now_ns; // Frozen mid-word
+    } else if (enabled && !sm->enabled && sm->busy) {
+        sm->word_end_ns = now_ns + sm->remaining_ns;
+    }
+    sm->enabled = enabled;
+    service_sm(sm_id);
+}
+
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask) {
+    for (uint i = 0; i < SIM_PIO_NUM_SMS; i++) {
+        if (mask & (1u << i)) pio_sm_set_enabled(pio, i, true);
+    }
+}
+
+void pio_sm_restart(PIO pio, uint sm) {
+    (void)pio;
+    sms[sm].busy = false; // Back to the pull: the interval in progress is abandoned
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+    (void)pio;
+    sms[sm].fifo_count = 0;
+}
+
+void pio_sm_exec(PIO pio, uint sm_id, uint instr) {
+    (void)pio;
+    sim_sm_t *sm = &sms[sm_id];
+    service_sm(sm_id);
+    if (instr == pio_encode_mov_not(pio_isr, pio_y)) {
+        sm->isr = sm->pulses;
+    } else if (instr == pio_encode_push(false, false)) {
+        sm->rx = sm->isr;
+    } else if (instr == pio_encode_mov_not(pio_y, pio_null)) {
+        sm->pulses = 0;
+    }
+    // Anything else is part of the restart sequence (see pio_sm_restart())
+}
+
+void pio_sm_put(PIO pio, uint sm_id, uint32_t data) {
+    (void)pio;
+    sim_sm_t *sm = &sms[sm_id];
+    service_sm(sm_id);
+    if (sm->fifo_count == SIM_PIO_FIFO_DEPTH) return; // Like the hardware: a put to a full FIFO is lost
+    sm->fifo[(sm->fifo_head + sm->fifo_count) % SIM_PIO_FIFO_DEPTH] = data;
+    sm->fifo_count++;
+    service_sm(sm_id);
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm) {
+    (void)pio;
+    return sms[sm].rx;
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) {
+    (void)pio;
+    service_sm(sm);
+    return sms[sm].fifo_count == SIM_PIO_FIFO_DEPTH;
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm) {
+    (void)pio;
+    service_sm(sm);
+    return sms[sm].fifo_count == 0;
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    (void)pio;
+    uint sm = (uint)source - pis_sm0_tx_fifo_not_full;
+    if (sm < SIM_PIO_NUM_SMS) sms[sm].src_enabled = enabled;
+    run_irqs();
+}
+
+static bool pio_irq_pending(void) {
+    for (uint i = 0; i < SIM_PIO_NUM_SMS; i++) {
+        if (sms[i].claimed && sms[i].src_enabled && sms[i].fifo_count < SIM_PIO_FIFO_DEPTH) return true;
+    }
+    return false;
+}
+
+// --- GPIO ---
+void gpio_init(uint gpio) {
+    gpios[gpio].out_dir = false;
+    gpios[gpio].out = false;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    gpios[gpio].out_dir = out;
+}
+
+void gpio_put(uint gpio, bool value) {
+    gpios[gpio].out = value;
+}
+
+bool gpio_get(uint gpio) {
+    return gpios[gpio].out_dir ? gpios[gpio].out : gpios[gpio].in;
+}
+
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_set_function(uint gpio, enum gpio_function fn) { (void)gpio; (void)fn; }
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if (enabled) {
+        gpios[gpio].irq_mask |= events;
+    } else {
+        gpios[gpio].irq_mask &= ~events;
+    }
+    run_irqs();
+}
+
+void gpio_add_raw_irq_handler(uint gpio, irq_handler_t handler) {
+    (void)gpio;
+    sim_irq_t *irq = &irqs[IO_IRQ_BANK0];
+    for (uint i = 0; i < irq->count; i++) {
+        if (irq->handlers[i] == handler) return; // One handler may serve several pins
+    }
+    if (irq->count < MAX_IRQ_HANDLERS) irq->handlers[irq->count++] = handler;
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio) {
+    return gpios[gpio].raw_events & gpios[gpio].irq_mask;
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t events) {
+    gpios[gpio].raw_events &= ~events;
+}
+
+void sim_gpio_set_input(uint gpio, bool level) {
+    if (gpios[gpio].in != level) {
+        gpios[gpio].raw_events |= level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+        gpios[gpio].in = level;
+    }
+    run_irqs();
+}
+
+bool sim_gpio_get_output(uint gpio) {
+    return gpios[gpio].out;
+}
+
+static bool gpio_irq_pending(void) {
+    for (uint i = 0; i < SIM_NUM_GPIOS; i++) {
+        if (gpios[i].raw_events & gpios[i].irq_mask) return true;
+    }
+    return false;
+}
+
+// --- UART ---
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+    (void)uart;
+    uart_baud = baudrate;
+    return baudrate;
+}
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate) {
+    (void)uart;
+    uart_baud = baudrate;
+    return baudrate;
+}
+
+void sim_uart_force_baud(uint32_t baud) {
+    uart_baud = baud;
+}
+
+uint32_t sim_uart_baud(void) {
+    return uart_baud;
+}
+
+bool uart_is_readable(uart_inst_t *uart) {
+    (void)uart;
+    return rx_read < rx_ready;
+}
+
+char uart_getc(uart_inst_t *uart) {
+    (void)uart;
+    if (rx_read >= rx_ready) return 0;
+    return (char)rx_bytes[rx_read++ & (SIM_UART_RX_QUEUE - 1)];
+}
+
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data) {
+    (void)uart; (void)tx_needs_data;
+    uart_rx_irq = rx_has_data;
+    run_irqs();
+}
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart) {
+    (void)uart;
+    uart_regs.fr = tx_line_free > now_ns ? UART_UARTFR_BUSY_BITS : 0;
+    return &uart_regs;
+}
+
+uint uart_get_dreq(uart_inst_t *uart, bool is_tx) {
+    (void)uart; (void)is_tx;
+    return SIM_DREQ_UART0_TX;
+}
+
+uint uart_get_index(uart_inst_t *uart) {
+    (void)uart;
+    return 0;
+}
+
+void sim_uart_send(const uint8_t *data, size_t len) {
+    uint64_t t = rx_line_free > now_ns ? rx_line_free : now_ns;
+    for (size_t i = 0; i < len; i++) {
+        if (rx_head - rx_read >= SIM_UART_RX_QUEUE) {
+            fprintf(stderr, "sim: UART RX queue overflow\n");
+            abort();
+        }
+        t += uart_byte_ns();
+        rx_bytes[rx_head & (SIM_UART_RX_QUEUE - 1)] = data[i];
+        rx_arrival[rx_head & (SIM_UART_RX_QUEUE - 1)] = t;
+        rx_head++;
+    }
+    rx_line_free = t;
+}
+
+uint64_t sim_uart_rx_done_ns(void) {
+    return rx_line_free;
+}
+
+size_t sim_uart_receive(uint8_t *buf, size_t max) {
+    size_t n = 0;
+    while (n < max && tx_taken < tx_head && tx_done[tx_taken & (SIM_UART_TX_CAPTURE - 1)] <= now_ns) {
+        buf[n++] = tx_bytes[tx_taken & (SIM_UART_TX_CAPTURE - 1)];
+        tx_taken++;
+    }
+    return n;
+}
+
+uint64_t sim_uart_next_tx_ns(void) {
+    return tx_taken < tx_head ? tx_done[tx_taken & (SIM_UART_TX_CAPTURE - 1)] : UINT64_MAX;
+}
+
+static bool uart_irq_pending(void) {
+    return uart_rx_irq && rx_read < rx_ready;
+}
+
+// Bytes go on the line back to back; DMA is done once the rest fits in the FIFO
+static uint64_t uart_tx_start(const volatile uint8_t *src, uint32_t count) {
+    uint64_t t = tx_line_free > now_ns ? tx_line_free : now_ns;
+    for (uint32_t i = 0; i < count; i++) {
+        if (tx_head - tx_taken >= SIM_UART_TX_CAPTURE) tx_taken++; // Host not listening: drop the oldest
+        t += uart_byte_ns();
+        tx_bytes[tx_head & (SIM_UART_TX_CAPTURE - 1)] = src[i];
+        tx_done[tx_head & (SIM_UART_TX_CAPTURE - 1)] = t;
+        tx_head++;
+    }
+    tx_line_free = t;
+    uint64_t fifo_ns = UART_FIFO_DEPTH * uart_byte_ns();
+    return t > now_ns + fifo_ns ? t - fifo_ns : now_ns;
+}
+
+// --- TMC2130 Model ---
+void sim_tmc_attach(const uint *cs_pins, uint count, bool daisy_chain) {
+    tmc_count = count > SIM_MAX_TMC_DRIVERS ? SIM_MAX_TMC_DRIVERS : count;
+    for (uint i = 0; i < tmc_count; i++) tmc_cs[i] = cs_pins[i];
+    tmc_daisy = daisy_chain;
+}
+
+void sim_tmc_set_sg_result(uint driver, uint16_t sg_result) {
+    if (driver < SIM_MAX_TMC_DRIVERS) tmc[driver].sg_result = sg_result & 0x3FF;
+}
+
+void sim_tmc_set_stall(uint driver, bool stall) {
+    if (driver < SIM_MAX_TMC_DRIVERS) tmc[driver].stall = stall;
+}
+
+void sim_tmc_drop_pulses(uint driver, uint32_t count) {
+    if (driver < SIM_MAX_TMC_DRIVERS) tmc[driver].drop_pulses += count;
+}
+
+// A STEP pulse reaching the driver: MSCNT moves by 1 << MRES (CHOPCONF 27:24)
+static void tmc_step(uint driver, bool forward) {
+    if (driver >= tmc_count) return;
+    sim_tmc_t *t = &tmc[driver];
+    if (t->drop_pulses) {
+        t->drop_pulses--;
+        return;
+    }
+    uint32_t mres = (t->regs[TMC_REG_CHOPCONF] >> 24) & 0x0F;
+    uint16_t inc = (uint16_t)(1u << (mres > 8 ? 8 : mres));
+    t->mscnt = (uint16_t)((forward ? t->mscnt + inc : t->mscnt - inc) & 0x3FF);
+}
+
+uint32_t sim_tmc_datagrams(void) {
+    return tmc_datagram_count;
+}
+
+static uint32_t tmc_read_value(uint d, uint8_t addr) {
+    if (addr == TMC_REG_DRVSTATUS) {
+        uint32_t cs_actual = (tmc[d].regs[TMC_REG_IHOLD_IRUN] >> 8) & 0x1F; // IRUN
+        return (uint32_t)tmc[d].sg_result | (cs_actual << 16) | (tmc[d].stall ? TMC_DRV_STALLGUARD : 0);
+    }
+    if (addr == TMC_REG_MSCNT) return tmc[d].mscnt;
+    return tmc[d].regs[addr & 0x7F];
+}
+
+uint32_t sim_tmc_get_register(uint driver, uint8_t addr) {
+    return driver < SIM_MAX_TMC_DRIVERS ? tmc_read_value(driver, addr) : 0;
+}
+
+// One 40-bit datagram: the response carries the register the previous read selected
+static void tmc_datagram(uint d, const volatile uint8_t *in, volatile uint8_t *out) {
+    uint8_t addr = in[0];
+    uint32_t value = ((uint32_t)in[1] << 24) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 8) | in[4];
+    uint32_t reply = tmc_read_value(d, tmc[d].last_read);
+    out[0] = 0; // SPI_STATUS: no errors, no standstill
+    out[1] = (uint8_t)(reply >> 24);
+    out[2] = (uint8_t)(reply >> 16);
+    out[3] = (uint8_t)(reply >> 8);
+    out[4] = (uint8_t)reply;
+    if (addr & 0x80) {
+        tmc[d].regs[addr & 0x7F] = value;
+    } else {
+        tmc[d].last_read = addr & 0x7F;
+    }
+    tmc_datagram_count++;
+}
+
+static void spi_exchange(const volatile uint8_t *src, volatile uint8_t *dst, size_t len) {
+    for (size_t i = 0; i < len; i++) dst[i] = 0xFF; // MISO idles high
+    if (tmc_daisy) {
+        // The first datagram in travels to the last driver (see chain_offset() in tmc2130.c)
+        if (tmc_count == 0 || gpio_get(tmc_cs[0])) return;
+        uint n = (uint)(len / 5);
+        for (uint d = 0; d < tmc_count && d < n; d++) {
+            size_t off = (size_t)(n - 1 - d) * 5;
+            tmc_datagram(d, &src[off], &dst[off]);
+        }
+        return;
+    }
+    for (uint d = 0; d < tmc_count; d++) {
+        if (!gpio_get(tmc_cs[d]) && len >= 5) {
+            tmc_datagram(d, src, dst);
+            return;
+        }
+    }
+}
+
+static inline uint64_t spi_transfer_ns(size_t len) {
+    return (uint64_t)len * 8u * NS_PER_S / spi_baud;
+}
+
+// --- SPI ---
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    (void)spi;
+    spi_baud = baudrate;
+    return baudrate;
+}
+
+uint spi_get_index(spi_inst_t *spi) {
+    (void)spi;
+    return 0;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+    (void)spi;
+    return &spi_regs;
+}
+
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+    (void)spi;
+    return is_tx ? SIM_DREQ_SPI0_TX : SIM_DREQ_SPI0_RX;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len) {
+    (void)spi;
+    spi_exchange(src, dst, len);
+    sim_advance(spi_transfer_ns(len));
+    return (int)len;
+}
+
+// --- DMA ---
+int dma_claim_unused_channel(bool required) {
+    for (uint i = 0; i < SIM_NUM_DMA; i++) {
+        if (!dma[i].claimed) {
+            dma[i].claimed = true;
+            return (int)i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "sim: no free DMA channel\n");
+        abort();
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    dma_channel_config c = { 0 };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { (void)c; (void)size; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { (void)c; (void)incr; }
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    c->dreq = dreq;
+}
+
+void dma_start_channel_mask(uint32_t chan_mask) {
+    int spi_tx = -1, spi_rx = -1;
+    for (uint i = 0; i < SIM_NUM_DMA; i++) {
+        if (!(chan_mask & (1u << i))) continue;
+        if (dma[i].dreq == SIM_DREQ_SPI0_TX) spi_tx = (int)i;
+        if (dma[i].dreq == SIM_DREQ_SPI0_RX) spi_rx = (int)i;
+    }
+    if (spi_tx >= 0 && spi_rx >= 0) {
+        // Full duplex: the response is complete when the last TX byte is
+        spi_exchange(dma[spi_tx].read_addr, dma[spi_rx].write_addr, dma[spi_tx].count);
+        uint64_t end = now_ns + spi_transfer_ns(dma[spi_tx].count);
+        dma[spi_tx].busy = dma[spi_rx].busy = true;
+        dma[spi_tx].end_ns = dma[spi_rx].end_ns = end;
+    }
+    for (uint i = 0; i < SIM_NUM_DMA; i++) {
+        if (!(chan_mask & (1u << i)) || dma[i].dreq != SIM_DREQ_UART0_TX) continue;
+        dma[i].busy = true;
+        dma[i].end_ns = uart_tx_start(dma[i].read_addr, dma[i].count);
+    }
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    dma[channel].dreq = config->dreq;
+    dma[channel].write_addr = write_addr;
+    dma[channel].read_addr = read_addr;
+    dma[channel].count = transfer_count;
+    if (trigger) dma_start_channel_mask(1u << channel);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+    dma[channel].read_addr = read_addr;
+    if (trigger) dma_start_channel_mask(1u << channel);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+    dma[channel].write_addr = write_addr;
+    if (trigger) dma_start_channel_mask(1u << channel);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    dma[channel].count = trans_count;
+    if (trigger) dma_start_channel_mask(1u << channel);
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    dma[channel].irq0_enabled = enabled;
+    run_irqs();
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+    return dma[channel].irq0_status;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+    dma[channel].irq0_status = false;
+}
+
+static bool dma_irq_pending(void) {
+    for (uint i = 0; i < SIM_NUM_DMA; i++) {
+        if (dma[i].irq0_enabled && dma[i].irq0_status) return true;
+    }
+    return false;
+}
+
+// --- IRQ Dispatch ---
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    irqs[num].handlers[0] = handler;
+    irqs[num].count = 1;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    (void)order_priority;
+    if (irqs[num].count < MAX_IRQ_HANDLERS) irqs[num].handlers[irqs[num].count++] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    irqs[num].enabled = enabled;
+    irqs[num].core = current_core;
+    run_irqs();
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = interrupts_disabled ? 1u : 0u;
+    interrupts_disabled = true;
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    interrupts_disabled = status != 0;
+    run_irqs();
+}
+
+static bool irq_pending(uint num) {
+    switch (num) {
+        case PIO0_IRQ_0:    return pio_irq_pending();
+        case DMA_IRQ_0:     return dma_irq_pending();
+        case IO_IRQ_BANK0:  return gpio_irq_pending();
+        case UART0_IRQ:     return uart_irq_pending();
+        default:            return false;
+    }
+}
+
+// Level-triggered, lowest number first, no nesting
+static void run_irqs(void) {
+    static const uint order[] = { PIO0_IRQ_0, DMA_IRQ_0, IO_IRQ_BANK0, UART0_IRQ };
+    if (in_irq || interrupts_disabled) return;
+    in_irq = true;
+    uint saved_core = current_core;
+    for (uint round = 0; round < MAX_IRQ_ROUNDS; round++) {
+        bool ran = false;
+        for (uint n = 0; n < sizeof(order) / sizeof(order[0]) && !ran; n++) {
+            sim_irq_t *irq = &irqs[order[n]];
+            if (!irq->enabled || irq->count == 0 || !irq_pending(order[n])) continue;
+            current_core = irq->core;
+            for (uint h = 0; h < irq->count; h++) irq->handlers[h]();
+            ran = true;
+        }
+        if (!ran) break;
+        if (round == MAX_IRQ_ROUNDS - 1) {
+            fprintf(stderr, "sim: IRQ storm (a pending interrupt is never cleared)\n");
+            abort();
+        }
+    }
+    current_core = saved_core;
+    in_irq = false;
+}
+
+// --- Event Loop ---
+static uint64_t next_event_ns(void) {
+    uint64_t next = UINT64_MAX;
+    for (uint i = 0; i < SIM_PIO_NUM_SMS; i++) {
+        if (sms[i].enabled && sms[i].busy && sms[i].word_end_ns < next) next = sms[i].word_end_ns;
+    }
+    for (uint i = 0; i < SIM_NUM_DMA; i++) {
+        if (dma[i].busy && dma[i].end_ns < next) next = dma[i].end_ns;
+    }
+    if (rx_ready < rx_head) {
+        uint64_t t = rx_arrival[rx_ready & (SIM_UART_RX_QUEUE - 1)];
+        if (t < next) next = t;
+    }
+    return next;
+}
+
+static void process_events(void) {
+    for (uint i = 0; i < SIM_PIO_NUM_SMS; i++) service_sm(i);
+    for (uint i = 0; i < SIM_NUM_DMA; i++) {
+        if (dma[i].busy && dma[i].end_ns <= now_ns) {
+            dma[i].busy = false;
+            dma[i].irq0_status = true;
+        }
+    }
+    while (rx_ready < rx_head && rx_arrival[rx_ready & (SIM_UART_RX_QUEUE - 1)] <= now_ns) rx_ready++;
+}
+
+void sim_advance_to(uint64_t time_ns) {
+    while (1) {
+        uint64_t next = next_event_ns();
+        if (next > time_ns) break;
+        if (next > now_ns) now_ns = next;
+        process_events();
+        run_irqs();
+    }
+    if (time_ns > now_ns) now_ns = time_ns;
+    process_events();
+    run_irqs();
+}
+
+void sim_advance(uint64_t delta_ns) {
+    sim_advance_to(now_ns + delta_ns);
+}
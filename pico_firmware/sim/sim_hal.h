@@ -0,0 +1,73 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include "pico/stdlib.h"
+
+// --- Host-side Control of the Simulated Hardware ---
+// The firmware sees the stub SDK headers in sim/hal; the harness (bench.c,
+// sim_firmware.c) drives the same model through this interface.
+//
+// Time only moves when the harness (or a blocking SDK call such as
+// busy_wait_us_32() or spi_write_read_blocking()) advances it. Advancing
+// replays every hardware event due in between in time order (PIO FIFO words,
+// DMA completions, UART bytes) and runs the IRQ handlers they raise, on the
+// core that enabled the IRQ. Loop passes take no virtual time by themselves.
+
+#define SIM_MAX_TMC_DRIVERS     4
+#define SIM_UART_TX_CAPTURE     65536   // Bytes of firmware output kept for the host (power of 2)
+#define SIM_UART_RX_QUEUE       65536   // Bytes the host may have in flight to the firmware (power of 2)
+
+// Called for every STEP pulse the simulated PIO emits
+typedef void (*sim_step_hook_t)(uint sm, uint64_t time_ns, bool forward);
+
+// --- Clock ---
+void sim_reset(void);
+uint64_t sim_now_ns(void);
+void sim_advance(uint64_t delta_ns);
+void sim_advance_to(uint64_t time_ns);
+
+// Core whose code runs next (loop passes); IRQs switch to their owning core
+void sim_set_core(uint core);
+
+// Route firmware printf output: false discards it (see sim_printf in CMakeLists.txt)
+void sim_set_verbose(bool verbose);
+int sim_printf(const char *format, ...);
+
+// --- UART (the host end of the link) ---
+// Queue bytes towards the firmware; they arrive one byte time apart at the
+// current baud rate, after anything still in flight.
+void sim_uart_send(const uint8_t *data, size_t len);
+// Time the last queued byte will have arrived
+uint64_t sim_uart_rx_done_ns(void);
+// Copy out firmware output whose last bit has left the line; returns the count
+size_t sim_uart_receive(uint8_t *buf, size_t max);
+// Time the first not yet received output byte finishes (UINT64_MAX if none)
+uint64_t sim_uart_next_tx_ns(void);
+uint32_t sim_uart_baud(void);
+// Line model only: set the rate without the firmware (bench throughput runs)
+void sim_uart_force_baud(uint32_t baud);
+
+// --- GPIO ---
+// Drive an input pin (switches, DIAG1); edges latch IRQ events
+void sim_gpio_set_input(uint gpio, bool level);
+bool sim_gpio_get_output(uint gpio);
+
+// --- PIO ---
+void sim_set_step_hook(sim_step_hook_t hook);
+// The direction pin the step engine drives for SM 'sm' (for the hook's 'forward')
+void sim_pio_set_dir_pin(uint sm, uint gpio);
+
+// --- TMC2130 Model ---
+// Chip selects of the drivers (all the same pin on a daisy chain)
+void sim_tmc_attach(const uint *cs_pins, uint count, bool daisy_chain);
+// DRV_STATUS.SG_RESULT reported by a driver (load, 0 = stalled)
+void sim_tmc_set_sg_result(uint driver, uint16_t sg_result);
+// DRV_STATUS.stallGuard reported by a driver
+void sim_tmc_set_stall(uint driver, bool stall);
+// The driver misses its next 'count' STEP pulses (MSCNT stays behind the PIO count)
+void sim_tmc_drop_pulses(uint driver, uint32_t count);
+uint32_t sim_tmc_get_register(uint driver, uint8_t addr);
+// Datagrams exchanged so far (all drivers)
+uint32_t sim_tmc_datagrams(void);
+
+#endif // SIM_HAL_H
@@ -0,0 +1,172 @@
+// --- Simulated Pico on a Pseudo-terminal ---
+// Runs the host build of the firmware in real time behind a pty, so anything
+// that talks to the Pico over a serial port (the agent, link_test.py) can be
+// pointed at the simulator instead:
+//   stepper_sim_pty [--link PATH] [--verbose]
+//   python3 rpi_zero_agent/link_test.py --port /dev/pts/N load
+// Bytes written to the pty go into the simulated UART at the firmware's
+// current baud rate (CMD_SET_BAUD switches it, the pty itself ignores rates);
+// firmware output is copied back as soon as its last bit has left the line.
+// The virtual clock follows the host clock: loop passes run PASS_NS apart
+// until it catches up, then the process waits for input. If the host can't
+// keep up for SIM_PTY_MAX_LAG_NS the clock is let go (reported at exit).
+// Caught up, it sleeps in poll() for at most SIM_PTY_POLL_MS, and input
+// wakes it at once.
+//
+// The line "Simulated Pico (N axes) on <device>" on stdout marks the pty as
+// ready. --link also creates a symlink to it (removed at exit).
+
+#define _XOPEN_SOURCE 600   // posix_openpt()
+#define _DEFAULT_SOURCE     // cfmakeraw()
+#include "sim_firmware.h"
+#include "motor_control.h" // NUM_MOTORS
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PASS_NS             10000ull        // Virtual time between loop passes (as in bench.c)
+#define SIM_PTY_RX_AHEAD_NS 20000000ull     // Host bytes queued on the simulated line at most (then the pty buffers)
+#define SIM_PTY_MAX_LAG_NS  100000000ull    // Behind the host clock by this much: resync
+#define SIM_PTY_POLL_MS     1               // Wait for input when caught up
+#define SIM_PTY_TX_BUFFER   4096            // Firmware output the pty has not taken yet
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static inline uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Master end of a new pty in raw mode. The slave stays open here too, so a
+// client closing its end doesn't hang up the master (clients may reconnect).
+static int open_pty(char *name, size_t name_len, int *slave_fd) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return -1;
+    const char *slave_name = ptsname(master);
+    if (!slave_name) return -1;
+    snprintf(name, name_len, "%s", slave_name);
+
+    *slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if (*slave_fd < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(*slave_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(*slave_fd, TCSANOW, &tio);
+    }
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    return master;
+}
+
+int main(int argc, char **argv) {
+    const char *link_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--link") && i + 1 < argc) {
+            link_path = argv[++i];
+        } else if (!strcmp(argv[i], "--verbose")) {
+            sim_set_verbose(true);
+        } else {
+            fprintf(stderr, "usage: %s [--link PATH] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    char name[128];
+    int slave = -1;
+    int master = open_pty(name, sizeof(name), &slave);
+    if (master < 0) {
+        perror("stepper_sim_pty: pty");
+        return 1;
+    }
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(name, link_path) < 0) {
+            perror("stepper_sim_pty: symlink");
+            return 1;
+        }
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    sim_firmware_boot();
+    printf("Simulated Pico (%d axes) on %s\n", NUM_MOTORS, name);
+    fflush(stdout);
+
+    uint8_t tx[SIM_PTY_TX_BUFFER];
+    size_t tx_len = 0;
+    uint64_t bytes_in = 0, bytes_out = 0, tx_dropped = 0, resyncs = 0;
+    uint64_t host0 = host_ns(), virt0 = sim_now_ns();
+
+    while (!stop) {
+        // Run the loops up to the host clock
+        uint64_t target = virt0 + (host_ns() - host0);
+        if (target > sim_now_ns() + SIM_PTY_MAX_LAG_NS) {
+            host0 = host_ns();
+            virt0 = sim_now_ns();
+            target = virt0;
+            resyncs++;
+        }
+        while (sim_now_ns() < target) {
+            sim_core1_pass();
+            sim_core0_pass();
+            sim_advance(PASS_NS);
+            if (sim_uart_next_tx_ns() <= sim_now_ns()) break; // Output ready: pass it on first
+        }
+
+        // Host -> firmware once the clock has caught up (bytes arrive now, not
+        // in the virtual past), only as far ahead as the line needs
+        if (sim_uart_rx_done_ns() <= sim_now_ns() + SIM_PTY_RX_AHEAD_NS) {
+            uint8_t rx[256];
+            ssize_t n = read(master, rx, sizeof(rx));
+            if (n > 0) {
+                sim_uart_send(rx, (size_t)n);
+                bytes_in += (uint64_t)n;
+            }
+        }
+
+        // Firmware -> host (what the pty won't take waits; past the buffer it's lost)
+        size_t got = sim_uart_receive(&tx[tx_len], sizeof(tx) - tx_len);
+        tx_len += got;
+        bytes_out += got;
+        if (tx_len == sizeof(tx)) {
+            uint8_t discard[256];
+            size_t lost;
+            while ((lost = sim_uart_receive(discard, sizeof(discard))) > 0) tx_dropped += lost;
+        }
+        if (tx_len) {
+            ssize_t n = write(master, tx, tx_len);
+            if (n > 0) {
+                memmove(tx, &tx[n], tx_len - (size_t)n);
+                tx_len -= (size_t)n;
+            } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("stepper_sim_pty: write");
+                break;
+            }
+        }
+
+        if (!tx_len && sim_now_ns() >= target) {
+            struct pollfd pfd = { .fd = master, .events = POLLIN };
+            poll(&pfd, 1, SIM_PTY_POLL_MS);
+        }
+    }
+
+    fprintf(stderr, "stepper_sim_pty: %llu bytes in, %llu bytes out, %llu dropped, %llu clock resyncs\n",
+            (unsigned long long)bytes_in, (unsigned long long)bytes_out,
+            (unsigned long long)tx_dropped, (unsigned long long)resyncs);
+    if (link_path) unlink(link_path);
+    close(slave);
+    close(master);
+    return 0;
+}
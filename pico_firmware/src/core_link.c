@@ -0,0 +1,182 @@
+#include "core_link.h"
+#include "uart_protocol.h" // UART_MAX_DATA_LEN
+#include "motor_control.h" // NUM_MOTORS, ERROR_FLAGS_ENDSTOP_MASK
+#include "reg_dirty.h"
+#include "hardware/sync.h" // __dmb, __sev
+#include <string.h> // For memcpy
+
+_Static_assert((CORE_LINK_RING_SIZE & (CORE_LINK_RING_SIZE - 1)) == 0, "Ring size must be a power of 2");
+
+// --- Core 0 -> Core 1: Forwarded Writes ---
+typedef struct {
+    uint16_t addr;
+    uint8_t len;
+    uint8_t data[UART_MAX_DATA_LEN];
+} forwarded_write_t;
+
+static forwarded_write_t write_ring[CORE_LINK_RING_SIZE];
+static volatile uint32_t write_head = 0; // Only written by core 0
+static volatile uint32_t write_tail = 0; // Only written by core 1
+static uint32_t fill_head = 0;           // Core 0: next record, ahead of write_head in a batch
+static bool batching = false;            // Core 0: hold records back until the batch ends
+
+// --- Core 1 -> Core 0: Status Snapshots ---
+typedef struct {
+    volatile uint32_t seq;                  // Odd while being written
+    uint8_t registers[REGISTER_MAP_SIZE];
+    uint32_t pushes_applied[NUM_MOTORS];    // Queue pushes core 1 has replayed
+} status_snapshot_t;
+
+static status_snapshot_t snapshots[2];
+static volatile uint32_t published = 0; // Index of the latest complete snapshot
+
+// Registers written by core 1 (everything else belongs to core 0): global
+// addresses, and offsets repeated in every axis block
+typedef struct { uint16_t addr; uint8_t len; } reg_range_t;
+
+static const reg_range_t core1_ranges[] = {
+    { REG_STATUS, 2 },                  // STATUS, SWITCH_STATUS (and the endstop bits of ERROR_FLAGS)
+    { REG_COORD_CONTROL, 1 },
+};
+
+#define AXIS_OFFSET(reg) (reg(0) - REG_AXIS(0))
+
+static const reg_range_t core1_axis_ranges[] = {
+    { AXIS_OFFSET(REG_MOTOR_CONTROL), 1 },
+    { AXIS_OFFSET(REG_MOTOR_CURRENT_POS_L), 4 },
+    { AXIS_OFFSET(REG_MOTOR_STATUS), 3 },           // STATUS, CURRENT_SPEED
+    { AXIS_OFFSET(REG_MOTOR_QUEUE_CONTROL), 2 },    // QUEUE_CONTROL, QUEUE_FREE
+    { AXIS_OFFSET(REG_MOTOR_HOMING_STATE), 1 },
+    { AXIS_OFFSET(REG_MOTOR_ENDSTOP_POS_L), 8 },    // ENDSTOP_POS, ENDSTOP_TIME
+};
+
+static uint32_t pushes_sent[NUM_MOTORS]; // Core 0 only
+
+// Motor whose queue a write pushes to, or -1
+static int queue_push_motor(uint16_t reg_addr, uint8_t len, const uint8_t *data) {
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        uint16_t ctrl = REG_MOTOR_QUEUE_CONTROL(i);
+        if (ctrl >= reg_addr && ctrl < reg_addr + len && (data[ctrl - reg_addr] & 0x01)) return (int)i;
+    }
+    return -1;
+}
+
+// Consistent copy of the latest snapshot (retries if core 1 overwrote it meanwhile)
+static void read_snapshot(status_snapshot_t *out) {
+    while (1) {
+        const status_snapshot_t *snap = &snapshots[published];
+        uint32_t seq = snap->seq;
+        if (seq & 1) continue;
+        __dmb();
+        memcpy(out->registers, snap->registers, sizeof(out->registers));
+        memcpy(out->pushes_applied, snap->pushes_applied, sizeof(out->pushes_applied));
+        __dmb();
+        if (snap->seq == seq) return;
+    }
+}
+
+// --- Core 0 ---
+bool core_link_forward_write(uint16_t reg_addr, uint8_t len, volatile uint8_t *registers) {
+    uint32_t head = fill_head;
+    if (head - write_tail >= CORE_LINK_RING_SIZE || len > UART_MAX_DATA_LEN) {
+        return false; // Core 1 is behind, the master retries
+    }
+
+    forwarded_write_t *rec = &write_ring[head & (CORE_LINK_RING_SIZE - 1)];
+    rec->addr = reg_addr;
+    rec->len = len;
+    for (uint8_t i = 0; i < len; i++) rec->data[i] = registers[reg_addr + i];
+
+    bool ok = true;
+    int motor = queue_push_motor(reg_addr, len, rec->data);
+    if (motor >= 0) {
+        status_snapshot_t snap;
+        read_snapshot(&snap);
+        uint32_t in_flight = pushes_sent[motor] - snap.pushes_applied[motor];
+        if (snap.registers[REG_MOTOR_QUEUE_FREE(motor)] > in_flight) {
+            pushes_sent[motor]++;
+        } else {
+            // Queue (probably) full: forward the staging bytes without the push
+            rec->data[REG_MOTOR_QUEUE_CONTROL(motor) - reg_addr] &= ~0x01;
+            ok = false;
+        }
+    }
+
+    fill_head = head + 1;
+    if (!batching) {
+        __dmb(); // Record complete before core 1 can see it
+        write_head = fill_head;
+        __sev(); // Wake core 1 if it is idle
+    }
+    return ok;
+}
+
+bool core_link_forward_batch(bool begin, uint8_t writes) {
+    if (begin) {
+        if (fill_head - write_tail + writes > CORE_LINK_RING_SIZE) return false;
+        batching = true;
+        return true;
+    }
+    batching = false;
+    __dmb(); // All records complete before core 1 can see any
+    write_head = fill_head;
+    __sev();
+    return true;
+}
+
+void core_link_pull_status(volatile uint8_t *registers) {
+    static status_snapshot_t snap;
+    read_snapshot(&snap);
+    for (size_t r = 0; r < sizeof(core1_ranges) / sizeof(core1_ranges[0]); r++) {
+        for (uint8_t i = 0; i < core1_ranges[r].len; i++) {
+            uint16_t addr = core1_ranges[r].addr + i;
+            reg_publish_u8(registers, addr, snap.registers[addr]);
+        }
+    }
+    // The driver fault bits of ERROR_FLAGS are core 0's (driver_monitor.c)
+    reg_publish_u8(registers, REG_ERROR_FLAGS, (snap.registers[REG_ERROR_FLAGS] & ERROR_FLAGS_ENDSTOP_MASK) |
+                                               (registers[REG_ERROR_FLAGS] & ~ERROR_FLAGS_ENDSTOP_MASK));
+    for (uint axis = 0; axis < NUM_MOTORS; axis++) {
+        for (size_t r = 0; r < sizeof(core1_axis_ranges) / sizeof(core1_axis_ranges[0]); r++) {
+            for (uint8_t i = 0; i < core1_axis_ranges[r].len; i++) {
+                uint16_t addr = REG_AXIS(axis) + core1_axis_ranges[r].addr + i;
+                reg_publish_u8(registers, addr, snap.registers[addr]);
+            }
+        }
+    }
+}
+
+// --- Core 1 ---
+static uint32_t pushes_applied[NUM_MOTORS]; // Core 1 only
+
+void core_link_apply_writes(volatile uint8_t *registers, bool (*on_write)(uint16_t, uint8_t, volatile uint8_t *)) {
+    uint32_t tail = write_tail;
+    while (tail != write_head) {
+        __dmb(); // Read the record only after seeing the new head
+        const forwarded_write_t *rec = &write_ring[tail & (CORE_LINK_RING_SIZE - 1)];
+        int motor = queue_push_motor(rec->addr, rec->len, rec->data);
+        for (uint8_t i = 0; i < rec->len; i++) registers[rec->addr + i] = rec->data[i];
+        if (on_write) on_write(rec->addr, rec->len, registers);
+        if (motor >= 0) pushes_applied[motor]++;
+
+        __dmb(); // Done with the record before core 0 may reuse it
+        write_tail = ++tail;
+    }
+}
+
+void core_link_publish_status(const volatile uint8_t *registers) {
+    uint32_t next = published ^ 1; // Core 0 reads the other one
+    status_snapshot_t *snap = &snapshots[next];
+    snap->seq++;
+    __dmb();
+    for (uint i = 0; i < REGISTER_MAP_SIZE; i++) snap->registers[i] = registers[i];
+    memcpy(snap->pushes_applied, pushes_applied, sizeof(pushes_applied));
+    __dmb();
+    snap->seq++;
+    published = next;
+    __sev(); // Wake core 0 if it is idle
+}
+
+bool core_link_writes_pending(void) {
+    return write_tail != write_head;
+}
@@ -0,0 +1,54 @@
+#ifndef CORE_LINK_H
+#define CORE_LINK_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Inter-core Register Link ---
+// Core 0 runs the UART protocol, TMC SPI and telemetry and owns
+// virtual_registers[], the map the master reads and writes. Core 1 runs the
+// planner, the step engine IRQs and the endstops on its own copy of the map.
+// Neither core ever touches the other's copy, and there are no locks:
+//  - core 0 -> core 1: every WRITE frame applied to virtual_registers[] is
+//    forwarded as a record through a single-producer/single-consumer ring, and
+//    core 1 replays the records into its copy in order. The records of a
+//    staged commit are published together, so core 1 replays them in one go.
+//  - core 1 -> core 0: after each pass, core 1 publishes its copy into one of
+//    two snapshot buffers (sequence-counted, so a torn copy is detected and
+//    retried). Core 0 merges the registers core 1 owns (status, positions,
+//    speeds, queue space, control bits it has consumed) into virtual_registers[].
+// Both directions end with a __sev(), which wakes the other core from an idle
+// WFE (see idle.h).
+
+#define CORE_LINK_RING_SIZE 32 // Forwarded WRITE frames in flight, power of 2
+
+// --- Core 0 ---
+
+// Register write hook for uart_protocol_set_write_hook(): forwards the write
+// to core 1. Returns false (NACK) if the ring is full, or for a queue push
+// while the last published REG_MOTOR_QUEUE_FREE minus the pushes still in
+// flight leaves no room (core 1 can't be asked without blocking).
+bool core_link_forward_write(uint16_t reg_addr, uint8_t len, volatile uint8_t *registers);
+
+// Batch hook for uart_protocol_set_batch_hook(): while a batch is open the
+// forwarded writes are held back, then published at once. Returns false if
+// the ring has no room for 'writes' more records.
+bool core_link_forward_batch(bool begin, uint8_t writes);
+
+// Copy the registers owned by core 1 from the latest snapshot. Bytes that
+// changed are marked in host_changes (see reg_dirty.h).
+void core_link_pull_status(volatile uint8_t *registers);
+
+// --- Core 1 ---
+
+// Replay the forwarded writes into core 1's register copy, calling 'on_write'
+// after each one (like the UART write hook).
+void core_link_apply_writes(volatile uint8_t *registers, bool (*on_write)(uint16_t, uint8_t, volatile uint8_t *));
+
+// Publish core 1's register copy. Call once per core 1 pass.
+void core_link_publish_status(const volatile uint8_t *registers);
+
+// True if forwarded writes are waiting for core_link_apply_writes()
+bool core_link_writes_pending(void);
+
+#endif // CORE_LINK_H
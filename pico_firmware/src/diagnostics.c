@@ -0,0 +1,148 @@
+#include "diagnostics.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include <string.h> // For memset
+
+// --- Internal State ---
+typedef struct {
+    uint32_t last_cycles;       // SysTick at the end of the previous pass
+    uint32_t last_us;
+    bool started;
+    uint32_t min;
+    uint32_t avg_acc;           // Average << DIAG_AVG_SHIFT
+    uint32_t max;
+    uint32_t generation;        // Last reset_generation seen by the owning core
+} loop_stats_t;
+
+volatile uint32_t diag_counters[DIAG_NUM_COUNTERS];
+
+static loop_stats_t loop_stats[2];
+static volatile uint32_t reset_generation = 0;  // Bumped by core 0; each owner resets its own stats
+
+static volatile uint32_t spi_last = 0;
+static volatile uint32_t spi_max = 0;
+
+static volatile uint16_t step_hist[DIAG_HIST_BUCKETS];
+static volatile uint32_t step_dry = 0;
+static uint32_t step_generation = 0;
+static uint32_t cycles_per_us = 125;
+static uint32_t last_publish_time = 0;
+
+static const uint16_t loop_regs[2] = { REG_DIAG_CORE0_LOOP_MIN_L, REG_DIAG_CORE1_LOOP_MIN_L };
+static const uint16_t counter_regs[DIAG_NUM_COUNTERS] = {
+    REG_DIAG_UART_FRAMES_OK_L, REG_DIAG_UART_CHECKSUM_ERRORS_L, REG_DIAG_UART_NACKS_L, REG_DIAG_UART_RX_OVERFLOWS_L,
+};
+
+static inline uint16_t saturate_u16(uint32_t value) {
+    return value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+}
+
+// --- Initialization ---
+void init_diagnostics_core(void) {
+    systick_hw->csr = 0;
+    systick_hw->rvr = DIAG_CYCLE_SPAN_MAX;
+    systick_hw->cvr = 0; // Any write reloads
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS; // Processor clock, no interrupt
+}
+
+void init_diagnostics(volatile uint8_t *registers) {
+    cycles_per_us = clock_get_hz(clk_sys) / 1000000u;
+    reset_generation++;
+    for (uint i = 0; i < DIAG_NUM_COUNTERS; i++) diag_counters[i] = 0;
+    spi_last = 0;
+    spi_max = 0;
+    for (uint i = REG_DIAG_CONTROL; i <= REG_DIAG_STEP_IRQ_HIST_END; i++) registers[i] = 0;
+    last_publish_time = time_us_32();
+}
+
+// --- Recording ---
+void diag_loop_tick(uint core) {
+    loop_stats_t *s = &loop_stats[core & 1];
+    uint32_t now_cycles = diag_cycles();
+    uint32_t now_us = time_us_32();
+
+    if (s->generation != reset_generation) {
+        s->generation = reset_generation;
+        s->started = false;
+    }
+    if (s->started) {
+        uint32_t us = now_us - s->last_us;
+        uint32_t cycles = (s->last_cycles - now_cycles) & DIAG_CYCLE_SPAN_MAX;
+        if (us >= (DIAG_CYCLE_SPAN_MAX / cycles_per_us) / 2) {
+            cycles = us * cycles_per_us; // SysTick may have wrapped: use the (coarser) timer
+        }
+        uint32_t sample = cycles > DIAG_AVG_SAMPLE_MAX ? DIAG_AVG_SAMPLE_MAX : cycles; // avg_acc must not overflow
+        if (s->max == 0) s->avg_acc = sample << DIAG_AVG_SHIFT; // First pass: seed the average
+        if (cycles < s->min) s->min = cycles;
+        if (cycles > s->max) s->max = cycles;
+        s->avg_acc += sample - (s->avg_acc >> DIAG_AVG_SHIFT);
+    } else {
+        s->started = true;
+        s->min = UINT32_MAX;
+        s->max = 0;
+        s->avg_acc = 0;
+    }
+    s->last_cycles = now_cycles;
+    s->last_us = now_us;
+}
+
+void diag_loop_resume(uint core) {
+    loop_stats_t *s = &loop_stats[core & 1];
+    s->last_cycles = diag_cycles();
+    s->last_us = time_us_32();
+}
+
+void diag_record_spi(uint32_t cycles) {
+    spi_last = cycles;
+    if (cycles > spi_max) spi_max = cycles;
+}
+
+void __not_in_flash_func(diag_record_step_irq)(uint32_t cycles, bool fifo_was_empty) {
+    if (step_generation != reset_generation) {
+        step_generation = reset_generation;
+        for (uint i = 0; i < DIAG_HIST_BUCKETS; i++) step_hist[i] = 0;
+        step_dry = 0;
+    }
+    uint bucket = 0;
+    uint32_t limit = DIAG_HIST_FIRST_LIMIT;
+    while (bucket < DIAG_HIST_BUCKETS - 1 && cycles >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    if (step_hist[bucket] != 0xFFFF) step_hist[bucket]++;
+    if (fifo_was_empty) step_dry++;
+}
+
+// --- Update Registers ---
+void update_diagnostics_registers(volatile uint8_t *registers) {
+    if (registers[REG_DIAG_CONTROL] & 0x01) {
+        registers[REG_DIAG_CONTROL] = 0;
+        reset_generation++; // Loop and step IRQ stats reset on their own core
+        for (uint i = 0; i < DIAG_NUM_COUNTERS; i++) diag_counters[i] = 0;
+        spi_last = 0;
+        spi_max = 0;
+    }
+
+    uint32_t now = time_us_32();
+    if (now - last_publish_time < DIAG_PUBLISH_INTERVAL_US) return;
+    last_publish_time = now;
+
+    for (uint core = 0; core < 2; core++) {
+        const loop_stats_t *s = &loop_stats[core];
+        bool valid = s->started && s->min != UINT32_MAX && s->generation == reset_generation;
+        WRITE_U32_REGISTER(registers, loop_regs[core], valid ? s->min : 0);
+        WRITE_U32_REGISTER(registers, loop_regs[core] + 4, valid ? s->avg_acc >> DIAG_AVG_SHIFT : 0);
+        WRITE_U32_REGISTER(registers, loop_regs[core] + 8, valid ? s->max : 0);
+    }
+    for (uint i = 0; i < DIAG_NUM_COUNTERS; i++) {
+        WRITE_U16_REGISTER(registers, counter_regs[i], (uint16_t)diag_counters[i]);
+    }
+    WRITE_U16_REGISTER(registers, REG_DIAG_SPI_TIME_LAST_L, saturate_u16(spi_last));
+    WRITE_U16_REGISTER(registers, REG_DIAG_SPI_TIME_MAX_L, saturate_u16(spi_max));
+
+    bool step_valid = step_generation == reset_generation;
+    WRITE_U16_REGISTER(registers, REG_DIAG_STEP_IRQ_DRY_L, step_valid ? (uint16_t)step_dry : 0);
+    for (uint i = 0; i < DIAG_HIST_BUCKETS; i++) {
+        WRITE_U16_REGISTER(registers, REG_DIAG_STEP_IRQ_HIST + 2 * i, step_valid ? step_hist[i] : 0);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
+
+// --- Diagnostics ---
+// Always-on instrumentation, published read-only in the REG_DIAG_* block:
+//  - min/avg/max pass time of both superloops (core 0: communication,
+//    core 1: motion),
+//  - UART frame counters (valid, bad checksum/CRC, NACKs, RX ring overflows),
+//  - the time of blocking TMC SPI transactions,
+//  - a histogram of the step engine IRQ service time, plus a count of refills
+//    that found a FIFO already empty (the PIO was about to stall a step).
+// Times come from SysTick, run free as a 24-bit down counter on the processor
+// clock (the M0+ has no DWT cycle counter). Reading it is a single load, so
+// the hooks cost a few cycles each. Each core has its own SysTick; spans
+// longer than DIAG_CYCLE_SPAN_MAX are measured with the microsecond timer.
+// Statistics are kept by the core that produces them; core 0 copies them
+// into the register map every DIAG_PUBLISH_INTERVAL_US.
+
+#define DIAG_CYCLE_SPAN_MAX         0xFFFFFFu   // SysTick wraps after 2^24 cycles (134 ms at 125 MHz)
+#define DIAG_AVG_SHIFT              4           // Loop average: new = old + (sample - old) / 16
+#define DIAG_AVG_SAMPLE_MAX         (UINT32_MAX >> DIAG_AVG_SHIFT) // Longer passes count as this in the average
+#define DIAG_PUBLISH_INTERVAL_US    10000
+#define DIAG_HIST_BUCKETS           8
+#define DIAG_HIST_FIRST_LIMIT       128         // Bucket 0: < 128 cycles, bucket n: < 128 << n, last: the rest
+
+// UART counters
+typedef enum {
+    DIAG_UART_FRAME_OK = 0,
+    DIAG_UART_CHECKSUM_ERROR,
+    DIAG_UART_NACK,
+    DIAG_UART_RX_OVERFLOW,
+    DIAG_NUM_COUNTERS
+} diag_counter_t;
+
+extern volatile uint32_t diag_counters[DIAG_NUM_COUNTERS];
+
+// Current SysTick value (counts down)
+static inline uint32_t diag_cycles(void) {
+    return systick_hw->cvr;
+}
+
+// Cycles from 'start' (an earlier diag_cycles()) to now, spans < 2^24 cycles
+static inline uint32_t diag_cycles_since(uint32_t start) {
+    return (start - systick_hw->cvr) & DIAG_CYCLE_SPAN_MAX;
+}
+
+static inline void diag_count(diag_counter_t counter) {
+    diag_counters[counter]++;
+}
+
+// --- Function Prototypes ---
+
+// Start SysTick on the calling core. Call once on each core before its loop.
+void init_diagnostics_core(void);
+
+// Reset all statistics and the register block (core 0, before the loop)
+void init_diagnostics(volatile uint8_t *registers);
+
+// Mark the end of one superloop pass on core 0 or 1
+void diag_loop_tick(uint core);
+
+// Restart the pass timer of core 0 or 1 (after an idle sleep, see idle.h)
+void diag_loop_resume(uint core);
+
+// Record a blocking SPI transaction of 'cycles'
+void diag_record_spi(uint32_t cycles);
+
+// Record one step engine IRQ (called from the IRQ itself)
+void diag_record_step_irq(uint32_t cycles, bool fifo_was_empty);
+
+// Handle REG_DIAG_CONTROL and publish the statistics (core 0 main loop)
+void update_diagnostics_registers(volatile uint8_t *registers);
+
+#endif // DIAGNOSTICS_H
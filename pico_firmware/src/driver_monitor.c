@@ -0,0 +1,207 @@
+#include "driver_monitor.h"
+#include "tmc2130.h"
+#include "motor_control.h" // NUM_MOTORS, ERROR_FLAGS_*
+#include "core_link.h"
+#include "event_log.h"
+#include "reg_dirty.h"
+#include <string.h> // For memset
+
+// REG_MOTOR_CONTROL bits the monitor sends
+#define CONTROL_STOP    0x02
+#define CONTROL_HOME    0x04
+
+// --- Internal State ---
+typedef struct {
+    uint8_t faults;             // REG_MOTOR_DRIVER_FAULTS
+    bool was_moving;            // Moving (not homing) at the last pass
+    uint8_t stall_samples;      // Consecutive stallGuard scans
+    bool recovered;             // Stop/re-home already sent for this move
+    uint8_t pending_control;    // REG_MOTOR_CONTROL bits not yet forwarded (ring full)
+    bool adjust_pending;
+    int8_t adjust;              // REG_MOTOR_POS_ADJUST not yet forwarded
+    // Standstill
+    bool still;
+    uint32_t still_since;       // time_us_32() the axis was first seen idle
+    int32_t last_pos;
+    uint32_t last_mscnt_time;   // MSCNT sample already checked
+    // MSCNT reference: driver MSCNT at counter position ref_pos
+    bool ref_valid;
+    int32_t ref_pos;
+    uint16_t ref_mscnt;
+    uint ref_mres;
+} axis_monitor_t;
+
+static axis_monitor_t axes[NUM_MOTORS];
+static uint32_t last_scan_count = 0;
+
+// --- Helpers ---
+// Latch fault bits; returns the ones not set before
+static uint8_t raise_faults(uint axis, uint8_t faults) {
+    axis_monitor_t *m = &axes[axis];
+    uint8_t added = faults & ~m->faults;
+    m->faults |= added;
+    return added;
+}
+
+// Stop/re-home once per move, for actions 2 and 3
+static void recover(uint axis, uint8_t action, bool rehome_allowed) {
+    axis_monitor_t *m = &axes[axis];
+    if (m->recovered || action < STALL_RECOVERY_STOP) return;
+    m->recovered = true;
+    m->pending_control |= (action == STALL_RECOVERY_REHOME && rehome_allowed) ? CONTROL_HOME : CONTROL_STOP;
+}
+
+static void check_drv_status(uint axis, volatile uint8_t *registers, bool moving) {
+    axis_monitor_t *m = &axes[axis];
+    uint32_t status;
+    if (!tmc_get_drv_status(axis, &status)) return;
+    uint8_t action = registers[REG_MOTOR_STALL_RECOVERY(axis)] & STALL_RECOVERY_ACTION_MASK;
+
+    uint8_t faults = 0;
+    if (status & TMC_DRV_OTPW) faults |= DRIVER_FAULT_OTPW;
+    if (status & TMC_DRV_OT) faults |= DRIVER_FAULT_OT;
+    if (status & (TMC_DRV_S2GA | TMC_DRV_S2GB)) faults |= DRIVER_FAULT_SHORT;
+    if (moving && (status & (TMC_DRV_OLA | TMC_DRV_OLB))) faults |= DRIVER_FAULT_OPEN_LOAD;
+    if (faults & (DRIVER_FAULT_OT | DRIVER_FAULT_SHORT)) {
+        m->ref_valid = false; // Driver shut down: the rotor may have moved
+        if (moving) recover(axis, action, false);
+    }
+    uint8_t added = raise_faults(axis, faults);
+    if (added) event_log(LOG_EVT_DRIVER_FAULT, axis, 0, (int32_t)status, added);
+
+    // StallGuard2 is only valid in SpreadCycle above TCOOLTHRS (COOLSTEP_MIN_SPEED)
+    uint16_t speed = READ_U16_REGISTER(registers, REG_MOTOR_CURRENT_SPEED_L(axis));
+    uint16_t cool_min = READ_U16_REGISTER(registers, REG_MOTOR_COOLSTEP_MIN_SPEED_L(axis));
+    if (cool_min == 0) cool_min = TMC_DEFAULT_COOLSTEP_MIN_SPEED;
+    uint8_t mode = registers[REG_MOTOR_DRIVER_MODE(axis)];
+    bool valid = moving && action && speed >= cool_min &&
+                 (mode == TMC_DRIVER_SPREADCYCLE || mode == TMC_DRIVER_COOLSTEP);
+    if (!valid || !(status & TMC_DRV_STALLGUARD)) {
+        m->stall_samples = 0;
+        return;
+    }
+    if (++m->stall_samples < DRIVER_MONITOR_STALL_SAMPLES || (m->faults & DRIVER_FAULT_STALL)) return;
+    m->ref_valid = false; // Rotor slipped by an unknown number of cycles
+    event_log(LOG_EVT_STALL_DETECTED, axis, action, (int32_t)READ_U32_REGISTER(registers, REG_MOTOR_CURRENT_POS_L(axis)),
+              (int32_t)(status & 0x3FF));
+    raise_faults(axis, DRIVER_FAULT_STALL);
+    recover(axis, action, true);
+}
+
+// Compare MSCNT at standstill with the MSCNT the position counter predicts
+static void check_mscnt(uint axis, volatile uint8_t *registers, int32_t pos) {
+    axis_monitor_t *m = &axes[axis];
+    uint16_t mscnt;
+    uint32_t sample_time;
+    if (!tmc_get_mscnt(axis, &mscnt, &sample_time)) return;
+    reg_publish_u16(registers, REG_MOTOR_MSCNT_L(axis), mscnt);
+
+    uint8_t recovery = registers[REG_MOTOR_STALL_RECOVERY(axis)];
+    if (!(recovery & STALL_RECOVERY_MSCNT)) {
+        m->ref_valid = false;
+        return;
+    }
+    // Sample requested after the axis settled, and not checked yet
+    if (!m->still || (int32_t)(sample_time - m->still_since) < DRIVER_MONITOR_SETTLE_US ||
+        sample_time == m->last_mscnt_time) {
+        return;
+    }
+    m->last_mscnt_time = sample_time;
+
+    uint mres = tmc_get_mres(axis);
+    if (!m->ref_valid || m->ref_mres != mres) {
+        m->ref_valid = true;
+        m->ref_pos = pos;
+        m->ref_mscnt = mscnt;
+        m->ref_mres = mres;
+        return;
+    }
+
+    // One step moves MSCNT by 1 << MRES; the counters agree modulo 1024
+    uint32_t expected = m->ref_mscnt + (uint32_t)DRIVER_MONITOR_MSCNT_DIR * ((uint32_t)(pos - m->ref_pos) << mres);
+    int32_t diff = (int32_t)((mscnt - expected + 512u) & 0x3FF) - 512;
+    int32_t steps = DRIVER_MONITOR_MSCNT_DIR * (diff / (1 << mres)); // Driver position - counter
+    if (steps == 0) return;
+
+    event_log(LOG_EVT_STEPS_LOST, axis, (uint16_t)mres, steps, pos);
+    raise_faults(axis, DRIVER_FAULT_STEPS_LOST);
+    if (steps >= -DRIVER_MONITOR_MAX_ADJUST && steps <= DRIVER_MONITOR_MAX_ADJUST) {
+        // The reference stays: the corrected counter matches it again
+        m->adjust = (int8_t)steps;
+        m->adjust_pending = true;
+        m->still = false; // Check again once core 1 has applied it
+        raise_faults(axis, DRIVER_FAULT_POS_CORRECTED);
+    } else {
+        m->ref_valid = false;
+        if ((recovery & STALL_RECOVERY_ACTION_MASK) == STALL_RECOVERY_REHOME) m->pending_control |= CONTROL_HOME;
+    }
+}
+
+// Forward the monitor's commands; retried on the next pass if the ring is full
+static void send_commands(uint axis, volatile uint8_t *registers) {
+    axis_monitor_t *m = &axes[axis];
+    if (m->adjust_pending) {
+        registers[REG_MOTOR_POS_ADJUST(axis)] = (uint8_t)m->adjust;
+        if (core_link_forward_write(REG_MOTOR_POS_ADJUST(axis), 1, registers)) m->adjust_pending = false;
+    }
+    if (m->pending_control) {
+        registers[REG_MOTOR_CONTROL(axis)] = m->pending_control;
+        if (core_link_forward_write(REG_MOTOR_CONTROL(axis), 1, registers)) m->pending_control = 0;
+    }
+}
+
+// --- Initialization ---
+void init_driver_monitor(volatile uint8_t *registers) {
+    memset(axes, 0, sizeof(axes));
+    last_scan_count = tmc_get_scan_count();
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        registers[REG_MOTOR_DRIVER_FAULTS(i)] = 0;
+        WRITE_U16_REGISTER(registers, REG_MOTOR_MSCNT_L(i), 0);
+        registers[REG_MOTOR_STALL_RECOVERY(i)] = 0;
+        registers[REG_MOTOR_POS_ADJUST(i)] = 0;
+    }
+}
+
+// --- Main Loop ---
+void update_driver_monitor(volatile uint8_t *registers) {
+    uint32_t now = time_us_32();
+    uint32_t scans = tmc_get_scan_count();
+    bool new_scan = scans != last_scan_count;
+    last_scan_count = scans;
+
+    uint8_t driver_errors = 0;
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        axis_monitor_t *m = &axes[i];
+        uint8_t status = registers[REG_MOTOR_STATUS(i)];
+        bool homing = (status & 0x02) != 0;
+        bool moving = (status & 0x01) && !homing;
+        int32_t pos = (int32_t)READ_U32_REGISTER(registers, REG_MOTOR_CURRENT_POS_L(i));
+
+        // A new move clears the latched faults (like the endstop error bits)
+        if (moving && !m->was_moving) {
+            m->faults = 0;
+            m->stall_samples = 0;
+            m->recovered = false;
+        }
+        m->was_moving = moving;
+        if (homing) m->ref_valid = false; // Homing redefines the position
+
+        if (status != 0 || pos != m->last_pos) {
+            m->still = false;
+        } else if (!m->still) {
+            m->still = true;
+            m->still_since = now;
+        }
+        m->last_pos = pos;
+
+        if (new_scan) {
+            check_drv_status(i, registers, moving);
+            check_mscnt(i, registers, pos);
+        }
+        send_commands(i, registers);
+
+        reg_publish_u8(registers, REG_MOTOR_DRIVER_FAULTS(i), m->faults);
+        if (m->faults & DRIVER_FAULT_ERRORS) driver_errors |= ERROR_FLAGS_DRIVER_FAULT(i);
+    }
+    reg_publish_u8(registers, REG_ERROR_FLAGS, (registers[REG_ERROR_FLAGS] & ERROR_FLAGS_ENDSTOP_MASK) | driver_errors);
+}
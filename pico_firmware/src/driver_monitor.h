@@ -0,0 +1,66 @@
+#ifndef DRIVER_MONITOR_H
+#define DRIVER_MONITOR_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Driver Monitor (core 0) ---
+// Watches the TMC2130s through the background DRV_STATUS/MSCNT scan
+// (tmc2130.h), once per completed scan:
+//  - Faults: DRV_STATUS flags go to REG_MOTOR_DRIVER_FAULTS(axis), latched
+//    until the axis' next move. Stall, overtemp shutdown, short to GND and
+//    lost steps also raise bit 4+axis of REG_ERROR_FLAGS. Open load is only
+//    taken while the axis moves (the driver reports it at standstill too).
+//  - Stall: with REG_MOTOR_STALL_RECOVERY bits 0-1 set, tmc2130.c programs
+//    SGT (REG_MOTOR_STALL_THRESHOLD) and a TCOOLTHRS, and a stall is
+//    DRV_STATUS.stallGuard on DRIVER_MONITOR_STALL_SAMPLES scans in a row
+//    while the axis moves at COOLSTEP_MIN_SPEED or faster in SpreadCycle or
+//    CoolStep (StallGuard2 reads nothing useful elsewhere). The axis is then
+//    stopped (2), or stopped and re-homed with its REG_MOTOR_HOMING_* settings
+//    (3). A stalled rotor slips by whole electrical cycles (4 full steps),
+//    which the driver can't count, so only homing gets the position back.
+//    Overtemp shutdown and short to GND stop the axis for actions 2 and 3.
+//  - Lost steps: with bit 2, MSCNT read at standstill is compared with the
+//    MSCNT the position counter predicts (reference taken at an earlier
+//    standstill). A difference means the driver took other STEP pulses than
+//    the PIO counted (noise, pulses too short); the rotor follows the driver,
+//    so the counter is moved to match through REG_MOTOR_POS_ADJUST(axis).
+//    MSCNT wraps every 4 full steps: a difference is seen modulo that, and one
+//    over 127 steps is flagged but not corrected (re-homed with action 3).
+// Core 1 owns the motion, so the recovery commands are register writes
+// forwarded to it like the master's (core_link_forward_write()).
+
+// REG_MOTOR_STALL_RECOVERY
+#define STALL_RECOVERY_ACTION_MASK  0x03
+#define STALL_RECOVERY_FLAG         1   // Flag only
+#define STALL_RECOVERY_STOP         2   // Flag and stop
+#define STALL_RECOVERY_REHOME       3   // Flag, stop and re-home
+#define STALL_RECOVERY_MSCNT        (1u << 2) // Check MSCNT at standstill, correct lost steps
+
+// REG_MOTOR_DRIVER_FAULTS bits
+#define DRIVER_FAULT_STALL          (1u << 0)
+#define DRIVER_FAULT_OTPW           (1u << 1)
+#define DRIVER_FAULT_OT             (1u << 2)
+#define DRIVER_FAULT_SHORT          (1u << 3)
+#define DRIVER_FAULT_OPEN_LOAD      (1u << 4)
+#define DRIVER_FAULT_STEPS_LOST     (1u << 5)
+#define DRIVER_FAULT_POS_CORRECTED  (1u << 6)
+// Faults that raise the axis' REG_ERROR_FLAGS bit
+#define DRIVER_FAULT_ERRORS (DRIVER_FAULT_STALL | DRIVER_FAULT_OT | DRIVER_FAULT_SHORT | DRIVER_FAULT_STEPS_LOST)
+
+#define DRIVER_MONITOR_STALL_SAMPLES    2       // Consecutive stallGuard scans for a stall
+#define DRIVER_MONITOR_SETTLE_US        2000    // Standstill before an MSCNT sample counts
+#define DRIVER_MONITOR_MAX_ADJUST       127     // Largest correction (REG_MOTOR_POS_ADJUST is an i8)
+#define DRIVER_MONITOR_MSCNT_DIR        1       // MSCNT counts up on forward steps (-1 with GCONF.shaft)
+
+// --- Function Prototypes ---
+
+// Reset the monitor state and its registers
+void init_driver_monitor(volatile uint8_t *registers);
+
+// Evaluate new scan results, publish REG_MOTOR_DRIVER_FAULTS/MSCNT and the
+// driver bits of REG_ERROR_FLAGS, and forward recovery commands. Call from the
+// core 0 main loop after core_link_pull_status() and update_tmc_status_scan().
+void update_driver_monitor(volatile uint8_t *registers);
+
+#endif // DRIVER_MONITOR_H
@@ -0,0 +1,196 @@
+#include "event_log.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h" // __dmb, save_and_disable_interrupts
+#include <stdio.h> // For the text drain
+#include <string.h> // For memset
+
+// --- Internal State ---
+typedef struct {
+    uint32_t time_us;
+    uint8_t event;
+    uint8_t axis;
+    uint16_t arg16;
+    int32_t arg0;
+    int32_t arg1;
+} log_record_t;
+
+_Static_assert(sizeof(log_record_t) == EVENT_LOG_RECORD_LEN, "Record must match REG_DIAG_LOG_RECORD");
+
+#define RING_MASK (EVENT_LOG_RING_SIZE - 1)
+
+typedef struct {
+    log_record_t records[EVENT_LOG_RING_SIZE];
+    volatile uint32_t head;     // Written by the owning core only
+    volatile uint32_t tail;     // Written by core 0 (drain) only
+    volatile uint32_t dropped;  // Written by the owning core only
+} log_ring_t;
+
+static log_ring_t rings[2];                 // One per core
+static uint32_t dropped_base = 0;           // Drop count at the last clear (core 0)
+static bool window_valid = false;           // REG_DIAG_LOG_RECORD holds an unread record
+static uint32_t last_print_time = 0;
+
+// Text for the stdio drain; arguments are passed as (ARG0, ARG1, ARG16)
+static const char *const event_formats[LOG_NUM_EVENTS] = {
+    [LOG_EVT_MOVE_START]            = "Start Cmd: Target=%ld, Accel=%ld, Speed=%u",
+    [LOG_EVT_MOVE_STOP]             = "Stop Cmd",
+    [LOG_EVT_TARGET_REACHED]        = "Target Reached",
+    [LOG_EVT_HARD_STOP]             = "Endstop Hard Stop at %ld",
+    [LOG_EVT_QUEUE_FULL]            = "Queue Full",
+    [LOG_EVT_QUEUE_FLUSH]           = "Queue Flush",
+    [LOG_EVT_COORD_START]           = "Coord Start Cmd: X=%ld, Y=%ld, Feed=%u",
+    [LOG_EVT_COORD_STOP]            = "Coord Stop Cmd",
+    [LOG_EVT_COORD_DONE]            = "Coordinated Move Complete",
+    [LOG_EVT_COORD_IGNORED]         = "Coord Start Cmd ignored: single axis",
+    [LOG_EVT_HOMING_START]          = "Homing Start: Speed=%ld, Config=0x%02lX",
+    [LOG_EVT_HOMING_DONE]           = "Homing Done",
+    [LOG_EVT_HOMING_FAILED]         = "Homing Failed",
+    [LOG_EVT_HOMING_ABORTED]        = "Homing Aborted",
+    [LOG_EVT_HOMING_NO_TRIGGER]     = "Homing: No Trigger Within %ld Steps",
+    [LOG_EVT_HOMING_STILL_PRESSED]  = "Homing: Switch Still Pressed After Back-off",
+    [LOG_EVT_UART_CHECKSUM]         = "UART RX Error: Checksum mismatch (Cmd %02lX)",
+    [LOG_EVT_UART_UNKNOWN_CMD]      = "UART RX Error: Unknown command type %02lX",
+    [LOG_EVT_UART_BAD_RANGE]        = "UART RX Error: Invalid address/length (Addr: %02lX, Len: %ld)",
+    [LOG_EVT_UART_NEEDS_ADDR16]     = "UART RX Error: Address %02lX needs the 16-bit form",
+    [LOG_EVT_UART_DATA_TOO_LONG]    = "UART RX Error: Data length too large (%ld)",
+    [LOG_EVT_UART_BAD_MULTI_READ]   = "UART RX Error: Invalid multi-read (%ld, %ld)",
+    [LOG_EVT_UART_BAD_BAUD_CODE]    = "UART RX Error: Invalid baud code %ld",
+    [LOG_EVT_UART_BAD_FRAME]        = "UART RX Error: Invalid framed command %02lX (Len: %ld)",
+    [LOG_EVT_UART_BAD_FRAME_LEN]    = "UART RX Error: Invalid frame length %ld",
+    [LOG_EVT_UART_CRC]              = "UART RX Error: Frame CRC mismatch",
+    [LOG_EVT_UART_FRAME_TIMEOUT]    = "UART RX Error: Frame timeout, dropping partial frame",
+    [LOG_EVT_UART_BAUD_SWITCHED]    = "UART: Baud switched to %ld (actual %ld), awaiting confirmation",
+    [LOG_EVT_UART_BAUD_FALLBACK]    = "UART: Baud %ld not confirmed, falling back to the default",
+    [LOG_EVT_UART_LATCH_TIMEOUT]    = "UART: Read latch timed out, releasing",
+    [LOG_EVT_TMC_CONFIG_APPLIED]    = "TMC Config 0x%04lX, Mode 0x%02lX applied (%u registers written)",
+    [LOG_EVT_UART_BAD_STAGE]        = "UART RX Error: Invalid staged write (Runs: %02lX, Len: %ld)",
+    [LOG_EVT_UART_STAGE_MISMATCH]   = "UART RX Error: Stage commit does not match (%ld runs, CRC %04lX staged)",
+    [LOG_EVT_UART_STAGE_COMMITTED]  = "UART: Staged write committed (%ld bytes in %ld runs, %u writes)",
+    [LOG_EVT_DRIVER_FAULT]          = "Driver Fault: DRV_STATUS 0x%08lX, new faults 0x%02lX",
+    [LOG_EVT_STALL_DETECTED]        = "Stall Detected at %ld (SG_RESULT %ld), recovery action %u",
+    [LOG_EVT_STEPS_LOST]            = "Steps Lost: driver %+ld steps from counter at %ld (MRES %u)",
+    [LOG_EVT_POSITION_ADJUSTED]     = "Position Adjusted by %ld to %ld",
+    [LOG_EVT_POSITION_ADJUST_REFUSED] = "Position Adjust by %ld Refused: Axis Busy",
+    [LOG_EVT_ENDSTOP_REFUSED]       = "Move Into Pressed Endstop Refused at %ld",
+};
+
+// --- Producer ---
+void event_log(log_event_t event, uint8_t axis, uint16_t arg16, int32_t arg0, int32_t arg1) {
+    log_ring_t *ring = &rings[get_core_num()];
+    uint32_t saved_irq = save_and_disable_interrupts(); // An IRQ on this core may log as well
+    uint32_t head = ring->head;
+    if (head - ring->tail >= EVENT_LOG_RING_SIZE) {
+        ring->dropped++;
+    } else {
+        log_record_t *rec = &ring->records[head & RING_MASK];
+        rec->time_us = time_us_32();
+        rec->event = (uint8_t)event;
+        rec->axis = axis;
+        rec->arg16 = arg16;
+        rec->arg0 = arg0;
+        rec->arg1 = arg1;
+        __dmb(); // Record complete before core 0 can see it
+        ring->head = head + 1;
+    }
+    restore_interrupts(saved_irq);
+}
+
+// --- Consumer (core 0) ---
+// Oldest record over both rings, or NULL if both are empty
+static log_ring_t *oldest_ring(void) {
+    log_ring_t *oldest = NULL;
+    uint32_t oldest_time = 0;
+    for (uint i = 0; i < 2; i++) {
+        log_ring_t *ring = &rings[i];
+        if (ring->head == ring->tail) continue;
+        __dmb(); // Read the record only after seeing the new head
+        uint32_t t = ring->records[ring->tail & RING_MASK].time_us;
+        if (!oldest || (int32_t)(t - oldest_time) < 0) {
+            oldest = ring;
+            oldest_time = t;
+        }
+    }
+    return oldest;
+}
+
+static bool pop_record(log_record_t *out) {
+    log_ring_t *ring = oldest_ring();
+    if (!ring) return false;
+    *out = ring->records[ring->tail & RING_MASK];
+    __dmb(); // Done with the record before the producer may reuse it
+    ring->tail++;
+    return true;
+}
+
+static uint32_t queued_records(void) {
+    return (rings[0].head - rings[0].tail) + (rings[1].head - rings[1].tail);
+}
+
+static void print_record(const log_record_t *rec) {
+    const char *format = rec->event < LOG_NUM_EVENTS ? event_formats[rec->event] : NULL;
+    printf("[%lu.%06lu] ", (unsigned long)(rec->time_us / 1000000), (unsigned long)(rec->time_us % 1000000));
+    if (rec->axis != LOG_NO_AXIS) printf(rec->event == LOG_EVT_TMC_CONFIG_APPLIED ? "TMC Driver %d: " : "M%d ", rec->axis + 1);
+    if (format) {
+        printf(format, (long)rec->arg0, (long)rec->arg1, (unsigned)rec->arg16);
+    } else {
+        printf("Event %d (%ld, %ld, %u)", rec->event, (long)rec->arg0, (long)rec->arg1, (unsigned)rec->arg16);
+    }
+    printf("\n");
+}
+
+static void publish_record(volatile uint8_t *registers, const log_record_t *rec) {
+    const uint8_t *bytes = (const uint8_t *)rec; // Little endian, matches the window layout
+    for (uint i = 0; i < EVENT_LOG_RECORD_LEN; i++) {
+        registers[REG_DIAG_LOG_RECORD + i] = bytes[i];
+    }
+}
+
+static void clear_log(volatile uint8_t *registers) {
+    for (uint i = 0; i < 2; i++) rings[i].tail = rings[i].head;
+    dropped_base = rings[0].dropped + rings[1].dropped;
+    window_valid = false;
+    for (uint i = 0; i < EVENT_LOG_RECORD_LEN; i++) registers[REG_DIAG_LOG_RECORD + i] = 0;
+}
+
+// --- Initialization ---
+void init_event_log(volatile uint8_t *registers) {
+    memset(rings, 0, sizeof(rings));
+    dropped_base = 0;
+    registers[REG_DIAG_LOG_CONTROL] = 0;
+    clear_log(registers);
+    last_print_time = time_us_32();
+}
+
+// --- Drain and Update Registers ---
+void update_event_log(volatile uint8_t *registers) {
+    uint8_t control = registers[REG_DIAG_LOG_CONTROL];
+
+    if (control & LOG_CTRL_CLEAR) {
+        clear_log(registers);
+    } else if (control & LOG_CTRL_NEXT) {
+        window_valid = false;
+    }
+    if (control & (LOG_CTRL_CLEAR | LOG_CTRL_NEXT)) {
+        registers[REG_DIAG_LOG_CONTROL] = control & ~(LOG_CTRL_CLEAR | LOG_CTRL_NEXT);
+    }
+
+    log_record_t rec;
+    if (control & LOG_CTRL_HOST_READOUT) {
+        if (!window_valid && pop_record(&rec)) {
+            publish_record(registers, &rec);
+            window_valid = true;
+        }
+    } else {
+        // The text drain may block on a slow host, but only core 0 and at a bounded rate
+        uint32_t now = time_us_32();
+        if (now - last_print_time >= EVENT_LOG_PRINT_INTERVAL_US && pop_record(&rec)) {
+            last_print_time = now;
+            print_record(&rec);
+        }
+        window_valid = false;
+    }
+
+    uint32_t pending = queued_records() + (window_valid ? 1 : 0);
+    registers[REG_DIAG_LOG_PENDING] = pending > 0xFF ? 0xFF : (uint8_t)pending;
+    WRITE_U16_REGISTER(registers, REG_DIAG_LOG_DROPPED_L, (uint16_t)(rings[0].dropped + rings[1].dropped - dropped_base));
+}
@@ -0,0 +1,94 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Deferred Event Log ---
+// Replaces printf on the command/protocol paths: logging an event copies a
+// fixed-size record (event ID, axis, three arguments, time_us_32()) into a
+// RAM ring and returns, so neither core ever waits for the USB host.
+// Each core has its own ring (single producer, interrupts masked for the
+// copy so IRQ handlers may log too). A full ring drops the new record and
+// counts it in REG_DIAG_LOG_DROPPED.
+// Core 0 drains both rings oldest-first from its main loop, either:
+//  - as text over stdio, at most one line per EVENT_LOG_PRINT_INTERVAL_US, or
+//  - through the register window (REG_DIAG_LOG_CONTROL bit 1 set): the oldest
+//    record sits in REG_DIAG_LOG_RECORD until the host writes bit 0 (Next).
+// Window layout (16 bytes, little endian):
+//   [TIME_US u32] [EVENT u8] [AXIS u8, 0xFF = none] [ARG16 u16] [ARG0 i32] [ARG1 i32]
+
+#define EVENT_LOG_RING_SIZE         64      // Records per core (power of 2)
+#define EVENT_LOG_RECORD_LEN        16      // Bytes in REG_DIAG_LOG_RECORD
+#define EVENT_LOG_PRINT_INTERVAL_US 2000    // Text drain rate limit
+#define LOG_NO_AXIS                 0xFF
+
+// REG_DIAG_LOG_CONTROL bits
+#define LOG_CTRL_NEXT               0x01    // Done with the window record (self-clearing)
+#define LOG_CTRL_HOST_READOUT       0x02    // Serve records through the window instead of stdio
+#define LOG_CTRL_CLEAR              0x04    // Discard all records and the drop count (self-clearing)
+
+// Event IDs (REG_DIAG_LOG_RECORD EVENT byte). Append only: hosts decode by number.
+typedef enum {
+    LOG_EVT_NONE = 0,
+    // Motion (core 1)
+    LOG_EVT_MOVE_START,             // ARG0 target, ARG1 accel, ARG16 max speed
+    LOG_EVT_MOVE_STOP,
+    LOG_EVT_TARGET_REACHED,
+    LOG_EVT_HARD_STOP,              // ARG0 position
+    LOG_EVT_QUEUE_FULL,
+    LOG_EVT_QUEUE_FLUSH,
+    LOG_EVT_COORD_START,            // ARG0 X target, ARG1 Y target, ARG16 feed rate
+    LOG_EVT_COORD_STOP,
+    LOG_EVT_COORD_DONE,
+    LOG_EVT_COORD_IGNORED,          // Single-axis build
+    // Homing (core 1)
+    LOG_EVT_HOMING_START,           // ARG0 seek speed, ARG1 REG_MOTOR_HOMING_CONFIG
+    LOG_EVT_HOMING_DONE,
+    LOG_EVT_HOMING_FAILED,
+    LOG_EVT_HOMING_ABORTED,
+    LOG_EVT_HOMING_NO_TRIGGER,      // ARG0 travel limit (steps)
+    LOG_EVT_HOMING_STILL_PRESSED,
+    // Protocol (core 0)
+    LOG_EVT_UART_CHECKSUM,          // ARG0 command
+    LOG_EVT_UART_UNKNOWN_CMD,       // ARG0 command byte
+    LOG_EVT_UART_BAD_RANGE,         // ARG0 address, ARG1 length
+    LOG_EVT_UART_NEEDS_ADDR16,      // ARG0 address
+    LOG_EVT_UART_DATA_TOO_LONG,     // ARG0 length
+    LOG_EVT_UART_BAD_MULTI_READ,    // ARG0 range count (or index), ARG1 total length (or range length)
+    LOG_EVT_UART_BAD_BAUD_CODE,     // ARG0 code
+    LOG_EVT_UART_BAD_FRAME,         // ARG0 first body byte, ARG1 body length
+    LOG_EVT_UART_BAD_FRAME_LEN,     // ARG0 LEN byte
+    LOG_EVT_UART_CRC,
+    LOG_EVT_UART_FRAME_TIMEOUT,
+    LOG_EVT_UART_BAUD_SWITCHED,     // ARG0 requested rate, ARG1 actual rate
+    LOG_EVT_UART_BAUD_FALLBACK,     // ARG0 unconfirmed rate
+    LOG_EVT_UART_LATCH_TIMEOUT,
+    // Drivers (core 0)
+    LOG_EVT_TMC_CONFIG_APPLIED,     // ARG0 config, ARG1 mode control, ARG16 registers written
+    // Staged bulk writes (core 0)
+    LOG_EVT_UART_BAD_STAGE,         // ARG0 RUNS byte, ARG1 payload length
+    LOG_EVT_UART_STAGE_MISMATCH,    // ARG0 runs staged, ARG1 CRC of the staged payloads
+    LOG_EVT_UART_STAGE_COMMITTED,   // ARG0 bytes, ARG1 runs, ARG16 forwarded writes
+    // Driver monitor (core 0) and position corrections (core 1)
+    LOG_EVT_DRIVER_FAULT,           // ARG0 DRV_STATUS, ARG1 new REG_MOTOR_DRIVER_FAULTS bits
+    LOG_EVT_STALL_DETECTED,         // ARG0 position, ARG1 SG_RESULT, ARG16 REG_MOTOR_STALL_RECOVERY action
+    LOG_EVT_STEPS_LOST,             // ARG0 steps (driver - counter), ARG1 position, ARG16 MRES
+    LOG_EVT_POSITION_ADJUSTED,      // ARG0 steps, ARG1 new position
+    LOG_EVT_POSITION_ADJUST_REFUSED, // ARG0 steps (axis not idle)
+    LOG_EVT_ENDSTOP_REFUSED,        // ARG0 position (move into a pressed endstop)
+    LOG_NUM_EVENTS
+} log_event_t;
+
+// --- Function Prototypes ---
+
+// Reset both rings and the register window (core 0, before core 1 starts)
+void init_event_log(volatile uint8_t *registers);
+
+// Record an event from either core (or an IRQ). Never blocks.
+void event_log(log_event_t event, uint8_t axis, uint16_t arg16, int32_t arg0, int32_t arg1);
+
+// Handle REG_DIAG_LOG_CONTROL and drain records to stdio or the window (core 0 main loop)
+void update_event_log(volatile uint8_t *registers);
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,228 @@
+#include "homing.h"
+#include "motor_control.h" // NUM_MOTORS, pins
+#include "step_engine.h"
+#include "planner.h"
+#include "switches.h"
+#include "event_log.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include <string.h> // For memset
+
+// --- Internal State ---
+typedef struct {
+    volatile homing_phase_t phase;
+    bool use_stall;             // DIAG1 (StallGuard) instead of the endstop
+    bool positive;              // Seek direction
+    uint16_t speed;
+    uint16_t backoff;
+    uint16_t accel;
+    ramp_t ramp;                // Ramp of the current homing leg
+    volatile bool armed;        // Trigger edge stops the axis
+    volatile bool triggered;    // Set by the GPIO ISR
+} homing_state_t;
+
+static homing_state_t homing[NUM_MOTORS];
+static uint switch_pins[NUM_MOTORS];
+static uint diag_pins[NUM_MOTORS];
+
+static const uint enable_pins[MOTOR_MAX_AXES] = MOTOR_ENABLE_PINS;
+
+// --- Step Interval Source (called from the step engine IRQ) ---
+static uint32_t __not_in_flash_func(homing_source)(uint axis) {
+    return planner_next_interval(&homing[axis].ramp);
+}
+
+// --- Trigger Interrupts ---
+// Both share the default IRQ priority with the step engine, so they never
+// preempt a PIO FIFO refill halfway and the interval source sees a
+// consistent ramp.
+static void __not_in_flash_func(trigger)(uint motor) {
+    homing_state_t *h = &homing[motor];
+    if (!h->armed) return;
+    step_engine_stop(motor); // Already stopped if the endstop hard stop applied
+    h->ramp.phase = RAMP_IDLE;
+    h->armed = false;
+    h->triggered = true;
+}
+
+// Endstop press (switches.c hook)
+static void __not_in_flash_func(homing_endstop_hook)(uint motor) {
+    if (motor < NUM_MOTORS && !homing[motor].use_stall) trigger(motor);
+}
+
+// DIAG1 falling edge (StallGuard)
+static void __not_in_flash_func(homing_diag_irq_handler)(void) {
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        if (!(gpio_get_irq_event_mask(diag_pins[i]) & GPIO_IRQ_EDGE_FALL)) continue;
+        gpio_acknowledge_irq(diag_pins[i], GPIO_IRQ_EDGE_FALL);
+        if (homing[i].use_stall) trigger(i);
+    }
+}
+
+static void arm_trigger(uint motor) {
+    homing_state_t *h = &homing[motor];
+    uint pin = h->use_stall ? diag_pins[motor] : switch_pins[motor];
+    h->triggered = false;
+    h->armed = true;
+    if (h->use_stall) gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL, true); // Clears stale edges first
+
+    // The trigger may already be asserted (no edge will follow)
+    if (!gpio_get(pin)) {
+        uint32_t saved_irq = save_and_disable_interrupts();
+        trigger(motor);
+        restore_interrupts(saved_irq);
+    }
+}
+
+static void disarm_trigger(uint motor) {
+    homing_state_t *h = &homing[motor];
+    h->armed = false;
+    gpio_set_irq_enabled(diag_pins[motor], GPIO_IRQ_EDGE_FALL, false); // Endstop IRQs stay on (switches.c)
+}
+
+static void start_leg(uint motor, homing_phase_t phase, bool positive, uint32_t steps, uint32_t speed) {
+    homing_state_t *h = &homing[motor];
+    h->phase = phase;
+    if (speed == 0) speed = 1;
+    planner_plan_move(&h->ramp, steps, speed, h->accel, 0);
+    step_engine_start(motor, positive, homing_source);
+}
+
+static void begin_homing(uint motor) {
+    homing_state_t *h = &homing[motor];
+    gpio_put(enable_pins[motor], 0); // Enable driver (active LOW)
+    if (!h->use_stall && !gpio_get(switch_pins[motor])) {
+        // Already on the switch: back off, then approach slowly
+        start_leg(motor, HOMING_BACKOFF, !h->positive, h->backoff, h->speed);
+        return;
+    }
+    start_leg(motor, HOMING_SEEK, h->positive, HOMING_MAX_TRAVEL, h->speed);
+    if (!h->use_stall) arm_trigger(motor); // StallGuard waits for cruise speed
+}
+
+static void finish_homing(uint motor, homing_phase_t result) {
+    homing_state_t *h = &homing[motor];
+    disarm_trigger(motor);
+    h->phase = result;
+    event_log(result == HOMING_DONE ? LOG_EVT_HOMING_DONE : LOG_EVT_HOMING_FAILED, motor, 0, 0, 0);
+}
+
+// --- Initialization ---
+void init_homing(const uint *sw_pins, const uint *diag1_pins) {
+    memset(homing, 0, sizeof(homing));
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        switch_pins[i] = sw_pins[i];
+        diag_pins[i] = diag1_pins[i];
+
+        gpio_init(diag_pins[i]);
+        gpio_set_dir(diag_pins[i], GPIO_IN);
+        gpio_pull_up(diag_pins[i]); // DIAG1 is open drain
+        gpio_add_raw_irq_handler(diag_pins[i], homing_diag_irq_handler); // Edge enabled per seek
+    }
+    switches_set_endstop_hook(homing_endstop_hook);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+// --- Control ---
+void homing_start(uint motor, volatile uint8_t *registers) {
+    homing_state_t *h = &homing[motor];
+    homing_abort(motor); // Restart: ramps a running homing leg down first
+
+    uint8_t config = registers[REG_MOTOR_HOMING_CONFIG(motor)];
+    h->positive = (config & HOMING_CFG_POSITIVE) != 0;
+    h->use_stall = (config & HOMING_CFG_STALLGUARD) != 0;
+    h->speed = READ_U16_REGISTER(registers, REG_MOTOR_HOMING_SPEED_L(motor));
+    h->backoff = READ_U16_REGISTER(registers, REG_MOTOR_HOMING_BACKOFF_L(motor));
+    h->accel = READ_U16_REGISTER(registers, REG_MOTOR_ACCEL_L(motor));
+    if (h->speed == 0) h->speed = HOMING_DEFAULT_SPEED;
+    if (h->backoff == 0) h->backoff = HOMING_DEFAULT_BACKOFF;
+
+    event_log(LOG_EVT_HOMING_START, motor, 0, h->speed, config);
+    if (step_engine_is_busy(motor)) {
+        h->phase = HOMING_WAIT;
+    } else {
+        begin_homing(motor);
+    }
+}
+
+void homing_abort(uint motor) {
+    homing_state_t *h = &homing[motor];
+    if (!homing_is_active(motor)) return;
+    disarm_trigger(motor);
+    if (h->phase != HOMING_WAIT) {
+        uint32_t saved_irq = save_and_disable_interrupts();
+        planner_request_stop(&h->ramp);
+        restore_interrupts(saved_irq);
+    }
+    h->phase = HOMING_IDLE;
+    event_log(LOG_EVT_HOMING_ABORTED, motor, 0, 0, 0);
+}
+
+bool homing_is_active(uint motor) {
+    homing_phase_t phase = homing[motor].phase;
+    return phase != HOMING_IDLE && phase != HOMING_DONE && phase != HOMING_FAILED;
+}
+
+uint32_t homing_get_speed(uint motor) {
+    return planner_get_speed(&homing[motor].ramp);
+}
+
+// --- Update ---
+static void service_homing(uint motor) {
+    homing_state_t *h = &homing[motor];
+    bool busy = step_engine_is_busy(motor);
+
+    switch (h->phase) {
+    case HOMING_WAIT:
+        if (!busy) begin_homing(motor);
+        break;
+
+    case HOMING_SEEK:
+        if (h->use_stall && !h->armed && !h->triggered && h->ramp.phase == RAMP_CRUISE) {
+            arm_trigger(motor);
+        }
+        if (h->triggered) {
+            if (h->use_stall) step_engine_set_position(motor, 0);
+            start_leg(motor, HOMING_BACKOFF, !h->positive, h->backoff, h->speed);
+        } else if (!busy) {
+            event_log(LOG_EVT_HOMING_NO_TRIGGER, motor, 0, HOMING_MAX_TRAVEL, 0);
+            finish_homing(motor, HOMING_FAILED);
+        }
+        break;
+
+    case HOMING_BACKOFF:
+        if (busy) break;
+        if (h->use_stall) {
+            finish_homing(motor, HOMING_DONE);
+        } else if (!gpio_get(switch_pins[motor])) {
+            event_log(LOG_EVT_HOMING_STILL_PRESSED, motor, 0, 0, 0);
+            finish_homing(motor, HOMING_FAILED);
+        } else {
+            // Twice the back-off distance covers the switch hysteresis
+            start_leg(motor, HOMING_LATCH, h->positive, 2u * h->backoff, h->speed / HOMING_LATCH_DIVIDER);
+            arm_trigger(motor);
+        }
+        break;
+
+    case HOMING_LATCH:
+        if (h->triggered) {
+            step_engine_set_position(motor, 0);
+            finish_homing(motor, HOMING_DONE);
+        } else if (!busy) {
+            finish_homing(motor, HOMING_FAILED);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void update_homing(volatile uint8_t *registers) {
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        service_homing(i);
+        registers[REG_MOTOR_HOMING_STATE(i)] = (uint8_t)homing[i].phase;
+    }
+}
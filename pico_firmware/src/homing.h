@@ -0,0 +1,69 @@
+#ifndef HOMING_H
+#define HOMING_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Homing ---
+// Started with bit 2 of REG_MOTOR_CONTROL. The axis seeks towards its home
+// trigger at REG_MOTOR_HOMING_SPEED until one of these fires:
+//  - the endstop switch (active LOW), or
+//  - with HOMING_CONFIG bit 1, a StallGuard2 stall reported by the TMC2130 on
+//    its DIAG1 pin (open drain, active LOW). Core 0 switches the driver to
+//    SpreadCycle with diag1_stall and REG_MOTOR_STALL_THRESHOLD as SGT while
+//    the seek runs, see update_tmc_config_from_registers().
+// Both triggers are GPIO edge interrupts that halt the step engine from the
+// ISR, so the axis stops within a few microseconds of the edge instead of a
+// main loop pass later. Endstop edges come from switches.c (its endstop hook),
+// DIAG1 edges from a raw GPIO handler here.
+//
+// Switch homing: seek, back off, approach again at 1/HOMING_LATCH_DIVIDER of
+// the speed; the second trigger point is position 0.
+// StallGuard homing: the stall point is position 0, then the axis backs off.
+// StallGuard only reports reliably at a steady speed, so the stall trigger is
+// armed once the seek ramp has reached its cruise speed.
+
+#define HOMING_DEFAULT_SPEED    500     // steps/sec when REG_MOTOR_HOMING_SPEED is 0
+#define HOMING_DEFAULT_BACKOFF  200     // steps when REG_MOTOR_HOMING_BACKOFF is 0
+#define HOMING_MAX_TRAVEL       200000  // Seek fails after this many steps without a trigger
+#define HOMING_LATCH_DIVIDER    4       // Slow approach speed = homing speed / 4
+
+// REG_MOTOR_HOMING_CONFIG bits
+#define HOMING_CFG_POSITIVE     (1u << 0) // Home towards positive positions
+#define HOMING_CFG_STALLGUARD   (1u << 1) // Trigger on DIAG1 instead of the switch
+
+// Values of REG_MOTOR_HOMING_STATE
+typedef enum {
+    HOMING_IDLE = 0,
+    HOMING_SEEK,        // Moving towards the trigger
+    HOMING_BACKOFF,     // Moving away from it
+    HOMING_LATCH,       // Slow second approach (switch homing)
+    HOMING_DONE,        // Position 0 set
+    HOMING_FAILED,      // No trigger within HOMING_MAX_TRAVEL, or switch stuck
+    HOMING_WAIT,        // Waiting for a running move to ramp down
+} homing_phase_t;
+
+// --- Function Prototypes ---
+
+// Configure the DIAG1 inputs and their IRQ handler and subscribe to the
+// endstops. Call on core 1 after init_switches() (GPIO IRQs run on the core
+// that enabled them).
+void init_homing(const uint *switch_pins, const uint *diag_pins);
+
+// Start homing 'motor' with the parameters in the REG_MOTOR_HOMING_* registers.
+// The caller ramps a running move down first; homing begins once it is idle.
+void homing_start(uint motor, volatile uint8_t *registers);
+
+// Abort homing with a controlled stop (state returns to HOMING_IDLE)
+void homing_abort(uint motor);
+
+// True from homing_start() until HOMING_DONE/HOMING_FAILED/abort
+bool homing_is_active(uint motor);
+
+// Current homing speed in steps/sec (0 when not moving)
+uint32_t homing_get_speed(uint motor);
+
+// Advance the homing state machines and write REG_MOTOR_HOMING_STATE
+void update_homing(volatile uint8_t *registers);
+
+#endif // HOMING_H
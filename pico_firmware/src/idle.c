@@ -0,0 +1,52 @@
+#include "idle.h"
+#include "uart_protocol.h"  // uart_protocol_busy()
+#include "motor_control.h"  // NUM_MOTORS, motor_control_is_idle()
+#include "switches.h"       // switches_settling()
+#include "core_link.h"      // core_link_writes_pending()
+#include "diagnostics.h"    // diag_loop_resume()
+#include "hardware/clocks.h"
+#include "hardware/structs/scb.h"
+
+// Peripherals the firmware doesn't use (ADC, I2C, PWM, RTC, PIO1, SPI1, UART1,
+// the test bus manager). USB stays clocked: it carries stdio or the protocol.
+#define IDLE_SLEEP_GATED_EN0 (CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS | CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS | \
+                              CLOCKS_SLEEP_EN0_CLK_SYS_I2C0_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_I2C1_BITS | \
+                              CLOCKS_SLEEP_EN0_CLK_SYS_PWM_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS | \
+                              CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS | CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS)
+#define IDLE_SLEEP_GATED_EN1 (CLOCKS_SLEEP_EN1_CLK_SYS_SPI1_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_SPI1_BITS | \
+                              CLOCKS_SLEEP_EN1_CLK_SYS_UART1_BITS | CLOCKS_SLEEP_EN1_CLK_PERI_UART1_BITS | \
+                              CLOCKS_SLEEP_EN1_CLK_SYS_TBMAN_BITS)
+
+// WFE until an interrupt, a __sev() from the other core or the timeout. An
+// event that arrived since the caller's checks is still latched, so the WFE
+// falls straight through instead of sleeping on it.
+static void sleep_until_event(uint core) {
+    best_effort_wfe_or_timeout(make_timeout_time_us(IDLE_MAX_SLEEP_US));
+    diag_loop_resume(core); // The sleep is not pass time
+}
+
+// --- Initialization ---
+void init_idle_core(uint core) {
+    if (core == 0) {
+        clocks_hw->sleep_en0 = ~IDLE_SLEEP_GATED_EN0;
+        clocks_hw->sleep_en1 = ~IDLE_SLEEP_GATED_EN1;
+    }
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS; // Per core
+}
+
+// --- Main Loops ---
+bool idle_core0(const volatile uint8_t *registers) {
+    if (registers[REG_STATUS] & (1 << 5)) return false; // Coordinated move
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        if (registers[REG_MOTOR_STATUS(i)]) return false; // Moving or homing
+    }
+    if (uart_protocol_busy()) return false;
+    sleep_until_event(0);
+    return true;
+}
+
+bool idle_core1(void) {
+    if (!motor_control_is_idle() || switches_settling() || core_link_writes_pending()) return false;
+    sleep_until_event(1);
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Low-Power Idle ---
+// A superloop pass with nothing to poll ends in a WFE sleep instead of going
+// straight into the next pass. Anything that makes work for a core wakes it:
+//  - core 0: the UART RX IRQ (the byte is in the ring before the core runs
+//    again, nothing is lost however long the wake-up takes), the TX/SPI DMA
+//    IRQs, USB, and a __sev() from core 1 after each status snapshot,
+//  - core 1: the step engine (PIO) and endstop/DIAG1 GPIO IRQs, and a
+//    __sev() from core 0 for every write forwarded through core_link.c.
+// Time-driven work (TMC status scan, telemetry period, frame timeouts, switch
+// debouncing) is covered by a timer alarm that ends every sleep after at most
+// IDLE_MAX_SLEEP_US.
+// Core 0 only sleeps while no axis moves: core 1 then publishes status at its
+// own pass rate, and pulling it promptly is what the telemetry is for.
+// Both cores run with SLEEPDEEP, so while both sleep the system clock is
+// gated from every peripheral not in use (IDLE_SLEEP_GATED_*). clk_sys itself
+// keeps its frequency: the PIO step timing, the UART baud rate and the SPI
+// clock are all derived from it.
+
+#define IDLE_MAX_SLEEP_US   1000 // TMC_STATUS_SCAN_PERIOD_US, the shortest periodic task
+
+// --- Function Prototypes ---
+
+// Enable deep sleep on the calling core; core 0 also sets the clocks gated
+// while both cores sleep. Call once on each core before its loop.
+void init_idle_core(uint core);
+
+// End a core 0 pass: sleep if no axis is moving and the protocol has nothing
+// to poll. Returns true if the core slept.
+bool idle_core0(const volatile uint8_t *registers);
+
+// End a core 1 pass: sleep if motion, homing and debouncing are idle and no
+// forwarded write is waiting. Returns true if the core slept.
+bool idle_core1(void);
+
+#endif // IDLE_H
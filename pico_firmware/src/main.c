@@ -3,42 +3,103 @@
 #include "hardware/uart.h"
 #include "hardware/spi.h"
 #include "hardware/gpio.h"
+#include "pico/multicore.h"
 #include "registers.h"      // Define register addresses and the register array
 #include "uart_protocol.h"  // Handle UART communication and register access logic
 #include "tmc2130.h"        // Handle SPI communication with TMC drivers
 #include "motor_control.h"  // Handle motor movement logic
 #include "switches.h"       // Handle switch reading
+#include "homing.h"         // Endstop / StallGuard homing
+#include "telemetry.h"      // Unsolicited status frames
+#include "driver_monitor.h" // DRV_STATUS faults, stall recovery, MSCNT checks
+#include "core_link.h"      // Register hand-off between the two cores
+#include "diagnostics.h"    // Loop timing and error counters
+#include "event_log.h"      // Deferred debug output from the loops
+#include "idle.h"           // WFE sleep when a loop has nothing to do
 
 // --- Hardware Pins (Example - Adjust as per your wiring) ---
 #define UART_ID uart0
 #define UART_TX_PIN 0
 #define UART_RX_PIN 1
-#define BAUD_RATE 115200
+#define BAUD_RATE UART_DEFAULT_BAUD // Start-up rate; the agent raises it with CMD_SET_BAUD
 
 #define SPI_PORT spi0
 #define SPI_MISO_PIN 16
 #define SPI_CSN1_PIN 17 // Chip select for TMC Driver 1
-#define SPI_CSN2_PIN 2 // Chip select for TMC Driver 2
+#define SPI_CSN2_PIN 2 // Chip select for TMC Driver 2 (unused on the daisy chain)
 #define SPI_SCK_PIN 18
 #define SPI_MOSI_PIN 19
 
 #define SWITCH1_PIN 20
 #define SWITCH2_PIN 21
+#define SWITCH3_PIN 26
+#define SWITCH4_PIN 27
+
+// Per-axis pin tables (entries past NUM_MOTORS are unused)
+static const uint switch_pins[MOTOR_MAX_AXES] = { SWITCH1_PIN, SWITCH2_PIN, SWITCH3_PIN, SWITCH4_PIN };
+static const uint diag1_pins[MOTOR_MAX_AXES] = MOTOR_DIAG1_PINS;
+static const uint tmc_cs_pins[2] = { SPI_CSN1_PIN, SPI_CSN2_PIN }; // The daisy chain uses CS1 only
 
 // --- Global Register Storage ---
 // Define this array based on your register map in registers.h
+// Core 0 (protocol side) owns virtual_registers, core 1 works on
+// motion_registers; core_link.c keeps the two in sync without locks.
 volatile uint8_t virtual_registers[REGISTER_MAP_SIZE]; // Use volatile if accessed by ISRs
+static volatile uint8_t motion_registers[REGISTER_MAP_SIZE];
+
+#define CORE1_READY_FLAG 0xC0DE0001
+
+// --- Core 1: Real-time Motion ---
+// Runs the planner, the step engine IRQs (handled on the core that enables
+// them, so init_motor_control() must run here), the endstops and homing.
+static void core1_main(void) {
+    init_diagnostics_core(); // SysTick is per core
+    init_switches(switch_pins);
+    init_motor_control();
+    init_homing(switch_pins, diag1_pins); // Trigger IRQs must live on this core too
+    init_idle_core(1);
+    multicore_fifo_push_blocking(CORE1_READY_FLAG);
+
+    while (1) {
+        // 1. Replay register writes forwarded by core 0 (queue pushes act immediately)
+        core_link_apply_writes(motion_registers, motor_control_on_register_write);
+
+        // 2. Update hardware/motor state based on register changes
+        update_motor_control_from_registers(motion_registers);
+
+        // 3. Debounce settling switches (endstop edges are handled by IRQ) and
+        // write switch and motion state into the status registers
+        update_switch_status_registers(motion_registers);
+        update_motor_status_registers(motion_registers);
+
+        // 4. Hand the status over to core 0
+        core_link_publish_status(motion_registers);
+        diag_loop_tick(1);
+
+        // 5. Nothing moving or settling: sleep until an IRQ or core 0's next write
+        idle_core1();
+    }
+}
 
 int main() {
-    stdio_init_all(); // Initialize stdio for printf over USB UART
+    stdio_init_all(); // Initialize stdio for printf over USB UART (UART0 in the USB transport build)
     printf("Pico Stepper Controller Booting...\n");
-
+    init_diagnostics_core();
+    init_diagnostics(virtual_registers);
+    init_event_log(virtual_registers); // Loops log through the ring from here on, printf is for init only
+
+#if STEPPER_USB_TRANSPORT
+    // --- Initialize USB CDC Link (UART0 carries the debug output instead) ---
+    init_uart_protocol(NULL);
+    printf("USB CDC Link Initialized\n");
+#else
     // --- Initialize UART ---
     uart_init(UART_ID, BAUD_RATE);
     gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
     gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
-    // Optionally enable UART interrupts here if needed for uart_protocol.c
+    init_uart_protocol(UART_ID); // RX IRQ ring buffer + DMA TX queue
     printf("UART Initialized (Pins %d TX, %d RX, Baud %d)\n", UART_TX_PIN, UART_RX_PIN, BAUD_RATE);
+#endif
 
     // --- Initialize SPI ---
     spi_init(SPI_PORT, 500 * 1000); // 500kHz clock speed - Adjust as needed
@@ -48,50 +109,64 @@ int main() {
     printf("SPI Initialized (Port %d, MISO %d, SCK %d, MOSI %d)\n", spi_get_index(SPI_PORT), SPI_MISO_PIN, SPI_SCK_PIN, SPI_MOSI_PIN);
 
     // Initialize Chip Select pins for TMC drivers
-    gpio_init(SPI_CSN1_PIN);
-    gpio_set_dir(SPI_CSN1_PIN, GPIO_OUT);
-    gpio_put(SPI_CSN1_PIN, 1); // Deselect initially
-    gpio_init(SPI_CSN2_PIN);
-    gpio_set_dir(SPI_CSN2_PIN, GPIO_OUT);
-    gpio_put(SPI_CSN2_PIN, 1); // Deselect initially
-    printf("SPI CS Initialized (CS1 %d, CS2 %d)\n", SPI_CSN1_PIN, SPI_CSN2_PIN);
-
-    // --- Initialize Switches ---
-    init_switches(SWITCH1_PIN, SWITCH2_PIN);
-    printf("Switches Initialized (SW1 %d, SW2 %d)\n", SWITCH1_PIN, SWITCH2_PIN);
+    uint cs_count = TMC_DAISY_CHAIN ? 1 : NUM_MOTORS;
+    for (uint i = 0; i < cs_count; i++) {
+        gpio_init(tmc_cs_pins[i]);
+        gpio_set_dir(tmc_cs_pins[i], GPIO_OUT);
+        gpio_put(tmc_cs_pins[i], 1); // Deselect initially
+        printf("SPI CS%d Initialized (Pin %d)\n", i + 1, tmc_cs_pins[i]);
+    }
 
     // --- Initialize TMC Drivers ---
     // Add specific TMC2130 initialization code here via tmc2130.c functions
     // e.g., configure microstepping, currents, modes via SPI
-    init_tmc_drivers(SPI_PORT, SPI_CSN1_PIN, SPI_CSN2_PIN);
+    init_tmc_drivers(SPI_PORT, tmc_cs_pins);
     printf("TMC Drivers Initialized\n");
 
-    // --- Initialize Motor Control ---
-    init_motor_control();
-    printf("Motor Control Initialized\n");
+    // --- Start Core 1 (switches, motor control, step engine) ---
+    uart_protocol_set_write_hook(core_link_forward_write); // Writes go on to core 1
+    uart_protocol_set_batch_hook(core_link_forward_batch); // Staged commits in one replay
+    multicore_launch_core1(core1_main);
+    if (multicore_fifo_pop_blocking() == CORE1_READY_FLAG) {
+        printf("Switches Initialized (SW1 %d ... SW%d %d)\n", SWITCH1_PIN, NUM_MOTORS, switch_pins[NUM_MOTORS - 1]);
+        printf("Motor Control Initialized (Core 1, %d axes)\n", NUM_MOTORS);
+    }
+
+    // --- Initialize Telemetry (disabled until REG_TELEMETRY_CONTROL is written) ---
+    init_telemetry(virtual_registers);
+    init_driver_monitor(virtual_registers);
+    init_idle_core(0);
 
-    // --- Main Loop ---
+    // --- Main Loop (Core 0: communication) ---
     printf("Starting main loop...\n");
     while (1) {
-        // 1. Handle incoming UART commands & update registers
+        // 1. Handle incoming UART commands & update registers (never blocks)
+        // Applied writes are forwarded to core 1 by core_link_forward_write()
         handle_uart_rx(UART_ID, virtual_registers);
 
-        // 2. Update hardware/motor state based on register changes
-        // This logic might be complex, potentially involving state machines
-        update_motor_control_from_registers(virtual_registers);
+        // 2. Pick up status, positions and speeds published by core 1
+        core_link_pull_status(virtual_registers);
+
+        // 3. Send changed REG_MOTOR_CONFIG values to the TMC drivers (dirty
+        // shadow registers only), then keep the background DRV_STATUS reads going
+        // and act on their results (faults, stalls, lost steps)
+        update_tmc_config_from_registers(virtual_registers);
+        update_tmc_status_scan();
+        update_driver_monitor(virtual_registers);
+
+        // 4. Push telemetry frames if enabled (periodic and/or on change)
+        update_telemetry(virtual_registers);
 
-        // 3. Perform real-time tasks
-        // Example: If using polling for steps instead of timers/interrupts
-        // run_motor_step_sequence(); // Placeholder for step generation logic
+        // 5. Publish loop timing / error counters (REG_DIAG_*)
+        update_diagnostics_registers(virtual_registers);
 
-        // 4. Read hardware status and update relevant registers
-        // Debouncing for switches should be handled within update_switch_status
-        update_switch_status_registers(virtual_registers, SWITCH1_PIN, SWITCH2_PIN);
-        update_motor_status_registers(virtual_registers); // Update current position, status flags etc.
+        // 6. Drain deferred log records (stdio or the REG_DIAG_LOG_* window)
+        update_event_log(virtual_registers);
+        diag_loop_tick(0);
 
-        // Consider using sleep_ms(1) or WFI (Wait For Interrupt) if using interrupts
-        // to reduce CPU load, especially if tasks are not needed every cycle.
-        // tight_loop_contents(); // Use if no sleep/interrupts are used
+        // 7. Axes idle and no bytes to parse: sleep until an IRQ, core 1's next
+        // status or IDLE_MAX_SLEEP_US (the periodic tasks above)
+        idle_core0(virtual_registers);
     }
 
     return 0; // Should not reach here
@@ -1,91 +1,729 @@
 #include "motor_control.h"
+#include "step_engine.h"
+#include "planner.h"
+#include "homing.h"
+#include "switches.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
-#include <stdio.h> // For debug printf
+#include "hardware/sync.h"
+#include "event_log.h"
+#include "reg_dirty.h"
+#include <stdio.h> // For the init message
 #include <string.h> // For memcpy
 
-// --- Placeholder Implementation ---
-// This needs to be replaced with actual stepper motor control logic.
-// Consider using:
-// 1. Timer Interrupts: Generate STEP pulses at precise intervals based on speed/acceleration.
-// 2. PIO (Programmable I/O): Offload step generation to the PIO state machines for high speeds.
-// 3. Simple blocking loops (for low speeds, less precise): Generate steps directly.
+// --- Step Generation ---
+// STEP pulses are generated by the PIO step engine (step_engine.c) with
+// intervals from the ramp planner (planner.c). current_pos is read back from
+// the pulse count of the PIO state machine.
+//
+// --- Move Queue ---
+// Segments pushed through REG_MOTOR_QUEUE_*(axis) wait in a per-motor ring buffer.
+// While one segment runs, the next one is planned into the second ramp slot
+// and the step engine IRQ switches over without stopping. Junction speeds come
+// from a backward pass over the queue (each segment must still be able to stop
+// by the end of the queue), limited by both segments' max speeds. A direction
+// reversal is a junction at speed 0; the DIR change then waits for standstill.
+//
+// --- Coordinated Moves ---
+// REG_COORD_* runs axes 0/1 (M1/M2) along a straight line from one timebase. The axis
+// with the longer travel (major) follows a ramp planned for the path feed
+// rate scaled to that axis. The minor axis replays an identical copy of that
+// ramp and distributes its steps with a Bresenham/DDA rule: minor pulse m
+// (m = 1 .. minor) lands on major step ceil(m * major / minor), counting the
+// major steps from 1, so the last minor pulse is the last major pulse. Its
+// intervals are the sums of the major intervals in between. Both state
+// machines start on the same PIO clock edge, so the axes start and finish
+// together. A single-axis build refuses REG_COORD_CONTROL.
+//
+// --- Homing ---
+// Bit 2 of REG_MOTOR_CONTROL(axis) hands the axis to homing.c once any running
+// move has ramped down. Queued segments wait until homing has finished.
+//
+// --- Endstops ---
+// switches.c halts an axis from the GPIO IRQ when it runs into its endstop.
+// The next pass drops the rest of the move (queue, pending start, the other
+// axis of a coordinated move) and raises the axis' bit in REG_ERROR_FLAGS.
+// An axis already resting on its pressed switch makes no press edge, so a
+// move, queued segment or coordinated line starting further into it is
+// refused the same way; moves away from the switch run.
+
+#define COORD_MAX_STEPS_PER_CALL 32 // Major steps the minor source folds per IRQ call
+
+#define COORD_AXES 2 // Axes 0 and 1 run coordinated moves
+
+#define DEFAULT_MAX_SPEED 1000 // steps/sec used when REG_MOTOR_MAX_SPEED is 0
+
+// A single-axis build keeps a spare (idle) state slot for the coordinated
+// move code, which addresses axes 0 and 1 directly
+#define MOTOR_STATE_SLOTS (NUM_MOTORS > COORD_AXES ? NUM_MOTORS : COORD_AXES)
+
+// --- Internal State ---
+typedef struct {
+    int32_t target_pos;
+    uint16_t max_speed;
+    uint16_t accel;
+} queued_move_t;
 
-// --- Internal State (Example) ---
 typedef struct {
     bool moving;
     int32_t current_pos;
     int32_t target_pos;
     uint16_t max_speed;
     uint16_t accel;
-    // Add state for current speed, acceleration phase, direction etc.
+    uint16_t jerk_time;     // S-curve accel ramp time (ms), 0 = Trapezoidal
+    bool start_pending;     // New move waiting for the current one to ramp down
+    bool forward;           // Direction of the running move
+    bool homing;            // Axis owned by homing.c (until it is idle again)
+    bool limit_hit;         // Endstop hard stop, cleared by the next move
+
+    // Planner state, advanced from the step engine IRQ. ramps[active_ramp] is
+    // running; the other slot holds the next queued segment once planned.
+    ramp_t ramps[2];
+    volatile uint8_t active_ramp;
+    volatile bool next_ready;       // IRQ may chain into the other slot
+    volatile uint32_t chain_count;  // Incremented by the IRQ on each chained switch
+    uint32_t chain_seen;
+
+    // Move queue (segments not yet running)
+    queued_move_t queue[MOVE_QUEUE_DEPTH];
+    uint8_t queue_head;
+    uint8_t queue_count;
+    bool lookahead_dirty;           // Queue grew: junction speeds may be raised
+    bool running_queued;            // Running move came from the queue
+    queued_move_t running;          // Running segment (when running_queued)
+    int32_t running_start;
+    uint32_t exit_speed;            // Planned exit speed of the running segment
+    bool next_planned;              // Queue head planned (or not chainable)
+    uint32_t next_exit_speed;
 } motor_state_t;
 
-static motor_state_t motor_state[2]; // State for motor 1 and motor 2
-static uint32_t last_reg_check_time = 0;
+static motor_state_t motor_state[MOTOR_STATE_SLOTS]; // Indexed by axis (motor - 1)
+
+typedef struct {
+    bool active;
+    bool pending;                   // Start once both axes have ramped down
+    uint major;                     // Axis with the longer travel
+    uint minor;
+    uint32_t major_steps;
+    uint32_t minor_steps;
+    uint32_t remainder;             // (j * minor_steps) mod major_steps, j = next major step (from 1)
+    uint32_t minor_emitted;         // Minor pulses handed to the step engine
+    bool pulse_pending;             // Next minor word starts with a pulse
+    bool shadow_done;
+    ramp_t shadow;                  // Copy of the major ramp, replayed for the minor axis
+    int32_t target[COORD_AXES];
+    uint16_t feed_rate;
+    uint16_t accel;
+    uint16_t jerk_time;
+} coord_state_t;
+
+static coord_state_t coord;
+static reg_dirty_t written; // Registers the host wrote since the last update pass
+
+static const uint step_pins[MOTOR_MAX_AXES] = MOTOR_STEP_PINS;
+static const uint dir_pins[MOTOR_MAX_AXES] = MOTOR_DIR_PINS;
+static const uint enable_pins[MOTOR_MAX_AXES] = MOTOR_ENABLE_PINS;
+
+// --- Step Interval Source (called from the step engine IRQ) ---
+static uint32_t __not_in_flash_func(planner_source)(uint axis) {
+    motor_state_t *m = &motor_state[axis];
+    uint32_t interval = planner_next_interval(&m->ramps[m->active_ramp]);
+    if (interval == 0 && m->next_ready) {
+        // Chain into the next queued segment without stopping
+        m->active_ramp ^= 1;
+        m->next_ready = false;
+        m->chain_count++;
+        interval = planner_next_interval(&m->ramps[m->active_ramp]);
+    }
+    return interval;
+}
+
+// Minor axis of a coordinated move: folds up to COORD_MAX_STEPS_PER_CALL major
+// intervals per call, so long gaps are split into pulse-less delay words
+static uint32_t __not_in_flash_func(coord_minor_source)(void) {
+    if (coord.shadow_done || coord.minor_emitted >= coord.minor_steps) return 0;
+
+    bool pulse = coord.pulse_pending;
+    uint64_t sum = 0;
+    for (uint n = 0; n < COORD_MAX_STEPS_PER_CALL; n++) {
+        uint32_t interval = planner_next_interval(&coord.shadow);
+        if (interval == 0) {
+            coord.shadow_done = true;
+            break;
+        }
+        sum += interval;
+        // Does the following major step carry a minor pulse? Step j does if
+        // floor(j * minor / major) went up, i.e. the remainder wrapped.
+        uint32_t r = coord.remainder + coord.minor_steps;
+        if (r >= coord.major_steps) r -= coord.major_steps;
+        coord.remainder = r;
+        if (r < coord.minor_steps) {
+            coord.pulse_pending = true;
+            break;
+        }
+        coord.pulse_pending = false;
+    }
+    if (coord.shadow_done) coord.pulse_pending = false;
+
+    if (pulse) coord.minor_emitted++;
+    if (sum > STEP_ENGINE_MAX_INTERVAL) sum = STEP_ENGINE_MAX_INTERVAL;
+    if (sum < STEP_ENGINE_MIN_INTERVAL) sum = STEP_ENGINE_MIN_INTERVAL;
+    return pulse ? (uint32_t)sum : ((uint32_t)sum | STEP_INTERVAL_NO_PULSE);
+}
+
+static uint32_t __not_in_flash_func(coord_source)(uint axis) {
+    return axis == coord.minor ? coord_minor_source() : planner_source(axis);
+}
+
+static inline ramp_t *active_ramp(motor_state_t *m) {
+    return &m->ramps[m->active_ramp];
+}
+
+static inline ramp_t *next_ramp(motor_state_t *m) {
+    return &m->ramps[m->active_ramp ^ 1];
+}
+
+// --- Move Queue ---
+static inline queued_move_t *queue_at(motor_state_t *m, uint index) {
+    return &m->queue[(m->queue_head + index) % MOVE_QUEUE_DEPTH];
+}
+
+static queued_move_t queue_pop(motor_state_t *m) {
+    queued_move_t move = m->queue[m->queue_head];
+    m->queue_head = (m->queue_head + 1) % MOVE_QUEUE_DEPTH;
+    m->queue_count--;
+    return move;
+}
+
+static void queue_flush(motor_state_t *m) {
+    uint32_t saved_irq = save_and_disable_interrupts();
+    m->next_ready = false;
+    restore_interrupts(saved_irq);
+    m->queue_count = 0;
+    m->next_planned = false;
+    m->lookahead_dirty = false;
+}
+
+// Position the queue ends at (where the next pushed segment starts)
+static int32_t queue_end_pos(motor_state_t *m) {
+    if (m->queue_count) return queue_at(m, m->queue_count - 1)->target_pos;
+    return m->target_pos;
+}
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+// Max speed through the junction between 'prev' (prev_start -> next_start)
+// and 'next' (next_start -> target), given the speed 'next' must exit with
+static uint32_t junction_speed(const queued_move_t *prev, int32_t prev_start, int32_t next_start,
+                               const queued_move_t *next, uint32_t next_exit) {
+    int32_t d_prev = next_start - prev_start;
+    int32_t d_next = next->target_pos - next_start;
+    if (d_prev == 0 || d_next == 0 || (d_prev > 0) != (d_next > 0)) return 0; // Reversal
+    if (prev->accel == 0 || next->accel == 0) return 0;
+    uint32_t steps = (uint32_t)(d_next > 0 ? d_next : -d_next);
+    uint32_t v = min_u32(prev->max_speed, next->max_speed);
+    return min_u32(v, planner_max_entry_speed(steps, next->accel, next_exit));
+}
+
+// Exit speed for segment 'seg' (seg_start -> seg->target_pos) followed by
+// queue[first..]: backward pass so every later segment can still stop in time
+static uint32_t lookahead_exit_speed(motor_state_t *m, uint first, const queued_move_t *seg, int32_t seg_start) {
+    if (first >= m->queue_count) return 0;
+    int32_t start[MOVE_QUEUE_DEPTH];
+    int32_t pos = seg->target_pos;
+    for (uint k = first; k < m->queue_count; k++) {
+        start[k] = pos;
+        pos = queue_at(m, k)->target_pos;
+    }
+    uint32_t v = 0; // The queue ends at standstill
+    for (int k = (int)m->queue_count - 1; k >= (int)first; k--) {
+        const queued_move_t *prev = k > (int)first ? queue_at(m, k - 1) : seg;
+        int32_t prev_start = k > (int)first ? start[k - 1] : seg_start;
+        v = junction_speed(prev, prev_start, start[k], queue_at(m, k), v);
+    }
+    return v;
+}
+
+static bool queue_push(uint motor, volatile uint8_t *registers, uint16_t reg_target) {
+    motor_state_t *m = &motor_state[motor];
+    if (m->queue_count >= MOVE_QUEUE_DEPTH) {
+        event_log(LOG_EVT_QUEUE_FULL, motor, 0, 0, 0);
+        return false;
+    }
+    queued_move_t move;
+    move.target_pos = (int32_t)READ_U32_REGISTER(registers, reg_target);
+    move.max_speed = READ_U16_REGISTER(registers, reg_target + 4);
+    move.accel = READ_U16_REGISTER(registers, reg_target + 6);
+    if (move.max_speed == 0) move.max_speed = DEFAULT_MAX_SPEED;
+    if (move.target_pos == queue_end_pos(m)) return true; // Zero-length segment
+
+    *queue_at(m, m->queue_count) = move;
+    m->queue_count++;
+    m->lookahead_dirty = true;
+    return true;
+}
+
+// --- Move Helpers ---
+static void ramp_down(motor_state_t *m) {
+    uint32_t saved_irq = save_and_disable_interrupts();
+    m->next_ready = false;
+    planner_request_stop(active_ramp(m));
+    restore_interrupts(saved_irq);
+    // A stop may overshoot the segment target, so nothing chains onto it:
+    // segments pushed from now on start from standstill once idle
+    m->running_queued = false;
+    m->exit_speed = 0;
+}
+
+static void coord_ramp_down(void);
+
+// Refuse a start further into a pressed endstop: drop the rest of the move
+// and flag it like a hard stop
+static bool refuse_into_endstop(uint motor, bool forward) {
+    if (!switches_blocks_move(motor, forward)) return false;
+    motor_state_t *m = &motor_state[motor];
+    queue_flush(m);
+    m->start_pending = false;
+    m->moving = false;
+    m->limit_hit = true;
+    m->target_pos = step_engine_get_position(motor);
+    event_log(LOG_EVT_ENDSTOP_REFUSED, motor, 0, m->target_pos, 0);
+    return true;
+}
+
+static void start_motor_move(uint motor) {
+    motor_state_t *m = &motor_state[motor];
+    queue_flush(m); // A direct move replaces any queued segments
+    homing_abort(motor);
+
+    if (coord.active && motor < COORD_AXES) {
+        // Single-axis commands end the coordinated move (both axes brake)
+        coord_ramp_down();
+        m->start_pending = true;
+        return;
+    }
+
+    if (step_engine_is_busy(motor) || m->homing) {
+        // Ramp the current move down first, the new one starts once idle
+        ramp_down(m);
+        m->start_pending = true;
+        return;
+    }
+    m->start_pending = false;
+    m->running_queued = false;
+    m->limit_hit = false;
+    m->current_pos = step_engine_get_position(motor);
+
+    int32_t delta = m->target_pos - m->current_pos;
+    if (delta == 0) {
+        m->moving = false;
+        return;
+    }
+    if (refuse_into_endstop(motor, delta > 0)) return;
+    uint32_t speed = m->max_speed ? m->max_speed : DEFAULT_MAX_SPEED;
+    planner_plan_move(active_ramp(m), (uint32_t)(delta > 0 ? delta : -delta), speed, m->accel, m->jerk_time);
+    m->moving = true;
+    m->forward = delta > 0;
+
+    gpio_put(enable_pins[motor], 0); // Enable driver (active LOW)
+    step_engine_start(motor, m->forward, planner_source);
+}
+
+static void stop_motor(uint motor) {
+    // Controlled stop: decelerate with the move's own ramp
+    motor_state_t *m = &motor_state[motor];
+    queue_flush(m);
+    homing_abort(motor);
+    if (coord.active && motor < COORD_AXES) coord_ramp_down(); else ramp_down(m);
+    m->start_pending = false;
+}
+
+// REG_MOTOR_POS_ADJUST: shift the position counter of an idle axis (the
+// driver monitor's MSCNT correction). Refused while anything owns the axis.
+static void adjust_position(uint motor, int8_t steps) {
+    motor_state_t *m = &motor_state[motor];
+    bool coord_axis = motor < COORD_AXES && (coord.active || coord.pending);
+    if (m->moving || m->homing || m->start_pending || m->queue_count || coord_axis || step_engine_is_busy(motor)) {
+        event_log(LOG_EVT_POSITION_ADJUST_REFUSED, motor, 0, steps, 0);
+        return;
+    }
+    int32_t pos = step_engine_get_position(motor) + steps;
+    step_engine_set_position(motor, pos);
+    m->current_pos = pos;
+    m->target_pos = pos;
+    event_log(LOG_EVT_POSITION_ADJUSTED, motor, 0, steps, pos);
+}
+
+static void start_homing(uint motor, volatile uint8_t *registers) {
+    motor_state_t *m = &motor_state[motor];
+    queue_flush(m);
+    if (motor < COORD_AXES) coord.pending = false;
+    if (coord.active && motor < COORD_AXES) coord_ramp_down(); else ramp_down(m);
+    m->start_pending = false;
+    m->limit_hit = false;
+    m->homing = true;
+    m->moving = true;
+    homing_start(motor, registers); // Waits for the axis to be idle
+}
+
+// --- Coordinated Moves ---
+static void coord_ramp_down(void) {
+    // Brake the major ramp and mirror the new plan into the minor axis' copy.
+    // The copy runs a few steps ahead, so the minor axis may end up to a few
+    // steps off the line.
+    uint32_t saved_irq = save_and_disable_interrupts();
+    ramp_t *ramp = active_ramp(&motor_state[coord.major]);
+    planner_request_stop(ramp);
+    coord.shadow.total_steps = ramp->total_steps;
+    coord.shadow.decel_at = ramp->decel_at;
+    coord.shadow.p_end = ramp->p_end;
+    restore_interrupts(saved_irq);
+}
+
+static void start_coordinated_move(void) {
+    for (uint i = 0; i < COORD_AXES; i++) homing_abort(i);
+    if (step_engine_is_busy(0) || step_engine_is_busy(1) || motor_state[0].homing || motor_state[1].homing) {
+        // Ramp both axes down first, the coordinated move starts once idle
+        if (coord.active) {
+            coord_ramp_down();
+        } else {
+            for (uint i = 0; i < COORD_AXES; i++) {
+                queue_flush(&motor_state[i]);
+                ramp_down(&motor_state[i]);
+            }
+        }
+        coord.pending = true;
+        return;
+    }
+    coord.pending = false;
+
+    int32_t delta[COORD_AXES];
+    uint32_t steps[COORD_AXES];
+    for (uint i = 0; i < COORD_AXES; i++) {
+        motor_state_t *m = &motor_state[i];
+        queue_flush(m);
+        m->start_pending = false;
+        m->running_queued = false;
+        m->limit_hit = false;
+        m->current_pos = step_engine_get_position(i);
+        m->target_pos = coord.target[i];
+        delta[i] = coord.target[i] - m->current_pos;
+        steps[i] = (uint32_t)(delta[i] > 0 ? delta[i] : -delta[i]);
+    }
+    if (steps[0] == 0 && steps[1] == 0) return;
+    bool refused = false;
+    for (uint i = 0; i < COORD_AXES; i++) {
+        if (steps[i]) refused |= refuse_into_endstop(i, delta[i] > 0);
+    }
+    if (refused) {
+        // The line is lost: neither axis starts
+        for (uint i = 0; i < COORD_AXES; i++) motor_state[i].target_pos = motor_state[i].current_pos;
+        return;
+    }
+
+    coord.major = steps[0] >= steps[1] ? 0 : 1;
+    coord.minor = coord.major ^ 1;
+    coord.major_steps = steps[coord.major];
+    coord.minor_steps = steps[coord.minor];
+
+    // Scale the path feed rate and acceleration to the major axis by
+    // major / length. The length is taken in 1/256 steps unless its square
+    // would overflow (steps below 2^31, so the plain sum always fits).
+    uint64_t length2 = (uint64_t)steps[0] * steps[0] + (uint64_t)steps[1] * steps[1];
+    uint shift = length2 >> 46 ? 0 : 8;
+    uint64_t length = isqrt64(length2 << (2 * shift));
+    uint64_t major_scaled = (uint64_t)coord.major_steps << shift;
+    uint32_t feed = coord.feed_rate ? coord.feed_rate : DEFAULT_MAX_SPEED;
+    uint32_t major_speed = (uint32_t)((feed * major_scaled + length / 2) / length);
+    uint32_t major_accel = (uint32_t)((coord.accel * major_scaled + length / 2) / length);
+    if (major_speed == 0) major_speed = 1;
+    if (coord.accel && major_accel == 0) major_accel = 1;
+
+    motor_state_t *major = &motor_state[coord.major];
+    planner_plan_move(active_ramp(major), coord.major_steps, major_speed, major_accel, coord.jerk_time);
+    coord.shadow = *active_ramp(major);
+    coord.remainder = coord.minor_steps % coord.major_steps; // Major step 1
+    coord.minor_emitted = 0;
+    coord.pulse_pending = coord.remainder < coord.minor_steps; // Only on a 45 degree line
+    coord.shadow_done = coord.minor_steps == 0;
+    coord.active = true;
+
+    const uint axis_ids[COORD_AXES] = { coord.major, coord.minor };
+    const bool forward[COORD_AXES] = { delta[coord.major] > 0, delta[coord.minor] > 0 };
+    uint count = coord.minor_steps ? 2 : 1;
+    for (uint n = 0; n < count; n++) {
+        motor_state[axis_ids[n]].moving = true;
+        motor_state[axis_ids[n]].forward = forward[n];
+        motor_state[axis_ids[n]].next_ready = false;
+        gpio_put(enable_pins[axis_ids[n]], 0); // Enable driver (active LOW)
+    }
+    step_engine_start_synced(axis_ids, forward, coord_source, count);
+}
+
+static void stop_coordinated_move(void) {
+    coord.pending = false;
+    if (coord.active) coord_ramp_down();
+}
+
+static void service_coordinated(void) {
+    if (coord.active && !step_engine_is_busy(coord.major) && !step_engine_is_busy(coord.minor)) {
+        coord.active = false;
+        for (uint i = 0; i < COORD_AXES; i++) {
+            motor_state[i].moving = false;
+        }
+        event_log(LOG_EVT_COORD_DONE, LOG_NO_AXIS, 0, 0, 0);
+        for (uint i = 0; i < COORD_AXES; i++) {
+            if (motor_state[i].start_pending) start_motor_move(i);
+        }
+    }
+    if (coord.pending && !step_engine_is_busy(0) && !step_engine_is_busy(1) &&
+        !motor_state[0].homing && !motor_state[1].homing) {
+        start_coordinated_move();
+    }
+}
+
+// Current speed of an axis in steps/sec (0 when idle)
+static uint32_t axis_speed(uint motor) {
+    motor_state_t *m = &motor_state[motor];
+    if (!m->moving) return 0;
+    if (m->homing) return homing_get_speed(motor);
+    if (coord.active && motor == coord.minor) {
+        uint32_t major_speed = planner_get_speed(active_ramp(&motor_state[coord.major]));
+        return (uint32_t)(((uint64_t)major_speed * coord.minor_steps) / coord.major_steps);
+    }
+    return planner_get_speed(active_ramp(m));
+}
+
+// Plan queue[0] into the free ramp slot so the IRQ can chain into it
+static void plan_next_segment(uint motor) {
+    motor_state_t *m = &motor_state[motor];
+    if (!m->running_queued || m->next_planned || m->queue_count == 0) return;
+
+    const queued_move_t *seg = queue_at(m, 0);
+    int32_t start = m->running.target_pos;
+    int32_t delta = seg->target_pos - start;
+    m->next_planned = true;
+    if ((delta > 0) != m->forward) return; // Reversal: starts from standstill once idle
+
+    // Try to carry speed through the junction if the running segment still can
+    uint32_t entry = m->exit_speed;
+    bool raise = false;
+    if (entry == 0) {
+        entry = junction_speed(&m->running, m->running_start, start, seg, lookahead_exit_speed(m, 1, seg, start));
+        entry = min_u32(entry, planner_exit_speed_limit(active_ramp(m)));
+        raise = entry > 0;
+    }
+    uint32_t exit = lookahead_exit_speed(m, 1, seg, start);
+    uint32_t steps = (uint32_t)(delta > 0 ? delta : -delta);
+    planner_plan_segment(next_ramp(m), steps, entry, seg->max_speed, exit, seg->accel);
+    m->next_exit_speed = exit;
+
+    uint32_t saved_irq = save_and_disable_interrupts();
+    bool ok = !raise || planner_raise_exit_speed(active_ramp(m), entry);
+    if (ok) {
+        if (raise) m->exit_speed = entry;
+        m->next_ready = true;
+    }
+    restore_interrupts(saved_irq);
+
+    if (!ok) {
+        // The running segment is already braking: chain from standstill
+        planner_plan_segment(next_ramp(m), steps, 0, seg->max_speed, exit, seg->accel);
+        saved_irq = save_and_disable_interrupts();
+        m->next_ready = true;
+        restore_interrupts(saved_irq);
+    }
+}
+
+// New segments were queued: let the planned-but-not-started segment exit faster
+static void refresh_lookahead(uint motor) {
+    motor_state_t *m = &motor_state[motor];
+    m->lookahead_dirty = false;
+    if (!m->running_queued) return;
+    if (!m->next_planned) {
+        plan_next_segment(motor);
+        return;
+    }
+    if (m->queue_count == 0) return;
+
+    const queued_move_t *seg = queue_at(m, 0);
+    uint32_t exit = lookahead_exit_speed(m, 1, seg, m->running.target_pos);
+    if (exit <= m->next_exit_speed) return;
+
+    uint32_t saved_irq = save_and_disable_interrupts();
+    if (m->next_ready && planner_raise_exit_speed(next_ramp(m), exit)) {
+        m->next_exit_speed = exit;
+    }
+    restore_interrupts(saved_irq);
+}
+
+static void start_queued_move(uint motor) {
+    motor_state_t *m = &motor_state[motor];
+    m->current_pos = step_engine_get_position(motor);
+    while (m->queue_count) {
+        queued_move_t seg = queue_pop(m);
+        int32_t delta = seg.target_pos - m->current_pos;
+        if (delta == 0) continue;
+        if (refuse_into_endstop(motor, delta > 0)) return;
+
+        m->running = seg;
+        m->running_start = m->current_pos;
+        m->running_queued = true;
+        m->limit_hit = false;
+        m->target_pos = seg.target_pos;
+        m->forward = delta > 0;
+        m->exit_speed = lookahead_exit_speed(m, 0, &seg, m->current_pos);
+        m->next_planned = false;
+        m->next_ready = false;
+        m->lookahead_dirty = false;
+        planner_plan_segment(active_ramp(m), (uint32_t)(delta > 0 ? delta : -delta), 0, seg.max_speed,
+                             m->exit_speed, seg.accel);
+        m->moving = true;
+
+        gpio_put(enable_pins[motor], 0); // Enable driver (active LOW)
+        step_engine_start(motor, m->forward, planner_source);
+        plan_next_segment(motor);
+        return;
+    }
+}
+
+// Per-pass queue bookkeeping (main loop, not rate limited)
+static void service_motor(uint motor) {
+    motor_state_t *m = &motor_state[motor];
+    if (switches_take_hard_stop(motor) && !m->homing) { // Homing handles its own trigger
+        m->limit_hit = true;
+        queue_flush(m);
+        m->start_pending = false;
+        m->target_pos = step_engine_get_position(motor);
+        if (motor < COORD_AXES) coord.pending = false;
+        if (coord.active && motor < COORD_AXES) coord_ramp_down(); // The other axis brakes, the line is lost
+        event_log(LOG_EVT_HARD_STOP, motor, 0, m->target_pos, 0);
+    }
+    if (m->homing) {
+        // Homing (or its aborted leg ramping down) owns the axis
+        if (homing_is_active(motor) || step_engine_is_busy(motor)) {
+            m->moving = true;
+            return;
+        }
+        m->homing = false;
+        m->moving = false;
+        m->target_pos = step_engine_get_position(motor);
+        if (m->start_pending) start_motor_move(motor);
+    }
+    if ((coord.active || coord.pending) && motor < COORD_AXES) return; // Coordinated move owns both axes
+
+    if (m->chain_seen != m->chain_count) {
+        // The IRQ moved on to the pre-planned segment
+        m->chain_seen = m->chain_count;
+        m->running_start = m->running.target_pos;
+        m->running = queue_pop(m);
+        m->target_pos = m->running.target_pos;
+        m->exit_speed = m->next_exit_speed;
+        m->next_planned = false;
+        plan_next_segment(motor);
+    }
+
+    if (m->moving && !step_engine_is_busy(motor)) {
+        m->moving = false;
+        m->next_ready = false; // Engine idle: nothing left to chain into
+        m->next_planned = false;
+        m->running_queued = false;
+        if (m->start_pending) {
+            start_motor_move(motor); // Previous move has ramped down
+        } else if (m->queue_count == 0 && !m->limit_hit) {
+            event_log(LOG_EVT_TARGET_REACHED, motor, 0, 0, 0);
+        }
+    }
+
+    if (!m->moving && m->queue_count) {
+        start_queued_move(motor);
+    } else if (m->lookahead_dirty) {
+        refresh_lookahead(motor);
+    }
+}
 
 // --- Initialization ---
 void init_motor_control(void) {
-    printf("Motor Control Init (Placeholder)\n");
-    // Initialize GPIOs if STEP/DIR pins are used
-    // Setup timers or PIO if used for step generation
+    printf("Motor Control Init\n");
     memset(motor_state, 0, sizeof(motor_state));
-    last_reg_check_time = time_us_32();
+    memset(&coord, 0, sizeof(coord));
+    reg_dirty_clear(&written);
 
-    // Example: If using dedicated enable pins
-    // gpio_init(MOTOR1_ENABLE_PIN); gpio_set_dir(MOTOR1_ENABLE_PIN, GPIO_OUT); gpio_put(MOTOR1_ENABLE_PIN, 1); // Disabled
-    // gpio_init(MOTOR2_ENABLE_PIN); gpio_set_dir(MOTOR2_ENABLE_PIN, GPIO_OUT); gpio_put(MOTOR2_ENABLE_PIN, 1); // Disabled
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        gpio_init(enable_pins[i]);
+        gpio_set_dir(enable_pins[i], GPIO_OUT);
+        gpio_put(enable_pins[i], 1); // Disabled until the first move
+    }
+    init_step_engine(step_pins, dir_pins, NUM_MOTORS);
 }
 
 // --- Update state from registers ---
 void update_motor_control_from_registers(volatile uint8_t *registers) {
-    // Check registers periodically, not necessarily every loop iteration
-    uint32_t now = time_us_32();
-    if (now - last_reg_check_time < 10000) { // Check every 10ms (adjust interval)
-        return;
+    // Only control registers written since the last pass are looked at, so a
+    // command takes effect on the next core 1 pass and a quiet pass costs a
+    // few bit tests
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        if (reg_dirty_take(&written, REG_MOTOR_POS_ADJUST(i), 1)) {
+            adjust_position(i, (int8_t)registers[REG_MOTOR_POS_ADJUST(i)]);
+        }
+        if (!reg_dirty_take(&written, REG_MOTOR_CONTROL(i), 1)) continue;
+        motor_state_t *m = &motor_state[i];
+        uint8_t control = registers[REG_MOTOR_CONTROL(i)];
+        if (control & 0x01) { // Check Start Move bit
+            m->target_pos = READ_U32_REGISTER(registers, REG_MOTOR_TARGET_POS_L(i));
+            m->max_speed = READ_U16_REGISTER(registers, REG_MOTOR_MAX_SPEED_L(i));
+            m->accel = READ_U16_REGISTER(registers, REG_MOTOR_ACCEL_L(i));
+            m->jerk_time = READ_U16_REGISTER(registers, REG_MOTOR_JERK_TIME_L(i));
+            start_motor_move(i);
+            event_log(LOG_EVT_MOVE_START, i, m->max_speed, m->target_pos, m->accel);
+            // Clear the start bit in the register after processing
+            registers[REG_MOTOR_CONTROL(i)] &= ~0x01;
+        }
+        if (control & 0x02) { // Check Stop Move bit
+            stop_motor(i);
+            event_log(LOG_EVT_MOVE_STOP, i, 0, 0, 0);
+            // Clear the stop bit
+            registers[REG_MOTOR_CONTROL(i)] &= ~0x02;
+        }
+        if (control & 0x04) { // Check Start Homing bit
+            start_homing(i, registers);
+            registers[REG_MOTOR_CONTROL(i)] &= ~0x04;
+        }
+    }
+
+    // --- Coordinated Move (M1 = X, M2 = Y) ---
+    uint8_t coord_control = reg_dirty_take(&written, REG_COORD_CONTROL, 1) ? registers[REG_COORD_CONTROL] : 0;
+    if ((coord_control & 0x01) && NUM_MOTORS < COORD_AXES) {
+        event_log(LOG_EVT_COORD_IGNORED, LOG_NO_AXIS, 0, 0, 0);
+    } else if (coord_control & 0x01) { // Start
+        coord.target[0] = READ_U32_REGISTER(registers, REG_MOTOR_TARGET_POS_L(0));
+        coord.target[1] = READ_U32_REGISTER(registers, REG_MOTOR_TARGET_POS_L(1));
+        coord.feed_rate = READ_U16_REGISTER(registers, REG_COORD_FEED_RATE_L);
+        coord.accel = READ_U16_REGISTER(registers, REG_COORD_ACCEL_L);
+        coord.jerk_time = READ_U16_REGISTER(registers, REG_COORD_JERK_TIME_L);
+        start_coordinated_move();
+        event_log(LOG_EVT_COORD_START, LOG_NO_AXIS, coord.feed_rate, coord.target[0], coord.target[1]);
+    }
+    if (coord_control & 0x01) registers[REG_COORD_CONTROL] &= ~0x01;
+    if (coord_control & 0x02) { // Stop
+        stop_coordinated_move();
+        event_log(LOG_EVT_COORD_STOP, LOG_NO_AXIS, 0, 0, 0);
+        registers[REG_COORD_CONTROL] &= ~0x02;
     }
-    last_reg_check_time = now;
-
-    // --- Motor 1 ---
-    uint8_t m1_control = registers[REG_MOTOR1_CONTROL];
-    if (m1_control & 0x01) { // Check Start Move bit
-        motor_state[0].target_pos = READ_U32_REGISTER(registers, REG_MOTOR1_TARGET_POS_L);
-        motor_state[0].max_speed = READ_U16_REGISTER(registers, REG_MOTOR1_MAX_SPEED_L);
-        motor_state[0].accel = READ_U16_REGISTER(registers, REG_MOTOR1_ACCEL_L);
-        // TODO: Add actual logic to start movement (e.g., enable timer, set PIO)
-        motor_state[0].moving = true;
-        printf("M1 Start Cmd: Target=%ld, Speed=%d, Accel=%d\n", motor_state[0].target_pos, motor_state[0].max_speed, motor_state[0].accel);
-        // Clear the start bit in the register after processing
-        registers[REG_MOTOR1_CONTROL] &= ~0x01;
-    }
-    if (m1_control & 0x02) { // Check Stop Move bit
-         // TODO: Add actual logic to stop movement (disable timer, PIO, ramp down)
-         motor_state[0].moving = false;
-         printf("M1 Stop Cmd\n");
-         // Clear the stop bit
-         registers[REG_MOTOR1_CONTROL] &= ~0x02;
-    }
-    // Add homing command handling (bit 2)
-
-    // --- Motor 2 ---
-    // Similar logic for Motor 2 using REG_MOTOR2_* registers
-     uint8_t m2_control = registers[REG_MOTOR2_CONTROL];
-     if (m2_control & 0x01) { // Start
-         motor_state[1].target_pos = READ_U32_REGISTER(registers, REG_MOTOR2_TARGET_POS_L);
-         motor_state[1].max_speed = READ_U16_REGISTER(registers, REG_MOTOR2_MAX_SPEED_L);
-         motor_state[1].accel = READ_U16_REGISTER(registers, REG_MOTOR2_ACCEL_L);
-         motor_state[1].moving = true;
-         printf("M2 Start Cmd: Target=%ld, Speed=%d, Accel=%d\n", motor_state[1].target_pos, motor_state[1].max_speed, motor_state[1].accel);
-         registers[REG_MOTOR2_CONTROL] &= ~0x01;
-     }
-     if (m2_control & 0x02) { // Stop
-          motor_state[1].moving = false;
-          printf("M2 Stop Cmd\n");
-          registers[REG_MOTOR2_CONTROL] &= ~0x02;
-     }
-
-    // TODO: Apply other configurations read from registers (e.g., microstepping from REG_MOTORx_CONFIG)
-    // This might involve writing to TMC registers via tmc2130.c functions
+
+    // Move queue flush requests (pushes are handled by the UART write hook)
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        if (!reg_dirty_take(&written, REG_MOTOR_QUEUE_CONTROL(i), 1)) continue;
+        if (!(registers[REG_MOTOR_QUEUE_CONTROL(i)] & 0x02)) continue;
+        if (motor_state[i].running_queued) stop_motor(i); else queue_flush(&motor_state[i]);
+        event_log(LOG_EVT_QUEUE_FLUSH, i, 0, 0, 0);
+        registers[REG_MOTOR_QUEUE_CONTROL(i)] &= ~0x02;
+    }
+
+    // REG_MOTOR_CONFIG(axis) (microstepping, currents) is applied to the TMC drivers
+    // on core 0, see update_tmc_config_from_registers() in tmc2130.c
 }
 
 
@@ -93,45 +731,67 @@ void update_motor_control_from_registers(volatile uint8_t *registers) {
 void update_motor_status_registers(volatile uint8_t *registers) {
     // --- Update Status Byte ---
     uint8_t status = registers[REG_STATUS]; // Read current status
-    // Set/clear moving bits based on internal state
+    // Set/clear moving bits based on internal state (M1/M2, other axes only
+    // report through REG_MOTOR_STATUS)
     if (motor_state[0].moving) status |= (1 << 1); else status &= ~(1 << 1);
-    if (motor_state[1].moving) status |= (1 << 2); else status &= ~(1 << 2);
-    // Add homing status bits (3, 4) if implementing homing
+    if (NUM_MOTORS > 1 && motor_state[1].moving) status |= (1 << 2); else status &= ~(1 << 2);
+    if (motor_state[0].homing) status |= (1 << 3); else status &= ~(1 << 3);
+    if (NUM_MOTORS > 1 && motor_state[1].homing) status |= (1 << 4); else status &= ~(1 << 4);
+    if (coord.active || coord.pending) status |= (1 << 5); else status &= ~(1 << 5);
     // Update ready bit (0) - maybe based on initialization complete or error status?
     status |= (1 << 0); // Assume ready for now
     registers[REG_STATUS] = status;
 
     // --- Update Current Positions ---
-    // TODO: Update motor_state[0].current_pos and motor_state[1].current_pos based on
-    // actual steps generated (e.g., count steps in ISR or read from PIO)
-    // This is just a placeholder:
-    if (motor_state[0].moving && motor_state[0].current_pos < motor_state[0].target_pos) motor_state[0].current_pos++;
-    if (motor_state[0].moving && motor_state[0].current_pos > motor_state[0].target_pos) motor_state[0].current_pos--;
-    if (motor_state[1].moving && motor_state[1].current_pos < motor_state[1].target_pos) motor_state[1].current_pos++;
-    if (motor_state[1].moving && motor_state[1].current_pos > motor_state[1].target_pos) motor_state[1].current_pos--;
+    // Positions come from the PIO pulse counters, so they match the pulses
+    // actually emitted on the STEP pins.
+    update_homing(registers);
+    service_coordinated();
+    uint8_t errors = registers[REG_ERROR_FLAGS] & ~((1u << NUM_MOTORS) - 1);
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        motor_state_t *m = &motor_state[i];
+        service_motor(i);
+        m->current_pos = step_engine_get_position(i);
 
-    // Check if target reached (simplified)
-    if (motor_state[0].moving && motor_state[0].current_pos == motor_state[0].target_pos) {
-        motor_state[0].moving = false;
-        printf("M1 Target Reached\n");
-    }
-     if (motor_state[1].moving && motor_state[1].current_pos == motor_state[1].target_pos) {
-        motor_state[1].moving = false;
-        printf("M2 Target Reached\n");
-    }
+        // Write updated positions back to registers
+        WRITE_U32_REGISTER(registers, REG_MOTOR_CURRENT_POS_L(i), m->current_pos);
+
+        // Current planned speed (0 when idle)
+        uint32_t speed = axis_speed(i);
+        WRITE_U16_REGISTER(registers, REG_MOTOR_CURRENT_SPEED_L(i), speed > 0xFFFF ? 0xFFFF : speed);
 
+        // Move queue space for host flow control
+        registers[REG_MOTOR_QUEUE_FREE(i)] = MOVE_QUEUE_DEPTH - m->queue_count;
 
-    // Write updated positions back to registers
-    WRITE_U32_REGISTER(registers, REG_MOTOR1_CURRENT_POS_L, motor_state[0].current_pos);
-    WRITE_U32_REGISTER(registers, REG_MOTOR2_CURRENT_POS_L, motor_state[1].current_pos);
+        registers[REG_MOTOR_STATUS(i)] = (m->moving ? 0x01 : 0) | (m->homing ? 0x02 : 0);
 
-    // TODO: Update error flags register (REG_ERROR_FLAGS) based on TMC status reads or limit switches
+        // Endstop hard stop (bit n for axis n)
+        if (m->limit_hit) errors |= (1 << i);
+    }
+    registers[REG_ERROR_FLAGS] = errors;
 }
 
-// --- Step Generation (Placeholder - Not functional without timer/PIO) ---
-// void run_motor_step_sequence(void) {
-//     // This function would contain the logic to generate STEP pulses
-//     // based on the current speed and acceleration profile derived from
-//     // motor_state. This is highly timing-dependent and best done
-//     // with hardware timers or PIO.
-// }
+bool motor_control_is_idle(void) {
+    if (coord.active || coord.pending) return false;
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        motor_state_t *m = &motor_state[i];
+        if (m->moving || m->homing || m->queue_count || homing_is_active(i)) return false;
+    }
+    return true;
+}
+
+// --- Register Write Hook ---
+bool motor_control_on_register_write(uint16_t reg_addr, uint8_t len, volatile uint8_t *registers) {
+    bool ok = true;
+    reg_dirty_mark(&written, reg_addr, len);
+
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        uint16_t ctrl = REG_MOTOR_QUEUE_CONTROL(i);
+        if (ctrl < reg_addr || ctrl >= reg_addr + len) continue;
+        if (registers[ctrl] & 0x01) { // Push segment
+            if (!queue_push(i, registers, REG_MOTOR_QUEUE_TARGET_L(i))) ok = false;
+            registers[ctrl] &= ~0x01;
+        }
+    }
+    return ok;
+}
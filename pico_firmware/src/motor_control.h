@@ -2,15 +2,46 @@
 #define MOTOR_CONTROL_H
 
 #include "registers.h"
+#include "pico/stdlib.h" // bool, uint
 
-// Define GPIO pins used for STEP/DIR/ENABLE if not directly controlled by TMC SPI only modes
-// Example:
-// #define MOTOR1_STEP_PIN   3
-// #define MOTOR1_DIR_PIN    4
-// #define MOTOR1_ENABLE_PIN 5 // Active LOW
-// #define MOTOR2_STEP_PIN   6
-// #define MOTOR2_DIR_PIN    7
-// #define MOTOR2_ENABLE_PIN 8 // Active LOW
+// GPIO pins used for STEP/DIR/ENABLE (STEP is driven by PIO, see step_engine.c)
+#define MOTOR1_STEP_PIN   3
+#define MOTOR1_DIR_PIN    4
+#define MOTOR1_ENABLE_PIN 5 // Active LOW
+#define MOTOR2_STEP_PIN   6
+#define MOTOR2_DIR_PIN    7
+#define MOTOR2_ENABLE_PIN 8 // Active LOW
+#define MOTOR3_STEP_PIN   11
+#define MOTOR3_DIR_PIN    12
+#define MOTOR3_ENABLE_PIN 13 // Active LOW
+#define MOTOR4_STEP_PIN   14
+#define MOTOR4_DIR_PIN    15
+#define MOTOR4_ENABLE_PIN 22 // Active LOW
+
+// TMC2130 DIAG1 outputs (StallGuard homing, open drain, see homing.h)
+#define MOTOR1_DIAG1_PIN  9
+#define MOTOR2_DIAG1_PIN  10
+#define MOTOR3_DIAG1_PIN  28
+#define MOTOR4_DIAG1_PIN  2  // CS2 with separate chip selects, free on the daisy chain
+
+// Pin tables indexed by axis (entries past NUM_MOTORS are unused)
+#define MOTOR_MAX_AXES    4
+#define MOTOR_STEP_PINS   { MOTOR1_STEP_PIN, MOTOR2_STEP_PIN, MOTOR3_STEP_PIN, MOTOR4_STEP_PIN }
+#define MOTOR_DIR_PINS    { MOTOR1_DIR_PIN, MOTOR2_DIR_PIN, MOTOR3_DIR_PIN, MOTOR4_DIR_PIN }
+#define MOTOR_ENABLE_PINS { MOTOR1_ENABLE_PIN, MOTOR2_ENABLE_PIN, MOTOR3_ENABLE_PIN, MOTOR4_ENABLE_PIN }
+#define MOTOR_DIAG1_PINS  { MOTOR1_DIAG1_PIN, MOTOR2_DIAG1_PIN, MOTOR3_DIAG1_PIN, MOTOR4_DIAG1_PIN }
+
+#define NUM_MOTORS        REG_NUM_AXES // STEPPER_NUM_AXES, see CMakeLists.txt
+#define MOVE_QUEUE_DEPTH  16 // Queued segments per motor (REG_MOTOR_QUEUE_*)
+
+#if NUM_MOTORS < 1 || NUM_MOTORS > MOTOR_MAX_AXES
+#error "STEPPER_NUM_AXES must be 1-4"
+#endif
+
+// REG_ERROR_FLAGS: endstop hard stops and refused moves set by core 1 (bit n), driver faults
+// set by core 0's driver monitor (bit 4+n, see driver_monitor.h)
+#define ERROR_FLAGS_ENDSTOP_MASK        0x0F
+#define ERROR_FLAGS_DRIVER_FAULT(axis)  (1u << (4 + (axis)))
 
 // --- Function Prototypes ---
 
@@ -18,14 +49,21 @@
 void init_motor_control(void);
 
 // Read relevant registers and update motor controller state (targets, speeds, start/stop commands)
-// This is the main interface between the register map and the motion control logic
+// This is the main interface between the register map and the motion control logic.
+// Acts only on control registers marked by motor_control_on_register_write().
 void update_motor_control_from_registers(volatile uint8_t *registers);
 
 // Update status registers (e.g., current position, moving flags) based on internal state
 void update_motor_status_registers(volatile uint8_t *registers);
 
-// If using a polling-based step generation, this function would be called in the main loop
-// void run_motor_step_sequence(void); // Uncomment if needed
+// UART write hook (see uart_protocol_set_write_hook): queues a segment as soon
+// as REG_MOTOR_QUEUE_CONTROL(axis) is written, and marks the written range for
+// the next update_motor_control_from_registers(). Returns false if the queue is full.
+bool motor_control_on_register_write(uint16_t reg_addr, uint8_t len, volatile uint8_t *registers);
+
+// True if no axis is moving or homing, no segment is queued and no
+// coordinated move is running or pending (core 1 may sleep, see idle.h)
+bool motor_control_is_idle(void);
 
 // --- Add internal state variables or structures if needed ---
 // typedef struct { ... } motor_state_t;
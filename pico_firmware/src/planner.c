@@ -0,0 +1,331 @@
+#include "planner.h"
+#include "step_engine.h" // STEP_ENGINE_TICK_HZ
+
+// --- Fixed-Point Constants ---
+// F = step engine tick rate. Intervals are Q24.8 ticks.
+#define F_TICKS         ((uint64_t)STEP_ENGINE_TICK_HZ)
+#define F_TICKS_Q8      (F_TICKS << PLANNER_P_FRAC_BITS)
+
+// 2^56 / F^2, scaled by 1024 to keep precision: k = (a * K_UNIT_X1024) >> 10
+#define K_UNIT_X1024    ((1ull << 62) / (F_TICKS * F_TICKS / 16))
+
+// sqrt(4j + 2) in Q16, j = 0..PLANNER_EXACT_STEPS (.data: read in the IRQ path)
+static uint32_t rest_sqrt_q16[PLANNER_EXACT_STEPS + 1] = {
+    92682, 160530, 207243, 245213, 278046, 307391, 334169, 358955, 382137,
+    403991, 424722, 444487, 463410, 481589, 499107, 516031, 532417,
+};
+
+// --- Helpers ---
+uint64_t isqrt64(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > value) bit >>= 2;
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+static inline uint32_t interval_for_speed(uint32_t speed) {
+    if (speed == 0) speed = 1;
+    uint64_t p = F_TICKS_Q8 / speed;
+    return p > UINT32_MAX ? UINT32_MAX : (uint32_t)p;
+}
+
+// First interval from standstill (Eiderman): p0 = F / sqrt(2a)
+static uint32_t rest_interval(uint32_t accel) {
+    uint64_t p = isqrt64(((F_TICKS * F_TICKS) << (2 * PLANNER_P_FRAC_BITS)) / (2ull * accel));
+    return p > UINT32_MAX ? UINT32_MAX : (uint32_t)p;
+}
+
+// Steps needed to change speed between v_high and v_low at 'accel'
+static inline uint32_t ramp_steps(uint32_t v_high, uint32_t v_low, uint32_t accel) {
+    uint64_t dv2 = (uint64_t)v_high * v_high - (uint64_t)v_low * v_low;
+    return (uint32_t)(dv2 / (2ull * accel));
+}
+
+// q = k * p^2 >> PLANNER_K_SHIFT (Q0.32). Bounded by ~0.5 because p never
+// exceeds p_start = F / sqrt(2a), so the 64-bit product cannot overflow.
+// p^2 keeps 8 fractional bits: truncating p to whole ticks biases q low,
+// which shifts the end of a long ramp by whole steps.
+static inline uint32_t __not_in_flash_func(ramp_q)(uint32_t p, uint32_t k) {
+    uint64_t p2_q8 = ((uint64_t)p * p) >> PLANNER_P_FRAC_BITS;
+    return (uint32_t)((p2_q8 * k) >> (PLANNER_K_SHIFT + PLANNER_P_FRAC_BITS));
+}
+
+// 3/2 q^2 (Q0.32); q stays below ~1/2 (see ramp_q), so q - 3/2 q^2 cannot underflow
+static inline uint32_t __not_in_flash_func(ramp_q2)(uint32_t q) {
+    uint32_t q2 = (uint32_t)(((uint64_t)q * q) >> 32);
+    return q2 + (q2 >> 1);
+}
+
+// Move k by one step's worth of jerk: +1 increase, -1 decrease, 0 hold
+static inline void __not_in_flash_func(update_jerk)(ramp_t *ramp, int direction) {
+    if (direction == 0) return;
+    uint32_t dk = (uint32_t)(((uint64_t)ramp->k_jerk * (ramp->p >> PLANNER_P_FRAC_BITS)) >> 16);
+    if (direction > 0) {
+        ramp->k = (ramp->k_max - ramp->k > dk) ? ramp->k + dk : ramp->k_max;
+    } else {
+        ramp->k = (ramp->k > dk && ramp->k - dk > ramp->k_min) ? ramp->k - dk : ramp->k_min;
+    }
+}
+
+// Interval j (j < PLANNER_EXACT_STEPS) of a trapezoidal ramp from standstill
+static inline uint32_t __not_in_flash_func(rest_step_interval)(const ramp_t *ramp, uint32_t j) {
+    uint32_t d = rest_sqrt_q16[j + 1] - rest_sqrt_q16[j];
+    return (uint32_t)(((uint64_t)ramp->p_rest * d) >> 16);
+}
+
+static inline void __not_in_flash_func(enter_decel)(ramp_t *ramp) {
+    ramp->phase = RAMP_DECEL;
+    ramp->decel_start = ramp->step;
+    ramp->k = ramp->k_jerk ? ramp->k_min : ramp->k_max;
+}
+
+// --- Planning ---
+void planner_plan_move(ramp_t *ramp, uint32_t steps, uint32_t max_speed, uint32_t accel, uint32_t jerk_time_ms) {
+    memset(ramp, 0, sizeof(*ramp));
+    if (steps == 0) return;
+    if (max_speed == 0) max_speed = 1;
+
+    ramp->total_steps = steps;
+    ramp->p_cruise = interval_for_speed(max_speed);
+
+    if (accel == 0) {
+        // No ramp: run the whole move at max speed
+        ramp->p_start = ramp->p_cruise;
+        ramp->p = ramp->p_cruise;
+        ramp->phase = RAMP_CRUISE;
+        return;
+    }
+
+    ramp->p_start = rest_interval(accel);
+    ramp->p_rest = ramp->p_start;
+    ramp->p_end = ramp->p_start;
+    ramp->accel = accel;
+    ramp->k_max = (uint32_t)(((uint64_t)accel * K_UNIT_X1024) >> 10);
+    ramp->k = ramp->k_max;
+
+    if (jerk_time_ms > 0) {
+        // Limit the peak speed so a full S-curve accel + decel fits the move:
+        // v^2 + v*a*Tj <= a*steps
+        uint64_t b = (uint64_t)accel * jerk_time_ms / 1000;
+        uint32_t v_peak = (uint32_t)((isqrt64(b * b + 4ull * accel * steps) - b) / 2);
+        if (v_peak < max_speed) {
+            max_speed = v_peak ? v_peak : 1;
+            ramp->p_cruise = interval_for_speed(max_speed);
+        }
+
+        // Linear accel ramp in time: dk/dt = k_max / Tj, per tick, Q16
+        ramp->k_jerk = (uint32_t)(((uint64_t)accel * 1000 * K_UNIT_X1024 * 64) / ((uint64_t)jerk_time_ms * F_TICKS));
+        if (ramp->k_jerk == 0) ramp->k_jerk = 1;
+        ramp->k_min = ramp->k_max / 16;
+        ramp->k = ramp->k_min;
+
+        // Speed gained while easing accel out: dv = a * Tj / 2
+        uint32_t dv = (uint32_t)(b / 2);
+        if (dv > max_speed / 2) dv = max_speed / 2;
+        ramp->p_jerk_high = interval_for_speed(max_speed - dv);
+    }
+
+    if (ramp->p_start <= ramp->p_cruise) {
+        // Max speed is below the start speed: no ramp needed
+        ramp->p_start = ramp->p_cruise;
+        ramp->p = ramp->p_cruise;
+        ramp->phase = RAMP_CRUISE;
+        return;
+    }
+    ramp->p = ramp->k_jerk ? ramp->p_start : rest_step_interval(ramp, 0);
+    ramp->phase = RAMP_ACCEL;
+}
+
+void planner_plan_segment(ramp_t *ramp, uint32_t steps, uint32_t entry_speed, uint32_t max_speed,
+                          uint32_t exit_speed, uint32_t accel) {
+    if (accel == 0) {
+        // Constant speed, nothing to ramp between
+        planner_plan_move(ramp, steps, max_speed, accel, 0);
+        return;
+    }
+    memset(ramp, 0, sizeof(*ramp));
+    if (steps == 0) return;
+    if (max_speed == 0) max_speed = 1;
+    if (entry_speed > max_speed) entry_speed = max_speed;
+    if (exit_speed > max_speed) exit_speed = max_speed;
+
+    // Peak speed if the move is too short to reach max_speed:
+    // v_peak^2 = (2 * a * steps + v_entry^2 + v_exit^2) / 2
+    uint64_t peak2 = (2ull * accel * steps + (uint64_t)entry_speed * entry_speed +
+                      (uint64_t)exit_speed * exit_speed) / 2;
+    if ((uint64_t)max_speed * max_speed > peak2) max_speed = (uint32_t)isqrt64(peak2);
+    if (max_speed < entry_speed) max_speed = entry_speed;
+    if (max_speed < exit_speed) max_speed = exit_speed;
+
+    ramp->total_steps = steps;
+    ramp->accel = accel;
+    ramp->peak_speed = max_speed;
+    ramp->k_max = (uint32_t)(((uint64_t)accel * K_UNIT_X1024) >> 10);
+    ramp->k = ramp->k_max;
+    ramp->p_rest = rest_interval(accel);
+    ramp->p_cruise = interval_for_speed(max_speed);
+    if (ramp->p_cruise > ramp->p_rest) ramp->p_cruise = ramp->p_rest;
+
+    // Speeds below the standstill speed start/end at the standstill interval
+    ramp->p_start = entry_speed ? interval_for_speed(entry_speed) : ramp->p_rest;
+    if (ramp->p_start > ramp->p_rest) ramp->p_start = ramp->p_rest;
+    ramp->p_end = exit_speed ? interval_for_speed(exit_speed) : ramp->p_rest;
+    if (ramp->p_end > ramp->p_rest) ramp->p_end = ramp->p_rest;
+
+    // Deceleration point from the exit speed (always >= 1, 0 means mirror mode)
+    uint32_t decel_steps = ramp_steps(max_speed, exit_speed, accel);
+    ramp->decel_at = decel_steps < steps ? steps - decel_steps : 1;
+
+    ramp->p = ramp->p_start;
+    ramp->phase = ramp->p_start <= ramp->p_cruise ? RAMP_CRUISE : RAMP_ACCEL;
+    if (ramp->phase == RAMP_ACCEL && ramp->p_start == ramp->p_rest) ramp->p = rest_step_interval(ramp, 0);
+}
+
+uint32_t planner_max_entry_speed(uint32_t steps, uint32_t accel, uint32_t exit_speed) {
+    uint64_t v2 = (uint64_t)exit_speed * exit_speed + 2ull * accel * steps;
+    uint64_t v = isqrt64(v2);
+    return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+uint32_t planner_exit_speed_limit(const ramp_t *ramp) {
+    if (ramp->decel_at == 0 || ramp->accel == 0) return 0; // Not a segment
+    if (ramp->phase != RAMP_ACCEL && ramp->phase != RAMP_CRUISE) return 0;
+    return ramp->peak_speed;
+}
+
+bool planner_raise_exit_speed(ramp_t *ramp, uint32_t exit_speed) {
+    if (exit_speed == 0 || exit_speed > planner_exit_speed_limit(ramp)) return false;
+
+    uint32_t decel_steps = ramp_steps(ramp->peak_speed, exit_speed, ramp->accel);
+    uint32_t decel_at = decel_steps < ramp->total_steps ? ramp->total_steps - decel_steps : 1;
+    if (decel_at < ramp->decel_at) return false; // Would have to brake harder than planned
+
+    uint32_t p_end = interval_for_speed(exit_speed);
+    ramp->decel_at = decel_at;
+    ramp->p_end = p_end < ramp->p_rest ? p_end : ramp->p_rest;
+    return true;
+}
+
+// --- Step Interval Generation (IRQ context) ---
+uint32_t __not_in_flash_func(planner_next_interval)(ramp_t *ramp) {
+    if (ramp->phase == RAMP_IDLE) return 0;
+    if (ramp->step >= ramp->total_steps) {
+        ramp->phase = RAMP_IDLE;
+        return 0;
+    }
+
+    // Emit the current interval, carrying the fractional part forward
+    uint32_t acc = ramp->p + ramp->frac;
+    uint32_t interval = acc >> PLANNER_P_FRAC_BITS;
+    ramp->frac = acc & ((1u << PLANNER_P_FRAC_BITS) - 1);
+    uint32_t step = ++ramp->step;
+
+    // Phase transitions: deceleration mirrors the steps spent accelerating,
+    // segments decelerate at their planned point instead
+    if (ramp->decel_at) {
+        if ((ramp->phase == RAMP_ACCEL || ramp->phase == RAMP_CRUISE) && step >= ramp->decel_at) {
+            enter_decel(ramp);
+        }
+    } else if (ramp->phase == RAMP_ACCEL) {
+        ramp->accel_steps = step;
+        if (2 * step >= ramp->total_steps) enter_decel(ramp);
+    } else if (ramp->phase == RAMP_CRUISE) {
+        if (step + ramp->accel_steps >= ramp->total_steps) enter_decel(ramp);
+    }
+
+    // Interval update for the next step
+    uint32_t p = ramp->p;
+    if (ramp->phase == RAMP_ACCEL) {
+        if (ramp->k_jerk) {
+            if (p > ramp->p_jerk_high) {
+                update_jerk(ramp, +1);
+                if (ramp->k == ramp->k_max && !ramp->ease_in_end) ramp->ease_in_end = step;
+            } else {
+                if (!ramp->ease_out_start) ramp->ease_out_start = step;
+                if (!ramp->ease_in_end) ramp->ease_in_end = step;
+                update_jerk(ramp, -1);
+                if (ramp->k == ramp->k_min && !ramp->ease_out_end) ramp->ease_out_end = step;
+            }
+        }
+        if (!ramp->k_jerk && ramp->p_start == ramp->p_rest && step < PLANNER_EXACT_STEPS) {
+            p = rest_step_interval(ramp, step); // Started from standstill
+        } else {
+            uint32_t q = ramp_q(p, ramp->k);
+            uint32_t q2 = ramp_q2(q);
+            p -= (uint32_t)(((uint64_t)p * (q - q2) + (1ull << 31)) >> 32); // Rounded: no drift over the ramp
+        }
+        if (p <= ramp->p_cruise) {
+            p = ramp->p_cruise;
+            ramp->phase = RAMP_CRUISE;
+        }
+    } else if (ramp->phase == RAMP_DECEL) {
+        if (ramp->k_jerk) {
+            // Replay the accel jerk schedule backwards: decel step d mirrors
+            // accel step m = accel_steps - d with the opposite k change.
+            uint32_t d = step - ramp->decel_start;
+            uint32_t m = d < ramp->accel_steps ? ramp->accel_steps - d : 0;
+            uint32_t ease_out_end = ramp->ease_out_end ? ramp->ease_out_end : UINT32_MAX;
+            uint32_t ease_out_start = ramp->ease_out_start ? ramp->ease_out_start : UINT32_MAX;
+            int direction;
+            if (m >= ease_out_end) direction = 0;           // accel held at k_min
+            else if (m >= ease_out_start) direction = +1;   // accel was easing out
+            else if (m >= ramp->ease_in_end) direction = 0; // accel held at k_max
+            else direction = -1;                            // accel was easing in
+            update_jerk(ramp, direction);
+        }
+        // The interval after pulse 'step' mirrors interval total - 2 - step
+        // of a ramp from standstill (the one after the last pulse is unused)
+        uint32_t left = ramp->total_steps - step;
+        if (!ramp->k_jerk && ramp->p_end == ramp->p_rest && left <= PLANNER_EXACT_STEPS + 1) {
+            p = left >= 2 ? rest_step_interval(ramp, left - 2) : ramp->p_end;
+        } else {
+            uint32_t q = ramp_q(p, ramp->k);
+            uint32_t q2 = ramp_q2(q);
+            uint64_t next = p + (((uint64_t)p * ((uint64_t)q + q2) + (1ull << 31)) >> 32);
+            p = next > ramp->p_end ? ramp->p_end : (uint32_t)next;
+        }
+    }
+    ramp->p = p;
+
+    return interval;
+}
+
+// --- Stop / Status ---
+void planner_request_stop(ramp_t *ramp) {
+    if (ramp->decel_at) {
+        // Segment: brake from the current speed to standstill
+        if (ramp->phase == RAMP_IDLE) return;
+        uint32_t stop_at = ramp->step + ramp_steps(planner_get_speed(ramp), 0, ramp->accel) + 1;
+        if (ramp->phase != RAMP_DECEL) ramp->decel_at = ramp->step + 1;
+        if (ramp->p_end != ramp->p_rest) {
+            // Was going to exit at speed: this may run past the end of the segment
+            ramp->p_end = ramp->p_rest;
+            ramp->total_steps = stop_at;
+        } else if (stop_at < ramp->total_steps) {
+            ramp->total_steps = stop_at;
+        }
+        return;
+    }
+
+    uint32_t stop_at = ramp->total_steps;
+    if (ramp->phase == RAMP_ACCEL) {
+        stop_at = 2 * ramp->step; // Triggers the decel transition on the next step
+    } else if (ramp->phase == RAMP_CRUISE) {
+        stop_at = ramp->step + ramp->accel_steps;
+    }
+    if (stop_at < ramp->total_steps) ramp->total_steps = stop_at;
+}
+
+uint32_t planner_get_speed(const ramp_t *ramp) {
+    if (ramp->phase == RAMP_IDLE || ramp->p == 0) return 0;
+    return (uint32_t)(F_TICKS_Q8 / ramp->p);
+}
@@ -0,0 +1,106 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "pico/stdlib.h"
+
+// --- Ramp Planner ---
+// Generates the step intervals of a move, one step at a time, for the PIO step
+// engine. Interval updates use Eiderman's multiplication-only recurrence,
+// with the second-order term of the exact ratio sqrt(n / (n + 1)):
+//     accel: p' = p * (1 - q + 3/2 q^2)      decel: p' = p * (1 + q + 3/2 q^2)
+//     q = a * p^2 / F^2
+// evaluated in fixed point, so there is no divide or float in the per-step
+// path (planner_next_interval() runs in the step engine IRQ).
+// Near standstill q is too large for the truncated series (the deceleration
+// would end its last steps far too fast), so on a trapezoidal ramp the first
+// and last PLANNER_EXACT_STEPS intervals come from the closed form instead:
+//     interval j from standstill = F / sqrt(2a) * (sqrt(4j + 6) - sqrt(4j + 2))
+// (pulse j at t = sqrt(2 (j + 1/2) / a)), with the square roots from a table.
+//
+// Profiles:
+//  - Trapezoidal: constant acceleration 'accel' up to 'max_speed'.
+//  - S-curve: acceleration ramps linearly in time from 0 to 'accel' over
+//    'jerk_time_ms' (jerk-limited), at both ends of the accel/decel phases.
+//  - Segment: trapezoid between an entry and an exit speed, so queued moves
+//    can be chained through a junction without stopping (see motor_control.c).
+
+#define PLANNER_P_FRAC_BITS  8  // Fractional bits of the interval (Q24.8 ticks)
+#define PLANNER_K_SHIFT      24 // q = (p^2 * k) >> PLANNER_K_SHIFT, Q0.32 result
+#define PLANNER_EXACT_STEPS  16 // Intervals next to standstill taken from the closed form
+
+typedef enum {
+    RAMP_IDLE = 0,
+    RAMP_ACCEL,
+    RAMP_CRUISE,
+    RAMP_DECEL,
+} ramp_phase_t;
+
+typedef struct {
+    // --- Plan (computed once per move, may use divides) ---
+    uint32_t total_steps;
+    uint32_t p_start;       // Slowest interval (start/end of move), Q24.8 ticks
+    uint32_t p_cruise;      // Interval at max speed, Q24.8 ticks
+    uint32_t k_max;         // Accel factor for 'accel': a * 2^56 / F^2
+    uint32_t k_min;         // S-curve: floor so the ramp always completes
+    uint32_t k_jerk;        // S-curve: k change per tick, Q16 (0 = trapezoidal)
+    uint32_t p_jerk_high;   // S-curve: start easing accel out below this interval
+    uint32_t p_rest;        // Interval of the first step from standstill: F / sqrt(2a)
+    uint32_t p_end;         // Interval to decelerate to (p_rest unless chained)
+    uint32_t accel;         // steps/sec^2
+    uint32_t peak_speed;    // Segment: highest speed reached (steps/sec)
+
+    // --- Runtime (updated per step) ---
+    volatile ramp_phase_t phase;
+    volatile uint32_t step;     // Steps emitted so far
+    volatile uint32_t p;        // Next interval, Q24.8 ticks
+    uint32_t k;                 // Current accel factor
+    uint32_t accel_steps;       // Steps spent accelerating (mirrored by decel)
+    uint32_t ease_in_end;       // S-curve: step where accel reached k_max
+    uint32_t ease_out_start;    // S-curve: step where accel started easing out
+    uint32_t ease_out_end;      // S-curve: step where accel reached k_min
+    uint32_t decel_start;       // Step where deceleration began
+    uint32_t decel_at;          // Segment: step to start decelerating (0 = mirror accel)
+    uint32_t frac;              // Carried fractional ticks
+} ramp_t;
+
+// --- Function Prototypes ---
+
+// Plan a move of 'steps' steps starting and ending at standstill.
+// accel == 0 runs the whole move at max_speed (no ramp).
+// jerk_time_ms == 0 selects the trapezoidal profile, otherwise S-curve.
+void planner_plan_move(ramp_t *ramp, uint32_t steps, uint32_t max_speed, uint32_t accel, uint32_t jerk_time_ms);
+
+// Plan one segment of a chained move: accelerate from 'entry_speed' towards
+// 'max_speed' and end at 'exit_speed' (0 = standstill). Trapezoidal only.
+// The caller guarantees the exit speed is reachable (see planner_max_entry_speed()).
+void planner_plan_segment(ramp_t *ramp, uint32_t steps, uint32_t entry_speed, uint32_t max_speed,
+                          uint32_t exit_speed, uint32_t accel);
+
+// Highest speed a segment can be entered with and still slow down to
+// 'exit_speed' within 'steps': sqrt(exit^2 + 2 * accel * steps)
+uint32_t planner_max_entry_speed(uint32_t steps, uint32_t accel, uint32_t exit_speed);
+
+// Highest exit speed a running segment can still be given (0 if none).
+uint32_t planner_exit_speed_limit(const ramp_t *ramp);
+
+// Let a running segment finish at 'exit_speed' instead of stopping, by moving
+// its deceleration point later. Fails (returns false, nothing changed) once
+// the segment is decelerating or if the speed is above planner_exit_speed_limit().
+// Must not race planner_next_interval() (call with interrupts disabled).
+bool planner_raise_exit_speed(ramp_t *ramp, uint32_t exit_speed);
+
+// Next step interval in step engine ticks, 0 once the move is complete.
+// Called from the step engine IRQ.
+uint32_t planner_next_interval(ramp_t *ramp);
+
+// Decelerate to a stop as soon as possible (mirrors the acceleration so far).
+// Must not race planner_next_interval() (call with interrupts disabled).
+void planner_request_stop(ramp_t *ramp);
+
+// Current speed in steps/sec (0 when idle). Uses a divide: not for the IRQ path.
+uint32_t planner_get_speed(const ramp_t *ramp);
+
+// floor(sqrt(value)), integer only
+uint64_t isqrt64(uint64_t value);
+
+#endif // PLANNER_H
@@ -0,0 +1,61 @@
+#include "reg_dirty.h"
+#include <string.h> // For memset
+
+_Static_assert(REG_DIRTY_TRACKED <= REGISTER_MAP_SIZE, "Tracked range must lie within the map");
+
+reg_dirty_t host_changes;
+
+void reg_dirty_clear(reg_dirty_t *set) {
+    memset(set->bits, 0, sizeof(set->bits));
+}
+
+void reg_dirty_mark(reg_dirty_t *set, uint16_t addr, uint16_t len) {
+    uint32_t end = (uint32_t)addr + len;
+    if (end > REG_DIRTY_TRACKED) end = REG_DIRTY_TRACKED;
+    for (uint32_t a = addr; a < end; a++) set->bits[a / 32] |= 1u << (a % 32);
+}
+
+void reg_dirty_mark_all(reg_dirty_t *set) {
+    reg_dirty_clear(set);
+    reg_dirty_mark(set, 0, REG_DIRTY_TRACKED);
+}
+
+bool reg_dirty_take(reg_dirty_t *set, uint16_t addr, uint16_t len) {
+    uint32_t end = (uint32_t)addr + len;
+    if (end > REG_DIRTY_TRACKED) end = REG_DIRTY_TRACKED;
+    bool any = false;
+    for (uint32_t a = addr; a < end; a++) {
+        uint32_t bit = 1u << (a % 32);
+        if (set->bits[a / 32] & bit) {
+            any = true;
+            set->bits[a / 32] &= ~bit;
+        }
+    }
+    return any;
+}
+
+// Word-wise scan: a quiet map costs REG_DIRTY_WORDS loads
+uint16_t reg_dirty_next(const reg_dirty_t *set, uint16_t from) {
+    if (from >= REG_DIRTY_TRACKED) return REG_DIRTY_TRACKED;
+    uint32_t word = from / 32;
+    uint32_t bits = set->bits[word] & (~0u << (from % 32));
+    while (1) {
+        if (bits) {
+            uint32_t addr = word * 32 + (uint32_t)__builtin_ctz(bits);
+            return addr < REG_DIRTY_TRACKED ? (uint16_t)addr : REG_DIRTY_TRACKED;
+        }
+        if (++word >= REG_DIRTY_WORDS) return REG_DIRTY_TRACKED;
+        bits = set->bits[word];
+    }
+}
+
+void reg_publish_u8(volatile uint8_t *registers, uint16_t addr, uint8_t value) {
+    if (registers[addr] == value) return;
+    registers[addr] = value;
+    reg_dirty_mark(&host_changes, addr, 1);
+}
+
+void reg_publish_u16(volatile uint8_t *registers, uint16_t addr, uint16_t value) {
+    reg_publish_u8(registers, addr, (uint8_t)value);
+    reg_publish_u8(registers, addr + 1, (uint8_t)(value >> 8));
+}
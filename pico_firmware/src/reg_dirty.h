@@ -0,0 +1,47 @@
+#ifndef REG_DIRTY_H
+#define REG_DIRTY_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Register Change Tracking ---
+// One bit per register address, set when the byte changes and cleared when
+// whoever consumes the changes has seen it. Two sets are kept:
+//  - core 1 marks the addresses of the forwarded WRITE frames it replays, so
+//    update_motor_control_from_registers() only acts on control registers
+//    the host actually wrote (see motor_control.c),
+//  - core 0 keeps host_changes: registers whose value the firmware changed
+//    since the host last fetched them with CMD_READ_CHANGES (status merged
+//    from core 1, TMC readback). Host writes are not marked: the host knows.
+// uart_protocol.c also uses a set for the bytes of a staged bulk write.
+// The diagnostics block is not tracked (its loop times change on every
+// publish), addresses from REG_DIRTY_TRACKED up are ignored.
+// A set belongs to one core and is not touched from IRQ handlers.
+
+#define REG_DIRTY_TRACKED   REG_DIAG_BASE
+#define REG_DIRTY_WORDS     ((REG_DIRTY_TRACKED + 31) / 32)
+
+typedef struct {
+    uint32_t bits[REG_DIRTY_WORDS];
+} reg_dirty_t;
+
+// Changes for CMD_READ_CHANGES (core 0)
+extern reg_dirty_t host_changes;
+
+// --- Function Prototypes ---
+
+void reg_dirty_clear(reg_dirty_t *set);
+void reg_dirty_mark(reg_dirty_t *set, uint16_t addr, uint16_t len);
+void reg_dirty_mark_all(reg_dirty_t *set);
+
+// True if any byte of [addr, addr + len) is marked; clears them
+bool reg_dirty_take(reg_dirty_t *set, uint16_t addr, uint16_t len);
+
+// First marked address at or after 'from', or REG_DIRTY_TRACKED if none
+uint16_t reg_dirty_next(const reg_dirty_t *set, uint16_t from);
+
+// Store 'value' and mark it in host_changes if it differs (core 0 status writers)
+void reg_publish_u8(volatile uint8_t *registers, uint16_t addr, uint8_t value);
+void reg_publish_u16(volatile uint8_t *registers, uint16_t addr, uint16_t value);
+
+#endif // REG_DIRTY_H
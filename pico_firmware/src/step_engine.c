@@ -0,0 +1,222 @@
+#include "step_engine.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "stepper.pio.h" // Generated by pico_generate_pio_header()
+#include "diagnostics.h"
+#include <stdio.h> // For debug printf
+#include <string.h> // For memset
+
+// --- Configuration ---
+#define STEP_ENGINE_PIO     pio0
+#define STEP_ENGINE_IRQ     PIO0_IRQ_0
+
+// --- Internal State ---
+typedef struct {
+    uint sm;                        // PIO state machine driving this axis
+    uint dir_pin;
+    volatile bool active;           // Source still providing intervals
+    bool primed;                    // FIFO filled since start: empty now means an underrun
+    step_interval_source_t source;
+    volatile uint32_t steps_pushed; // Pulses queued into the FIFO (same unit as PIO count)
+    uint32_t count_base;            // PIO pulse count at start of current direction
+    int32_t pos_base;               // Position at start of current direction
+    bool forward;
+} step_axis_t;
+
+static step_axis_t axes[STEP_ENGINE_MAX_AXES];
+static uint axis_count = 0;
+static uint program_offset = 0;
+
+// --- Helpers ---
+static inline uint32_t clamp_interval(uint32_t interval) {
+    if (interval < STEP_ENGINE_MIN_INTERVAL) return STEP_ENGINE_MIN_INTERVAL;
+    if (interval > STEP_ENGINE_MAX_INTERVAL) return STEP_ENGINE_MAX_INTERVAL;
+    return interval;
+}
+
+// Read the pulse counter (~Y) without disturbing the program. The forced
+// instructions add at most two PIO ticks to the interval in progress.
+static uint32_t read_pulse_count(const step_axis_t *axis) {
+    uint32_t saved_irq = save_and_disable_interrupts();
+    pio_sm_exec(STEP_ENGINE_PIO, axis->sm, pio_encode_mov_not(pio_isr, pio_y));
+    pio_sm_exec(STEP_ENGINE_PIO, axis->sm, pio_encode_push(false, false));
+    uint32_t count = pio_sm_get_blocking(STEP_ENGINE_PIO, axis->sm);
+    restore_interrupts(saved_irq);
+    return count;
+}
+
+// --- FIFO Refill (PIO IRQ) ---
+static void __not_in_flash_func(refill_fifo)(uint axis_id) {
+    step_axis_t *axis = &axes[axis_id];
+    while (!pio_sm_is_tx_fifo_full(STEP_ENGINE_PIO, axis->sm)) {
+        uint32_t interval = axis->source(axis_id);
+        if (interval == 0) {
+            // Move fully queued: stop requesting refills for this axis
+            axis->active = false;
+            pio_set_irq0_source_enabled(STEP_ENGINE_PIO, pis_sm0_tx_fifo_not_full + axis->sm, false);
+            break;
+        }
+        // FIFO word: (delay << 1) | pulse flag (see stepper.pio)
+        bool pulse = !(interval & STEP_INTERVAL_NO_PULSE);
+        uint32_t delay = clamp_interval(interval & ~STEP_INTERVAL_NO_PULSE) - STEP_ENGINE_OVERHEAD_TICKS;
+        pio_sm_put(STEP_ENGINE_PIO, axis->sm, (delay << 1) | (pulse ? 1u : 0u));
+        if (pulse) axis->steps_pushed++;
+    }
+}
+
+static void __not_in_flash_func(step_engine_irq_handler)(void) {
+    uint32_t start = diag_cycles();
+    bool fifo_was_empty = false;
+    for (uint i = 0; i < axis_count; i++) {
+        if (!axes[i].active) continue;
+        fifo_was_empty |= axes[i].primed && pio_sm_is_tx_fifo_empty(STEP_ENGINE_PIO, axes[i].sm);
+        refill_fifo(i);
+        axes[i].primed = true;
+    }
+    diag_record_step_irq(diag_cycles_since(start), fifo_was_empty);
+}
+
+// --- Initialization ---
+void init_step_engine(const uint *step_pins, const uint *dir_pins, uint count) {
+    if (count > STEP_ENGINE_MAX_AXES) count = STEP_ENGINE_MAX_AXES;
+    axis_count = count;
+    program_offset = pio_add_program(STEP_ENGINE_PIO, &stepper_program);
+    float clkdiv = (float)clock_get_hz(clk_sys) / STEP_ENGINE_TICK_HZ;
+
+    for (uint i = 0; i < count; i++) {
+        step_axis_t *axis = &axes[i];
+        memset(axis, 0, sizeof(*axis));
+        axis->sm = (uint)pio_claim_unused_sm(STEP_ENGINE_PIO, true);
+        axis->dir_pin = dir_pins[i];
+        axis->forward = true;
+
+        gpio_init(dir_pins[i]);
+        gpio_set_dir(dir_pins[i], GPIO_OUT);
+        gpio_put(dir_pins[i], 1);
+
+        pio_gpio_init(STEP_ENGINE_PIO, step_pins[i]);
+        pio_sm_set_consecutive_pindirs(STEP_ENGINE_PIO, axis->sm, step_pins[i], 1, true);
+
+        pio_sm_config c = stepper_program_get_default_config(program_offset);
+        sm_config_set_sideset_pins(&c, step_pins[i]);
+        sm_config_set_out_shift(&c, true, false, 32);
+        sm_config_set_clkdiv(&c, clkdiv);
+        pio_sm_init(STEP_ENGINE_PIO, axis->sm, program_offset, &c);
+
+        // Y = 0xFFFFFFFF so that ~Y reads back as the number of pulses emitted
+        pio_sm_exec(STEP_ENGINE_PIO, axis->sm, pio_encode_mov_not(pio_y, pio_null));
+        pio_sm_set_enabled(STEP_ENGINE_PIO, axis->sm, true);
+        printf("Step Engine: Axis %d on SM %d (STEP %d, DIR %d)\n", i, axis->sm, step_pins[i], dir_pins[i]);
+    }
+
+    irq_set_exclusive_handler(STEP_ENGINE_IRQ, step_engine_irq_handler);
+    irq_set_enabled(STEP_ENGINE_IRQ, true);
+}
+
+// --- Axis Control ---
+void step_engine_start(uint axis_id, bool forward, step_interval_source_t source) {
+    if (axis_id >= axis_count || source == NULL) return;
+    step_axis_t *axis = &axes[axis_id];
+
+    if (forward != axis->forward) {
+        // Rebase position so the pulse counter keeps counting in the new direction
+        axis->pos_base = step_engine_get_position(axis_id);
+        axis->count_base = read_pulse_count(axis);
+        axis->forward = forward;
+        gpio_put(axis->dir_pin, forward ? 1 : 0);
+    }
+
+    axis->source = source;
+    axis->primed = false;
+    axis->active = true;
+    // The TX-not-full interrupt fires immediately and primes the FIFO
+    pio_set_irq0_source_enabled(STEP_ENGINE_PIO, pis_sm0_tx_fifo_not_full + axis->sm, true);
+}
+
+void step_engine_start_synced(const uint *axis_ids, const bool *forward, step_interval_source_t source, uint count) {
+    if (source == NULL) return;
+    uint32_t sm_mask = 0;
+
+    // Hold the state machines (stalled on 'pull') while their FIFOs are primed
+    for (uint n = 0; n < count; n++) {
+        uint axis_id = axis_ids[n];
+        if (axis_id >= axis_count) continue;
+        step_axis_t *axis = &axes[axis_id];
+        pio_sm_set_enabled(STEP_ENGINE_PIO, axis->sm, false);
+        if (forward[n] != axis->forward) {
+            axis->pos_base = step_engine_get_position(axis_id);
+            axis->count_base = read_pulse_count(axis);
+            axis->forward = forward[n];
+            gpio_put(axis->dir_pin, forward[n] ? 1 : 0);
+        }
+        sm_mask |= 1u << axis->sm;
+    }
+
+    uint32_t saved_irq = save_and_disable_interrupts();
+    for (uint n = 0; n < count; n++) {
+        uint axis_id = axis_ids[n];
+        if (axis_id >= axis_count) continue;
+        axes[axis_id].source = source;
+        axes[axis_id].active = true;
+        refill_fifo(axis_id);
+        axes[axis_id].primed = true;
+    }
+    // Restarts the clock dividers too, so the axes tick in lockstep
+    pio_enable_sm_mask_in_sync(STEP_ENGINE_PIO, sm_mask);
+    for (uint n = 0; n < count; n++) {
+        uint axis_id = axis_ids[n];
+        if (axis_id >= axis_count || !axes[axis_id].active) continue;
+        pio_set_irq0_source_enabled(STEP_ENGINE_PIO, pis_sm0_tx_fifo_not_full + axes[axis_id].sm, true);
+    }
+    restore_interrupts(saved_irq);
+}
+
+void step_engine_stop(uint axis_id) {
+    if (axis_id >= axis_count) return;
+    step_axis_t *axis = &axes[axis_id];
+    uint32_t saved_irq = save_and_disable_interrupts();
+
+    axis->active = false;
+    pio_set_irq0_source_enabled(STEP_ENGINE_PIO, pis_sm0_tx_fifo_not_full + axis->sm, false);
+
+    // Discard queued intervals and restart at the pull, forcing STEP low.
+    // X/Y survive the restart, so the pulse count stays valid.
+    pio_sm_set_enabled(STEP_ENGINE_PIO, axis->sm, false);
+    pio_sm_clear_fifos(STEP_ENGINE_PIO, axis->sm);
+    pio_sm_restart(STEP_ENGINE_PIO, axis->sm);
+    pio_sm_exec(STEP_ENGINE_PIO, axis->sm, pio_encode_nop() | pio_encode_sideset_opt(1, 0));
+    pio_sm_exec(STEP_ENGINE_PIO, axis->sm, pio_encode_jmp(program_offset));
+    pio_sm_set_enabled(STEP_ENGINE_PIO, axis->sm, true);
+
+    axis->steps_pushed = read_pulse_count(axis);
+    restore_interrupts(saved_irq);
+}
+
+bool step_engine_is_busy(uint axis_id) {
+    if (axis_id >= axis_count) return false;
+    const step_axis_t *axis = &axes[axis_id];
+    if (axis->active) return true;
+    return read_pulse_count(axis) != axis->steps_pushed;
+}
+
+// --- Position ---
+int32_t step_engine_get_position(uint axis_id) {
+    if (axis_id >= axis_count) return 0;
+    const step_axis_t *axis = &axes[axis_id];
+    int32_t delta = (int32_t)(read_pulse_count(axis) - axis->count_base);
+    return axis->forward ? axis->pos_base + delta : axis->pos_base - delta;
+}
+
+bool step_engine_get_direction(uint axis_id) {
+    if (axis_id >= axis_count) return true;
+    return axes[axis_id].forward;
+}
+
+void step_engine_set_position(uint axis_id, int32_t position) {
+    if (axis_id >= axis_count) return;
+    step_axis_t *axis = &axes[axis_id];
+    axis->pos_base = position;
+    axis->count_base = read_pulse_count(axis);
+}
@@ -0,0 +1,63 @@
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include "pico/stdlib.h"
+
+// --- PIO Step Engine ---
+// One PIO state machine per motor generates the STEP pulses. The CPU only
+// refills the TX FIFO with step intervals from the PIO IRQ, so the pulse
+// timing is independent of how long the main loop takes.
+
+// PIO state machine clock. All step intervals are expressed in these ticks.
+#define STEP_ENGINE_TICK_HZ         10000000u // 10 MHz -> 0.1us resolution
+
+// Fixed PIO cycles spent per step outside the delay loop (see stepper.pio)
+#define STEP_ENGINE_OVERHEAD_TICKS  13u
+
+// Shortest/longest interval accepted (shorter/longer values are clamped)
+#define STEP_ENGINE_MIN_INTERVAL    STEP_ENGINE_OVERHEAD_TICKS
+#define STEP_ENGINE_MAX_INTERVAL    (STEP_ENGINE_TICK_HZ * 10u) // 10 s per step
+
+#define STEP_ENGINE_MAX_AXES        4   // One PIO block has 4 state machines
+
+// OR'd into an interval returned by a source: wait for the interval without
+// emitting a STEP pulse. Lets a source split a long interval into bounded
+// pieces of work (see the coordinated moves in motor_control.c).
+#define STEP_INTERVAL_NO_PULSE      (1u << 31)
+
+// Callback providing the next step interval (in ticks) for an axis.
+// Called from the PIO IRQ whenever the FIFO has room; return 0 when the move
+// has no more steps. Must be fast and must not block.
+typedef uint32_t (*step_interval_source_t)(uint axis);
+
+// --- Function Prototypes ---
+
+// Load the PIO program and claim one state machine per axis.
+// step_pins/dir_pins: arrays of 'count' GPIO numbers
+void init_step_engine(const uint *step_pins, const uint *dir_pins, uint count);
+
+// Start feeding steps for an axis in the given direction.
+// The axis must be idle (direction is only changed between moves).
+void step_engine_start(uint axis, bool forward, step_interval_source_t source);
+
+// Start several idle axes on the same PIO clock edge. FIFOs are primed before
+// the state machines are enabled together, so their step timelines line up.
+void step_engine_start_synced(const uint *axis_ids, const bool *forward, step_interval_source_t source, uint count);
+
+// Halt an axis immediately: pending intervals are discarded and the
+// STEP pin is forced low. The position stays exact (only emitted pulses count).
+void step_engine_stop(uint axis);
+
+// True while the axis still has steps queued or pending from its source
+bool step_engine_is_busy(uint axis);
+
+// Current position in steps, derived from the pulse count read back from PIO
+int32_t step_engine_get_position(uint axis);
+
+// Direction of the current (or last) move: true = forward (positive)
+bool step_engine_get_direction(uint axis);
+
+// Redefine the current position (e.g., after homing). Axis must be idle.
+void step_engine_set_position(uint axis, int32_t position);
+
+#endif // STEP_ENGINE_H
@@ -1,88 +1,165 @@
 #include "switches.h"
+#include "motor_control.h" // NUM_MOTORS
+#include "step_engine.h"
 #include "pico/stdlib.h" // Includes stdint.h types
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
 
-// --- Debouncing Parameters ---
-#define DEBOUNCE_DELAY_US 5000 // 5ms debounce time (adjust as needed)
-
-// --- Internal State for Debouncing ---
+// --- Internal State ---
 typedef struct {
     uint32_t pin;           // Use uint32_t for the pin number
-    bool raw_state;         // Current unfiltered reading
-    bool debounced_state;   // Stable state after debouncing
-    bool changed;           // Flag if debounced_state changed
-    uint32_t last_change_time; // Time of last potential change
-} switch_debounce_t;
+    uint8_t integrator;     // 0 = released ... SWITCH_INTEGRATOR_MAX = pressed
+    bool pressed;           // Debounced state
+    volatile bool settling; // Edge seen, integrator running
+
+    // Edge latch (written by the IRQ)
+    volatile bool latch_armed;      // Next press edge is latched (re-armed on release)
+    volatile bool latched;          // New latch not yet copied to the registers
+    volatile uint64_t latch_time_us;
+    volatile int32_t latch_pos;
+    volatile bool hard_stop;        // IRQ halted the axis, see switches_take_hard_stop()
+    bool stop_forward;              // Direction in which the axis runs into the switch
+} switch_state_t;
+
+static switch_state_t switch_state[NUM_MOTORS];
+static endstop_hook_t endstop_hook = NULL;
+static uint32_t last_sample_time = 0;
+static bool status_published = false;
+
+// --- Edge Interrupt ---
+// Shares the default IRQ priority with the step engine, so a PIO FIFO refill
+// is never interrupted halfway by the stop.
+static void __not_in_flash_func(switch_edge)(uint i) {
+    switch_state_t *sw = &switch_state[i];
+    uint32_t events = gpio_get_irq_event_mask(sw->pin) & (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE);
+    if (!events) return;
+    gpio_acknowledge_irq(sw->pin, events);
+    sw->settling = true;
 
-static switch_debounce_t switch_state[2];
+    // Active LOW: a falling edge is a press. Only the first edge of a bounce
+    // burst is the trigger point.
+    if (!(events & GPIO_IRQ_EDGE_FALL) || !sw->latch_armed) return;
+    sw->latch_armed = false;
+    sw->latch_time_us = time_us_64();
+    sw->latch_pos = step_engine_get_position(i);
+    if (step_engine_is_busy(i) && step_engine_get_direction(i) == sw->stop_forward) {
+        step_engine_stop(i);
+        sw->hard_stop = true;
+    }
+    sw->latched = true;
+    if (endstop_hook) endstop_hook(i);
+}
+
+static void __not_in_flash_func(switches_irq_handler)(void) {
+    for (uint i = 0; i < NUM_MOTORS; i++) switch_edge(i);
+}
 
 // --- Initialization ---
-// Use uint32_t for pin numbers
-void init_switches(uint32_t sw1_pin, uint32_t sw2_pin) {
-    // Switch 1
-    gpio_init(sw1_pin);
-    gpio_set_dir(sw1_pin, GPIO_IN);
-    gpio_pull_up(sw1_pin); // Enable internal pull-up (assumes switches connect pin to GND)
-    switch_state[0].pin = sw1_pin; // Store uint32_t
-    switch_state[0].raw_state = gpio_get(sw1_pin);
-    switch_state[0].debounced_state = switch_state[0].raw_state;
-    switch_state[0].changed = false;
-    switch_state[0].last_change_time = time_us_32();
-
-    // Switch 2
-    gpio_init(sw2_pin);
-    gpio_set_dir(sw2_pin, GPIO_IN);
-    gpio_pull_up(sw2_pin);
-    switch_state[1].pin = sw2_pin; // Store uint32_t
-    switch_state[1].raw_state = gpio_get(sw2_pin);
-    switch_state[1].debounced_state = switch_state[1].raw_state;
-    switch_state[1].changed = false;
-    switch_state[1].last_change_time = time_us_32();
+void init_switches(const uint *pins) {
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        switch_state_t *sw = &switch_state[i];
+        gpio_init(pins[i]);
+        gpio_set_dir(pins[i], GPIO_IN);
+        gpio_pull_up(pins[i]); // Enable internal pull-up (assumes switches connect pin to GND)
+        sw->pin = pins[i]; // Store uint32_t
+        sw->pressed = !gpio_get(pins[i]);
+        sw->integrator = sw->pressed ? SWITCH_INTEGRATOR_MAX : 0;
+        sw->settling = false;
+        sw->latch_armed = !sw->pressed;
+        sw->latched = false;
+        sw->hard_stop = false;
+        sw->stop_forward = false; // Home towards negative until HOMING_CONFIG says otherwise
+
+        gpio_add_raw_irq_handler(pins[i], switches_irq_handler);
+        gpio_set_irq_enabled(pins[i], GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
+    }
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    last_sample_time = time_us_32();
+}
+
+void switches_set_endstop_hook(endstop_hook_t hook) {
+    endstop_hook = hook;
+}
+
+bool switches_take_hard_stop(uint motor) {
+    if (motor >= NUM_MOTORS || !switch_state[motor].hard_stop) return false;
+    switch_state[motor].hard_stop = false;
+    return true;
+}
+
+bool switches_blocks_move(uint motor, bool forward) {
+    if (motor >= NUM_MOTORS) return false;
+    const switch_state_t *sw = &switch_state[motor];
+    return forward == sw->stop_forward && (sw->pressed || !gpio_get(sw->pin));
+}
+
+bool switches_settling(void) {
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        if (switch_state[i].settling) return true;
+    }
+    return false;
 }
 
-// --- Update and Debounce Switches ---
-// Use uint32_t for pin numbers (though they are not used directly here, use stored values)
-void update_switch_status_registers(volatile uint8_t *registers, uint32_t sw1_pin, uint32_t sw2_pin) {
+// --- Debounce and Update Registers ---
+void update_switch_status_registers(volatile uint8_t *registers) {
+    bool needs_register_update = !status_published; // States read at init
+    bool settling = false;
+
+    for (uint i = 0; i < NUM_MOTORS; i++) {
+        switch_state_t *sw = &switch_state[i];
+        sw->stop_forward = (registers[REG_MOTOR_HOMING_CONFIG(i)] & 0x01) != 0;
+        settling |= sw->settling;
+
+        if (sw->latched) {
+            sw->latched = false;
+            WRITE_U32_REGISTER(registers, REG_MOTOR_ENDSTOP_POS_L(i), sw->latch_pos);
+            WRITE_U32_REGISTER(registers, REG_MOTOR_ENDSTOP_TIME_L(i), (uint32_t)sw->latch_time_us);
+        }
+    }
+
+    // Integrators only run while a switch is settling after an edge
     uint32_t now = time_us_32();
-    bool needs_register_update = false;
-
-    for (int i = 0; i < 2; i++) {
-        bool current_reading = gpio_get(switch_state[i].pin); // Use stored pin number
-
-        if (current_reading != switch_state[i].raw_state) {
-            // State differs from last reading, reset debounce timer
-            switch_state[i].raw_state = current_reading;
-            switch_state[i].last_change_time = now;
-            switch_state[i].changed = false; // Not stable yet
-        } else {
-            // State is the same as last reading
-            if (!switch_state[i].changed && (now - switch_state[i].last_change_time > DEBOUNCE_DELAY_US)) {
-                // State has been stable for longer than debounce delay
-                if (current_reading != switch_state[i].debounced_state) {
-                    // Stable state is different from the last known stable state
-                    switch_state[i].debounced_state = current_reading;
-                    switch_state[i].changed = true; // Mark that a stable change occurred
-                    needs_register_update = true; // Signal that the register needs updating
-                }
+    bool sample = settling && now - last_sample_time >= SWITCH_SAMPLE_US;
+    if (sample) last_sample_time = now;
+
+    for (uint i = 0; i < NUM_MOTORS && sample; i++) {
+        switch_state_t *sw = &switch_state[i];
+        if (!sw->settling) continue;
+
+        bool reading = !gpio_get(sw->pin); // Pressed reads LOW
+        if (reading && sw->integrator < SWITCH_INTEGRATOR_MAX) sw->integrator++;
+        if (!reading && sw->integrator > 0) sw->integrator--;
+
+        if (sw->integrator == SWITCH_INTEGRATOR_MAX && !sw->pressed) {
+            sw->pressed = true;
+            needs_register_update = true;
+        } else if (sw->integrator == 0 && sw->pressed) {
+            sw->pressed = false;
+            needs_register_update = true;
+        }
+
+        // Settled once the integrator is saturated in the direction of the pin.
+        // The flag is cleared before the final check, so an edge arriving in
+        // between starts another round instead of being lost.
+        if ((sw->integrator == SWITCH_INTEGRATOR_MAX && reading) || (sw->integrator == 0 && !reading)) {
+            sw->settling = false;
+            if (!gpio_get(sw->pin) != reading) {
+                sw->settling = true;
+            } else if (!reading) {
+                // Settled released (even if a short press never debounced,
+                // e.g. homing backing straight off): the next press is a new trigger
+                sw->latch_armed = true;
             }
         }
-         // After debounce time passes, changed remains true until next change starts
-         if (now - switch_state[i].last_change_time <= DEBOUNCE_DELAY_US) {
-              switch_state[i].changed = false; // Clear changed flag during debounce period
-         }
     }
 
     // --- Update Register if any debounced state changed ---
-    // Only update register if a stable change was detected to avoid constant volatile writes
     if (needs_register_update) {
         uint8_t status_byte = 0;
-        // Remember: gpio_get reads 1 if high (not pressed with pull-up), 0 if low (pressed)
-        if (!switch_state[0].debounced_state) { // Bit 0 for Switch 1 pressed (LOW)
-            status_byte |= (1 << 0);
-        }
-        if (!switch_state[1].debounced_state) { // Bit 1 for Switch 2 pressed (LOW)
-            status_byte |= (1 << 1);
+        for (uint i = 0; i < NUM_MOTORS; i++) {
+            if (switch_state[i].pressed) status_byte |= (1 << i); // Bit n for the switch of axis n pressed (LOW)
         }
         registers[REG_SWITCH_STATUS] = status_byte; // Perform volatile write
+        status_published = true;
     }
 }
@@ -4,14 +4,46 @@
 #include "registers.h" // Includes stdint.h via pico/stdlib.h -> pico/types.h likely
 #include "pico/stdlib.h" // Ensure stdint types are available
 
+// --- Endstops ---
+// Switch N is the endstop of motor N, at the home end of its travel (the
+// direction given by REG_MOTOR_HOMING_CONFIG bit 0). Both edges raise a GPIO
+// interrupt (core 1). The first press edge after a release:
+//  - latches time_us_64() and the step engine position into
+//    REG_MOTOR_ENDSTOP_TIME / REG_MOTOR_ENDSTOP_POS, and
+//  - halts the step engine on the spot if the axis is moving towards the
+//    switch (hard stop, flagged in REG_ERROR_FLAGS unless homing ran the axis).
+// Debouncing is an integrator sampled every SWITCH_SAMPLE_US, only while a
+// switch is settling after an edge; a quiet switch costs nothing per loop.
+
+#define SWITCH_SAMPLE_US        1000 // Integrator sample period while settling
+#define SWITCH_INTEGRATOR_MAX   5    // Agreeing samples needed to change state (~5 ms)
+
+// Called from the GPIO IRQ for every latched press (after the hard stop, if any)
+typedef void (*endstop_hook_t)(uint motor);
+
 // --- Function Prototypes ---
 
-// Initialize GPIO pins for switches with pull-ups
-// Use uint32_t for pin numbers, consistent with Pico SDK GPIO functions
-void init_switches(uint32_t sw1_pin, uint32_t sw2_pin);
+// Initialize GPIO pins for switches with pull-ups and enable their edge IRQs
+// pins: one per axis (NUM_MOTORS), switch N + 1 is the endstop of axis N
+void init_switches(const uint *pins);
+
+// Run the debounce integrators (while settling), update the switch status
+// register and the endstop latch registers
+void update_switch_status_registers(volatile uint8_t *registers);
+
+// Subscribe to endstop presses (homing). One hook; NULL removes it.
+void switches_set_endstop_hook(endstop_hook_t hook);
+
+// True once after the IRQ hard-stopped 'motor' (the caller cleans up the move)
+bool switches_take_hard_stop(uint motor);
+
+// True if 'motor' sits on its pressed endstop (debounced, or already low on
+// the pin) and a move in direction 'forward' would run further into it. No
+// press edge comes (at boot, after a hard stop), so the IRQ would not stop it.
+bool switches_blocks_move(uint motor, bool forward);
 
-// Read switch states (with debouncing) and update the switch status register
-// Use uint32_t for pin numbers
-void update_switch_status_registers(volatile uint8_t *registers, uint32_t sw1_pin, uint32_t sw2_pin);
+// True while a debounce integrator runs (update_switch_status_registers()
+// must then be called every SWITCH_SAMPLE_US)
+bool switches_settling(void);
 
 #endif // SWITCHES_H
@@ -0,0 +1,74 @@
+#include "telemetry.h"
+#include "uart_protocol.h"
+#include <string.h> // For memcmp
+
+_Static_assert(TELEMETRY_FRAME_MARKER >= REG_SHORT_ADDR_LIMIT,
+               "Telemetry marker must not collide with a short register address");
+
+// --- Internal State ---
+static uint8_t last_payload[TELEMETRY_PAYLOAD_LEN];
+static uint32_t last_send_time = 0; // time_us_32() of the last frame
+static bool have_sent = false;
+
+// --- Helpers ---
+static void build_payload(volatile uint8_t *registers, uint8_t *payload) {
+    size_t pos = 0;
+    payload[pos++] = registers[REG_STATUS];
+    payload[pos++] = registers[REG_SWITCH_STATUS];
+    payload[pos++] = registers[REG_ERROR_FLAGS];
+    for (uint m = 0; m < REG_NUM_AXES; m++) {
+        for (int i = 0; i < 4; i++) payload[pos++] = registers[REG_MOTOR_CURRENT_POS_L(m) + i];
+    }
+    for (uint m = 0; m < REG_NUM_AXES; m++) {
+        for (int i = 0; i < 2; i++) payload[pos++] = registers[REG_MOTOR_CURRENT_SPEED_L(m) + i];
+    }
+}
+
+static bool send_frame(const uint8_t *payload) {
+    uint8_t frame[2 + TELEMETRY_PAYLOAD_LEN];
+    frame[0] = TELEMETRY_FRAME_MARKER;
+    frame[1] = TELEMETRY_PAYLOAD_LEN;
+    memcpy(&frame[2], payload, TELEMETRY_PAYLOAD_LEN);
+    // Frames are queued whole, so they never interleave with a command response
+    return uart_send_frame(frame, sizeof(frame)); // Adds the checksum (or CRC envelope)
+}
+
+// --- Initialization ---
+void init_telemetry(volatile uint8_t *registers) {
+    registers[REG_TELEMETRY_CONTROL] = 0;
+    WRITE_U16_REGISTER(registers, REG_TELEMETRY_PERIOD_L, TELEMETRY_DEFAULT_PERIOD_MS);
+    have_sent = false;
+}
+
+// --- Update ---
+void update_telemetry(volatile uint8_t *registers) {
+    uint8_t control = registers[REG_TELEMETRY_CONTROL];
+    if (!(control & (TELEMETRY_CTRL_PERIODIC | TELEMETRY_CTRL_ON_CHANGE))) {
+        have_sent = false;
+        return;
+    }
+
+    uint32_t now = time_us_32();
+    uint32_t elapsed = now - last_send_time;
+    uint32_t period_us = (uint32_t)READ_U16_REGISTER(registers, REG_TELEMETRY_PERIOD_L) * 1000;
+
+    uint8_t payload[TELEMETRY_PAYLOAD_LEN];
+    build_payload(registers, payload);
+
+    bool send = !have_sent;
+    if ((control & TELEMETRY_CTRL_PERIODIC) && period_us > 0 && elapsed >= period_us) {
+        send = true;
+    }
+    if ((control & TELEMETRY_CTRL_ON_CHANGE) && elapsed >= TELEMETRY_MIN_GAP_US &&
+        memcmp(payload, last_payload, TELEMETRY_PAYLOAD_LEN) != 0) {
+        send = true;
+    }
+    if (!send) return;
+
+    // If the TX queue is full, keep the old state and retry on the next pass
+    if (send_frame(payload)) {
+        memcpy(last_payload, payload, TELEMETRY_PAYLOAD_LEN);
+        last_send_time = now;
+        have_sent = true;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "registers.h"
+#include "pico/stdlib.h"
+
+// --- Telemetry Push ---
+// When enabled through REG_TELEMETRY_CONTROL, the Pico sends status frames on
+// its own instead of waiting to be polled:
+// Pico -> Master: [TELEMETRY_FRAME_MARKER] [LEN] [STATUS] [SWITCHES] [ERRORS]
+//                 [M1_POS (4)] ... [Mn_POS (4)] [M1_SPEED (2)] ... [Mn_SPEED (2)] [CHECKSUM]
+// with n = NUM_MOTORS (STEPPER_NUM_AXES; 15 payload bytes for 2 axes).
+// Multi-byte fields are little endian, the checksum is the XOR of all
+// preceding bytes. The marker is never a valid register address, so the master
+// can tell a telemetry frame from a command response by its first byte
+// (addresses from 0xFC up only appear in the 16-bit address form).
+// Once the master uses the framed protocol, the same bytes (minus the checksum)
+// arrive as the BODY of a CRC-16 frame, see uart_protocol.h.
+
+#define TELEMETRY_FRAME_MARKER      0xFE
+#define TELEMETRY_PAYLOAD_LEN       (3 + 6 * REG_NUM_AXES)
+
+// REG_TELEMETRY_CONTROL bits
+#define TELEMETRY_CTRL_PERIODIC     (1u << 0)
+#define TELEMETRY_CTRL_ON_CHANGE    (1u << 1)
+
+#define TELEMETRY_DEFAULT_PERIOD_MS 100
+#define TELEMETRY_MIN_GAP_US        10000 // Rate limit for on-change frames
+
+// --- Function Prototypes ---
+
+// Reset telemetry state and the control registers (push disabled)
+void init_telemetry(volatile uint8_t *registers);
+
+// Send a frame if the period elapsed or the status changed (per the control
+// register). Call from the main loop after the status registers are updated.
+void update_telemetry(volatile uint8_t *registers);
+
+#endif // TELEMETRY_H
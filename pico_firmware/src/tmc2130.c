@@ -1,40 +1,245 @@
 #include "tmc2130.h"
+#include "homing.h" // StallGuard homing states
+#include "diagnostics.h" // SPI transaction time
+#include "event_log.h"
+#include "reg_dirty.h" // Readback goes through reg_publish_*()
+#include "driver_monitor.h" // STALL_RECOVERY_*
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include <stdio.h> // For debug printf
+#include <string.h> // For memset/memcmp
+
+#define DATAGRAM_LEN 5  // 1 byte address/status + 4 bytes data
+#define TMC_NO_READ  0xFF
 
 // Store SPI instance and CS pins globally or pass them around
 static spi_inst_t* spi_instance;
-static uint cs_pins[2]; // cs_pins[0] for driver 1, cs_pins[1] for driver 2
+static uint cs_pins[TMC_MAX_DRIVERS]; // cs_pins[d] for driver d + 1 (all CS1 on the daisy chain)
+static const bool daisy_chain = TMC_DAISY_CHAIN;
 
-// --- Helper for SPI transaction ---
-static void tmc_spi_transfer(uint driver_id, uint8_t* data_tx, uint8_t* data_rx, size_t len) {
-    if (driver_id >= 2) return; // Invalid driver ID
+// Register whose data each driver returns with its next response
+static uint8_t pending_read[TMC_MAX_DRIVERS];
+
+// --- Async (DMA) Transfers ---
+static int dma_tx_chan = -1;
+static int dma_rx_chan = -1;
+static uint8_t async_tx[TMC_MAX_DRIVERS * DATAGRAM_LEN];
+static uint8_t async_rx[TMC_MAX_DRIVERS * DATAGRAM_LEN];
+static volatile bool async_busy = false;
+static volatile bool scan_done = false;
+static volatile uint async_driver = 0;   // Separate CS: driver being transferred
+
+// --- Register Shadow ---
+static const struct { uint8_t addr; bool readable; } shadow_regs[] = {
+    { TMC_REG_GCONF,      true  },
+    { TMC_REG_IHOLD_IRUN, false },
+    { TMC_REG_TPOWERDOWN, false },
+    { TMC_REG_TPWMTHRS,   false },
+    { TMC_REG_TCOOLTHRS,  false },
+    { TMC_REG_THIGH,      false },
+    { TMC_REG_CHOPCONF,   true  },
+    { TMC_REG_COOLCONF,   false },
+    { TMC_REG_PWMCONF,    false },
+};
+#define SHADOW_COUNT (sizeof(shadow_regs) / sizeof(shadow_regs[0]))
+
+typedef struct {
+    uint32_t value[SHADOW_COUNT];
+    uint16_t valid;     // Bit per register: value is known
+    uint16_t dirty;     // Bit per register: value not yet sent
+} tmc_shadow_t;
+
+static tmc_shadow_t shadow[TMC_MAX_DRIVERS];
+
+// Register-level settings of one driver (compared as a whole to spot changes)
+typedef struct {
+    uint16_t config;            // REG_MOTOR_CONFIG
+    uint16_t mode_control;      // REG_MOTOR_DRIVER_MODE_CONTROL
+    uint16_t stealth_max_speed;
+    uint16_t coolstep_min_speed;
+    uint16_t coolstep_config;
+    int16_t stall_sgt;          // StallGuard homing SGT, or TMC_STALL_OFF
+    int16_t detect_sgt;         // Stall detection SGT while moving (REG_MOTOR_STALL_RECOVERY), or TMC_STALL_OFF
+} tmc_settings_t;
+
+static tmc_settings_t applied[TMC_MAX_DRIVERS]; // Last settings applied
+
+// Base values of the fields REG_MOTOR_CONFIG doesn't cover
+#define CHOPCONF_BASE   ((3u << 0) | (4u << 4) | (1u << 7) | (2u << 20) | (0u << 14)) // TOFF=3, HSTRT=4, HEND=1, TBL=2, CHM=0 (SpreadCycle)
+#define IHOLDDELAY_BASE (4u << 16)
+#define TPOWERDOWN_BASE 20      // ~0.5 sec delay before power down
+
+#define TMC_STALL_OFF   0x7FFF  // StallGuard homing not running (SGT is -64..63)
+#define GCONF_EN_PWM_MODE   (1u << 2)
+#define GCONF_DIAG1_STALL   (1u << 8)
+#define TCOOLTHRS_MAX   0xFFFFF // StallGuard output at every velocity
+
+static int shadow_index(uint8_t reg_addr) {
+    for (uint i = 0; i < SHADOW_COUNT; i++) {
+        if (shadow_regs[i].addr == reg_addr) return (int)i;
+    }
+    return -1;
+}
 
-    // Assert CS
-    gpio_put(cs_pins[driver_id], 0);
-    sleep_us(2); // Small delay after CS assert might be needed
+// --- DRV_STATUS Monitor ---
+static uint32_t drv_status[TMC_MAX_DRIVERS];
+static bool drv_status_valid[TMC_MAX_DRIVERS];
+static uint16_t mscnt[TMC_MAX_DRIVERS];
+static uint32_t mscnt_time[TMC_MAX_DRIVERS];
+static bool mscnt_valid[TMC_MAX_DRIVERS];
+static uint8_t scan_reg[TMC_MAX_DRIVERS];       // Register the response of this scan carries
+static uint32_t scan_reg_time[TMC_MAX_DRIVERS]; // When it was requested
+static uint32_t request_time[TMC_MAX_DRIVERS];  // Time of the last scan request
+static uint32_t last_scan_time = 0;
+static uint32_t scan_count = 0;
 
-    // Perform SPI transfer
+// --- Datagram Helpers ---
+static void pack_datagram(uint8_t *buf, uint8_t addr_byte, uint32_t value) {
+    buf[0] = addr_byte;
+    // Data bytes (MSB first)
+    buf[1] = (value >> 24) & 0xFF;
+    buf[2] = (value >> 16) & 0xFF;
+    buf[3] = (value >> 8) & 0xFF;
+    buf[4] = value & 0xFF;
+}
+
+static uint32_t unpack_value(const uint8_t *buf) {
+    // The status byte is in buf[0], data is in buf[1..4]
+    return ((uint32_t)buf[1] << 24) |
+           ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 8)  |
+           ((uint32_t)buf[4]);
+}
+
+// Offset of a driver's datagram in a daisy-chain frame. The first datagram
+// shifted in travels furthest, to the last driver, and the last driver's
+// response comes out first.
+static inline size_t chain_offset(uint driver_id) {
+    return (TMC_MAX_DRIVERS - 1 - driver_id) * DATAGRAM_LEN;
+}
+
+// Read address that keeps a driver's pipeline as it is
+static inline uint8_t idle_read(uint driver_id) {
+    return pending_read[driver_id] == TMC_NO_READ ? TMC_REG_GCONF : pending_read[driver_id];
+}
+
+static void wait_async_idle(void) {
+    while (async_busy) tight_loop_contents();
+}
+
+// --- Helper for SPI transaction ---
+static void tmc_spi_transfer(uint cs_pin, uint8_t* data_tx, uint8_t* data_rx, size_t len) {
+    uint32_t start = diag_cycles();
+    gpio_put(cs_pin, 0); // Assert CS
     spi_write_read_blocking(spi_instance, data_tx, data_rx, len);
+    gpio_put(cs_pin, 1); // Deassert CS
+    diag_record_spi(diag_cycles_since(start));
+    busy_wait_us_32(TMC_CS_HIGH_US);
+}
+
+// Send one datagram to a driver and return the data of its response (the
+// register read by the previous datagram).
+static uint32_t tmc_exchange(uint driver_id, uint8_t addr_byte, uint32_t value) {
+    uint8_t data_tx[TMC_MAX_DRIVERS * DATAGRAM_LEN];
+    uint8_t data_rx[TMC_MAX_DRIVERS * DATAGRAM_LEN];
+    uint32_t result;
+
+    wait_async_idle();
+    if (daisy_chain) {
+        for (uint d = 0; d < TMC_MAX_DRIVERS; d++) {
+            if (d == driver_id) {
+                pack_datagram(&data_tx[chain_offset(d)], addr_byte, value);
+            } else {
+                pending_read[d] = idle_read(d);
+                pack_datagram(&data_tx[chain_offset(d)], pending_read[d], 0);
+            }
+        }
+        tmc_spi_transfer(cs_pins[0], data_tx, data_rx, sizeof(data_tx));
+        result = unpack_value(&data_rx[chain_offset(driver_id)]);
+    } else {
+        pack_datagram(data_tx, addr_byte, value);
+        tmc_spi_transfer(cs_pins[driver_id], data_tx, data_rx, DATAGRAM_LEN);
+        result = unpack_value(data_rx);
+    }
+    pending_read[driver_id] = (addr_byte & 0x80) ? TMC_NO_READ : addr_byte;
+    return result;
+}
+
+// --- SPI DMA ---
+static void start_async_transfer(uint cs_pin, const uint8_t *tx, uint8_t *rx, uint len) {
+    gpio_put(cs_pin, 0);
+    dma_channel_set_read_addr(dma_tx_chan, tx, false);
+    dma_channel_set_trans_count(dma_tx_chan, len, false);
+    dma_channel_set_write_addr(dma_rx_chan, rx, false);
+    dma_channel_set_trans_count(dma_rx_chan, len, false);
+    dma_start_channel_mask((1u << dma_tx_chan) | (1u << dma_rx_chan));
+}
+
+// RX completion: the last byte has been clocked in, so the datagram is done
+static void __not_in_flash_func(tmc_dma_irq_handler)(void) {
+    if (dma_rx_chan < 0 || !dma_channel_get_irq0_status(dma_rx_chan)) return;
+    dma_channel_acknowledge_irq0(dma_rx_chan);
+
+    if (daisy_chain) {
+        gpio_put(cs_pins[0], 1);
+    } else {
+        gpio_put(cs_pins[async_driver], 1);
+        if (++async_driver < TMC_MAX_DRIVERS) {
+            uint d = async_driver;
+            start_async_transfer(cs_pins[d], &async_tx[d * DATAGRAM_LEN], &async_rx[d * DATAGRAM_LEN], DATAGRAM_LEN);
+            return;
+        }
+    }
+    async_busy = false;
+    scan_done = true;
+}
+
+static void init_spi_dma(void) {
+    dma_tx_chan = dma_claim_unused_channel(true);
+    dma_channel_config tx_cfg = dma_channel_get_default_config(dma_tx_chan);
+    channel_config_set_transfer_data_size(&tx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&tx_cfg, true);
+    channel_config_set_write_increment(&tx_cfg, false);
+    channel_config_set_dreq(&tx_cfg, spi_get_dreq(spi_instance, true));
+    dma_channel_configure(dma_tx_chan, &tx_cfg, &spi_get_hw(spi_instance)->dr, async_tx, 0, false);
+
+    dma_rx_chan = dma_claim_unused_channel(true);
+    dma_channel_config rx_cfg = dma_channel_get_default_config(dma_rx_chan);
+    channel_config_set_transfer_data_size(&rx_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_cfg, false);
+    channel_config_set_write_increment(&rx_cfg, true);
+    channel_config_set_dreq(&rx_cfg, spi_get_dreq(spi_instance, false));
+    dma_channel_configure(dma_rx_chan, &rx_cfg, async_rx, &spi_get_hw(spi_instance)->dr, 0, false);
 
-    sleep_us(2); // Small delay before CS deassert might be needed
-    // Deassert CS
-    gpio_put(cs_pins[driver_id], 1);
+    // Shares DMA_IRQ_0 with the UART TX channel
+    dma_channel_set_irq0_enabled(dma_rx_chan, true);
+    irq_add_shared_handler(DMA_IRQ_0, tmc_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
 }
 
+static void tmc_apply_config(uint driver_id, const tmc_settings_t *settings);
+
 // --- Initialization ---
-void init_tmc_drivers(spi_inst_t *spi, uint cs1_pin, uint cs2_pin) {
+void init_tmc_drivers(spi_inst_t *spi, const uint *driver_cs_pins) {
     spi_instance = spi;
-    cs_pins[0] = cs1_pin;
-    cs_pins[1] = cs2_pin;
+    async_busy = false; // A poll cut short by a reset (re-boot on the simulator) never completes
+    scan_done = false;
 
-    // Ensure CS pins are high (deselected)
-    gpio_put(cs_pins[0], 1);
-    gpio_put(cs_pins[1], 1);
+    for (uint i = 0; i < TMC_MAX_DRIVERS; i++) {
+        cs_pins[i] = daisy_chain ? driver_cs_pins[0] : driver_cs_pins[i];
+        gpio_put(cs_pins[i], 1); // Ensure CS pins are high (deselected)
+        pending_read[i] = TMC_NO_READ;
+        drv_status_valid[i] = false;
+        mscnt_valid[i] = false;
+        shadow[i].valid = 0;
+        shadow[i].dirty = 0;
+    }
+    init_spi_dma();
 
-    printf("Initializing TMC2130 Drivers...\n");
+    printf("Initializing TMC2130 Drivers%s...\n", daisy_chain ? " (daisy chain on CS1)" : "");
 
-    // --- Configure BOTH Drivers ---
-    for (uint driver_id = 0; driver_id < 2; driver_id++) {
+    // --- Configure All Drivers ---
+    for (uint driver_id = 0; driver_id < TMC_MAX_DRIVERS; driver_id++) {
         printf("Configuring Driver %d...\n", driver_id + 1);
 
         // Example Configuration (ADJUST BASED ON YOUR NEEDS AND DATASHEET!)
@@ -43,29 +248,16 @@ void init_tmc_drivers(spi_inst_t *spi, uint cs1_pin, uint cs2_pin) {
         // Clear GSTAT flags (write 1 to clear)
         tmc_write_register(driver_id, TMC_REG_GSTAT, 0x07); // Clear reset, drv_err, uv_cp
 
-        // Set currents (e.g., Run current 10/31, Hold current 5/31, Hold delay 4)
-        // IHOLD_IRUN: IHOLD(4:0), IRUN(12:8), IHOLDDELAY(19:16)
-        uint32_t ihold_irun = (10 << 8) | (5 << 0) | (4 << 16);
-        tmc_write_register(driver_id, TMC_REG_IHOLD_IRUN, ihold_irun);
-
-        // Set TPOWERDOWN (e.g., 20 = ~0.5 sec delay before power down)
-        tmc_write_register(driver_id, TMC_REG_TPOWERDOWN, 20);
-
-        // Set CHOPCONF (Chopper config - critical for performance/noise)
-        // Example: TOFF=3, HSTRT=4, HEND=1, TBL=2, CHM=0 (SpreadCycle), MRES=2 (16 microsteps)
-        // Refer to datasheet for bit meanings!
-        uint32_t chopconf = (3 << 0) | (4 << 4) | (1 << 7) | (2 << 20) | (0 << 14) | (2 << 24);
-        // Also set: intpol=1 (interpolation), vsense=0/1? (high sensitivity sense resistors?)
-        chopconf |= (1 << 28); // intpol = 1
-        // chopconf |= (1 << 17); // vsense = 1 if needed
-        tmc_write_register(driver_id, TMC_REG_CHOPCONF, chopconf);
-
-        // Set GCONF (Global Config)
-        // Example: Enable diag0_error, diag1_stall, stealthChop(I_scale_analog=0)
-        // uint32_t gconf = (1 << 3) | (1 << 4) | (0 << 0); // Diag pins active low?
-        // tmc_write_register(driver_id, TMC_REG_GCONF, gconf);
+        // Currents, microstepping, chopper and GCONF come from the default
+        // REG_MOTOR_CONFIG (changed later by update_tmc_config_from_registers())
+        memset(&applied[driver_id], 0, sizeof(applied[driver_id]));
+        applied[driver_id].stall_sgt = TMC_STALL_OFF;
+        tmc_apply_config(driver_id, &applied[driver_id]);
+        tmc_set_register(driver_id, TMC_REG_TPOWERDOWN, TPOWERDOWN_BASE);
+        tmc_flush_registers(driver_id);
 
         // Read back some registers to verify SPI communication (optional debug)
+        // CHOPCONF comes over SPI; IHOLD_IRUN is write-only, so from the shadow
         uint32_t read_chopconf = tmc_read_register(driver_id, TMC_REG_CHOPCONF);
         uint32_t read_ihold = tmc_read_register(driver_id, TMC_REG_IHOLD_IRUN);
         printf("  Driver %d: Read CHOPCONF=0x%08lX, IHOLD_IRUN=0x%08lX\n",
@@ -78,51 +270,283 @@ void init_tmc_drivers(spi_inst_t *spi, uint cs1_pin, uint cs2_pin) {
 
 // --- Write Register ---
 void tmc_write_register(uint driver_id, uint8_t reg_addr, uint32_t value) {
-    uint8_t data_tx[5]; // 1 byte address + 4 bytes data
-    uint8_t data_rx[5]; // Dummy buffer for read part
-
+    if (driver_id >= TMC_MAX_DRIVERS) return; // Invalid driver ID
     // Set write bit (MSB) on register address
-    data_tx[0] = reg_addr | 0x80;
+    tmc_exchange(driver_id, reg_addr | 0x80, value);
 
-    // Data bytes (MSB first)
-    data_tx[1] = (value >> 24) & 0xFF;
-    data_tx[2] = (value >> 16) & 0xFF;
-    data_tx[3] = (value >> 8) & 0xFF;
-    data_tx[4] = value & 0xFF;
-
-    tmc_spi_transfer(driver_id, data_tx, data_rx, 5);
-    // Optional: Short delay after write?
-    // sleep_us(5);
+    // Keep the shadow in step with direct writes
+    int idx = shadow_index(reg_addr);
+    if (idx >= 0) {
+        shadow[driver_id].value[idx] = value;
+        shadow[driver_id].valid |= (1u << idx);
+        shadow[driver_id].dirty &= ~(1u << idx);
+    }
 }
 
 // --- Read Register ---
 uint32_t tmc_read_register(uint driver_id, uint8_t reg_addr) {
-    uint8_t data_tx[5] = {0}; // Address only needed for first transfer
-    uint8_t data_rx[5] = {0};
+    if (driver_id >= TMC_MAX_DRIVERS) return 0;
+    reg_addr &= 0x7F; // Ensure read bit (MSB) is clear on register address
 
-    // Ensure read bit (MSB) is clear on register address
-    data_tx[0] = reg_addr & 0x7F;
+    // Write-only registers can't be read back: answer from the shadow
+    int idx = shadow_index(reg_addr);
+    if (idx >= 0 && !shadow_regs[idx].readable) {
+        return shadow[driver_id].value[idx];
+    }
 
-    // 1. Send the register address (write with read bit clear)
-    // The TMC driver latches this address for the *next* transfer.
-    tmc_spi_transfer(driver_id, data_tx, data_rx, 5);
+    // 1. Send the register address; the driver latches it for the *next*
+    //    response. Skipped if the previous datagram already read it.
+    if (pending_read[driver_id] != reg_addr) {
+        tmc_exchange(driver_id, reg_addr, 0);
+    }
 
-    // Short delay might be necessary between transfers
-    sleep_us(50); // Adjust delay as needed
+    // 2. Send the address again to clock out the result. This leaves the
+    //    register latched, so reading it again only needs one datagram.
+    return tmc_exchange(driver_id, reg_addr, 0);
+}
 
-    // 2. Send the address *again* (or dummy data like 0x00) to clock out the result
-    // The data received during *this* transfer corresponds to the address sent *before*.
-    memset(data_tx, 0, 5); // Send dummy bytes
-    tmc_spi_transfer(driver_id, data_tx, data_rx, 5);
+void tmc_read_registers(uint driver_id, const uint8_t *reg_addrs, uint32_t *values, uint count) {
+    if (driver_id >= TMC_MAX_DRIVERS || count == 0) return;
 
-    // The status byte is in data_rx[0], data is in data_rx[1..4]
-    uint32_t value = ((uint32_t)data_rx[1] << 24) |
-                     ((uint32_t)data_rx[2] << 16) |
-                     ((uint32_t)data_rx[3] << 8)  |
-                     ((uint32_t)data_rx[4]);
+    if (pending_read[driver_id] != (reg_addrs[0] & 0x7F)) {
+        tmc_exchange(driver_id, reg_addrs[0] & 0x7F, 0);
+    }
+    // Each datagram requests the next register and returns the previous one;
+    // the last one re-reads its own register to keep the pipeline primed
+    for (uint i = 0; i < count; i++) {
+        uint8_t next = (i + 1 < count) ? reg_addrs[i + 1] : reg_addrs[i];
+        values[i] = tmc_exchange(driver_id, next & 0x7F, 0);
+    }
+}
+
+// --- Register Shadow ---
+void tmc_set_register(uint driver_id, uint8_t reg_addr, uint32_t value) {
+    if (driver_id >= TMC_MAX_DRIVERS) return;
+    int idx = shadow_index(reg_addr);
+    if (idx < 0) {
+        tmc_write_register(driver_id, reg_addr, value); // Not shadowed
+        return;
+    }
+    tmc_shadow_t *sh = &shadow[driver_id];
+    uint16_t bit = 1u << idx;
+    if ((sh->valid & bit) && sh->value[idx] == value) return; // Unchanged
+    sh->value[idx] = value;
+    sh->valid |= bit;
+    sh->dirty |= bit;
+}
+
+uint tmc_flush_registers(uint driver_id) {
+    if (driver_id >= TMC_MAX_DRIVERS) return 0;
+    uint written = 0;
+    for (uint i = 0; i < SHADOW_COUNT; i++) {
+        if (shadow[driver_id].dirty & (1u << i)) {
+            tmc_write_register(driver_id, shadow_regs[i].addr, shadow[driver_id].value[i]); // Clears the dirty bit
+            written++;
+        }
+    }
+    return written;
+}
+
+void tmc_invalidate_registers(uint driver_id) {
+    if (driver_id >= TMC_MAX_DRIVERS) return;
+    shadow[driver_id].dirty = shadow[driver_id].valid;
+}
+
+// TSTEP of 'speed' steps/sec at microstep resolution 'mres' (0 = no threshold)
+static uint32_t speed_to_tstep(uint32_t speed, uint32_t mres) {
+    if (speed == 0) return 0;
+    uint64_t tstep = (uint64_t)TMC_FCLK_HZ / ((uint64_t)speed << mres);
+    return tstep > TMC_TSTEP_MAX ? TMC_TSTEP_MAX : (uint32_t)tstep;
+}
 
-    // You might want to return or log the status byte (data_rx[0]) as well
-    // printf("TMC Read Addr %02X: Status=0x%02X, Value=0x%08lX\n", reg_addr, data_rx[0], value);
+// Map the settings onto the shadow registers (not flushed).
+// stall_sgt != TMC_STALL_OFF overrides the modes for StallGuard homing:
+// SpreadCycle (StallGuard2 doesn't work in StealthChop), no CoolStep, stall
+// output on DIAG1, SGT.
+// detect_sgt != TMC_STALL_OFF only adds SGT and a TCOOLTHRS, so
+// DRV_STATUS.stallGuard works in SpreadCycle above COOLSTEP_MIN_SPEED; the
+// modes stay as configured (see driver_monitor.h).
+static void tmc_apply_config(uint driver_id, const tmc_settings_t *settings) {
+    uint16_t config = settings->config ? settings->config : TMC_DEFAULT_CONFIG;
+
+    uint32_t mres = (config & TMC_CONFIG_MRES_MASK) >> TMC_CONFIG_MRES_SHIFT;
+    uint32_t irun = (config & TMC_CONFIG_IRUN_MASK) >> TMC_CONFIG_IRUN_SHIFT;
+    uint32_t ihold = (config & TMC_CONFIG_IHOLD_MASK) >> TMC_CONFIG_IHOLD_SHIFT;
+    if (mres > 8) mres = 8; // Full step
+
+    // CHOPCONF: MRES(27:24), intpol(28)
+    uint32_t chopconf = CHOPCONF_BASE | (mres << 24);
+    if (config & TMC_CONFIG_INTPOL) chopconf |= (1u << 28);
+    tmc_set_register(driver_id, TMC_REG_CHOPCONF, chopconf);
+
+    // IHOLD_IRUN: IHOLD(4:0), IRUN(12:8), IHOLDDELAY(19:16)
+    tmc_set_register(driver_id, TMC_REG_IHOLD_IRUN, IHOLDDELAY_BASE | (irun << 8) | (ihold << 0));
+
+    // GCONF: en_pwm_mode(2) selects StealthChop, TPWMTHRS hands over to
+    // SpreadCycle above a speed (0 = StealthChop at every speed)
+    int gconf_idx = shadow_index(TMC_REG_GCONF);
+    uint32_t gconf = (shadow[driver_id].valid & (1u << gconf_idx)) ? shadow[driver_id].value[gconf_idx] : 0;
+    bool auto_mode = (settings->mode_control & TMC_MODE_CTRL_AUTO) != 0;
+    bool stealth = auto_mode || (config & TMC_CONFIG_STEALTHCHOP);
+    uint32_t stealth_max = settings->stealth_max_speed ? settings->stealth_max_speed : TMC_DEFAULT_STEALTH_MAX_SPEED;
+    uint32_t tpwmthrs = auto_mode ? speed_to_tstep(stealth_max, mres) : 0;
+
+    // CoolStep: COOLCONF SEMIN..SEIMIN (15:0), active above TCOOLTHRS
+    bool coolstep = (settings->mode_control & TMC_MODE_CTRL_COOLSTEP) != 0;
+    uint32_t cool_min = settings->coolstep_min_speed ? settings->coolstep_min_speed : TMC_DEFAULT_COOLSTEP_MIN_SPEED;
+    uint32_t coolconf = 0, tcoolthrs = 0;
+    if (coolstep) {
+        coolconf = settings->coolstep_config ? settings->coolstep_config : TMC_DEFAULT_COOLSTEP_CONFIG;
+        tcoolthrs = speed_to_tstep(cool_min, mres);
+    }
+
+    // Stall detection: COOLCONF.sgt(22:16), SG_RESULT valid above the same
+    // TCOOLTHRS (SEMIN stays 0 without CoolStep, so the current is unchanged)
+    if (settings->detect_sgt != TMC_STALL_OFF) {
+        coolconf |= (uint32_t)(settings->detect_sgt & 0x7F) << 16;
+        tcoolthrs = speed_to_tstep(cool_min, mres);
+    }
+
+    // StallGuard: diag1_stall(8), COOLCONF.sgt(22:16), TCOOLTHRS
+    if (settings->stall_sgt != TMC_STALL_OFF) {
+        stealth = false;
+        tpwmthrs = 0;
+        coolconf = (uint32_t)(settings->stall_sgt & 0x7F) << 16;
+        tcoolthrs = TCOOLTHRS_MAX;
+        gconf |= GCONF_DIAG1_STALL;
+    } else {
+        gconf &= ~GCONF_DIAG1_STALL;
+    }
+    if (stealth) gconf |= GCONF_EN_PWM_MODE; else gconf &= ~GCONF_EN_PWM_MODE;
+
+    tmc_set_register(driver_id, TMC_REG_GCONF, gconf);
+    tmc_set_register(driver_id, TMC_REG_TPWMTHRS, tpwmthrs);
+    tmc_set_register(driver_id, TMC_REG_COOLCONF, coolconf);
+    tmc_set_register(driver_id, TMC_REG_TCOOLTHRS, tcoolthrs);
+}
+
+// Mode the driver runs in at 'speed' steps/sec with these settings (mirrors
+// the TSTEP comparisons the driver makes)
+static tmc_driver_mode_t driver_mode_at(const tmc_settings_t *settings, uint32_t speed) {
+    if (settings->stall_sgt != TMC_STALL_OFF) return TMC_DRIVER_STALLGUARD;
+    uint16_t config = settings->config ? settings->config : TMC_DEFAULT_CONFIG;
+    bool auto_mode = (settings->mode_control & TMC_MODE_CTRL_AUTO) != 0;
+    uint32_t stealth_max = settings->stealth_max_speed ? settings->stealth_max_speed : TMC_DEFAULT_STEALTH_MAX_SPEED;
+    if (auto_mode ? speed < stealth_max : (config & TMC_CONFIG_STEALTHCHOP) != 0) return TMC_DRIVER_STEALTHCHOP;
+
+    uint32_t cool_min = settings->coolstep_min_speed ? settings->coolstep_min_speed : TMC_DEFAULT_COOLSTEP_MIN_SPEED;
+    if ((settings->mode_control & TMC_MODE_CTRL_COOLSTEP) && speed >= cool_min) return TMC_DRIVER_COOLSTEP;
+    return TMC_DRIVER_SPREADCYCLE;
+}
+
+void update_tmc_config_from_registers(volatile uint8_t *registers) {
+    for (uint d = 0; d < TMC_MAX_DRIVERS; d++) {
+        tmc_settings_t settings;
+        memset(&settings, 0, sizeof(settings)); // Padding too, for memcmp()
+        settings.config = READ_U16_REGISTER(registers, REG_MOTOR_CONFIG_L(d));
+        settings.mode_control = registers[REG_MOTOR_DRIVER_MODE_CONTROL(d)];
+        settings.stealth_max_speed = READ_U16_REGISTER(registers, REG_MOTOR_STEALTH_MAX_SPEED_L(d));
+        settings.coolstep_min_speed = READ_U16_REGISTER(registers, REG_MOTOR_COOLSTEP_MIN_SPEED_L(d));
+        settings.coolstep_config = READ_U16_REGISTER(registers, REG_MOTOR_COOLSTEP_CONFIG_L(d));
+
+        // StallGuard while a StallGuard homing seek is pending or running
+        // (HOMING_STATE comes from core 1 through core_link_pull_status()),
+        // otherwise stall detection if the driver monitor asks for it
+        settings.stall_sgt = TMC_STALL_OFF;
+        settings.detect_sgt = TMC_STALL_OFF;
+        uint8_t state = registers[REG_MOTOR_HOMING_STATE(d)];
+        int8_t sgt = (int8_t)registers[REG_MOTOR_STALL_THRESHOLD(d)];
+        sgt = sgt < -64 ? -64 : (sgt > 63 ? 63 : sgt);
+        if ((registers[REG_MOTOR_HOMING_CONFIG(d)] & HOMING_CFG_STALLGUARD) && (state == HOMING_WAIT || state == HOMING_SEEK)) {
+            settings.stall_sgt = sgt;
+        } else if (registers[REG_MOTOR_STALL_RECOVERY(d)] & STALL_RECOVERY_ACTION_MASK) {
+            settings.detect_sgt = sgt;
+        }
+
+        if (memcmp(&settings, &applied[d], sizeof(settings)) != 0) {
+            applied[d] = settings;
+            tmc_apply_config(d, &settings);
+            uint written = tmc_flush_registers(d);
+            event_log(LOG_EVT_TMC_CONFIG_APPLIED, d, (uint16_t)written, settings.config, settings.mode_control);
+        }
+
+        // Mode at the planned speed, load and CoolStep current from DRV_STATUS
+        uint32_t speed = READ_U16_REGISTER(registers, REG_MOTOR_CURRENT_SPEED_L(d));
+        reg_publish_u8(registers, REG_MOTOR_DRIVER_MODE(d), (uint8_t)driver_mode_at(&applied[d], speed));
+        uint32_t status;
+        if (tmc_get_drv_status(d, &status)) {
+            reg_publish_u16(registers, REG_MOTOR_SG_RESULT_L(d), status & 0x3FF);           // SG_RESULT (9:0)
+            reg_publish_u8(registers, REG_MOTOR_CS_ACTUAL(d), (status >> 16) & 0x1F);       // CS_ACTUAL (20:16)
+        }
+    }
+}
+
+// --- Background DRV_STATUS Monitor ---
+void update_tmc_status_scan(void) {
+    if (async_busy) return;
+
+    if (scan_done) {
+        scan_done = false;
+        for (uint d = 0; d < TMC_MAX_DRIVERS; d++) {
+            size_t offset = daisy_chain ? chain_offset(d) : d * DATAGRAM_LEN;
+            uint32_t value = unpack_value(&async_rx[offset]);
+            if (scan_reg[d] == TMC_REG_DRVSTATUS) {
+                drv_status[d] = value;
+                drv_status_valid[d] = true;
+            } else if (scan_reg[d] == TMC_REG_MSCNT) {
+                mscnt[d] = value & 0x3FF;
+                mscnt_time[d] = scan_reg_time[d];
+                mscnt_valid[d] = true;
+            } // Else the response carried a register a blocking read selected
+        }
+        scan_count++;
+    }
+
+    uint32_t now = time_us_32();
+    if (now - last_scan_time < TMC_STATUS_SCAN_PERIOD_US) return;
+    last_scan_time = now;
+
+    // Every datagram requests DRV_STATUS (or MSCNT) and returns the register
+    // requested by the previous scan, so steady state is one datagram per
+    // driver per scan. The driver samples the value when it is requested.
+    uint8_t reg = (scan_count % TMC_MSCNT_SCAN_DIVIDER) == TMC_MSCNT_SCAN_DIVIDER - 1 ? TMC_REG_MSCNT : TMC_REG_DRVSTATUS;
+    for (uint d = 0; d < TMC_MAX_DRIVERS; d++) {
+        size_t offset = daisy_chain ? chain_offset(d) : d * DATAGRAM_LEN;
+        scan_reg[d] = pending_read[d];
+        scan_reg_time[d] = request_time[d];
+        pending_read[d] = reg;
+        request_time[d] = now;
+        pack_datagram(&async_tx[offset], reg, 0);
+    }
+
+    async_busy = true;
+    if (daisy_chain) {
+        start_async_transfer(cs_pins[0], async_tx, async_rx, sizeof(async_tx));
+    } else {
+        async_driver = 0;
+        start_async_transfer(cs_pins[0], async_tx, async_rx, DATAGRAM_LEN);
+    }
+}
+
+bool tmc_get_drv_status(uint driver_id, uint32_t *value) {
+    if (driver_id >= TMC_MAX_DRIVERS || !drv_status_valid[driver_id]) return false;
+    *value = drv_status[driver_id];
+    return true;
+}
+
+bool tmc_get_mscnt(uint driver_id, uint16_t *value, uint32_t *sample_time_us) {
+    if (driver_id >= TMC_MAX_DRIVERS || !mscnt_valid[driver_id]) return false;
+    *value = mscnt[driver_id];
+    *sample_time_us = mscnt_time[driver_id];
+    return true;
+}
+
+uint32_t tmc_get_scan_count(void) {
+    return scan_count;
+}
 
-    return value;
+uint tmc_get_mres(uint driver_id) {
+    int idx = shadow_index(TMC_REG_CHOPCONF);
+    if (driver_id >= TMC_MAX_DRIVERS || !(shadow[driver_id].valid & (1u << idx))) return 0;
+    return (shadow[driver_id].value[idx] >> 24) & 0x0F;
 }
@@ -3,6 +3,7 @@
 
 #include "hardware/spi.h"
 #include "pico/stdlib.h"
+#include "registers.h"
 
 // --- TMC2130 Register Addresses (Add more as needed) ---
 // See TMC2130 Datasheet
@@ -13,20 +14,148 @@
 #define TMC_REG_IHOLD_IRUN  0x10 // Current settings
 #define TMC_REG_TPOWERDOWN  0x11 // Standstill delay
 #define TMC_REG_XDIRECT     0x2D // Direct motor coil current (for diagnostics)
-// Add registers for COOLSTEP, STALLGUARD, microstepping (MSLUT, MSCNT), etc.
+#define TMC_REG_TPWMTHRS    0x13 // StealthChop upper velocity threshold (write-only)
+#define TMC_REG_TCOOLTHRS   0x14 // CoolStep/StallGuard lower velocity threshold (write-only)
+#define TMC_REG_THIGH       0x15 // High velocity threshold (write-only)
+#define TMC_REG_COOLCONF    0x6D // CoolStep and StallGuard configuration (write-only)
+#define TMC_REG_PWMCONF     0x70 // StealthChop configuration (write-only)
+#define TMC_REG_MSCNT       0x6A // Microstep counter (0-1023, read-only)
+// Add registers for COOLSTEP, STALLGUARD, microstepping (MSLUT), etc.
+
+// DRV_STATUS flags (SG_RESULT is bits 9:0, CS_ACTUAL bits 20:16)
+#define TMC_DRV_STALLGUARD  (1u << 24) // SG_RESULT reached 0 (needs SGT, SpreadCycle, TSTEP <= TCOOLTHRS)
+#define TMC_DRV_OT          (1u << 25) // Overtemperature: driver shut down
+#define TMC_DRV_OTPW        (1u << 26) // Overtemperature pre-warning
+#define TMC_DRV_S2GA        (1u << 27) // Short to GND, coil A (driver shut down)
+#define TMC_DRV_S2GB        (1u << 28)
+#define TMC_DRV_OLA         (1u << 29) // Open load, coil A (only meaningful while moving)
+#define TMC_DRV_OLB         (1u << 30)
+#define TMC_DRV_STST        (1u << 31) // Standstill
+
+#define TMC_MAX_DRIVERS     REG_NUM_AXES // One driver per axis
+
+// --- SPI Pipeline ---
+// Every 40-bit datagram is answered with the register read by the *previous*
+// datagram. Reads are therefore chained: N registers cost N + 1 datagrams, and
+// re-reading the register read last costs one. Other than the CS high time
+// between datagrams, no delays are needed.
+//
+// Daisy chain (TMC_DAISY_CHAIN = 1): all drivers share CS1, the SDO of driver 1
+// feeds the SDI of driver 2, and the last SDO goes to MISO. One CS assertion
+// then carries one datagram per driver. Drivers a call does not address re-read
+// their previous register, so their pipeline is kept.
+#ifndef TMC_DAISY_CHAIN
+#define TMC_DAISY_CHAIN     0
+#endif
+#if TMC_MAX_DRIVERS > 2 && !TMC_DAISY_CHAIN
+#error "More than 2 axes need TMC_DAISY_CHAIN (only CS1/CS2 are wired)"
+#endif
+#define TMC_CS_HIGH_US      1       // CSN high time between datagrams
+#define TMC_STATUS_SCAN_PERIOD_US 1000 // Background DRV_STATUS read interval
+#define TMC_MSCNT_SCAN_DIVIDER 8    // Every 8th scan reads MSCNT instead
+
+// --- Register Shadow ---
+// Each driver keeps a copy of its configuration registers (GCONF, IHOLD_IRUN,
+// TPOWERDOWN, TPWMTHRS, TCOOLTHRS, THIGH, CHOPCONF, COOLCONF, PWMCONF).
+// tmc_set_register() only updates the copy and marks it dirty if the value
+// changed, and tmc_flush_registers() sends the dirty ones. Most of these
+// registers are write-only, so tmc_read_register() returns them from the copy.
+
+// --- REG_MOTOR_CONFIG Fields (16 bits, 0 = firmware defaults) ---
+#define TMC_CONFIG_MRES_SHIFT       0   // Bits 0-3: CHOPCONF.MRES (0 = 256 microsteps ... 8 = full step)
+#define TMC_CONFIG_MRES_MASK        0x000F
+#define TMC_CONFIG_IRUN_SHIFT       4   // Bits 4-8: Run current (0-31)
+#define TMC_CONFIG_IRUN_MASK        0x01F0
+#define TMC_CONFIG_IHOLD_SHIFT      9   // Bits 9-13: Hold current (0-31)
+#define TMC_CONFIG_IHOLD_MASK       0x3E00
+#define TMC_CONFIG_STEALTHCHOP      (1u << 14) // GCONF.en_pwm_mode
+#define TMC_CONFIG_INTPOL           (1u << 15) // CHOPCONF.intpol (interpolate to 256 microsteps)
+#define TMC_DEFAULT_CONFIG  ((2u << TMC_CONFIG_MRES_SHIFT) | (10u << TMC_CONFIG_IRUN_SHIFT) | \
+                             (5u << TMC_CONFIG_IHOLD_SHIFT) | TMC_CONFIG_INTPOL)
+
+// --- Velocity-Based Driver Modes (REG_MOTOR_DRIVER_MODE_CONTROL etc.) ---
+// Thresholds are set in steps/sec, the unit of the planner and of
+// REG_MOTOR_CURRENT_SPEED, and converted to TSTEP for the current MRES
+// (TSTEP = fCLK / (speed * 2^MRES)). The driver then switches by itself at the
+// exact crossing, with no SPI latency in the step path:
+//  - StealthChop (quiet, efficient) below STEALTH_MAX_SPEED, SpreadCycle above
+//    it, where StealthChop loses torque (TPWMTHRS)
+//  - CoolStep above COOLSTEP_MIN_SPEED (TCOOLTHRS, SpreadCycle only): the
+//    driver lowers the current towards IRUN * SEIMIN while SG_RESULT shows
+//    light load, and raises it again as the load grows
+// REG_MOTOR_DRIVER_MODE reports the mode for the planner's current speed,
+// REG_MOTOR_SG_RESULT/CS_ACTUAL come from the DRV_STATUS scan.
+#define TMC_FCLK_HZ                 12000000 // Internal clock
+#define TMC_TSTEP_MAX               0xFFFFF
+#define TMC_MODE_CTRL_AUTO          (1u << 0)
+#define TMC_MODE_CTRL_COOLSTEP      (1u << 1)
+#define TMC_DEFAULT_STEALTH_MAX_SPEED  1000 // steps/sec
+#define TMC_DEFAULT_COOLSTEP_MIN_SPEED 1000 // steps/sec
+#define TMC_DEFAULT_COOLSTEP_CONFIG ((5u << 0) | (1u << 5) | (2u << 8) | (0u << 13)) // SEMIN=5, SEUP=1, SEMAX=2, SEDN=0, SEIMIN=1/2
+
+typedef enum {
+    TMC_DRIVER_STEALTHCHOP = 0,
+    TMC_DRIVER_SPREADCYCLE,
+    TMC_DRIVER_COOLSTEP,
+    TMC_DRIVER_STALLGUARD,  // StallGuard homing seek
+} tmc_driver_mode_t;
 
 // --- Function Prototypes ---
+// All TMC functions are for core 0 only (the SPI DMA IRQ runs there).
 
 // Initialize SPI and basic TMC configuration
-void init_tmc_drivers(spi_inst_t *spi, uint cs1_pin, uint cs2_pin);
+// cs_pins: chip select of each driver; the daisy chain only uses cs_pins[0]
+void init_tmc_drivers(spi_inst_t *spi, const uint *cs_pins);
 
 // Write to a TMC register
-// driver_id: 0 for motor 1 (CS1), 1 for motor 2 (CS2)
+// driver_id: axis (0 for motor 1 on CS1, 1 for motor 2 on CS2, ...)
 void tmc_write_register(uint driver_id, uint8_t reg_addr, uint32_t value);
 
 // Read from a TMC register
 uint32_t tmc_read_register(uint driver_id, uint8_t reg_addr);
 
+// Read several registers of one driver in a single pipelined burst (SPI only,
+// not the shadow)
+void tmc_read_registers(uint driver_id, const uint8_t *reg_addrs, uint32_t *values, uint count);
+
+// Update the shadow copy of a configuration register; sent by the next flush
+// only if the value changed. Registers without a shadow are written directly.
+void tmc_set_register(uint driver_id, uint8_t reg_addr, uint32_t value);
+
+// Write all dirty shadow registers of a driver. Returns the number written.
+uint tmc_flush_registers(uint driver_id);
+
+// Mark every shadow register dirty, e.g. after the driver reported a reset
+// (GSTAT.reset), so the next flush restores the whole configuration.
+void tmc_invalidate_registers(uint driver_id);
+
+// Apply REG_MOTOR_CONFIG and the driver mode registers to the shadows and
+// flush them, for each motor whose settings changed, plus the StallGuard
+// settings while StallGuard homing seeks (REG_MOTOR_HOMING_*). Also updates
+// REG_MOTOR_DRIVER_MODE, SG_RESULT and CS_ACTUAL. Call from the core 0 main loop.
+void update_tmc_config_from_registers(volatile uint8_t *registers);
+
+// --- Background DRV_STATUS Monitor ---
+// Reads DRV_STATUS of every driver by DMA every TMC_STATUS_SCAN_PERIOD_US,
+// one datagram per driver (one CS assertion in daisy-chain mode), and MSCNT
+// in place of it every TMC_MSCNT_SCAN_DIVIDER-th scan. Call from the core 0
+// main loop; it only starts transfers and collects the results.
+void update_tmc_status_scan(void);
+
+// Latest DRV_STATUS of a driver. Returns false until a scan has produced one.
+bool tmc_get_drv_status(uint driver_id, uint32_t *drv_status);
+
+// Latest MSCNT of a driver and the time_us_32() of the datagram that sampled
+// it. Returns false until a scan has produced one.
+bool tmc_get_mscnt(uint driver_id, uint16_t *mscnt, uint32_t *sample_time_us);
+
+// Scans completed so far (wraps): a new value means new samples
+uint32_t tmc_get_scan_count(void);
+
+// MRES the driver runs with (CHOPCONF shadow, 0 = 256 microsteps ... 8 = full
+// step): one step moves MSCNT by 1 << MRES
+uint tmc_get_mres(uint driver_id);
+
 // --- Helper Functions/Macros (Specific to your hardware/needs) ---
 // e.g., Functions to set specific modes like StealthChop, SpreadCycle
 // Functions to set current, microstepping, StallGuard thresholds
@@ -0,0 +1,30 @@
+#ifndef _TUSB_CONFIG_H_
+#define _TUSB_CONFIG_H_
+
+// TinyUSB configuration for the STEPPER_USB_TRANSPORT build: one CDC
+// interface carrying the binary register protocol (see uart_protocol.h).
+
+// --- Common ---
+#ifndef CFG_TUSB_MCU
+#define CFG_TUSB_MCU            OPT_MCU_RP2040
+#endif
+#ifndef CFG_TUSB_OS
+#define CFG_TUSB_OS             OPT_OS_PICO
+#endif
+#define CFG_TUSB_RHPORT0_MODE   OPT_MODE_DEVICE // Full speed (12 Mbit/s)
+
+// --- Device ---
+#define CFG_TUD_ENDPOINT0_SIZE  64
+
+#define CFG_TUD_CDC             1
+#define CFG_TUD_MSC             0
+#define CFG_TUD_HID             0
+#define CFG_TUD_MIDI            0
+#define CFG_TUD_VENDOR          0
+
+// CDC FIFOs; the protocol rings in uart_protocol.c sit behind these
+#define CFG_TUD_CDC_RX_BUFSIZE  256
+#define CFG_TUD_CDC_TX_BUFSIZE  256
+#define CFG_TUD_CDC_EP_BUFSIZE  64
+
+#endif // _TUSB_CONFIG_H_
@@ -1,8 +1,127 @@
 #include "uart_protocol.h"
+#include "diagnostics.h"
+#include "event_log.h"
+#include "reg_dirty.h"
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
-#include <string.h> // Not strictly needed now, but good practice if other string ops added
-#include <stdio.h> // For debug printf
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include <string.h> // For memcpy
+#if STEPPER_USB_TRANSPORT
+#include "tusb.h"
+#endif
+
+#define RX_MASK (UART_RX_BUFFER_SIZE - 1)
+#define TX_MASK (UART_TX_BUFFER_SIZE - 1)
+
+static uart_inst_t *protocol_uart = NULL;
+static register_write_hook_t write_hook = NULL;
+static register_batch_hook_t batch_hook = NULL;
+
+// --- RX Ring Buffer (filled by the UART IRQ) ---
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;       // Written by IRQ only
+static volatile uint32_t rx_tail = 0;       // Written by main loop only
+
+// --- TX Ring Buffer (drained by DMA) ---
+static uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head = 0;       // Written by main loop only
+static volatile uint32_t tx_tail = 0;       // Advanced on DMA completion
+static volatile uint32_t tx_in_flight = 0;  // Bytes in the current DMA transfer
+static int tx_dma_chan = -1;
+
+// --- Baud Rate Switching (CMD_SET_BAUD) ---
+static const uint32_t baud_table[] = UART_BAUD_TABLE;
+#define NUM_BAUD_CODES (sizeof(baud_table) / sizeof(baud_table[0]))
+
+static struct {
+    uint32_t current;       // Rate the UART runs at
+    uint32_t pending;       // Rate to switch to once the ACK has left (0 = none)
+    bool confirming;        // Switched, no valid frame received at the new rate yet
+    uint32_t switch_time;
+} baud = { UART_DEFAULT_BAUD, 0, false, 0 };
+
+// --- Incremental Frame Parser ---
+typedef enum {
+    PARSE_CMD = 0,
+    PARSE_SEQ,
+    PARSE_ADDR,
+    PARSE_ADDR_H,                       // CMD_ADDR16_FLAG: high address byte
+    PARSE_LEN,
+    PARSE_DATA,
+    PARSE_CHECKSUM,
+    // Framed (v2) messages
+    PARSE_SYNC,                         // FRAME_SYNC0 seen, expecting FRAME_SYNC1
+    PARSE_FRAME_LEN,
+    PARSE_FRAME_BODY,
+    PARSE_FRAME_CRC_H,
+    PARSE_FRAME_CRC_L,
+} parse_state_t;
+
+// Payload bytes stored per frame: a WRITE's data, the READ_MULTI ranges or the STAGE_WRITE runs
+#define PARSER_DATA_LEN UART_MAX_STAGE_LEN
+_Static_assert(PARSER_DATA_LEN >= UART_MAX_DATA_LEN && PARSER_DATA_LEN >= 3 * UART_MAX_MULTI_RANGES,
+               "Parser buffer must hold every payload");
+_Static_assert(4 + UART_MAX_STAGE_LEN <= UART_MAX_FRAME_BODY, "A full STAGE_WRITE must fit a sequenced frame");
+
+static struct {
+    parse_state_t state;
+    uint8_t header[3];                  // CMD (without flags), ADDR (low byte) or COUNT, LEN
+    uint16_t addr;                      // READ/WRITE register address (both bytes)
+    bool wide;                          // CMD_ADDR16_FLAG: 16-bit addresses
+    bool has_seq;                       // Frame carried a sequence ID
+    uint8_t seq;
+    uint8_t data[PARSER_DATA_LEN];
+    uint16_t expected;                  // Payload bytes following the header
+    uint16_t received;
+    uint8_t checksum;                   // Running XOR of header + payload
+    uint32_t last_byte_time;
+    bool framed;                        // Current frame arrived in the CRC envelope
+    uint8_t raw[1 + UART_MAX_FRAME_BODY + 2]; // Framed message after the preamble: LEN, BODY, CRC
+    uint8_t raw_len;
+    uint8_t body_len;
+    uint16_t crc;                       // Running CRC of LEN + BODY
+    bool rejected;                      // raw holds a rejected framed message, to be rescanned
+} parser;
+
+static bool link_framed = false;        // Last valid request was framed: frame unsolicited output too
+static bool framed_only = false;        // Preamble seen: only hunt for FRAME_SYNC0 between frames
+
+// --- Read Latch (REG_LATCH_CONTROL) ---
+static uint8_t latch_bank[REGISTER_MAP_SIZE];
+static bool latched = false;
+
+// Where READ/READ_MULTI take their data from
+static inline const volatile uint8_t *read_view(volatile uint8_t *registers) {
+    return latched ? latch_bank : registers;
+}
+
+static void update_latch(volatile uint8_t *registers) {
+    if (registers[REG_LATCH_CONTROL] & 0x01) {
+        for (uint i = 0; i < REGISTER_MAP_SIZE; i++) latch_bank[i] = registers[i];
+        latched = true;
+    } else {
+        latched = false;
+    }
+}
+
+// --- Staged Bulk Write (CMD_STAGE_WRITE / CMD_STAGE_COMMIT) ---
+static uint8_t stage_bank[REG_DIRTY_TRACKED];
+static reg_dirty_t staged;              // Bytes of stage_bank to commit
+
+static struct {
+    bool open;                          // STAGE_BEGIN seen since the last commit/discard
+    uint8_t runs;                       // Runs staged since STAGE_BEGIN
+    uint16_t crc;                       // CRC-16 over their STAGE_WRITE payloads
+} stage;
+
+static void discard_stage(void) {
+    reg_dirty_clear(&staged);
+    stage.open = false;
+    stage.runs = 0;
+    stage.crc = FRAME_CRC_INIT;
+}
 
 // --- Simple XOR Checksum ---
 uint8_t calculate_checksum(const uint8_t *data, size_t len) {
@@ -13,147 +132,839 @@ uint8_t calculate_checksum(const uint8_t *data, size_t len) {
     return checksum;
 }
 
-// --- UART Processing ---
-void handle_uart_rx(uart_inst_t *uart, volatile uint8_t *registers) {
-    // Check if start byte is available (if using one)
-    // Using uart_is_readable first prevents blocking unnecessarily if no data starts coming
-    if (uart_is_readable(uart)) {
-        uint8_t header[3]; // CMD, ADDR, LEN
-
-        // Read the header (blocks until 3 bytes are received)
-        uart_read_blocking(uart, header, 3);
-        // If the function returns, we assume 3 bytes were successfully read.
-        // Error handling here relies more on subsequent protocol validation.
-
-        uint8_t cmd_type = header[0];
-        uint8_t reg_addr = header[1];
-        uint8_t data_len = header[2];
-
-        // --- Validate Header ---
-        // Check address and length validity *before* reading more data
-        if (reg_addr >= REGISTER_MAP_SIZE || (reg_addr + data_len) > REGISTER_MAP_SIZE) {
-            printf("UART RX Error: Invalid address/length (Addr: %02X, Len: %d, MapSize: %d)\n", reg_addr, data_len, REGISTER_MAP_SIZE);
-            // How to recover? Flush remaining expected bytes or just NACK?
-            // Let's try to read and discard expected remaining bytes based on cmd_type for robustness
-            if (cmd_type == CMD_READ) {
-                 uart_read_blocking(uart, header, 1); // Read/discard expected checksum byte
-            } else if (cmd_type == CMD_WRITE) {
-                 uint8_t discard_buf[16+1]; // Max size
-                 if (data_len <= 16) { // Prevent overflow on discard read
-                     uart_read_blocking(uart, discard_buf, data_len + 1); // Read/discard data+checksum
-                 }
-            }
-            // Consider sending NACK here if protocol defines it
+// --- CRC-16/CCITT-FALSE (table driven, built at init) ---
+static uint16_t crc_table[256];
+
+static void init_crc_table(void) {
+    for (uint i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ FRAME_CRC_POLY) : (uint16_t)(crc << 1);
+        }
+        crc_table[i] = crc;
+    }
+}
+
+static inline uint16_t crc16_update(uint16_t crc, uint8_t byte) {
+    return (uint16_t)((crc << 8) ^ crc_table[((crc >> 8) ^ byte) & 0xFF]);
+}
+
+uint16_t frame_crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) crc = crc16_update(crc, data[i]);
+    return crc;
+}
+
+#if !STEPPER_USB_TRANSPORT
+// --- UART RX IRQ ---
+static void __not_in_flash_func(uart_rx_irq_handler)(void) {
+    while (uart_is_readable(protocol_uart)) {
+        uint8_t byte = (uint8_t)uart_getc(protocol_uart);
+        uint32_t head = rx_head;
+        if (head - rx_tail < UART_RX_BUFFER_SIZE) {
+            rx_buffer[head & RX_MASK] = byte;
+            rx_head = head + 1;
+        } else {
+            diag_count(DIAG_UART_RX_OVERFLOW);
+        }
+    }
+}
+
+// --- TX DMA ---
+// Start a transfer of the next contiguous chunk if the channel is idle.
+// Caller must hold off the DMA IRQ (interrupts disabled).
+static void tx_kick(void) {
+    if (tx_in_flight != 0) return;
+    uint32_t pending = tx_head - tx_tail;
+    if (pending == 0) return;
+
+    uint32_t offset = tx_tail & TX_MASK;
+    uint32_t chunk = UART_TX_BUFFER_SIZE - offset;
+    if (chunk > pending) chunk = pending;
+
+    tx_in_flight = chunk;
+    dma_channel_set_read_addr(tx_dma_chan, &tx_buffer[offset], false);
+    dma_channel_set_trans_count(tx_dma_chan, chunk, true);
+}
+
+static void __not_in_flash_func(uart_tx_dma_irq_handler)(void) {
+    if (!dma_channel_get_irq0_status(tx_dma_chan)) return;
+    dma_channel_acknowledge_irq0(tx_dma_chan);
+    tx_tail += tx_in_flight;
+    tx_in_flight = 0;
+    tx_kick();
+}
+#else
+// --- USB CDC ---
+// No interrupts on this path: the CDC FIFOs are serviced from handle_uart_rx()
+// and uart_tx_queue(), both main loop context.
+static void tx_kick(void) {
+    if (!tud_cdc_connected()) {
+        tx_tail = tx_head; // Nobody listening (port closed): drop instead of sending stale frames later
+        return;
+    }
+    while (tx_head != tx_tail) {
+        uint32_t offset = tx_tail & TX_MASK;
+        uint32_t chunk = UART_TX_BUFFER_SIZE - offset;
+        if (chunk > tx_head - tx_tail) chunk = tx_head - tx_tail;
+        uint32_t written = tud_cdc_write(&tx_buffer[offset], chunk);
+        if (written == 0) break; // CDC FIFO full, continue on the next poll
+        tx_tail += written;
+    }
+    tud_cdc_write_flush();
+}
+
+static void usb_poll(void) {
+    tud_task();
+    while (tud_cdc_available()) {
+        uint32_t space = UART_RX_BUFFER_SIZE - (rx_head - rx_tail);
+        if (space == 0) break; // Ring full: the bytes stay in the CDC FIFO (USB flow control)
+        uint32_t offset = rx_head & RX_MASK;
+        uint32_t chunk = UART_RX_BUFFER_SIZE - offset;
+        if (chunk > space) chunk = space;
+        uint32_t got = tud_cdc_read(&rx_buffer[offset], chunk);
+        if (got == 0) break;
+        rx_head += got;
+    }
+    tx_kick();
+}
+#endif
+
+bool uart_tx_queue(const uint8_t *data, size_t len) {
+    if (tx_head - tx_tail + len > UART_TX_BUFFER_SIZE) {
+        return false; // Not enough room, drop the whole frame
+    }
+    uint32_t head = tx_head;
+    for (size_t i = 0; i < len; i++) {
+        tx_buffer[(head + i) & TX_MASK] = data[i];
+    }
+    tx_head = head + len;
+
+#if STEPPER_USB_TRANSPORT
+    tx_kick();
+#else
+    uint32_t saved_irq = save_and_disable_interrupts();
+    tx_kick();
+    restore_interrupts(saved_irq);
+#endif
+    return true;
+}
+
+// Apply a pending rate change once the ACK is fully out (DMA done and the
+// UART FIFO and shift register empty), and fall back if it is not confirmed.
+static void update_baud(uint32_t now) {
+#if !STEPPER_USB_TRANSPORT
+    if (baud.pending && tx_head == tx_tail && tx_in_flight == 0 &&
+        !(uart_get_hw(protocol_uart)->fr & UART_UARTFR_BUSY_BITS)) {
+        uint actual = uart_set_baudrate(protocol_uart, baud.pending);
+        event_log(LOG_EVT_UART_BAUD_SWITCHED, LOG_NO_AXIS, 0, (int32_t)baud.pending, (int32_t)actual);
+        baud.current = baud.pending;
+        baud.pending = 0;
+        baud.confirming = true;
+        baud.switch_time = now;
+        parser.state = PARSE_CMD; // Anything half-parsed was sent at the old rate
+        parser.checksum = 0;
+    } else if (baud.confirming && (now - baud.switch_time) > UART_BAUD_CONFIRM_TIMEOUT_US) {
+        event_log(LOG_EVT_UART_BAUD_FALLBACK, LOG_NO_AXIS, 0, (int32_t)baud.current, 0);
+        uart_set_baudrate(protocol_uart, UART_DEFAULT_BAUD);
+        baud.current = UART_DEFAULT_BAUD;
+        baud.confirming = false;
+        rx_tail = rx_head; // Garbage received at the wrong rate
+        parser.state = PARSE_CMD;
+        parser.checksum = 0;
+    }
+#endif
+}
+
+// --- Initialization ---
+void init_uart_protocol(uart_inst_t *uart) {
+    protocol_uart = uart;
+    memset(&parser, 0, sizeof(parser));
+    init_crc_table();
+    discard_stage();
+    reg_dirty_mark_all(&host_changes); // The first CMD_READ_CHANGES returns the whole map
+
+#if STEPPER_USB_TRANSPORT
+    tusb_init();
+#else
+    // TX: DMA from the ring buffer into the UART data register, paced by DREQ
+    tx_dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(tx_dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, true));
+    dma_channel_configure(tx_dma_chan, &c, &uart_get_hw(uart)->dr, tx_buffer, 0, false);
+    dma_channel_set_irq0_enabled(tx_dma_chan, true);
+    irq_add_shared_handler(DMA_IRQ_0, uart_tx_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // RX: interrupt on FIFO level and RX timeout, drained into the ring buffer
+    int uart_irq = uart_get_index(uart) ? UART1_IRQ : UART0_IRQ;
+    irq_set_exclusive_handler(uart_irq, uart_rx_irq_handler);
+    irq_set_enabled(uart_irq, true);
+    uart_set_irq_enables(uart, true, false);
+#endif
+}
+
+void uart_protocol_set_write_hook(register_write_hook_t hook) {
+    write_hook = hook;
+}
+
+void uart_protocol_set_batch_hook(register_batch_hook_t hook) {
+    batch_hook = hook;
+}
+
+// --- Responses ---
+// Response buffers reserve RESP_HEADROOM bytes in front of the body for the
+// sequence prefix and the frame header, and RESP_TAILROOM after it for the
+// checksum or CRC, so all response formats share one code path.
+#define FRAME_HEADER_LEN 3  // SYNC0, SYNC1, LEN
+#define RESP_HEADROOM (2 + FRAME_HEADER_LEN)
+#define RESP_TAILROOM 2
+
+_Static_assert(RESP_SEQ_MARKER >= REG_SHORT_ADDR_LIMIT && RESP_ADDR16_MARKER >= REG_SHORT_ADDR_LIMIT,
+               "Response markers must not collide with a short register address");
+
+// Response address field: [ADDR] or [RESP_ADDR16_MARKER] [ADDR_L] [ADDR_H]
+#define RESP_ADDR_MAX 3
+
+static size_t put_resp_addr(uint8_t *body, uint16_t addr) {
+    if (!parser.wide) {
+        body[0] = (uint8_t)addr;
+        return 1;
+    }
+    body[0] = RESP_ADDR16_MARKER;
+    body[1] = (uint8_t)addr;
+    body[2] = (uint8_t)(addr >> 8);
+    return 3;
+}
+
+// Queue 'body' with an XOR checksum, or wrapped in the CRC-16 envelope.
+// 'body' needs FRAME_HEADER_LEN bytes of room in front and RESP_TAILROOM after.
+static bool queue_body(uint8_t *body, size_t len, bool framed) {
+    if (!framed) {
+        body[len] = calculate_checksum(body, len);
+        return uart_tx_queue(body, len + 1);
+    }
+    uint8_t *start = body - FRAME_HEADER_LEN;
+    start[0] = FRAME_SYNC0;
+    start[1] = FRAME_SYNC1;
+    start[2] = (uint8_t)len;
+    uint16_t crc = frame_crc16(FRAME_CRC_INIT, start + 2, len + 1);
+    body[len] = (uint8_t)(crc >> 8);
+    body[len + 1] = (uint8_t)crc;
+    return uart_tx_queue(start, FRAME_HEADER_LEN + len + 2);
+}
+
+bool uart_send_frame(const uint8_t *body, size_t len) {
+    uint8_t frame[FRAME_HEADER_LEN + UART_MAX_FRAME_BODY + RESP_TAILROOM];
+    if (len > UART_MAX_FRAME_BODY) return false;
+    memcpy(frame + FRAME_HEADER_LEN, body, len);
+    return queue_body(frame + FRAME_HEADER_LEN, len, link_framed);
+}
+
+// Add the sequence prefix (if the request had one) and the checksum or CRC
+// (in the format of the request), then queue. 'body_len' excludes the
+// checksum; 'frame' must have RESP_TAILROOM bytes of room at the end.
+// Returns false if the TX ring had no room (nothing queued).
+static bool queue_response(uint8_t *frame, size_t body_len) {
+    uint8_t *start = frame + RESP_HEADROOM;
+    size_t len = body_len;
+    if (parser.has_seq) {
+        start -= 2;
+        start[0] = RESP_SEQ_MARKER;
+        start[1] = parser.seq;
+        len += 2;
+    }
+    return queue_body(start, len, parser.framed);
+}
+
+static void send_write_status(uint16_t reg_addr, uint8_t status) {
+    // [ADDR, STATUS, CHECKSUM]
+    uint8_t response[RESP_HEADROOM + RESP_ADDR_MAX + 1 + RESP_TAILROOM];
+    size_t pos = put_resp_addr(response + RESP_HEADROOM, reg_addr);
+    response[RESP_HEADROOM + pos++] = status;
+    if (status == RESP_NACK) diag_count(DIAG_UART_NACK);
+    queue_response(response, pos);
+}
+
+static void process_set_baud(void) {
+    uint8_t code = parser.header[1];
+    if (parser.checksum != 0) {
+        event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_SET_BAUD, 0);
+        send_write_status(code, RESP_NACK);
+        return;
+    }
+    if (code >= NUM_BAUD_CODES) {
+        event_log(LOG_EVT_UART_BAD_BAUD_CODE, LOG_NO_AXIS, 0, code, 0);
+        send_write_status(code, RESP_NACK);
+        return;
+    }
+    send_write_status(code, RESP_ACK); // Goes out at the current rate
+#if !STEPPER_USB_TRANSPORT
+    if (baud_table[code] != baud.current) baud.pending = baud_table[code];
+#endif
+}
+
+// --- Multi-Range Read ---
+// Payload holds COUNT (ADDR, LEN) pairs, or (ADDR_L, ADDR_H, LEN) triples with
+// CMD_ADDR16_FLAG; the response concatenates the ranges.
+static inline uint16_t multi_range_addr(uint8_t r, uint8_t stride) {
+    const uint8_t *range = &parser.data[stride * r];
+    return stride == 3 ? (uint16_t)(range[0] | (range[1] << 8)) : range[0];
+}
+
+static void process_read_multi(volatile uint8_t *registers) {
+    uint8_t count = parser.header[1];
+    uint8_t total_len = parser.header[2];
+    uint8_t stride = parser.wide ? 3 : 2;
+
+    if (count == 0 || count > UART_MAX_MULTI_RANGES || total_len > UART_MAX_MULTI_DATA_LEN) {
+        event_log(LOG_EVT_UART_BAD_MULTI_READ, LOG_NO_AXIS, 0, count, total_len);
+        return;
+    }
+    if (parser.checksum != 0) {
+        event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_READ_MULTI, 0);
+        return;
+    }
+
+    // Validate every range before touching the response
+    uint32_t sum = 0;
+    for (uint8_t r = 0; r < count; r++) {
+        uint16_t addr = multi_range_addr(r, stride);
+        uint8_t len = parser.data[stride * r + stride - 1];
+        if (len == 0 || addr >= REGISTER_MAP_SIZE || (addr + len) > REGISTER_MAP_SIZE) {
+            event_log(LOG_EVT_UART_BAD_RANGE, LOG_NO_AXIS, 0, addr, len);
             return;
         }
-        if (data_len > 16) { // Arbitrary limit
-             printf("UART RX Error: Data length too large (%d > 16)\n", data_len);
-             // Read and discard expected remaining bytes (checksum or data+checksum)
-             if (cmd_type == CMD_READ) {
-                 uart_read_blocking(uart, header, 1);
-             } else if (cmd_type == CMD_WRITE) {
-                 // Can't safely read data_len+1 if data_len > 16, UART buffer might fill
-                 // Maybe just NACK and hope master resets? Or flush differently?
-                 // For now, just return after logging.
-             }
-             // Consider sending NACK
-             return;
-        }
-
-        // --- Handle READ Command ---
-        if (cmd_type == CMD_READ) {
-            uint8_t checksum_rx;
-
-            // Read the expected checksum byte for the read command itself
-            uart_read_blocking(uart, &checksum_rx, 1);
-            // Assume 1 byte read successfully if function returns
-
-            // Verify command checksum (CMD ^ ADDR ^ LEN)
-            if (calculate_checksum(header, 3) != checksum_rx) {
-                printf("UART RX Error: Read command checksum mismatch (Calc: %02X, Recv: %02X)\n", calculate_checksum(header, 3), checksum_rx);
-                 // Optional NACK?
-                 return;
-            }
+        sum += len;
+    }
+    if (sum != total_len) {
+        event_log(LOG_EVT_UART_BAD_MULTI_READ, LOG_NO_AXIS, 0, (int32_t)sum, total_len);
+        return;
+    }
+
+    // Prepare response buffer: [COUNT, TOTAL_LEN, DATA..., CHECKSUM]
+    uint8_t response[RESP_HEADROOM + 2 + UART_MAX_MULTI_DATA_LEN + RESP_TAILROOM];
+    uint8_t *body = response + RESP_HEADROOM;
+    body[0] = count;
+    body[1] = total_len;
+    size_t pos = 2;
+    const volatile uint8_t *view = read_view(registers);
+    for (uint8_t r = 0; r < count; r++) {
+        uint16_t addr = multi_range_addr(r, stride);
+        uint8_t len = parser.data[stride * r + stride - 1];
+        for (uint8_t i = 0; i < len; i++) {
+            body[pos++] = view[addr + i];
+        }
+    }
+    queue_response(response, pos);
+}
 
-            // Prepare response buffer: [ADDR, LEN, DATA..., CHECKSUM]
-            uint8_t response[2 + data_len + 1]; // Max size needed
-            response[0] = reg_addr;
-            response[1] = data_len;
+// --- Changed Registers ---
+_Static_assert(2 + 2 + UART_MAX_CHANGES_LEN <= UART_MAX_FRAME_BODY, "READ_CHANGES response must fit a sequenced frame");
 
-            // ** CRITICAL SECTION START (if registers modified by interrupts) **
-            // uint32_t saved_irq = save_and_disable_interrupts();
-            // Copy data byte-by-byte from volatile registers
-            for (size_t i = 0; i < data_len; ++i) {
-                response[2 + i] = registers[reg_addr + i]; // Direct volatile read
-            }
-            // ** CRITICAL SECTION END **
-            // restore_interrupts(saved_irq);
+// Runs of marked bytes, merged across gaps no longer than a run header (the
+// gap costs no more than starting a new run) and split at UART_MAX_DATA_LEN
+// and at the budget. Data comes from the live map even while latched: the
+// bits say what changed there. They are only cleared once the response is
+// queued; with the TX ring full the changes stay for the next fetch.
+static void process_read_changes(volatile uint8_t *registers) {
+    if (parser.checksum != 0) {
+        event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_READ_CHANGES, 0);
+        return;
+    }
+    uint8_t budget = parser.header[2];
+    if (budget == 0 || budget > UART_MAX_CHANGES_LEN) budget = UART_MAX_CHANGES_LEN;
+
+    // Prepare response buffer: [RUNS, PAYLOAD_LEN, (ADDR_L, ADDR_H, LEN, DATA...)..., CHECKSUM]
+    uint8_t response[RESP_HEADROOM + 2 + UART_MAX_CHANGES_LEN + RESP_TAILROOM];
+    uint8_t *body = response + RESP_HEADROOM;
+    size_t pos = 2;
+    uint8_t runs = 0;
+    uint16_t start = reg_dirty_next(&host_changes, 0);
+    while (start < REG_DIRTY_TRACKED && pos - 2 + CHANGES_RUN_HEADER < budget) {
+        uint32_t max_len = budget - (pos - 2) - CHANGES_RUN_HEADER;
+        if (max_len > UART_MAX_DATA_LEN) max_len = UART_MAX_DATA_LEN;
+        uint16_t end = start + 1;
+        while (1) {
+            uint16_t next = reg_dirty_next(&host_changes, end);
+            if (next >= REG_DIRTY_TRACKED || next - end > CHANGES_RUN_HEADER || next + 1u - start > max_len) break;
+            end = next + 1;
+        }
+        body[pos++] = (uint8_t)start;
+        body[pos++] = (uint8_t)(start >> 8);
+        body[pos++] = (uint8_t)(end - start);
+        for (uint16_t a = start; a < end; a++) body[pos++] = registers[a];
+        runs++;
+        start = reg_dirty_next(&host_changes, end);
+    }
+    body[0] = runs | (start < REG_DIRTY_TRACKED ? RESP_CHANGES_MORE : 0);
+    body[1] = (uint8_t)(pos - 2);
+    if (!queue_response(response, pos)) return;
+    for (size_t run = 2; run < pos; run += CHANGES_RUN_HEADER + body[run + 2]) {
+        reg_dirty_take(&host_changes, (uint16_t)(body[run] | (body[run + 1] << 8)), body[run + 2]);
+    }
+}
+
+// --- Applying Writes ---
+// Store 'data' in the map (and the latch copy) and pass it to the write hook.
+// Returns false if the hook rejects it (the bytes are stored regardless).
+static bool apply_write(volatile uint8_t *registers, uint16_t reg_addr, const uint8_t *data, uint8_t len) {
+    for (uint8_t i = 0; i < len; ++i) {
+        registers[reg_addr + i] = data[i];
+        if (latched) latch_bank[reg_addr + i] = data[i];
+    }
+    if (REG_LATCH_CONTROL >= reg_addr && REG_LATCH_CONTROL < reg_addr + len) {
+        update_latch(registers);
+    }
+    return !write_hook || write_hook(reg_addr, len, registers);
+}
+
+// --- Staged Bulk Write ---
+// Validate every run before staging any, so a bad frame stages nothing
+static void process_stage_write(void) {
+    uint8_t runs_byte = parser.header[1];
+    uint8_t runs = runs_byte & ~STAGE_BEGIN;
+    uint8_t payload_len = parser.header[2];
+
+    if (parser.checksum != 0) {
+        event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_STAGE_WRITE, 0);
+        discard_stage();
+        send_write_status(runs_byte, RESP_NACK);
+        return;
+    }
+    if (runs_byte & STAGE_BEGIN) {
+        discard_stage();
+        stage.open = true;
+    }
+    bool valid = stage.open && payload_len <= UART_MAX_STAGE_LEN;
+    uint8_t pos = 0;
+    for (uint8_t r = 0; valid && r < runs; r++) {
+        if (pos + CHANGES_RUN_HEADER > payload_len) {
+            valid = false;
+            break;
+        }
+        uint16_t addr = (uint16_t)(parser.data[pos] | (parser.data[pos + 1] << 8));
+        uint8_t len = parser.data[pos + 2];
+        if (len == 0 || addr + len > REG_DIRTY_TRACKED) {
+            event_log(LOG_EVT_UART_BAD_RANGE, LOG_NO_AXIS, 0, addr, len);
+            valid = false;
+            break;
+        }
+        pos += CHANGES_RUN_HEADER + len;
+    }
+    if (!valid || pos != payload_len) {
+        event_log(LOG_EVT_UART_BAD_STAGE, LOG_NO_AXIS, 0, runs_byte, payload_len);
+        discard_stage();
+        send_write_status(runs_byte, RESP_NACK);
+        return;
+    }
+
+    for (pos = 0; pos < payload_len; ) {
+        uint16_t addr = (uint16_t)(parser.data[pos] | (parser.data[pos + 1] << 8));
+        uint8_t len = parser.data[pos + 2];
+        memcpy(&stage_bank[addr], &parser.data[pos + CHANGES_RUN_HEADER], len);
+        reg_dirty_mark(&staged, addr, len);
+        pos += CHANGES_RUN_HEADER + len;
+    }
+    stage.runs += runs;
+    stage.crc = frame_crc16(stage.crc, parser.data, payload_len);
+    send_write_status(runs_byte, RESP_ACK);
+}
+
+// Next run of staged bytes at or after 'from' (REG_DIRTY_TRACKED if none),
+// at most UART_MAX_DATA_LEN long (one forwarded write)
+static uint16_t next_staged_run(uint16_t from, uint8_t *len) {
+    uint16_t start = reg_dirty_next(&staged, from);
+    uint16_t end = start;
+    while (end < REG_DIRTY_TRACKED && end - start < UART_MAX_DATA_LEN && reg_dirty_next(&staged, end) == end) end++;
+    *len = (uint8_t)(end - start);
+    return start;
+}
+
+static void process_stage_commit(volatile uint8_t *registers) {
+    uint8_t runs = parser.header[1];
+
+    if (parser.checksum != 0) {
+        event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_STAGE_COMMIT, 0);
+        discard_stage();
+        send_write_status(runs, RESP_NACK);
+        return;
+    }
+    uint16_t crc = (uint16_t)((parser.data[0] << 8) | parser.data[1]);
+    if (parser.header[2] != 2 || !stage.open || runs != stage.runs || crc != stage.crc) {
+        event_log(LOG_EVT_UART_STAGE_MISMATCH, LOG_NO_AXIS, 0, stage.runs, stage.crc);
+        discard_stage();
+        send_write_status(runs, RESP_NACK);
+        return;
+    }
+
+    // Count the forwarded writes first: core 1 must be able to take all of them
+    uint8_t writes = 0;
+    uint16_t bytes = 0;
+    uint8_t len;
+    for (uint16_t addr = next_staged_run(0, &len); addr < REG_DIRTY_TRACKED; addr = next_staged_run(addr + len, &len)) {
+        writes++;
+        bytes += len;
+    }
+    if (batch_hook && !batch_hook(true, writes)) {
+        discard_stage();
+        send_write_status(runs, RESP_NACK);
+        return;
+    }
+    bool ok = true;
+    for (uint16_t addr = next_staged_run(0, &len); addr < REG_DIRTY_TRACKED; addr = next_staged_run(addr + len, &len)) {
+        ok &= apply_write(registers, addr, &stage_bank[addr], len);
+    }
+    if (batch_hook) batch_hook(false, 0);
+
+    event_log(LOG_EVT_UART_STAGE_COMMITTED, LOG_NO_AXIS, writes, bytes, runs);
+    discard_stage();
+    send_write_status(runs, ok ? RESP_ACK : RESP_NACK);
+}
+
+// --- Frame Handling ---
+static void process_frame(volatile uint8_t *registers) {
+    uint8_t cmd_type = parser.header[0];
+    uint16_t reg_addr = parser.addr;
+    uint8_t data_len = parser.header[2];
+
+    if (cmd_type == CMD_READ_MULTI) {
+        process_read_multi(registers);
+        return;
+    }
+    if (cmd_type == CMD_SET_BAUD) {
+        process_set_baud();
+        return;
+    }
+    if (cmd_type == CMD_READ_CHANGES) {
+        process_read_changes(registers);
+        return;
+    }
+    if (cmd_type == CMD_STAGE_WRITE) {
+        process_stage_write();
+        return;
+    }
+    if (cmd_type == CMD_STAGE_COMMIT) {
+        process_stage_commit(registers);
+        return;
+    }
+
+    // --- Validate Header ---
+    bool range_ok = reg_addr < REGISTER_MAP_SIZE && (reg_addr + data_len) <= REGISTER_MAP_SIZE;
+    if (range_ok && !parser.wide && reg_addr >= REG_SHORT_ADDR_LIMIT) {
+        event_log(LOG_EVT_UART_NEEDS_ADDR16, LOG_NO_AXIS, 0, reg_addr, 0);
+        range_ok = false;
+    } else if (!range_ok) {
+        event_log(LOG_EVT_UART_BAD_RANGE, LOG_NO_AXIS, 0, reg_addr, data_len);
+    } else if (data_len > UART_MAX_DATA_LEN) {
+        event_log(LOG_EVT_UART_DATA_TOO_LONG, LOG_NO_AXIS, 0, data_len, 0);
+        range_ok = false;
+    }
+
+    // --- Handle READ Command ---
+    if (cmd_type == CMD_READ) {
+        if (!range_ok) return;
+        if (parser.checksum != 0) { // XOR over frame including checksum must be 0
+            event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_READ, 0);
+            return;
+        }
+
+        // Prepare response buffer: [ADDR, LEN, DATA..., CHECKSUM]
+        uint8_t response[RESP_HEADROOM + RESP_ADDR_MAX + 1 + UART_MAX_DATA_LEN + RESP_TAILROOM];
+        uint8_t *body = response + RESP_HEADROOM;
+        size_t pos = put_resp_addr(body, reg_addr);
+        body[pos++] = data_len;
+        const volatile uint8_t *view = read_view(registers);
+        for (size_t i = 0; i < data_len; ++i) {
+            body[pos++] = view[reg_addr + i];
+        }
+        queue_response(response, pos);
+    }
+    // --- Handle WRITE Command ---
+    else if (cmd_type == CMD_WRITE) {
+        if (!range_ok) {
+            send_write_status(reg_addr, RESP_NACK);
+            return;
+        }
+        if (parser.checksum != 0) {
+            event_log(LOG_EVT_UART_CHECKSUM, LOG_NO_AXIS, 0, CMD_WRITE, 0);
+            send_write_status(reg_addr, RESP_NACK);
+            return;
+        }
+        bool ok = apply_write(registers, reg_addr, parser.data, data_len);
+        send_write_status(reg_addr, ok ? RESP_ACK : RESP_NACK);
+    }
+}
 
-            // Calculate checksum over ADDR, LEN, DATA
-            response[2 + data_len] = calculate_checksum(response, 2 + data_len);
+// Number of payload bytes between the header and the checksum. A READ_MULTI
+// count up to 255 takes up to 765 bytes: kept wide so a bogus count cannot
+// wrap into a short payload. Oversized payloads are consumed (or fail the
+// framed length check) and the frame is rejected by process_frame().
+static uint16_t payload_length(uint8_t cmd_type, uint8_t addr_byte, uint8_t len_byte, bool wide) {
+    if (cmd_type == CMD_WRITE || cmd_type == CMD_STAGE_WRITE || cmd_type == CMD_STAGE_COMMIT) return len_byte;
+    if (cmd_type == CMD_READ_MULTI) return (uint16_t)((wide ? 3 : 2) * addr_byte); // (ADDR, LEN) per range
+    return 0;
+}
+
+static bool is_command(uint8_t cmd, bool wide) {
+    if (wide) return cmd == CMD_READ || cmd == CMD_WRITE || cmd == CMD_READ_MULTI;
+    return cmd == CMD_READ || cmd == CMD_WRITE || cmd == CMD_READ_MULTI || cmd == CMD_SET_BAUD ||
+           cmd == CMD_READ_CHANGES || cmd == CMD_STAGE_WRITE || cmd == CMD_STAGE_COMMIT;
+}
 
-            // Send the full response
-            uart_write_blocking(uart, response, 2 + data_len + 1);
+// Address field length after the command (and sequence) byte
+static inline uint8_t addr_field_length(uint8_t cmd, bool wide) {
+    return wide && cmd != CMD_READ_MULTI ? 2 : 1;
+}
+
+// --- Framed Messages ---
+// Split a CRC-checked body into the legacy header/payload and process it.
+// The CRC already vouches for the bytes, so the XOR check is bypassed.
+static void parse_byte(uint8_t byte, volatile uint8_t *registers);
+
+static void process_framed_body(volatile uint8_t *registers) {
+    const uint8_t *body = &parser.raw[1];
+    uint8_t cmd = body[0] & ~(CMD_SEQ_FLAG | CMD_ADDR16_FLAG);
+    uint8_t pos = 1;
+
+    parser.has_seq = (body[0] & CMD_SEQ_FLAG) != 0;
+    parser.wide = (body[0] & CMD_ADDR16_FLAG) != 0;
+    if (parser.has_seq) parser.seq = body[pos++];
+    uint8_t addr_len = addr_field_length(cmd, parser.wide);
+    if (!is_command(cmd, parser.wide) || parser.body_len < pos + addr_len + 1) {
+        event_log(LOG_EVT_UART_BAD_FRAME, LOG_NO_AXIS, 0, body[0], parser.body_len);
+        return;
+    }
+    parser.header[0] = cmd;
+    parser.header[1] = body[pos];
+    parser.addr = addr_len == 2 ? (uint16_t)(body[pos] | (body[pos + 1] << 8)) : body[pos];
+    pos += addr_len;
+    parser.header[2] = body[pos++];
+    parser.expected = payload_length(cmd, parser.header[1], parser.header[2], parser.wide);
+    if (parser.body_len != pos + parser.expected) {
+        event_log(LOG_EVT_UART_BAD_FRAME, LOG_NO_AXIS, 0, body[0], parser.body_len);
+        return;
+    }
+    uint16_t stored = parser.expected < PARSER_DATA_LEN ? parser.expected : PARSER_DATA_LEN;
+    memcpy(parser.data, &body[pos], stored); // Oversized payloads get rejected by process_frame()
 
+    parser.framed = true;
+    link_framed = true;
+    parser.checksum = 0;
+    process_frame(registers);
+}
+
+// Hand the bytes of a rejected frame (everything after its preamble) back to
+// the parser, so a preamble among them is found: after a dropped byte the CRC
+// check runs into the next frame, which must not be lost with it. Between
+// frames only FRAME_SYNC0 counts (framed_only), so the rescan starts at the
+// next one. A frame found there that is rejected too restarts the rescan
+// after its own preamble, in this loop: garbage full of preambles costs at
+// most one pass per preamble over the saved bytes, and no stack.
+static void resync_framed(volatile uint8_t *registers) {
+    uint8_t replay[sizeof(parser.raw)];
+    uint8_t len = parser.raw_len;
+    memcpy(replay, parser.raw, len);
+    uint8_t from = 0;
+    while (parser.rejected) {
+        parser.rejected = false;
+        parser.state = PARSE_CMD;
+        while (from < len && replay[from] != FRAME_SYNC0) from++;
+        uint8_t i = from;
+        while (i < len && !parser.rejected) parse_byte(replay[i++], registers);
+        if (parser.rejected) from = i - parser.raw_len; // Just after the rejected frame's preamble
+    }
+}
+
+// Each byte costs O(1) (CRC by table). A rejected frame is only flagged
+// here; parse_rx_byte() rescans it.
+static void parse_framed_byte(uint8_t byte, volatile uint8_t *registers) {
+    if (parser.state == PARSE_SYNC) {
+        if (byte == FRAME_SYNC1) {
+            parser.state = PARSE_FRAME_LEN;
+            parser.raw_len = 0;
+            framed_only = true; // The master speaks framed: stop parsing legacy frames
+        } else if (byte != FRAME_SYNC0) {
+            parser.state = PARSE_CMD;
         }
-        // --- Handle WRITE Command ---
-        else if (cmd_type == CMD_WRITE) {
-            uint8_t data_buffer[16 + 1]; // Buffer for data + checksum (max 16 data bytes)
-            uint8_t checksum_rx;
+        return;
+    }
+    parser.raw[parser.raw_len++] = byte;
 
-            // Read data (if any) and checksum
-            if (data_len > 0) {
-                // Read data_len bytes into the start of the buffer
-                uart_read_blocking(uart, data_buffer, data_len);
-                // Assume data read successfully if returns
+    switch (parser.state) {
+        case PARSE_FRAME_LEN:
+            if (byte == 0 || byte > UART_MAX_FRAME_BODY) {
+                event_log(LOG_EVT_UART_BAD_FRAME_LEN, LOG_NO_AXIS, 0, byte, 0);
+                parser.state = PARSE_CMD;
+                parser.rejected = true;
+                break;
             }
-            // Read the checksum byte (comes after data, or immediately if data_len is 0)
-            uart_read_blocking(uart, &checksum_rx, 1);
-            // Assume checksum byte read successfully if returns
+            parser.body_len = byte;
+            parser.crc = crc16_update(FRAME_CRC_INIT, byte);
+            parser.state = PARSE_FRAME_BODY;
+            break;
 
+        case PARSE_FRAME_BODY:
+            parser.crc = crc16_update(parser.crc, byte);
+            if (parser.raw_len > parser.body_len) { // LEN byte + body
+                parser.state = PARSE_FRAME_CRC_H;
+            }
+            break;
+
+        case PARSE_FRAME_CRC_H:
+            parser.state = PARSE_FRAME_CRC_L;
+            break;
 
-            // Verify command checksum (CMD ^ ADDR ^ LEN ^ DATA...)
-            uint8_t checksum_calc = header[0] ^ header[1] ^ header[2];
-            if (data_len > 0) {
-                checksum_calc = calculate_checksum(data_buffer, data_len) ^ checksum_calc; // XOR with data checksum part
+        case PARSE_FRAME_CRC_L: {
+            uint16_t crc = (uint16_t)((parser.raw[parser.raw_len - 2] << 8) | byte);
+            if (crc != parser.crc) {
+                event_log(LOG_EVT_UART_CRC, LOG_NO_AXIS, 0, 0, 0);
+                diag_count(DIAG_UART_CHECKSUM_ERROR);
+                parser.state = PARSE_CMD;
+                parser.rejected = true;
+                break;
             }
+            parser.state = PARSE_CMD;
+            baud.confirming = false; // The new rate works
+            diag_count(DIAG_UART_FRAME_OK);
+            process_framed_body(registers);
+            break;
+        }
+
+        default:
+            parser.state = PARSE_CMD;
+            break;
+    }
+}
 
-            if (checksum_calc != checksum_rx) {
-                printf("UART RX Error: Write command checksum mismatch (Calc: %02X, Recv: %02X)\n", checksum_calc, checksum_rx);
-                // Send NACK: [ADDR, 0xFF, CHECKSUM]
-                uint8_t nack_response[3];
-                nack_response[0] = reg_addr;
-                nack_response[1] = 0xFF; // NACK code
-                nack_response[2] = calculate_checksum(nack_response, 2);
-                uart_write_blocking(uart, nack_response, 3);
+static void parse_byte(uint8_t byte, volatile uint8_t *registers) {
+    if (parser.state >= PARSE_SYNC) {
+        parse_framed_byte(byte, registers);
+        return;
+    }
+    if (parser.state == PARSE_CMD && (byte == FRAME_SYNC0 || framed_only)) {
+        if (byte == FRAME_SYNC0) parser.state = PARSE_SYNC; // Other bytes: hunting, skip
+        return;
+    }
+    parser.checksum ^= byte;
+
+    switch (parser.state) {
+        case PARSE_CMD: {
+            uint8_t cmd = byte & ~(CMD_SEQ_FLAG | CMD_ADDR16_FLAG);
+            bool wide = (byte & CMD_ADDR16_FLAG) != 0;
+            if (!is_command(cmd, wide)) {
+                // Unknown command: drop it and look for a valid command byte
+                event_log(LOG_EVT_UART_UNKNOWN_CMD, LOG_NO_AXIS, 0, byte, 0);
+                parser.checksum = 0;
                 return;
             }
+            parser.header[0] = cmd;
+            parser.wide = wide;
+            parser.framed = false;
+            parser.has_seq = (byte & CMD_SEQ_FLAG) != 0;
+            parser.state = parser.has_seq ? PARSE_SEQ : PARSE_ADDR;
+            break;
+        }
+
+        case PARSE_SEQ:
+            parser.seq = byte;
+            parser.state = PARSE_ADDR;
+            break;
+
+        case PARSE_ADDR:
+            parser.header[1] = byte;
+            parser.addr = byte;
+            parser.state = addr_field_length(parser.header[0], parser.wide) == 2 ? PARSE_ADDR_H : PARSE_LEN;
+            break;
+
+        case PARSE_ADDR_H:
+            parser.addr |= (uint16_t)byte << 8;
+            parser.state = PARSE_LEN;
+            break;
 
-            // Checksum OK, write data to registers if data_len > 0
-            if (data_len > 0) {
-                // ** CRITICAL SECTION START (if registers modified by interrupts) **
-                // uint32_t saved_irq = save_and_disable_interrupts();
-                // Copy data byte-by-byte to volatile registers
-                for (size_t i = 0; i < data_len; ++i) {
-                    registers[reg_addr + i] = data_buffer[i]; // Direct volatile write
-                }
-                // ** CRITICAL SECTION END **
-                // restore_interrupts(saved_irq);
+        case PARSE_LEN:
+            parser.header[2] = byte;
+            parser.expected = payload_length(parser.header[0], parser.header[1], byte, parser.wide);
+            parser.received = 0;
+            parser.state = parser.expected ? PARSE_DATA : PARSE_CHECKSUM;
+            break;
+
+        case PARSE_DATA:
+            // Oversized payloads are consumed but not stored (frame gets rejected)
+            if (parser.received < PARSER_DATA_LEN) {
+                parser.data[parser.received] = byte;
+            }
+            if (++parser.received >= parser.expected) {
+                parser.state = PARSE_CHECKSUM;
             }
+            break;
 
-            // Send ACK: [ADDR, 0x00, CHECKSUM]
-            uint8_t ack_response[3];
-            ack_response[0] = reg_addr;
-            ack_response[1] = 0x00; // Success code
-            ack_response[2] = calculate_checksum(ack_response, 2);
-            uart_write_blocking(uart, ack_response, 3);
+        case PARSE_CHECKSUM:
+            if (parser.checksum == 0) {
+                baud.confirming = false; // The new rate works
+                link_framed = false;
+                diag_count(DIAG_UART_FRAME_OK);
+            } else {
+                diag_count(DIAG_UART_CHECKSUM_ERROR);
+            }
+            process_frame(registers);
+            parser.state = PARSE_CMD;
+            parser.checksum = 0;
+            break;
 
-        } else {
-            printf("UART RX Error: Unknown command type %02X\n", cmd_type);
-            // Unknown command - we don't know how many bytes might follow.
-            // Maybe NACK? Maybe try to flush UART input? Difficult to recover gracefully.
-            // Consider sending a specific NACK for unknown command if defined.
+        default:
+            break; // Framed states, handled by parse_framed_byte()
+    }
+}
+
+// One received byte, rescanning a framed message it got rejected with
+static void parse_rx_byte(uint8_t byte, volatile uint8_t *registers) {
+    parse_byte(byte, registers);
+    if (parser.rejected) resync_framed(registers);
+}
+
+// --- UART Processing ---
+void handle_uart_rx(uart_inst_t *uart, volatile uint8_t *registers) {
+    (void)uart; // The RX IRQ (or usb_poll()) fills rx_buffer: nothing is read from it here
+#if STEPPER_USB_TRANSPORT
+    usb_poll();
+#endif
+    uint32_t now = time_us_32();
+    update_baud(now);
+    uint32_t head = rx_head;
+
+    if (head == rx_tail) {
+        // Nothing buffered: abandon a partial frame if the sender went quiet
+        if (parser.state != PARSE_CMD && (now - parser.last_byte_time) > UART_FRAME_TIMEOUT_US) {
+            event_log(LOG_EVT_UART_FRAME_TIMEOUT, LOG_NO_AXIS, 0, 0, 0);
+            parser.state = PARSE_CMD;
+            parser.checksum = 0;
         }
+        if (framed_only && (now - parser.last_byte_time) > UART_LEGACY_RESUME_US) {
+            framed_only = false; // A (restarted) master may use legacy frames again
+        }
+        if (latched && (now - parser.last_byte_time) > UART_LATCH_TIMEOUT_US) {
+            event_log(LOG_EVT_UART_LATCH_TIMEOUT, LOG_NO_AXIS, 0, 0, 0);
+            registers[REG_LATCH_CONTROL] = 0;
+            latched = false;
+        }
+        return;
+    }
+
+    while (rx_tail != head) {
+        parse_rx_byte(rx_buffer[rx_tail & RX_MASK], registers);
+        rx_tail++;
     }
-    // No data available to read when uart_is_readable() was checked
+    parser.last_byte_time = now;
+}
+
+bool uart_protocol_busy(void) {
+    if (rx_head != rx_tail) return true;
+#if STEPPER_USB_TRANSPORT
+    return tx_head != tx_tail; // Left over from a full CDC FIFO
+#else
+    return baud.pending != 0; // Waits for the UART to drain, no IRQ for that
+#endif
 }
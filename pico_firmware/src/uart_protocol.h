@@ -10,16 +10,178 @@
 // Pico -> Master (Read): [REG_ADDR] [DATA_LEN] [DATA_0] ... [DATA_N] [CHECKSUM]
 // Pico -> Master (Write ACK): [REG_ADDR] [0x00] [CHECKSUM]
 // Pico -> Master (Write NACK): [REG_ADDR] [0xFF] [CHECKSUM]
+//
+// Multi-range read (several disjoint register ranges in one transaction):
+// Master -> Pico: [CMD_READ_MULTI] [COUNT] [TOTAL_LEN] [ADDR_0] [LEN_0] ... [ADDR_N] [LEN_N] [CHECKSUM]
+// Pico -> Master: [COUNT] [TOTAL_LEN] [DATA of range 0] ... [DATA of range N] [CHECKSUM]
+// TOTAL_LEN is the sum of all LEN_x. Invalid requests get no response (like CMD_READ).
+//
+// Sequenced commands (lets the master keep several commands in flight):
+// Setting CMD_SEQ_FLAG in the command byte inserts a sequence byte after it,
+//     Master -> Pico: [CMD | CMD_SEQ_FLAG] [SEQ] [rest of the frame as above]
+// and the response to that frame is prefixed the same way,
+//     Pico -> Master: [RESP_SEQ_MARKER] [SEQ] [response as above]
+// with the checksum covering the prefix. Frames are processed in order.
+//
+// 16-bit addresses (register maps of 3-4 axes reach past 0xFB): setting
+// CMD_ADDR16_FLAG in a READ or WRITE command byte makes the address field two
+// bytes, little endian, and the response starts with RESP_ADDR16_MARKER:
+//     Master -> Pico: [CMD | CMD_ADDR16_FLAG] [ADDR_L] [ADDR_H] [DATA_LEN] [DATA...] [CHECKSUM]
+//     Pico -> Master (Read):  [RESP_ADDR16_MARKER] [ADDR_L] [ADDR_H] [DATA_LEN] [DATA...] [CHECKSUM]
+//     Pico -> Master (Write): [RESP_ADDR16_MARKER] [ADDR_L] [ADDR_H] [ACK/NACK] [CHECKSUM]
+// On CMD_READ_MULTI the flag makes every range (ADDR_L, ADDR_H, LEN); the
+// response is unchanged. The flag combines with CMD_SEQ_FLAG (sequence byte
+// first) and the framed protocol. Short-form READ/WRITE must start below
+// REG_SHORT_ADDR_LIMIT, so a response never begins with a marker byte.
+//
+// Framed (v2) protocol: any of the frames above minus its XOR checksum byte,
+// wrapped in a sync preamble, a length and a CRC-16:
+//     [FRAME_SYNC0] [FRAME_SYNC1] [LEN] [BODY (LEN bytes)] [CRC_H] [CRC_L]
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, big endian on the wire) over
+// LEN and BODY. The Pico answers in the format of the request, and once the
+// master speaks framed, telemetry is framed too (see uart_send_frame()).
+// FRAME_SYNC0 is never a legacy command byte, so both formats share the line.
+// After a dropped byte or a bad CRC the parser hunts for the next preamble:
+// the next intact frame is handled, nothing needs flushing. Once a preamble
+// has been seen, legacy frames are ignored (stray bytes would otherwise parse
+// as legacy commands) until the line has been quiet for UART_LEGACY_RESUME_US.
+//
+// Baud rate switch (the link always starts at UART_DEFAULT_BAUD):
+// Master -> Pico: [CMD_SET_BAUD] [BAUD_CODE] [0x00] [CHECKSUM]
+// Pico -> Master: [BAUD_CODE] [ACK/NACK] [CHECKSUM]   (still at the old rate)
+// BAUD_CODE indexes UART_BAUD_TABLE. The Pico changes rate as soon as the ACK
+// has left the UART; the master follows once it has received the ACK. Unless a
+// frame with a valid checksum arrives within UART_BAUD_CONFIRM_TIMEOUT_US, the
+// Pico falls back to UART_DEFAULT_BAUD. Over USB CDC the rate means nothing:
+// the command is acknowledged and ignored.
+//
+// Changed registers (fetch only what the firmware changed since the last fetch):
+// Master -> Pico: [CMD_READ_CHANGES] [0x00] [MAX_LEN] [CHECKSUM]
+// Pico -> Master: [RUNS] [PAYLOAD_LEN] [ADDR_L] [ADDR_H] [LEN] [DATA...] ... [CHECKSUM]
+// The payload holds RUNS runs of consecutive registers (at most MAX_LEN bytes
+// with their headers, 0 = UART_MAX_CHANGES_LEN); RESP_CHANGES_MORE is set in
+// RUNS if changes are left for another fetch. Changes are what the firmware
+// wrote (status, positions, driver readback), not the master's own writes;
+// the diagnostics block is not tracked (see reg_dirty.h). A returned byte
+// counts as fetched once the response is queued: after a lost response, read
+// the registers in full. After boot every tracked register counts as changed.
+// No CMD_ADDR16_FLAG form (run addresses are always 16-bit).
+//
+// Staged bulk write (several registers applied as one, e.g. a config push):
+// Master -> Pico: [CMD_STAGE_WRITE] [RUNS | STAGE_BEGIN] [PAYLOAD_LEN] [ADDR_L] [ADDR_H] [LEN] [DATA...] ... [CHECKSUM]
+// Pico -> Master: [RUNS | STAGE_BEGIN] [ACK/NACK] [CHECKSUM]
+// Master -> Pico: [CMD_STAGE_COMMIT] [RUNS] [0x02] [CRC_H] [CRC_L] [CHECKSUM]
+// Pico -> Master: [RUNS] [ACK/NACK] [CHECKSUM]
+// Runs (READ_CHANGES layout, below REG_DIRTY_TRACKED) go into a shadow bank,
+// not the map. STAGE_BEGIN discards anything staged before; a STAGE_WRITE
+// without it adds to the open stage. The commit names the runs staged since
+// STAGE_BEGIN and the CRC-16/CCITT-FALSE (FRAME_CRC_INIT) over the payloads of
+// those STAGE_WRITE frames, in order. If both match, every staged byte is
+// written to the map within the one frame and reaches core 1 in one replay
+// (see register_batch_hook_t); otherwise nothing is written. Any NACK, and
+// every commit, discards the stage: start over with STAGE_BEGIN.
+// No CMD_ADDR16_FLAG form.
+//
+// Consistency: each frame is handled in one go, so a READ or READ_MULTI always
+// returns one consistent snapshot of the map. To read more than fits in one
+// frame, write 1 to REG_LATCH_CONTROL: the map is copied and all reads come
+// from the copy (writes update both) until 0 is written or UART_LATCH_TIMEOUT_US
+// passes without a frame.
+//
+// RX bytes are collected by the UART IRQ into a ring buffer and parsed
+// incrementally by handle_uart_rx(); responses are queued and sent by DMA.
+// Neither side ever blocks on the serial line.
+//
+// Built with STEPPER_USB_TRANSPORT=1 the same frames run over a USB CDC
+// interface (TinyUSB) instead: handle_uart_rx() runs the device stack and moves
+// bytes between the CDC FIFOs and the same ring buffers. The uart_inst_t
+// arguments are then unused.
 
 // Example Command Bytes
 #define CMD_READ  0x01
 #define CMD_WRITE 0x02
+#define CMD_READ_MULTI 0x03
+#define CMD_SET_BAUD   0x04
+#define CMD_READ_CHANGES 0x05
+#define CMD_STAGE_WRITE  0x06
+#define CMD_STAGE_COMMIT 0x07
+#define CMD_SEQ_FLAG   0x80 // OR'd into any command byte: frame carries a sequence ID
+#define CMD_ADDR16_FLAG 0x40 // OR'd into READ/WRITE/READ_MULTI: 16-bit register addresses
+
+// Response status codes
+#define RESP_ACK  0x00
+#define RESP_NACK 0xFF
+#define RESP_SEQ_MARKER 0xFD // First byte of a sequenced response (never a register address)
+#define RESP_ADDR16_MARKER 0xFC // First byte of a 16-bit address READ/WRITE response
+#define REG_SHORT_ADDR_LIMIT 0xFC // Short-form READ/WRITE addresses stay below the markers
+#define RESP_CHANGES_MORE 0x80 // READ_CHANGES RUNS flag: more changes pending
+#define STAGE_BEGIN       0x80 // STAGE_WRITE RUNS flag: discard the stage first
+
+// Framed protocol
+#define FRAME_SYNC0     0xAA
+#define FRAME_SYNC1     0x55
+#define FRAME_CRC_INIT  0xFFFF
+#define FRAME_CRC_POLY  0x1021
+
+// --- Limits ---
+#define UART_MAX_DATA_LEN       16      // Max data bytes per READ/WRITE frame
+#define UART_MAX_MULTI_RANGES   8       // Max ranges per READ_MULTI (2 payload bytes each, 3 with CMD_ADDR16_FLAG)
+#define UART_MAX_MULTI_DATA_LEN 32      // Max total data bytes per READ_MULTI response
+#define UART_MAX_FRAME_BODY     100     // Max BODY bytes of a framed message (a full STAGE_WRITE)
+#define UART_MAX_CHANGES_LEN    40      // Max payload of a READ_CHANGES response (fits a sequenced frame)
+#define CHANGES_RUN_HEADER      3       // ADDR_L, ADDR_H, LEN in front of each READ_CHANGES/STAGE_WRITE run
+#define UART_MAX_STAGE_LEN      96      // Max payload of a STAGE_WRITE frame (the whole config of 4 axes)
+#define UART_RX_BUFFER_SIZE     256     // Must be a power of 2
+#define UART_TX_BUFFER_SIZE     256     // Must be a power of 2
+#define UART_FRAME_TIMEOUT_US   20000   // Drop a partial frame after this much silence
+#define UART_LATCH_TIMEOUT_US   500000  // Release a forgotten read latch after this much silence
+#define UART_LEGACY_RESUME_US   500000  // Accept legacy frames again after this much silence (framed mode)
+
+// --- Baud Rates ---
+#define UART_DEFAULT_BAUD       115200
+#define UART_BAUD_TABLE         { 115200, 230400, 460800, 921600, 1000000, 2000000, 3000000 } // CMD_SET_BAUD codes
+#define UART_BAUD_CONFIRM_TIMEOUT_US 1000000 // Fall back to UART_DEFAULT_BAUD without a valid frame at the new rate
+
+// Set up the RX interrupt, ring buffers and TX DMA channel.
+// Call after uart_init(uart, UART_DEFAULT_BAUD) and the GPIO function setup.
+// USB transport: starts the TinyUSB device stack ('uart' unused).
+void init_uart_protocol(uart_inst_t *uart);
 
 // Function to process incoming UART data and update/read registers
-// This should be called periodically from the main loop or triggered by UART RX interrupt
+// Parses whatever bytes the RX IRQ has buffered and returns immediately.
+// Call periodically from the main loop.
 void handle_uart_rx(uart_inst_t *uart, volatile uint8_t *registers);
 
+// True if handle_uart_rx() has work no interrupt will announce: bytes not yet
+// parsed, a baud rate switch waiting for the ACK to leave, or (USB) responses
+// not yet taken by the CDC FIFO. Otherwise the core may sleep (idle.h).
+bool uart_protocol_busy(void);
+
+// Called after a WRITE frame has been applied to the register map, before the
+// ACK is sent. Returning false turns the ACK into a NACK (e.g. queue full).
+// Lets modules act on a write immediately instead of polling the registers.
+typedef bool (*register_write_hook_t)(uint16_t reg_addr, uint8_t len, volatile uint8_t *registers);
+void uart_protocol_set_write_hook(register_write_hook_t hook);
+
+// Brackets the write hook calls of a staged commit: called with begin = true
+// and the number of hook calls to come (false = can't take them all, the
+// commit is NACKed before anything is written), then with begin = false.
+typedef bool (*register_batch_hook_t)(bool begin, uint8_t writes);
+void uart_protocol_set_batch_hook(register_batch_hook_t hook);
+
+// Queue bytes for DMA transmission. Returns false (nothing queued) if the
+// TX buffer does not have room for the whole frame.
+bool uart_tx_queue(const uint8_t *data, size_t len);
+
+// Send an unsolicited frame (e.g. telemetry). 'body' is the frame without its
+// checksum; it goes out with an XOR checksum, or in the CRC-16 envelope once
+// the master has sent a framed request. Returns false if the TX ring is full.
+bool uart_send_frame(const uint8_t *body, size_t len);
+
 // Function to calculate checksum (example: simple XOR)
 uint8_t calculate_checksum(const uint8_t *data, size_t len);
 
+// CRC-16/CCITT-FALSE over 'data', continuing from 'crc' (FRAME_CRC_INIT to start)
+uint16_t frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
 #endif // UART_PROTOCOL_H
@@ -0,0 +1,103 @@
+#include "tusb.h"
+#include "pico/unique_id.h"
+#include <string.h> // For strlen
+
+// USB descriptors for the STEPPER_USB_TRANSPORT build: a single CDC ACM
+// interface (shows up as /dev/ttyACM* on the Pi). The serial number string is
+// the flash unique ID, so several controllers can be told apart by udev.
+
+// --- IDs ---
+#define USB_VID     0x2E8A  // Raspberry Pi
+#define USB_PID     0x000A  // Pico SDK CDC
+#define USB_BCD     0x0200
+
+enum {
+    ITF_NUM_CDC = 0,
+    ITF_NUM_CDC_DATA,
+    ITF_NUM_TOTAL
+};
+
+#define EPNUM_CDC_NOTIF 0x81
+#define EPNUM_CDC_OUT   0x02
+#define EPNUM_CDC_IN    0x82
+
+enum {
+    STRID_LANGID = 0,
+    STRID_MANUFACTURER,
+    STRID_PRODUCT,
+    STRID_SERIAL,
+    STRID_CDC,
+};
+
+// --- Device Descriptor ---
+static const tusb_desc_device_t desc_device = {
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = USB_BCD,
+    // Interface association (required for CDC on some hosts)
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor           = USB_VID,
+    .idProduct          = USB_PID,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = STRID_MANUFACTURER,
+    .iProduct           = STRID_PRODUCT,
+    .iSerialNumber      = STRID_SERIAL,
+    .bNumConfigurations = 1
+};
+
+const uint8_t *tud_descriptor_device_cb(void) {
+    return (const uint8_t *)&desc_device;
+}
+
+// --- Configuration Descriptor ---
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN)
+
+static const uint8_t desc_configuration[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE),
+};
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index) {
+    (void)index;
+    return desc_configuration;
+}
+
+// --- String Descriptors ---
+static const char *const desc_strings[] = {
+    [STRID_MANUFACTURER] = "Raspberry Pi",
+    [STRID_PRODUCT]      = "Pico Stepper Controller",
+    [STRID_SERIAL]       = NULL, // Filled from the flash unique ID
+    [STRID_CDC]          = "Stepper Protocol",
+};
+
+static uint16_t desc_str[32 + 1];
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    (void)langid;
+    char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    const char *str;
+    uint8_t len;
+
+    if (index == STRID_LANGID) {
+        desc_str[1] = 0x0409; // English
+        len = 1;
+    } else {
+        if (index >= sizeof(desc_strings) / sizeof(desc_strings[0])) return NULL;
+        if (index == STRID_SERIAL) {
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            str = serial;
+        } else {
+            str = desc_strings[index];
+        }
+        len = (uint8_t)strlen(str);
+        if (len > 32) len = 32;
+        for (uint8_t i = 0; i < len; i++) desc_str[1 + i] = str[i]; // ASCII to UTF-16
+    }
+
+    // First element: length (bytes, incl. header) and descriptor type
+    desc_str[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * len + 2));
+    return desc_str;
+}
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""
+Generates the register map constants from registers.json:
+  - a C header (register_map.h, included by src/registers.h), generated by the
+    firmware build for its STEPPER_NUM_AXES
+  - the agent's Python constants (rpi_zero_agent/registers.py)
+
+Usage (from pico_firmware/):
+    python3 tools/regmap_gen.py --axes 2 --c-header build/generated/register_map.h
+    python3 tools/regmap_gen.py --axes 2 --python ../rpi_zero_agent/registers.py
+
+The agent's copy must be generated for the axis count the Pico was built with.
+The layout is checked on the way: overlapping registers, axis fields outside
+the stride, globals running into the first axis block.
+"""
+import argparse
+import json
+import os
+import sys
+
+BYTE_SUFFIXES = {2: ['_L', '_H'], 4: ['_L', '_M', '_H', '_U']}
+ADDR_SPACE = 0x10000 # 16-bit addresses (CMD_ADDR16_FLAG above 0xFB, see uart_protocol.h)
+
+def parse_int(value):
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+def load_map(path):
+    with open(path) as f:
+        desc = json.load(f)
+    for section, key in (('global', 'addr'), ('axis', 'offset'), ('diag', 'offset')):
+        for entry in desc[section]:
+            if 'name' in entry:
+                entry['pos'] = parse_int(entry[key])
+    desc['axis_base'] = parse_int(desc['axis_base'])
+    desc['axis_stride'] = parse_int(desc['axis_stride'])
+    return desc
+
+def registers(entries):
+    return [e for e in entries if 'name' in e]
+
+def block_size(entries):
+    return max(e['pos'] + e['size'] for e in registers(entries))
+
+def check_overlaps(section, entries):
+    used = {}
+    for e in registers(entries):
+        for pos in range(e['pos'], e['pos'] + e['size']):
+            if pos in used:
+                raise ValueError(f"{section}: {e['name']} overlaps {used[pos]} at offset {pos:#04x}")
+            used[pos] = e['name']
+
+def layout(desc, axes):
+    """Validates the description for 'axes' axes; returns (diag_base, map_size)."""
+    if not 1 <= axes <= desc['max_axes']:
+        raise ValueError(f"Axis count {axes} out of range (1-{desc['max_axes']})")
+    for section in ('global', 'axis', 'diag'):
+        check_overlaps(section, desc[section])
+    if block_size(desc['global']) > desc['axis_base']:
+        raise ValueError(f"Global registers run into the first axis block at {desc['axis_base']:#04x}")
+    if block_size(desc['axis']) > desc['axis_stride']:
+        raise ValueError(f"Axis registers ({block_size(desc['axis'])} bytes) exceed the stride {desc['axis_stride']:#04x}")
+    diag_base = desc['axis_base'] + axes * desc['axis_stride']
+    map_size = diag_base + block_size(desc['diag'])
+    if map_size > ADDR_SPACE:
+        raise ValueError(f"Register map ({map_size} bytes) exceeds the address space")
+    return diag_base, map_size
+
+def byte_names(e):
+    """(suffixed name, offset into the register, comment) for each define."""
+    size = e['size']
+    access = e['access']
+    if size == 1:
+        first = f"{access} (1 byte)"
+        return [('', 0, first + (f": {e['doc']}" if e['doc'] else ''))]
+    first = f"{access} ({size} bytes total)" + (f": {e['doc']}" if e['doc'] else '')
+    if size in BYTE_SUFFIXES:
+        return [(s, i, first if i == 0 else access) for i, s in enumerate(BYTE_SUFFIXES[size])]
+    return [('', 0, first), ('_END', size - 1, f"{access} (last byte)")]
+
+# --- C Header ---
+def c_define(name, value, comment):
+    line = f"#define {name:<31} {value}"
+    return f"{line} // {comment}" if comment else line
+
+def gen_c(desc, axes, source):
+    diag_base, map_size = layout(desc, axes)
+    out = [
+        f"// Generated by tools/regmap_gen.py from {source} (--axes {axes}). Do not edit.",
+        "#ifndef REGISTER_MAP_H",
+        "#define REGISTER_MAP_H",
+        "",
+        c_define('REG_NUM_AXES', axes, 'STEPPER_NUM_AXES'),
+        "",
+    ]
+    for e in desc['global']:
+        if 'group' in e:
+            out += ["", f"// {e['group']}"] if out[-1] else [f"// {e['group']}"]
+            continue
+        for suffix, i, comment in byte_names(e):
+            out.append(c_define(f"REG_{e['name']}{suffix}", f"0x{e['pos'] + i:02X}", comment))
+
+    out += [
+        "",
+        "// --- Axis Blocks ---",
+        "// Axis n (0-based, motor n + 1) occupies REG_AXIS(n) ... REG_AXIS(n) + REG_AXIS_STRIDE - 1.",
+        c_define('REG_AXIS_BASE', f"0x{desc['axis_base']:02X}", ''),
+        c_define('REG_AXIS_STRIDE', f"0x{desc['axis_stride']:02X}", ''),
+        "#define REG_AXIS(axis)                  (REG_AXIS_BASE + (axis) * REG_AXIS_STRIDE)",
+    ]
+    for e in desc['axis']:
+        if 'group' in e:
+            out += ["", f"// {e['group']}"]
+            continue
+        for suffix, i, comment in byte_names(e):
+            out.append(c_define(f"REG_MOTOR_{e['name']}{suffix}(axis)", f"(REG_AXIS(axis) + 0x{e['pos'] + i:02X})", comment))
+
+    out += ["", "// --- Diagnostics Block (after the last axis block) ---",
+            c_define('REG_DIAG_BASE', f"0x{diag_base:02X}", '')]
+    for e in desc['diag']:
+        if 'group' in e:
+            out.append(f"// {e['group']}")
+            continue
+        for suffix, i, comment in byte_names(e):
+            out.append(c_define(f"REG_DIAG_{e['name']}{suffix}", f"0x{diag_base + e['pos'] + i:02X}", comment))
+
+    out += [
+        "",
+        "// --- Register Map Size ---",
+        c_define('REGISTER_MAP_SIZE', f"0x{map_size:02X}", '1 + the address of the last byte used'),
+        "",
+        "#endif // REGISTER_MAP_H",
+        "",
+    ]
+    return "\n".join(out)
+
+# --- Python Constants ---
+def py_const(name, value, comment):
+    line = f"{name} = {value}"
+    return f"{line} # {comment}" if comment else line
+
+def gen_python(desc, axes, source):
+    diag_base, map_size = layout(desc, axes)
+    out = [
+        f'"""Register map of the Pico firmware. Generated by pico_firmware/tools/regmap_gen.py',
+        f'from pico_firmware/{source} (--axes {axes}). Do not edit; regenerate for the',
+        f'STEPPER_NUM_AXES the Pico runs."""',
+        "",
+        py_const('NUM_AXES', axes, ''),
+        py_const('AXIS_BASE', f"0x{desc['axis_base']:02X}", ''),
+        py_const('AXIS_STRIDE', f"0x{desc['axis_stride']:02X}", ''),
+        py_const('REGISTER_MAP_SIZE', f"0x{map_size:02X}", ''),
+        "",
+        "def axis_reg(axis, offset):",
+        '    """Address of a per-axis register: axis 0..NUM_AXES-1 (motor number - 1), offset AXIS_*."""',
+        "    if not 0 <= axis < NUM_AXES:",
+        "        raise ValueError(f\"Axis {axis} out of range (0-{NUM_AXES - 1})\")",
+        "    return AXIS_BASE + axis * AXIS_STRIDE + offset",
+        "",
+        "# --- Global Registers ---",
+    ]
+    for e in registers(desc['global']):
+        for suffix, i, comment in byte_names(e):
+            out.append(py_const(f"REG_{e['name']}{suffix}", f"0x{e['pos'] + i:02X}", comment))
+    out += ["", "# --- Per-Axis Registers (offsets into an axis block, see axis_reg()) ---"]
+    for e in registers(desc['axis']):
+        for suffix, i, comment in byte_names(e):
+            out.append(py_const(f"AXIS_{e['name']}{suffix}", f"0x{e['pos'] + i:02X}", comment))
+    out += ["", "# --- Diagnostics Block ---", py_const('REG_DIAG_BASE', f"0x{diag_base:02X}", '')]
+    for e in registers(desc['diag']):
+        for suffix, i, comment in byte_names(e):
+            out.append(py_const(f"REG_DIAG_{e['name']}{suffix}", f"0x{diag_base + e['pos'] + i:02X}", comment))
+    out.append("")
+    return "\n".join(out)
+
+def write_if_changed(path, text):
+    """Keeps the timestamp (and the build) untouched if nothing changed."""
+    if os.path.exists(path):
+        with open(path, newline='') as f:
+            if f.read() == text:
+                return
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, 'w', newline='') as f:
+        f.write(text)
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description="Generate register map constants from registers.json")
+    parser.add_argument('--map', default=os.path.join(here, '..', 'registers.json'), help="Register map description")
+    parser.add_argument('--axes', type=int, default=2, help="Number of motor axes (STEPPER_NUM_AXES)")
+    parser.add_argument('--c-header', help="Write the C header here")
+    parser.add_argument('--python', help="Write the Python module here")
+    parser.add_argument('--crlf', action='store_true', help="CRLF line endings (files committed to the repo)")
+    args = parser.parse_args()
+
+    try:
+        desc = load_map(args.map)
+        source = os.path.basename(args.map)
+        newline = "\r\n" if args.crlf else "\n"
+        if args.c_header:
+            write_if_changed(args.c_header, gen_c(desc, args.axes, source).replace("\n", newline))
+        if args.python:
+            write_if_changed(args.python, gen_python(desc, args.axes, source).replace("\n", newline))
+        if not args.c_header and not args.python:
+            layout(desc, args.axes) # Validate only
+    except (OSError, ValueError, KeyError) as e:
+        print(f"regmap_gen: {e}", file=sys.stderr)
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
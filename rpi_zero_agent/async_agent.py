@@ -0,0 +1,152 @@
+import asyncio
+import itertools
+import logging
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+logger = logging.getLogger("AsyncAgent")
+
+# --- Job Priorities (lower runs first) ---
+PRIORITY_STOP = 0          # Stops and queue flushes jump ahead of everything
+PRIORITY_COMMAND = 1       # Motion commands
+PRIORITY_BACKGROUND = 2    # Config, diagnostics
+PRIORITY_STATUS = 3        # Status polls: only when nothing else waits
+
+STOP_ACTIONS = {'stop_move', 'coord_stop', 'flush_queue'}
+BACKGROUND_ACTIONS = {'resend_config', 'read_diagnostics', 'reset_diagnostics'}
+LATENCY_WARN_S = 0.010     # Command-to-wire target on the Pi Zero
+
+def command_priority(payload):
+    action = payload.get('action') if isinstance(payload, dict) else None
+    if action in STOP_ACTIONS:
+        return PRIORITY_STOP
+    if action in BACKGROUND_ACTIONS:
+        return PRIORITY_BACKGROUND
+    return PRIORITY_COMMAND
+
+class AsyncAgent:
+    """
+    Event-driven agent loop (AgentMode = async). Everything that touches the
+    serial port is a job in one priority queue, run one at a time by a single
+    serial task on a dedicated worker thread (pyserial blocks), so the event
+    loop never waits on the line and a job never waits behind more than the
+    transaction in flight. Status polls are small (one change fetch) and
+    queued at the lowest priority, at most one at a time.
+    MQTT stays on paho's network thread; its callbacks only hand commands
+    over to the loop (call_soon_threadsafe) and return.
+    command_transactions(payload) splits a command into blocking jobs, one
+    per serial transaction, queued together: a stop can run between two of
+    them, and then drops the rest. poll_status() is the status job body.
+    resend_config fetches from the backend (HTTP) on a worker of its own and
+    only queues apply_config(config) on the serial worker.
+    """
+    def __init__(self, mqtt_client, command_transactions, poll_status, status_period_s, stop_event,
+                 fetch_config, apply_config):
+        self.mqtt_client = mqtt_client
+        self.command_transactions = command_transactions
+        self.poll_status = poll_status
+        self.fetch_config = fetch_config
+        self.apply_config = apply_config
+        self.status_period_s = status_period_s
+        self.stop_event = stop_event
+        self._loop = None
+        self._queue = None
+        self._order = itertools.count() # FIFO within a priority
+        self._status_queued = False
+        self._stops_run = 0             # Stop jobs started so far (counted by the serial task)
+        self._fetches = set()           # Backend fetches in flight
+        self._executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix="SerialJob")
+        self._backend_executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix="BackendFetch")
+
+    # --- Job Submission ---
+    def _submit(self, priority, description, job, received_at=None):
+        self._queue.put_nowait((priority, next(self._order), received_at, description, job))
+
+    def _on_mqtt_command(self, payload):
+        """Runs on paho's network thread: timestamp and hand over, nothing else."""
+        received_at = time.monotonic()
+        self._loop.call_soon_threadsafe(self._submit_command, payload, received_at)
+
+    def _submit_command(self, payload, received_at):
+        priority = command_priority(payload)
+        action = payload.get('action') if isinstance(payload, dict) else payload
+        if action == 'resend_config':
+            fetch = self._loop.create_task(self._resend_config(received_at))
+            self._fetches.add(fetch)
+            fetch.add_done_callback(self._fetches.discard)
+            return
+        jobs = self.command_transactions(payload)
+        state = {'stops': None} # Stops run as of the last transaction, None once one failed
+        def transaction(n, job):
+            def run():
+                if n > 0 and state['stops'] != self._stops_run:
+                    logger.info(f"command {action}: dropped transaction {n + 1}/{len(jobs)}")
+                    return
+                state['stops'] = None # Refused (False) or raised: drop the rest
+                if job() is not False:
+                    state['stops'] = self._stops_run
+            return run
+        for n, job in enumerate(jobs):
+            # Only the first transaction measures the MQTT latency
+            self._submit(priority, f"command {action}", transaction(n, job), received_at if n == 0 else None)
+
+    async def _resend_config(self, received_at):
+        try:
+            config_data = await self._loop.run_in_executor(self._backend_executor, self.fetch_config)
+        except Exception as e:
+            logger.error(f"Configuration fetch failed: {e}", exc_info=True)
+            return
+        self._submit(PRIORITY_BACKGROUND, "command resend_config", lambda: self.apply_config(config_data), received_at)
+
+    # --- Tasks ---
+    async def _serial_task(self):
+        while True:
+            priority, _, received_at, description, job = await self._queue.get()
+            if priority == PRIORITY_STOP:
+                self._stops_run += 1
+            if priority == PRIORITY_STATUS:
+                self._status_queued = False
+            elif priority <= PRIORITY_COMMAND and received_at is not None:
+                latency = time.monotonic() - received_at
+                log = logger.warning if latency > LATENCY_WARN_S else logger.debug
+                log(f"{description}: {latency * 1000:.1f} ms from MQTT to the serial worker")
+            try:
+                await self._loop.run_in_executor(self._executor, job)
+            except Exception as e:
+                logger.error(f"Serial job '{description}' failed: {e}", exc_info=True)
+
+    async def _status_task(self):
+        while True:
+            if not self._status_queued: # Coalesce: a poll still waiting covers this tick too
+                self._status_queued = True
+                self._submit(PRIORITY_STATUS, "status poll", self.poll_status)
+            await asyncio.sleep(self.status_period_s)
+
+    async def _monitor_task(self):
+        last_check = 0.0
+        while not self.stop_event.is_set():
+            now = time.monotonic()
+            if now - last_check >= 5.0:
+                last_check = now
+                if not self.mqtt_client.is_connected():
+                    logger.warning("MQTT disconnected. Attempting reconnect...")
+                    self.mqtt_client.connect() # connect_async: returns immediately
+            await asyncio.sleep(0.2)
+
+    async def run(self):
+        """Runs until stop_event is set."""
+        self._loop = asyncio.get_running_loop()
+        self._queue = asyncio.PriorityQueue()
+        self.mqtt_client.set_command_callback(self._on_mqtt_command)
+        logger.info("Async agent running.")
+        tasks = [asyncio.create_task(self._serial_task(), name="serial"),
+                 asyncio.create_task(self._status_task(), name="status")]
+        try:
+            await self._monitor_task()
+        finally:
+            for task in tasks + list(self._fetches):
+                task.cancel()
+            await asyncio.gather(*tasks, *self._fetches, return_exceptions=True)
+            self._executor.shutdown(wait=True) # Let the transaction in flight finish
+            self._backend_executor.shutdown(wait=False) # An HTTP request may still time out
+            logger.info("Async agent stopped.")
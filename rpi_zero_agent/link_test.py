@@ -0,0 +1,529 @@
+#!/usr/bin/env python3
+"""
+Load and replay tests for the agent <-> Pico serial link, run through
+SerialHandler exactly as the agent uses it:
+  - load: a random mix of reads, writes, multi-reads, change fetches,
+    pipelined (sequenced) writes and staged writes at a target rate
+  - replay: the command frames of a captured trace, with their timing
+Optionally corrupts outgoing frames (--corrupt) and reports latency
+percentiles per operation, throughput, errors, read-back mismatches and the
+time the link takes to recover from each injected fault.
+
+Usage (from rpi_zero_agent/, with the agent stopped):
+    python3 link_test.py --port /dev/ttyS0 load --rate 200 --duration 30
+    python3 link_test.py --port /dev/ttyS0 --framed load --corrupt 0.01 --corrupt-mode truncate
+    python3 link_test.py --sim ../pico_firmware/build/stepper_sim_pty load --record trace.txt
+    python3 link_test.py --port /dev/ttyS0 replay trace.txt --speed 0
+
+Writes only go to the QUEUE_TARGET..QUEUE_ACCEL registers of each axis. The
+Pico keeps them until QUEUE_CONTROL pushes a segment, which this never
+writes, so nothing moves; the values found there are restored at the end.
+Each value read back from them is checked against the last acknowledged
+write (bytes of a failed write are unknown until the next one).
+
+Trace format (replay, --record): one command frame per line, in hex,
+optionally after its time in seconds; '#' starts a comment. The agent's debug
+log works as is: its "Serial TX (N bytes): <hex>" lines are replayed with the
+log timestamps. Framed (CRC envelope) frames are unwrapped and sent as the
+--framed setting says. Sequenced frames go out without their sequence ID and
+CMD_SET_BAUD frames are skipped; they would need the agent's state.
+"""
+import argparse
+import binascii
+import datetime
+import logging
+import math
+import random
+import subprocess
+import sys
+import time
+
+import serial_handler
+from serial_handler import SerialHandler, ProtocolError, RESP_LEN_FROM_HEADER
+from registers import * # Generated from pico_firmware/registers.json (tools/regmap_gen.py)
+
+logger = logging.getLogger("LinkTest")
+
+DEFAULT_MIX = "read=5,write=3,multi=2,changes=1,pipelined=1,staged=1"
+CORRUPT_MODES = ("flip", "drop", "truncate", "garbage")
+SCRATCH_OFFSETS = range(AXIS_QUEUE_TARGET_L, AXIS_QUEUE_ACCEL_H + 1) # Never AXIS_QUEUE_CONTROL
+PIPELINED_BATCH = 8 # Writes per pipelined batch (DEFAULT_WINDOW_SIZE)
+LOG_TIME_FORMAT = '%Y-%m-%d %H:%M:%S,%f' # asctime of the agent's log lines
+
+# Command bytes (Mirror from Pico's uart_protocol.h)
+CMD_NAMES = {0x01: "read", 0x02: "write", 0x03: "multi", serial_handler.CMD_SET_BAUD: "set_baud",
+             serial_handler.CMD_READ_CHANGES: "changes", serial_handler.CMD_STAGE_WRITE: "stage_write",
+             serial_handler.CMD_STAGE_COMMIT: "stage_commit"}
+
+def _xor(data):
+    checksum = 0
+    for byte in data:
+        checksum ^= byte
+    return checksum
+
+def percentile(sorted_values, pct):
+    """Nearest-rank percentile of an ascending list."""
+    if not sorted_values:
+        return None
+    rank = math.ceil(pct / 100.0 * len(sorted_values))
+    return sorted_values[max(0, min(len(sorted_values), rank) - 1)]
+
+class LinkTap:
+    """
+    Stands in for the handler's serial port: counts the bytes both ways,
+    records the frames sent (--record) and corrupts some of them (--corrupt).
+    A write is corrupted as a whole but reported as fully written, so the
+    handler carries on as if the line had mangled it.
+    """
+    _OWN = ('_port', 'corrupt_p', 'corrupt_mode', 'rng', 'record', 'tx_bytes', 'rx_bytes',
+            'frames', 'injected', 'injected_at', 'start')
+
+    def __init__(self, port, corrupt_p=0.0, corrupt_mode="flip", seed=None):
+        object.__setattr__(self, '_port', port)
+        self.corrupt_p = corrupt_p
+        self.corrupt_mode = corrupt_mode
+        self.rng = random.Random(seed)
+        self.record = None          # List of (time, frame) while recording
+        self.tx_bytes = 0
+        self.rx_bytes = 0
+        self.frames = 0
+        self.injected = 0
+        self.injected_at = None     # First fault not recovered from yet
+        self.start = time.monotonic()
+
+    def __getattr__(self, name):
+        return getattr(self._port, name)
+
+    def __setattr__(self, name, value):
+        if name in LinkTap._OWN:
+            object.__setattr__(self, name, value)
+        else:
+            setattr(self._port, name, value) # timeout, baudrate, ...
+
+    def write(self, data):
+        data = bytes(data)
+        now = time.monotonic()
+        self.frames += 1
+        if self.record is not None:
+            self.record.append((now - self.start, data))
+        wire = data
+        if self.corrupt_p and self.rng.random() < self.corrupt_p:
+            wire = self._corrupt(data)
+            self.injected += 1
+            if self.injected_at is None:
+                self.injected_at = now
+        if wire:
+            self._port.write(wire)
+        self.tx_bytes += len(wire)
+        return len(data)
+
+    def read(self, size=1):
+        data = self._port.read(size)
+        self.rx_bytes += len(data)
+        return data
+
+    def _corrupt(self, data):
+        if self.corrupt_mode == "drop":
+            return b''
+        if self.corrupt_mode == "truncate":
+            return data[:self.rng.randrange(1, len(data))] if len(data) > 1 else b''
+        if self.corrupt_mode == "garbage":
+            noise = bytes(self.rng.randrange(256) for _ in range(self.rng.randint(1, 8)))
+            return noise + data
+        index = self.rng.randrange(len(data))
+        return data[:index] + bytes([data[index] ^ (1 << self.rng.randrange(8))]) + data[index + 1:]
+
+class Report:
+    """Latencies per operation, failures and recovery times."""
+    def __init__(self):
+        self.latencies = {}     # op -> [seconds] of successful operations
+        self.errors = {}        # op -> count
+        self.mismatches = 0
+        self.recoveries = []    # Seconds from an injected fault to the next success
+        self.telemetry = 0
+        self.skipped = 0
+        self.late = 0           # Operations started behind schedule
+
+    def ok(self, op, seconds):
+        self.latencies.setdefault(op, []).append(seconds)
+        self.errors.setdefault(op, 0)
+
+    def error(self, op):
+        self.latencies.setdefault(op, [])
+        self.errors[op] = self.errors.get(op, 0) + 1
+
+    def total_errors(self):
+        return sum(self.errors.values())
+
+    def print(self, tap, elapsed, title):
+        def ms(value):
+            return f"{value * 1000:8.2f}" if value is not None else "       -"
+        print(f"\n{title}, {elapsed:.1f} s")
+        print(f"{'op':<14}{'count':>7}{'errors':>8}{'p50':>9}{'p90':>9}{'p99':>9}{'max':>9}  (ms)")
+        for op in sorted(self.latencies):
+            values = sorted(self.latencies[op])
+            print(f"{op:<14}{len(values):>7}{self.errors[op]:>8} {ms(percentile(values, 50))} "
+                  f"{ms(percentile(values, 90))} {ms(percentile(values, 99))} {ms(values[-1] if values else None)}")
+        elapsed = max(elapsed, 1e-9)
+        print(f"Frames sent: {tap.frames} ({tap.frames / elapsed:.1f}/s), "
+              f"TX {tap.tx_bytes} bytes ({tap.tx_bytes / elapsed:.0f} B/s), "
+              f"RX {tap.rx_bytes} bytes ({tap.rx_bytes / elapsed:.0f} B/s)")
+        print(f"Errors: {self.total_errors()}, read-back mismatches: {self.mismatches}, "
+              f"telemetry frames: {self.telemetry}, started late: {self.late}, skipped: {self.skipped}")
+        if tap.corrupt_p:
+            values = sorted(self.recoveries)
+            print(f"Injected faults ({tap.corrupt_mode}): {tap.injected}, recoveries: {len(values)}, "
+                  f"recovery p50/p90/max: {ms(percentile(values, 50)).strip()}/{ms(percentile(values, 90)).strip()}/"
+                  f"{ms(values[-1] if values else None).strip()} ms"
+                  f"{', not recovered at the end' if tap.injected_at is not None else ''}")
+
+# --- Load Test ---
+
+class LoadTest:
+    def __init__(self, handler, tap, report, rng):
+        self.handler = handler
+        self.tap = tap
+        self.report = report
+        self.rng = rng
+        self.scratch = [axis_reg(axis, offset) for axis in range(NUM_AXES) for offset in SCRATCH_OFFSETS]
+        self.stageable = [addr for addr in self.scratch if addr < serial_handler.STAGE_MAX_TRACKED]
+        self.known = {}         # Scratch address -> last acknowledged value, None = unknown
+        self.original = {}
+
+    # Scratch register bookkeeping
+    def _block(self, addr):
+        """Scratch run containing addr: (first address, length)."""
+        first = addr - (addr - AXIS_BASE) % AXIS_STRIDE + SCRATCH_OFFSETS[0]
+        return first, len(SCRATCH_OFFSETS)
+
+    def _random_write(self):
+        first, length = self._block(self.rng.choice(self.scratch))
+        offset = self.rng.randrange(length)
+        data = bytes(self.rng.randrange(256) for _ in range(self.rng.randint(1, length - offset)))
+        return first + offset, data
+
+    def _written(self, addr, data, acked):
+        for i, byte in enumerate(data):
+            self.known[addr + i] = byte if acked else None
+
+    def _check(self, addr, data):
+        for i, byte in enumerate(data):
+            expected = self.known.get(addr + i)
+            if expected is not None and expected != byte:
+                self.report.mismatches += 1
+                logger.error(f"Read-back mismatch at {addr + i:#06x}: expected {expected:#04x}, got {byte:#04x}")
+                return False
+        return True
+
+    def _random_range(self, max_len=16):
+        if self.rng.random() < 0.5:
+            first, length = self._block(self.rng.choice(self.scratch))
+            offset = self.rng.randrange(length)
+            return first + offset, self.rng.randint(1, min(max_len, length - offset))
+        addr = self.rng.randrange(REGISTER_MAP_SIZE)
+        return addr, self.rng.randint(1, min(max_len, REGISTER_MAP_SIZE - addr))
+
+    def seed(self):
+        """Reads the scratch registers: the baseline for checks and the restore."""
+        for axis in range(NUM_AXES):
+            first = axis_reg(axis, SCRATCH_OFFSETS[0])
+            data = self.handler.read_register(first, len(SCRATCH_OFFSETS))
+            if data is None:
+                raise ProtocolError(f"No response reading the scratch registers of axis {axis}.")
+            for i, byte in enumerate(data):
+                self.original[first + i] = byte
+        self.known = dict(self.original)
+
+    def restore(self):
+        for axis in range(NUM_AXES):
+            first = axis_reg(axis, SCRATCH_OFFSETS[0])
+            data = bytes(self.original[first + i] for i in range(len(SCRATCH_OFFSETS)))
+            if not self.handler.write_register(first, data):
+                logger.warning(f"Failed to restore the scratch registers of axis {axis}.")
+
+    # Operations: each returns True on success
+    def op_read(self):
+        addr, length = self._random_range()
+        data = self.handler.read_register(addr, length)
+        return data is not None and self._check(addr, data)
+
+    def op_write(self):
+        addr, data = self._random_write()
+        acked = self.handler.write_register(addr, data)
+        self._written(addr, data, acked)
+        return acked
+
+    def op_multi(self):
+        ranges = []
+        for _ in range(self.rng.randint(2, 4)):
+            addr, length = self._random_range(max_len=serial_handler.MULTI_READ_MAX_BYTES // 4)
+            ranges.append((addr, length))
+        results = self.handler.read_registers(ranges)
+        if results is None:
+            return False
+        return all(self._check(addr, data) for (addr, _), data in zip(ranges, results))
+
+    def op_changes(self):
+        result = self.handler.read_changes()
+        if result is None:
+            return False
+        changes, _ = result
+        return all(self._check(addr, data) for addr, data in changes)
+
+    def op_pipelined(self):
+        writes = [self._random_write() for _ in range(PIPELINED_BATCH)]
+        results = self.handler.write_registers(writes)
+        for (addr, data), acked in zip(writes, results):
+            self._written(addr, data, acked)
+        return all(results)
+
+    def op_staged(self):
+        if not self.stageable:
+            return None
+        writes = {}
+        for addr in self.rng.sample(self.stageable, self.rng.randint(1, len(self.stageable))):
+            writes[addr] = bytes([self.rng.randrange(256)])
+        acked = self.handler.write_staged(list(writes.items()))
+        for addr, data in writes.items():
+            self._written(addr, data, acked)
+        return acked
+
+    def run(self, mix, rate, duration):
+        ops = [(getattr(self, f"op_{name}"), name) for name, weight in mix.items() for _ in range(weight)]
+        interval = 1.0 / rate if rate > 0 else 0.0
+        start = time.monotonic()
+        next_time = start
+        while time.monotonic() - start < duration:
+            if interval:
+                delay = next_time - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                elif delay < -interval:
+                    self.report.late += 1
+                next_time += interval
+            op, name = self.rng.choice(ops)
+            t0 = time.monotonic()
+            success = op()
+            t1 = time.monotonic()
+            if success is None:
+                self.report.skipped += 1
+            elif success:
+                self.report.ok(name, t1 - t0)
+                if self.tap.injected_at is not None:
+                    self.report.recoveries.append(t1 - self.tap.injected_at)
+                    self.tap.injected_at = None
+            else:
+                self.report.error(name)
+        return time.monotonic() - start
+
+def parse_mix(text):
+    mix = {}
+    for item in text.split(','):
+        name, _, weight = item.partition('=')
+        name = name.strip()
+        if not hasattr(LoadTest, f"op_{name}"):
+            raise ValueError(f"Unknown operation '{name}' in --mix")
+        mix[name] = int(weight) if weight else 1
+    if not any(mix.values()):
+        raise ValueError("--mix has no operation with a weight")
+    return mix
+
+# --- Replay ---
+
+def unwrap_frame(frame):
+    """Legacy frame (with XOR checksum) of a CRC-enveloped one; others as they are."""
+    if len(frame) >= 5 and frame[0] == serial_handler.FRAME_SYNC0 and frame[1] == serial_handler.FRAME_SYNC1:
+        length = frame[2]
+        body, crc = frame[3:3 + length], frame[3 + length:5 + length]
+        if len(crc) != 2 or binascii.crc_hqx(frame[2:3 + length], serial_handler.FRAME_CRC_INIT) != int.from_bytes(crc, 'big'):
+            raise ValueError(f"bad framed message {frame.hex()}")
+        return body + bytes([_xor(body)])
+    return frame
+
+def load_trace(path):
+    """[(time in seconds or None, legacy frame)] of a trace file or agent log."""
+    entries = []
+    log = False # An agent log: only its TX lines count
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            try:
+                if "Serial TX (" in line:
+                    stamp = datetime.datetime.strptime(line[:23], LOG_TIME_FORMAT).timestamp()
+                    entries.append((stamp, unwrap_frame(bytes.fromhex(line.rsplit(':', 1)[1].strip()))))
+                    continue
+                log = log or " - " in line
+                if log:
+                    continue # Other log lines, tracebacks, ...
+                fields = line.split('#', 1)[0].split()
+                if not fields:
+                    continue
+                if len(fields) > 2:
+                    raise ValueError("expected [time] hex")
+                stamp = float(fields[0]) if len(fields) == 2 else None
+                entries.append((stamp, unwrap_frame(bytes.fromhex(fields[-1]))))
+            except ValueError as e:
+                raise ValueError(f"{path}:{number}: {e}")
+    return entries
+
+def response_len(frame):
+    """(op name, plain frame, expected response length) for a command frame;
+    the length is None for frames that can't be replayed."""
+    cmd = frame[0]
+    if cmd & serial_handler.CMD_SEQ_FLAG and len(frame) > 2:
+        body = bytes([cmd & ~serial_handler.CMD_SEQ_FLAG]) + frame[2:-1] # Send without the sequence ID
+        frame, cmd = body + bytes([_xor(body)]), body[0]
+    wide = bool(cmd & serial_handler.CMD_ADDR16_FLAG)
+    base = cmd & ~serial_handler.CMD_ADDR16_FLAG
+    name = CMD_NAMES.get(base, f"cmd_{base:#04x}")
+    addr_len, resp_addr_len = (2, 3) if wide else (1, 1)
+    try:
+        if base == 0x01:
+            return name, frame, resp_addr_len + 1 + frame[1 + addr_len] + 1
+        if base == 0x02:
+            return name, frame, resp_addr_len + 2
+        if base == 0x03:
+            return name, frame, 2 + frame[2] + 1
+        if base == serial_handler.CMD_READ_CHANGES:
+            return name, frame, RESP_LEN_FROM_HEADER
+        if base in (serial_handler.CMD_STAGE_WRITE, serial_handler.CMD_STAGE_COMMIT):
+            return name, frame, 3
+    except IndexError:
+        pass
+    return name, frame, None
+
+def replay(handler, tap, report, entries, speed, loops):
+    start = time.monotonic()
+    for _ in range(loops):
+        first_stamp = next((stamp for stamp, _ in entries if stamp is not None), None)
+        loop_start = time.monotonic()
+        for stamp, frame in entries:
+            name, frame, expected_len = response_len(frame)
+            if expected_len is None or name == "set_baud":
+                report.skipped += 1
+                continue
+            if speed > 0 and stamp is not None:
+                delay = (stamp - first_stamp) / speed - (time.monotonic() - loop_start)
+                if delay > 0:
+                    time.sleep(delay)
+            t0 = time.monotonic()
+            try:
+                response = handler.transact(frame, expected_len)
+                if _xor(response[:-1]) != response[-1]:
+                    raise ProtocolError(f"checksum mismatch: {response.hex()}")
+            except ProtocolError as e:
+                logger.debug(f"Replayed {frame.hex()}: {e}")
+                report.error(name)
+                continue
+            t1 = time.monotonic()
+            report.ok(name, t1 - t0)
+            if tap.injected_at is not None:
+                report.recoveries.append(t1 - tap.injected_at)
+                tap.injected_at = None
+    return time.monotonic() - start
+
+# --- Setup ---
+
+def start_simulator(binary):
+    """Starts stepper_sim_pty; returns (process, device path)."""
+    process = subprocess.Popen([binary], stdout=subprocess.PIPE, universal_newlines=True)
+    line = process.stdout.readline()
+    if not line.startswith("Simulated Pico"):
+        process.terminate()
+        raise OSError(f"{binary} did not report its pty (got {line.strip()!r})")
+    if f"({NUM_AXES} axes)" not in line:
+        logger.warning(f"Simulator axis count differs from registers.py ({NUM_AXES} axes): {line.strip()}")
+    return process, line.split()[-1]
+
+def main():
+    parser = argparse.ArgumentParser(description="Load and replay tests for the serial link to the Pico")
+    parser.add_argument('--port', help="Serial port of the Pico")
+    parser.add_argument('--sim', metavar='BINARY', help="Start this stepper_sim_pty and test it instead of --port")
+    parser.add_argument('--baud', type=int, default=serial_handler.UART_DEFAULT_BAUD, help="Rate the Pico runs at")
+    parser.add_argument('--target-baud', type=int, help="Negotiate this rate first (CMD_SET_BAUD)")
+    parser.add_argument('--framed', action='store_true', help="CRC-16 framed protocol")
+    parser.add_argument('--timeout', type=float, default=0.5, help="Response timeout (s)")
+    parser.add_argument('--corrupt', type=float, default=0.0, metavar='P', help="Corrupt each frame sent with probability P")
+    parser.add_argument('--corrupt-mode', choices=CORRUPT_MODES, default="flip",
+                        help="flip one bit, drop the frame, truncate it or prepend garbage")
+    parser.add_argument('--seed', type=int, help="Random seed (operations and corruption)")
+    parser.add_argument('-v', '--verbose', action='store_true', help="Debug logging (the TX lines can be replayed)")
+    commands = parser.add_subparsers(dest='command')
+    load = commands.add_parser('load', help="Random operation mix at a target rate")
+    load.add_argument('--rate', type=float, default=100.0, help="Operations per second, 0 = as fast as possible")
+    load.add_argument('--duration', type=float, default=10.0, help="Seconds")
+    load.add_argument('--mix', default=DEFAULT_MIX, help=f"Operation weights (default {DEFAULT_MIX})")
+    load.add_argument('--record', metavar='FILE', help="Write the frames sent as a trace")
+    replay_cmd = commands.add_parser('replay', help="Replay a trace or agent debug log")
+    replay_cmd.add_argument('trace')
+    replay_cmd.add_argument('--speed', type=float, default=1.0, help="Time scale of the trace, 0 = back to back")
+    replay_cmd.add_argument('--loops', type=int, default=1)
+    args = parser.parse_args()
+    if not args.command or not (args.port or args.sim):
+        parser.error("a port (--port or --sim) and a command (load, replay) are needed")
+
+    logging.basicConfig(level=logging.DEBUG if args.verbose else logging.WARNING,
+                        format='%(asctime)s - %(name)s - %(levelname)s - %(message)s')
+    if args.corrupt and not args.verbose:
+        logging.getLogger("SerialHandler").setLevel(logging.CRITICAL) # Every injected fault logs an error
+
+    try:
+        mix = parse_mix(args.mix) if args.command == 'load' else None
+        entries = load_trace(args.trace) if args.command == 'replay' else None
+    except (OSError, ValueError) as e:
+        print(f"link_test: {e}", file=sys.stderr)
+        return 2
+
+    sim = None
+    handler = None
+    try:
+        port = args.port
+        if args.sim:
+            sim, port = start_simulator(args.sim)
+        handler = SerialHandler(port, args.baud, timeout=args.timeout, framed=args.framed)
+        if args.target_baud and not handler.negotiate_baud(args.target_baud):
+            print(f"link_test: could not switch to {args.target_baud} baud", file=sys.stderr)
+            return 1
+        tap = LinkTap(handler.ser, seed=args.seed)
+        handler.ser = tap
+        report = Report()
+        handler.start_reader(lambda telemetry: setattr(report, 'telemetry', report.telemetry + 1))
+        framing = "framed" if args.framed else "legacy"
+        title = f"{args.command} on {port}, {NUM_AXES} axes, {handler.baudrate} baud, {framing} frames"
+
+        if args.command == 'load':
+            test = LoadTest(handler, tap, report, random.Random(args.seed))
+            test.seed()
+            tap.frames = tap.tx_bytes = tap.rx_bytes = 0
+            tap.corrupt_p, tap.corrupt_mode = args.corrupt, args.corrupt_mode
+            if args.record:
+                tap.record = []
+            elapsed = test.run(mix, args.rate, args.duration)
+            report.print(tap, elapsed, title + f", {args.rate:g} ops/s target")
+            tap.corrupt_p, record, tap.record = 0.0, tap.record, None
+            test.restore()
+            if record is not None:
+                with open(args.record, 'w') as f:
+                    f.write(f"# link_test.py load trace: {title}\n")
+                    for stamp, frame in record:
+                        f.write(f"{stamp:.6f} {frame.hex()}\n")
+        else:
+            tap.corrupt_p, tap.corrupt_mode = args.corrupt, args.corrupt_mode
+            elapsed = replay(handler, tap, report, entries, args.speed, args.loops)
+            report.print(tap, elapsed, title + f", {len(entries)} frames x {args.loops}")
+        if report.mismatches or (report.total_errors() and not args.corrupt):
+            return 1
+        return 0
+    except (OSError, ProtocolError) as e:
+        print(f"link_test: {e}", file=sys.stderr)
+        return 1
+    except KeyboardInterrupt:
+        return 130
+    finally:
+        if handler:
+            handler.close()
+        if sim:
+            sim.terminate()
+            sim.wait()
+
+if __name__ == '__main__':
+    sys.exit(main())
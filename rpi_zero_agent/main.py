@@ -1,5 +1,6 @@
 import time
 import threading
+import asyncio
 import configparser
 import logging
 import json
@@ -8,6 +9,9 @@ import struct
 from mqtt_client import MqttClient
 from serial_handler import SerialHandler, ProtocolError
 from backend_comm import get_config_from_backend
+from status_codec import StatusBatcher
+from async_agent import AsyncAgent
+from registers import * # Generated from pico_firmware/registers.json (tools/regmap_gen.py)
 
 # --- Logging Setup ---
 logging.basicConfig(
@@ -24,11 +28,24 @@ try:
     DEVICE_ID = config['DEFAULT']['DeviceID']
     SERIAL_PORT = config['DEFAULT']['SerialPort']
     BAUD_RATE = int(config['DEFAULT']['BaudRate'])
+    # Rate negotiated with the Pico after connecting (CMD_SET_BAUD)
+    TARGET_BAUD_RATE = int(config['DEFAULT'].get('TargetBaudRate', str(BAUD_RATE)))
+    # CRC-16 framed protocol (sync preamble, resyncs after corruption)
+    FRAMED_PROTOCOL = config['DEFAULT'].getboolean('FramedProtocol', False)
     BACKEND_URL = config['DEFAULT']['BackendURL']
     MQTT_BROKER = config['MQTT']['BrokerAddress']
     MQTT_PORT = int(config['MQTT']['BrokerPort'])
     MQTT_USER = config['MQTT'].get('Username', None)
     MQTT_PASS = config['MQTT'].get('Password', None)
+    # Telemetry push interval in ms (0 = poll the Pico instead)
+    TELEMETRY_PERIOD_MS = int(config['DEFAULT'].get('TelemetryPeriodMs', '0'))
+    # Status message format: json (one dict per update) or compact (binary batches, see status_codec.py)
+    STATUS_FORMAT = config['DEFAULT'].get('StatusFormat', 'json').lower()
+    STATUS_BATCH_SIZE = int(config['DEFAULT'].get('StatusBatchSize', '10'))
+    STATUS_BATCH_MAX_AGE_MS = int(config['DEFAULT'].get('StatusBatchMaxAgeMs', '500'))
+    # threaded (status thread + MQTT callbacks) or async (priority job queue, see async_agent.py)
+    AGENT_MODE = config['DEFAULT'].get('AgentMode', 'threaded').lower()
+    STATUS_PERIOD_MS = int(config['DEFAULT'].get('StatusPeriodMs', '1000'))
 except KeyError as e:
     logger.error(f"Configuration Error: Missing key {e} in config.ini")
     exit(1)
@@ -37,31 +54,38 @@ except Exception as e:
     exit(1)
 
 
-# --- Register Map Constants (Mirror from Pico's registers.h) ---
-REG_STATUS = 0x00
-REG_SWITCH_STATUS = 0x01
-REG_ERROR_FLAGS = 0x02
-REG_MOTOR1_CONTROL = 0x10
-REG_MOTOR1_TARGET_POS_L = 0x11
-REG_MOTOR1_CURRENT_POS_L = 0x15
-REG_MOTOR1_MAX_SPEED_L = 0x19
-REG_MOTOR1_ACCEL_L = 0x1B
-REG_MOTOR1_CONFIG = 0x1D
-REG_MOTOR2_CONTROL = 0x20
-REG_MOTOR2_TARGET_POS_L = 0x21
-REG_MOTOR2_CURRENT_POS_L = 0x25
-REG_MOTOR2_MAX_SPEED_L = 0x29
-REG_MOTOR2_ACCEL_H = 0x2A
-REG_MOTOR2_ACCEL_L = 0x2B
-REG_MOTOR2_CONFIG = 0x2D
+# --- Register Map Constants ---
+# Addresses come from registers.py (generated for the Pico's STEPPER_NUM_AXES);
+# per-axis registers are axis_reg(motor - 1, AXIS_*). Bit values below.
+DIAG_CTRL_RESET = 0x01
+# Layout from REG_DIAG_CORE0_LOOP_MIN_L: loop min/avg/max for core 0 and 1 (u32 cycles), UART
+# counters, SPI times, step IRQ dry count (u16), 8 histogram buckets (u16)
+DIAG_FORMAT = '<6I7H8H'
+DIAG_LEN = struct.calcsize(DIAG_FORMAT)
+MOTOR_CTRL_HOME = 0x04
+HOMING_CFG_POSITIVE = 0x01
+HOMING_CFG_STALLGUARD = 0x02
+QUEUE_CTRL_PUSH = 0x01
+QUEUE_CTRL_FLUSH = 0x02
+COORD_CTRL_START = 0x01
+COORD_CTRL_STOP = 0x02
 
 # --- Global Objects ---
 serial_handler = None
 mqtt_client = None
 stop_event = threading.Event()
 last_status = {} # Cache last sent status to avoid redundant messages
+status_batcher = None # StatusBatcher when STATUS_FORMAT is compact
+last_telemetry_time = 0.0 # time.monotonic() of the last pushed telemetry frame
+register_mirror = None # Pico's register map as of the last change fetch (None = read in full)
+MAX_CHANGE_FETCHES = 8 # Per status update: ~320 bytes of changes, more than the tracked map
+TELEMETRY_CTRL_PERIODIC = 0x01
+TELEMETRY_CTRL_ON_CHANGE = 0x02
 
 # --- Helper Functions ---
+def pack_u8(value):
+    return struct.pack('<B', value)
+
 def pack_u16(value):
     return struct.pack('<H', value) # Little-endian unsigned short
 
@@ -77,6 +101,29 @@ def unpack_u16(byte_data):
 def unpack_i32(byte_data):
     return struct.unpack('<i', byte_data)[0]
 
+def read_diagnostics():
+    """Reads the Pico's diagnostics block as one snapshot; returns a dict or None."""
+    ranges = []
+    for offset in range(0, DIAG_LEN, 32): # Multi-read frames carry up to 32 bytes
+        ranges.append((REG_DIAG_CORE0_LOOP_MIN_L + offset, min(32, DIAG_LEN - offset)))
+    results = serial_handler.read_snapshot(ranges)
+    if results is None:
+        return None
+    values = struct.unpack(DIAG_FORMAT, b''.join(results))
+    return {
+        "timestamp": time.time(),
+        "core0_loop_cycles": {"min": values[0], "avg": values[1], "max": values[2]},
+        "core1_loop_cycles": {"min": values[3], "avg": values[4], "max": values[5]},
+        "uart_frames_ok": values[6],
+        "uart_checksum_errors": values[7],
+        "uart_nacks": values[8],
+        "uart_rx_overflows": values[9],
+        "spi_time_last_cycles": values[10],
+        "spi_time_max_cycles": values[11],
+        "step_irq_fifo_dry": values[12],
+        "step_irq_hist": list(values[13:21]),
+    }
+
 # --- Apply Configuration from Backend ---
 def apply_config(config_data):
     """Writes configuration values received from backend to Pico registers."""
@@ -86,42 +133,37 @@ def apply_config(config_data):
         return
 
     logger.info("Applying configuration from backend...")
-    applied_count = 0
+    # (config key, description, register, packer) - written in this order
+    config_fields = [
+        ('config', "Config", AXIS_CONFIG_L, pack_u16),
+        ('max_speed', "Max Speed", AXIS_MAX_SPEED_L, pack_u16),
+        ('accel', "Accel", AXIS_ACCEL_L, pack_u16),
+        ('jerk_time', "Jerk Time", AXIS_JERK_TIME_L, pack_u16), # S-curve ramp time in ms, 0 = trapezoidal
+        # Driver modes: bit 0 = StealthChop below stealth_max_speed / SpreadCycle above, bit 1 = CoolStep
+        ('driver_mode', "Driver Mode", AXIS_DRIVER_MODE_CONTROL, pack_u8),
+        ('stealth_max_speed', "StealthChop Max Speed", AXIS_STEALTH_MAX_SPEED_L, pack_u16),
+        ('coolstep_min_speed', "CoolStep Min Speed", AXIS_COOLSTEP_MIN_SPEED_L, pack_u16),
+        ('coolstep_config', "CoolStep Config", AXIS_COOLSTEP_CONFIG_L, pack_u16), # COOLCONF bits 0-15
+    ]
+    # (config key, description, register, packer), e.g. 'motor2_accel'
+    config_registers = [(f"motor{axis + 1}_{field}", f"M{axis + 1} {description}", axis_reg(axis, offset), packer)
+                        for axis in range(NUM_AXES)
+                        for field, description, offset, packer in config_fields]
     try:
-        # Example: Motor 1 Config (assuming 2 bytes)
-        if 'motor1_config' in config_data:
-            val = int(config_data['motor1_config'])
-            if serial_handler.write_register(REG_MOTOR1_CONFIG, pack_u16(val)):
-                 logger.info(f"Applied M1 Config (Reg {REG_MOTOR1_CONFIG:#04x}): {val}")
-                 applied_count += 1
-            else: logger.warning(f"Failed to apply M1 Config (Reg {REG_MOTOR1_CONFIG:#04x})")
-
-        # Example: Motor 1 Speed (assuming 2 bytes)
-        if 'motor1_max_speed' in config_data:
-            val = int(config_data['motor1_max_speed'])
-            if serial_handler.write_register(REG_MOTOR1_MAX_SPEED_L, pack_u16(val)):
-                logger.info(f"Applied M1 Max Speed (Reg {REG_MOTOR1_MAX_SPEED_L:#04x}): {val}")
-                applied_count += 1
-            else: logger.warning(f"Failed to apply M1 Max Speed (Reg {REG_MOTOR1_MAX_SPEED_L:#04x})")
-
-        # Example: Motor 1 Acceleration (assuming 2 bytes)
-        if 'motor1_accel' in config_data:
-            val = int(config_data['motor1_accel'])
-            if serial_handler.write_register(REG_MOTOR1_ACCEL_L, pack_u16(val)):
-                logger.info(f"Applied M1 Accel (Reg {REG_MOTOR1_ACCEL_L:#04x}): {val}")
-                applied_count += 1
-            else: logger.warning(f"Failed to apply M1 Accel (Reg {REG_MOTOR1_ACCEL_L:#04x})")
-
-        # Add similar blocks for Motor 2 configuration...
-        if 'motor2_config' in config_data:
-            val = int(config_data['motor2_config'])
-            if serial_handler.write_register(REG_MOTOR2_CONFIG, pack_u16(val)):
-                 logger.info(f"Applied M2 Config (Reg {REG_MOTOR2_CONFIG:#04x}): {val}")
-                 applied_count += 1
-            else: logger.warning(f"Failed to apply M2 Config (Reg {REG_MOTOR2_CONFIG:#04x})")
-        # ... M2 Speed, M2 Accel ...
-
-        logger.info(f"Configuration application finished. Applied {applied_count} values.")
+        pending = [] # (description, register, value, packer)
+        for key, description, reg, packer in config_registers:
+            if key in config_data:
+                pending.append((description, reg, int(config_data[key]), packer))
+
+        # One staged write: the Pico applies all values on the CRC-checked commit, or none
+        writes = [(reg, packer(val)) for _, reg, val, packer in pending]
+        if not serial_handler.write_staged(writes):
+            logger.error(f"Configuration not applied ({len(pending)} values), the Pico keeps its previous config.")
+            return
+
+        for description, reg, val, _ in pending:
+            logger.debug(f"Applied {description} (Reg {reg:#04x}): {val}")
+        logger.info(f"Configuration application finished. Applied {len(pending)} values.")
 
     except ValueError as e:
         logger.error(f"Configuration Error: Invalid value type in config data - {e}")
@@ -131,6 +173,48 @@ def apply_config(config_data):
         logger.error(f"Unexpected error applying configuration: {e}")
 
 # --- MQTT Command Handling ---
+def fetch_config():
+    """Blocking HTTP fetch of this device's configuration (None on failure)."""
+    logger.info("Re-fetching configuration...")
+    return get_config_from_backend(BACKEND_URL, DEVICE_ID)
+
+def segment_block(seg):
+    """AXIS_QUEUE_* block pushing one queue_moves segment."""
+    return pack_i32(int(seg['target'])) + pack_u16(int(seg.get('speed', 0))) + \
+           pack_u16(int(seg.get('accel', 0))) + bytes([QUEUE_CTRL_PUSH])
+
+def push_segment(motor_id, reg_queue, block, index, count):
+    """One queue_moves segment as its own transaction; False if the Pico refused it."""
+    if serial_handler.write_register(reg_queue, block):
+        log = logger.info if index == count - 1 else logger.debug
+        log(f"Queued segment {index + 1}/{count} for Motor {motor_id}")
+        return True
+    logger.warning(f"Queued {index}/{count} segments for Motor {motor_id} (queue full?)")
+    return False
+
+def command_transactions(payload):
+    """
+    Splits a command into its serial transactions, in order, for the async
+    agent to queue as one job each so a stop can run in between. A job that
+    returns False drops the rest. Commands that are a single write, or one
+    short pipelined batch, stay one handle_command() job.
+    """
+    action = payload.get('action') if isinstance(payload, dict) else None
+    if action == 'queue_moves' and serial_handler:
+        motor_id = payload.get('motor')
+        segments = payload.get('value')
+        try:
+            if not (isinstance(motor_id, int) and 1 <= motor_id <= NUM_AXES and segments):
+                raise ValueError("invalid motor or no segments")
+            blocks = [segment_block(seg) for seg in segments]
+        except (ValueError, TypeError, KeyError):
+            return [lambda: handle_command(payload)] # Reports the bad payload
+        reg_queue = axis_reg(motor_id - 1, AXIS_QUEUE_TARGET_L)
+        logger.info(f"Received command: {payload}")
+        return [lambda n=n, block=block: push_segment(motor_id, reg_queue, block, n, len(blocks))
+                for n, block in enumerate(blocks)]
+    return [lambda: handle_command(payload)]
+
 def handle_command(payload):
     """Processes commands received from MQTT."""
     global serial_handler
@@ -141,26 +225,53 @@ def handle_command(payload):
     logger.info(f"Received command: {payload}")
     try:
         action = payload.get('action')
-        motor_id = payload.get('motor') # 1 or 2
+        motor_id = payload.get('motor') # 1 ... NUM_AXES
         value = payload.get('value')
 
         # Determine register base based on motor_id
-        if motor_id == 1:
-            reg_control = REG_MOTOR1_CONTROL
-            reg_target_pos = REG_MOTOR1_TARGET_POS_L
-            reg_max_speed = REG_MOTOR1_MAX_SPEED_L
-            reg_accel = REG_MOTOR1_ACCEL_L
-        elif motor_id == 2:
-            reg_control = REG_MOTOR2_CONTROL
-            reg_target_pos = REG_MOTOR2_TARGET_POS_L
-            reg_max_speed = REG_MOTOR2_MAX_SPEED_L
-            reg_accel = REG_MOTOR2_ACCEL_L
+        if isinstance(motor_id, int) and 1 <= motor_id <= NUM_AXES:
+            axis = motor_id - 1
+            reg_control = axis_reg(axis, AXIS_CONTROL)
+            reg_target_pos = axis_reg(axis, AXIS_TARGET_POS_L)
+            reg_max_speed = axis_reg(axis, AXIS_MAX_SPEED_L)
+            reg_accel = axis_reg(axis, AXIS_ACCEL_L)
+            reg_queue = axis_reg(axis, AXIS_QUEUE_TARGET_L)
+            reg_queue_control = axis_reg(axis, AXIS_QUEUE_CONTROL)
+            reg_homing = axis_reg(axis, AXIS_HOMING_CONFIG)
         else:
             # Handle general commands or invalid motor_id
             if action == 'resend_config':
-                 logger.info("Re-fetching and applying configuration...")
-                 config_data = get_config_from_backend(BACKEND_URL, DEVICE_ID)
-                 apply_config(config_data)
+                 apply_config(fetch_config())
+            elif action == 'coord_move':
+                 # value: {"x": steps, "y": steps, "feed": steps/s, "accel": steps/s^2, "jerk_time": ms}
+                 # M1/M2 move along a straight line to (x, y) and finish together
+                 if value and NUM_AXES >= 2:
+                     coord_block = pack_u16(int(value.get('feed', 0))) + pack_u16(int(value.get('accel', 0))) + \
+                                   pack_u16(int(value.get('jerk_time', 0)))
+                     writes = [
+                         (axis_reg(0, AXIS_TARGET_POS_L), pack_i32(int(value['x']))),
+                         (axis_reg(1, AXIS_TARGET_POS_L), pack_i32(int(value['y']))),
+                         (REG_COORD_FEED_RATE_L, coord_block),
+                         (REG_COORD_CONTROL, bytes([COORD_CTRL_START])),
+                     ]
+                     if all(serial_handler.write_registers(writes)):
+                         logger.info(f"Started coordinated move to ({value['x']}, {value['y']})")
+                     else: logger.warning("Failed to start coordinated move")
+                 else: logger.warning("Missing 'value' for coord_move command (or single-axis Pico).")
+            elif action == 'read_diagnostics':
+                 diagnostics = read_diagnostics()
+                 if diagnostics:
+                     mqtt_client.publish(f"devices/{DEVICE_ID}/diagnostics", diagnostics)
+                     logger.info(f"Published diagnostics: {diagnostics}")
+                 else: logger.warning("Failed to read diagnostics")
+            elif action == 'reset_diagnostics':
+                 if serial_handler.write_register(REG_DIAG_CONTROL, bytes([DIAG_CTRL_RESET])):
+                     logger.info("Diagnostics statistics reset")
+                 else: logger.warning("Failed to reset diagnostics")
+            elif action == 'coord_stop':
+                 if serial_handler.write_register(REG_COORD_CONTROL, bytes([COORD_CTRL_STOP])):
+                     logger.info("Sent coordinated move stop command")
+                 else: logger.warning("Failed to stop coordinated move")
             else:
                  logger.warning(f"Unknown command or missing/invalid motor ID: {payload}")
             return # Exit early for non-motor specific commands or errors
@@ -205,7 +316,39 @@ def handle_command(payload):
                  else: logger.warning(f"Failed to set Motor {motor_id} accel (Reg {reg_accel:#04x})")
              else: logger.warning("Missing 'value' for set_accel command.")
 
-        # Add more command handlers (e.g., homing)
+        elif action == "queue_moves":
+             # value: list of {"target": steps, "speed": steps/s, "accel": steps/s^2}
+             # Segments are chained on the Pico without stopping where junction speeds allow
+             if value:
+                 writes = [(reg_queue, segment_block(seg)) for seg in value]
+                 results = serial_handler.write_registers(writes)
+                 queued = sum(results)
+                 if queued == len(writes):
+                     logger.info(f"Queued {queued} segments for Motor {motor_id}")
+                 else: logger.warning(f"Queued {queued}/{len(writes)} segments for Motor {motor_id} (queue full?)")
+             else: logger.warning("Missing 'value' for queue_moves command.")
+
+        elif action == "flush_queue":
+             if serial_handler.write_register(reg_queue_control, bytes([QUEUE_CTRL_FLUSH])):
+                 logger.info(f"Flushed Motor {motor_id} move queue")
+             else: logger.warning(f"Failed to flush Motor {motor_id} move queue")
+
+        elif action == "home":
+             # value (optional): {"positive": bool, "stallguard": bool, "speed": steps/s,
+             #                    "backoff": steps, "threshold": SGT -64..63}
+             # 0 speed/backoff use the Pico defaults; StallGuard homing needs a tuned threshold
+             value = value or {}
+             config = (HOMING_CFG_POSITIVE if value.get('positive') else 0) | \
+                      (HOMING_CFG_STALLGUARD if value.get('stallguard') else 0)
+             threshold = max(-64, min(63, int(value.get('threshold', 0))))
+             block = bytes([config]) + pack_u16(int(value.get('speed', 0))) + \
+                     pack_u16(int(value.get('backoff', 0))) + bytes([threshold & 0xFF])
+             writes = [(reg_homing, block), (reg_control, bytes([MOTOR_CTRL_HOME]))]
+             if all(serial_handler.write_registers(writes)):
+                 logger.info(f"Started Motor {motor_id} homing ({'StallGuard' if config & HOMING_CFG_STALLGUARD else 'switch'})")
+             else: logger.warning(f"Failed to start Motor {motor_id} homing")
+
+        # Add more command handlers here
 
         else:
             logger.warning(f"Unknown action '{action}' for motor {motor_id}")
@@ -217,10 +360,138 @@ def handle_command(payload):
     except Exception as e:
         logger.error(f"Unexpected error processing command {payload}: {e}", exc_info=True)
 
+# --- Status Publishing ---
+def publish_status(current_status):
+    """Publishes a status dict to MQTT if it differs from the last one sent.
+    In compact mode the sample is batched instead (sent by the batcher)."""
+    global last_status
+    if status_batcher:
+        status_batcher.add(current_status)
+        return
+    # Compare with last sent status to reduce MQTT traffic
+    if current_status != last_status:
+        mqtt_client.publish(f"devices/{DEVICE_ID}/status", current_status)
+        logger.debug(f"Published status: {current_status}")
+        last_status = current_status # Update cache
+    else:
+         logger.debug("Status unchanged, skipping publish.")
+
+def handle_telemetry(telemetry):
+    """Called by the serial reader thread for each telemetry frame pushed by the Pico."""
+    global last_telemetry_time
+    last_telemetry_time = time.monotonic()
+    if mqtt_client and mqtt_client.is_connected():
+        publish_status(telemetry)
+
+def enable_telemetry(period_ms):
+    """Starts the serial reader and switches the Pico to telemetry push mode."""
+    serial_handler.start_reader(handle_telemetry)
+    if (serial_handler.write_register(REG_TELEMETRY_PERIOD_L, pack_u16(period_ms)) and
+            serial_handler.write_register(REG_TELEMETRY_CONTROL, bytes([TELEMETRY_CTRL_PERIODIC | TELEMETRY_CTRL_ON_CHANGE]))):
+        logger.info(f"Telemetry push enabled (period {period_ms} ms, plus on change).")
+    else:
+        logger.warning("Failed to enable telemetry push, falling back to polling.")
+
+def telemetry_is_fresh():
+    """True while pushed telemetry frames keep arriving (polling not needed)."""
+    if TELEMETRY_PERIOD_MS <= 0:
+        return False
+    max_age = max(2.0, 3 * TELEMETRY_PERIOD_MS / 1000.0)
+    return time.monotonic() - last_telemetry_time < max_age
+
 # --- Periodic Status Update ---
+def status_ranges():
+    """Register ranges making up the status message."""
+    ranges = [(REG_STATUS, 3)] # STATUS/SWITCH/ERROR are contiguous
+    ranges += [(axis_reg(axis, AXIS_CURRENT_POS_L), 4) for axis in range(NUM_AXES)]
+    ranges += [(axis_reg(axis, AXIS_CURRENT_SPEED_L), 2) for axis in range(NUM_AXES)]
+    return ranges
+
+def refresh_register_mirror():
+    """
+    Brings register_mirror up to date with the registers the Pico changed
+    (CMD_READ_CHANGES), reading the status ranges in full the first time and
+    after any failed fetch. Returns True if a status register changed, False
+    if none did, None on error.
+    """
+    global register_mirror
+    ranges = status_ranges()
+    if register_mirror is None:
+        results = serial_handler.read_snapshot(ranges) # One frame unless 4 axes exceed its range count
+        if not results:
+            return None
+        mirror = bytearray(REGISTER_MAP_SIZE)
+        for (reg_addr, num_bytes), data in zip(ranges, results):
+            mirror[reg_addr:reg_addr + num_bytes] = data
+        register_mirror = mirror
+        return True
+
+    touched = False
+    for _ in range(MAX_CHANGE_FETCHES):
+        result = serial_handler.read_changes()
+        if result is None:
+            register_mirror = None # Lost changes can't be fetched again
+            return None
+        changes, more = result
+        for reg_addr, data in changes:
+            register_mirror[reg_addr:reg_addr + len(data)] = data
+            if any(reg_addr < start + length and start < reg_addr + len(data) for start, length in ranges):
+                touched = True
+        if not more:
+            break
+    return touched
+
+def update_status_once():
+    """Fetches the changed registers and publishes the status if it changed.
+    Returns False if the Pico could not be read."""
+    # Only what the Pico changed since the last fetch crosses the link
+    changed = refresh_register_mirror()
+    if changed is None:
+        return False
+    if not changed:
+        logger.debug("No status registers changed, skipping publish.")
+        return True
+
+    # --- Unpack Data ---
+    mirror = register_mirror
+    flags_bytes = mirror[REG_STATUS:REG_STATUS + 3]
+    pos_regs = [axis_reg(axis, AXIS_CURRENT_POS_L) for axis in range(NUM_AXES)]
+    speed_regs = [axis_reg(axis, AXIS_CURRENT_SPEED_L) for axis in range(NUM_AXES)]
+    positions = [unpack_i32(mirror[reg:reg + 4]) for reg in pos_regs]
+    speeds = [unpack_u16(mirror[reg:reg + 2]) for reg in speed_regs]
+
+    # --- Prepare Payload ---
+    current_status = {
+        "timestamp": time.time(),
+        "status_flags": unpack_u8(flags_bytes[0:1]),
+        "switch_flags": unpack_u8(flags_bytes[1:2]),
+        "error_flags": unpack_u8(flags_bytes[2:3]),
+        # Add other readable registers if needed (e.g., config readback)
+    }
+    for axis in range(NUM_AXES):
+        current_status[f"motor{axis + 1}_pos"] = positions[axis]
+        current_status[f"motor{axis + 1}_speed"] = speeds[axis]
+
+    # --- Publish if Status Changed ---
+    publish_status(current_status)
+    return True
+
+def poll_status():
+    """Status job of the async agent: one pass of status_update_loop() without its waits."""
+    if status_batcher:
+        status_batcher.flush_if_stale(time.time())
+    if not serial_handler or not mqtt_client or not mqtt_client.is_connected() or telemetry_is_fresh():
+        return
+    try:
+        if not update_status_once():
+            logger.warning("Failed to read status registers from Pico.")
+    except ProtocolError as e:
+        logger.error(f"Serial Protocol Error in status poll: {e}")
+
 def status_update_loop():
-    """Periodically reads status from Pico and publishes to MQTT."""
-    global serial_handler, mqtt_client, stop_event, last_status
+    """Periodically reads status from Pico and publishes to MQTT.
+    In telemetry mode this only polls while pushed frames are missing."""
+    global serial_handler, mqtt_client, stop_event
     logger.info("Starting status update loop...")
     status_read_errors = 0
 
@@ -234,18 +505,15 @@ def status_update_loop():
             logger.warning("Status Loop: MQTT client not connected.")
             stop_event.wait(2)
             continue
+        if status_batcher:
+            status_batcher.flush_if_stale(time.time()) # Don't hold samples when updates stall
+        if telemetry_is_fresh():
+            stop_event.wait(1.0) # Pico is pushing status on its own
+            continue
 
         try:
-            # --- Read Status Registers ---
-            # Combine reads if protocol supports multi-register reads
-            status_bytes = serial_handler.read_register(REG_STATUS, 1)
-            switches_bytes = serial_handler.read_register(REG_SWITCH_STATUS, 1)
-            errors_bytes = serial_handler.read_register(REG_ERROR_FLAGS, 1)
-            m1_pos_bytes = serial_handler.read_register(REG_MOTOR1_CURRENT_POS_L, 4)
-            m2_pos_bytes = serial_handler.read_register(REG_MOTOR2_CURRENT_POS_L, 4)
-
-            if not all([status_bytes, switches_bytes, errors_bytes, m1_pos_bytes, m2_pos_bytes]):
-                logger.warning("Failed to read one or more status registers from Pico.")
+            if not update_status_once():
+                logger.warning("Failed to read status registers from Pico.")
                 status_read_errors += 1
                 if status_read_errors > 5:
                     logger.error("Multiple consecutive status read failures. Check Pico connection.")
@@ -255,33 +523,6 @@ def status_update_loop():
 
             status_read_errors = 0 # Reset error count on success
 
-            # --- Unpack Data ---
-            status_flags = unpack_u8(status_bytes)
-            switch_flags = unpack_u8(switches_bytes)
-            error_flags = unpack_u8(errors_bytes)
-            motor1_pos = unpack_i32(m1_pos_bytes)
-            motor2_pos = unpack_i32(m2_pos_bytes)
-
-            # --- Prepare Payload ---
-            current_status = {
-                "timestamp": time.time(),
-                "status_flags": status_flags,
-                "switch_flags": switch_flags,
-                "error_flags": error_flags,
-                "motor1_pos": motor1_pos,
-                "motor2_pos": motor2_pos,
-                # Add other readable registers if needed (e.g., current speed, config readback)
-            }
-
-            # --- Publish if Status Changed ---
-            # Compare with last sent status to reduce MQTT traffic
-            if current_status != last_status:
-                mqtt_client.publish(f"devices/{DEVICE_ID}/status", current_status)
-                logger.debug(f"Published status: {current_status}")
-                last_status = current_status # Update cache
-            else:
-                 logger.debug("Status unchanged, skipping publish.")
-
         except ProtocolError as e:
             logger.error(f"Serial Protocol Error in status loop: {e}")
             status_read_errors += 1
@@ -294,7 +535,7 @@ def status_update_loop():
 
         # --- Loop Timing ---
         elapsed = time.monotonic() - start_time
-        sleep_time = max(0, 1.0 - elapsed) # Target loop time 1 second
+        sleep_time = max(0, STATUS_PERIOD_MS / 1000.0 - elapsed) # Target loop time (1 second by default)
         if sleep_time > 0:
             stop_event.wait(sleep_time) # Use event wait for clean shutdown
 
@@ -307,10 +548,12 @@ if __name__ == "__main__":
 
     # 1. Initialize Serial Communication
     try:
-        serial_handler = SerialHandler(SERIAL_PORT, BAUD_RATE, timeout=0.5) # Shorter timeout
+        serial_handler = SerialHandler(SERIAL_PORT, BAUD_RATE, timeout=0.5, framed=FRAMED_PROTOCOL) # Shorter timeout
         logger.info(f"Serial port {SERIAL_PORT} opened.")
         # Brief pause to allow Pico to settle after potential reset on connect
         time.sleep(2.0)
+        if TARGET_BAUD_RATE != BAUD_RATE and not serial_handler.negotiate_baud(TARGET_BAUD_RATE):
+            logger.warning(f"Baud negotiation to {TARGET_BAUD_RATE} failed, staying at {serial_handler.baudrate}.")
         # Perform a simple read to test connection?
         # test_read = serial_handler.read_register(REG_STATUS, 1)
         # if not test_read: logger.warning("Initial serial test read failed.")
@@ -335,18 +578,32 @@ if __name__ == "__main__":
         logger.error(f"Failed during initial configuration fetch/apply: {e}")
         # Continue running even if config fetch fails? Or exit? Depends on requirements.
 
-    # 3. Initialize MQTT Client
+    # 3. Switch to Telemetry Push Mode (if configured)
+    if TELEMETRY_PERIOD_MS > 0:
+        enable_telemetry(TELEMETRY_PERIOD_MS)
+
+    # 4. Initialize MQTT Client
     mqtt_client = MqttClient(MQTT_BROKER, MQTT_PORT, DEVICE_ID, MQTT_USER, MQTT_PASS)
     mqtt_client.set_command_callback(handle_command)
     mqtt_client.connect()
-
-    # 4. Start Status Update Thread
-    status_thread = threading.Thread(target=status_update_loop, name="StatusLoop", daemon=True)
-    status_thread.start()
-
-    # 5. Keep Main Thread Alive & Monitor Connections
+    if STATUS_FORMAT == 'compact':
+        status_batcher = StatusBatcher(NUM_AXES, STATUS_BATCH_SIZE, STATUS_BATCH_MAX_AGE_MS / 1000.0,
+                                       lambda payload: mqtt_client.publish(f"devices/{DEVICE_ID}/status", payload))
+        logger.info(f"Compact status format, batches of up to {status_batcher.batch_size} samples.")
+
+    # 5. Start Status Update Thread (the async agent schedules status polls itself)
+    status_thread = None
+    if AGENT_MODE != 'async':
+        status_thread = threading.Thread(target=status_update_loop, name="StatusLoop", daemon=True)
+        status_thread.start()
+
+    # 6. Keep Main Thread Alive & Monitor Connections
     logger.info("Agent running. Press Ctrl+C to stop.")
     try:
+        if AGENT_MODE == 'async':
+            agent = AsyncAgent(mqtt_client, command_transactions, poll_status, STATUS_PERIOD_MS / 1000.0, stop_event,
+                               fetch_config, apply_config)
+            asyncio.run(agent.run())
         while not stop_event.is_set():
             if not mqtt_client.is_connected():
                 logger.warning("MQTT disconnected. Attempting reconnect...")
@@ -372,7 +629,7 @@ if __name__ == "__main__":
         logger.info("Shutting down agent...")
         stop_event.set()
 
-        if status_thread.is_alive():
+        if status_thread and status_thread.is_alive():
             logger.info("Waiting for status loop to finish...")
             status_thread.join(timeout=2.0) # Wait max 2 seconds
             if status_thread.is_alive():
@@ -382,6 +639,10 @@ if __name__ == "__main__":
             logger.info("Disconnecting MQTT client...")
             mqtt_client.disconnect()
 
+        if serial_handler and TELEMETRY_PERIOD_MS > 0:
+            logger.info("Disabling telemetry push...")
+            serial_handler.write_register(REG_TELEMETRY_CONTROL, bytes([0x00]))
+
         if serial_handler:
             logger.info("Closing serial port...")
             serial_handler.close()
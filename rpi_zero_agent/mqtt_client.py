@@ -137,8 +137,9 @@ class MqttClient:
             return False
 
         try:
-            json_payload = json.dumps(payload)
-            rc, mid = self._client.publish(topic, json_payload, qos=qos, retain=retain)
+            # bytes go out as they are (compact status), anything else as JSON
+            data = payload if isinstance(payload, (bytes, bytearray)) else json.dumps(payload)
+            rc, mid = self._client.publish(topic, data, qos=qos, retain=retain)
             if rc == mqtt.MQTT_ERR_SUCCESS:
                logger.debug(f"Publish initiated to {topic} (MID: {mid}, QoS: {qos})")
                return True
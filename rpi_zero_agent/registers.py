@@ -0,0 +1,143 @@
+"""Register map of the Pico firmware. Generated by pico_firmware/tools/regmap_gen.py
+from pico_firmware/registers.json (--axes 2). Do not edit; regenerate for the
+STEPPER_NUM_AXES the Pico runs."""
+
+NUM_AXES = 2
+AXIS_BASE = 0x10
+AXIS_STRIDE = 0x40
+REGISTER_MAP_SIZE = 0xDB
+
+def axis_reg(axis, offset):
+    """Address of a per-axis register: axis 0..NUM_AXES-1 (motor number - 1), offset AXIS_*."""
+    if not 0 <= axis < NUM_AXES:
+        raise ValueError(f"Axis {axis} out of range (0-{NUM_AXES - 1})")
+    return AXIS_BASE + axis * AXIS_STRIDE + offset
+
+# --- Global Registers ---
+REG_STATUS = 0x00 # R (1 byte): Bitmask: 0=Ready, 1=M1 Moving, 2=M2 Moving, 3=M1 Homing, 4=M2 Homing, 5=Coordinated Move (every axis: REG_MOTOR_STATUS)
+REG_SWITCH_STATUS = 0x01 # R (1 byte): Bitmask: bit n = SW of axis n Pressed (Active LOW)
+REG_ERROR_FLAGS = 0x02 # R (1 byte): Bitmask: bit n = Endstop of axis n: hard stop, or a move into the pressed switch refused (cleared by the motor's next move), bit 4+n = Driver fault of axis n (see REG_MOTOR_DRIVER_FAULTS)
+REG_TELEMETRY_CONTROL = 0x03 # R/W (1 byte): Bitmask: 0=Periodic push, 1=Push on change
+REG_TELEMETRY_PERIOD_L = 0x04 # R/W (2 bytes total): Periodic push interval (ms)
+REG_TELEMETRY_PERIOD_H = 0x05 # R/W
+REG_COORD_CONTROL = 0x06 # W (1 byte): Bitmask: 0=Start Coordinated Move, 1=Stop
+REG_COORD_FEED_RATE_L = 0x07 # R/W (2 bytes total): Path speed (steps/sec along the line)
+REG_COORD_FEED_RATE_H = 0x08 # R/W
+REG_COORD_ACCEL_L = 0x09 # R/W (2 bytes total): Path acceleration (steps/sec^2)
+REG_COORD_ACCEL_H = 0x0A # R/W
+REG_COORD_JERK_TIME_L = 0x0B # R/W (2 bytes total): S-curve accel ramp time (ms), 0 = Trapezoidal
+REG_COORD_JERK_TIME_H = 0x0C # R/W
+REG_LATCH_CONTROL = 0x0D # R/W (1 byte): 1 = Serve reads from a frozen copy of the map, 0 = Live
+
+# --- Per-Axis Registers (offsets into an axis block, see axis_reg()) ---
+AXIS_CONTROL = 0x00 # W (1 byte): Bitmask: 0=Start Move, 1=Stop Move, 2=Start Homing
+AXIS_TARGET_POS_L = 0x01 # R/W (4 bytes total): Target position (steps), Little Endian LSB
+AXIS_TARGET_POS_M = 0x02 # R/W
+AXIS_TARGET_POS_H = 0x03 # R/W
+AXIS_TARGET_POS_U = 0x04 # R/W
+AXIS_CURRENT_POS_L = 0x05 # R (4 bytes total): Current position (steps), Little Endian LSB
+AXIS_CURRENT_POS_M = 0x06 # R
+AXIS_CURRENT_POS_H = 0x07 # R
+AXIS_CURRENT_POS_U = 0x08 # R
+AXIS_MAX_SPEED_L = 0x09 # R/W (2 bytes total): Max speed (e.g., steps/sec)
+AXIS_MAX_SPEED_H = 0x0A # R/W
+AXIS_ACCEL_L = 0x0B # R/W (2 bytes total): Acceleration (e.g., steps/sec^2)
+AXIS_ACCEL_H = 0x0C # R/W
+AXIS_CONFIG_L = 0x0D # R/W (2 bytes total): Bits 0-3=MRES, 4-8=IRUN, 9-13=IHOLD, 14=StealthChop, 15=Interpolation; 0 = Defaults (see tmc2130.h)
+AXIS_CONFIG_H = 0x0E # R/W
+AXIS_STATUS = 0x0F # R (1 byte): Bitmask: 0=Moving, 1=Homing
+AXIS_CURRENT_SPEED_L = 0x10 # R (2 bytes total): Current planned speed (steps/sec)
+AXIS_CURRENT_SPEED_H = 0x11 # R
+AXIS_JERK_TIME_L = 0x12 # R/W (2 bytes total): S-curve accel ramp time (ms), 0 = Trapezoidal
+AXIS_JERK_TIME_H = 0x13 # R/W
+AXIS_QUEUE_TARGET_L = 0x14 # R/W (4 bytes total): Target of the segment to queue
+AXIS_QUEUE_TARGET_M = 0x15 # R/W
+AXIS_QUEUE_TARGET_H = 0x16 # R/W
+AXIS_QUEUE_TARGET_U = 0x17 # R/W
+AXIS_QUEUE_SPEED_L = 0x18 # R/W (2 bytes total): Max speed of the segment to queue
+AXIS_QUEUE_SPEED_H = 0x19 # R/W
+AXIS_QUEUE_ACCEL_L = 0x1A # R/W (2 bytes total): Accel of the segment to queue
+AXIS_QUEUE_ACCEL_H = 0x1B # R/W
+AXIS_QUEUE_CONTROL = 0x1C # W (1 byte): Bitmask: 0=Push segment, 1=Flush queue (ramps a queued move down). Write QUEUE_TARGET..QUEUE_CONTROL in one frame; NACK if full
+AXIS_QUEUE_FREE = 0x1D # R (1 byte): Free slots in the move queue
+AXIS_HOMING_CONFIG = 0x20 # R/W (1 byte): Bitmask: 0=Home towards positive, 1=StallGuard (DIAG1) instead of the switch
+AXIS_HOMING_SPEED_L = 0x21 # R/W (2 bytes total): Seek speed (steps/sec), 0 = Default
+AXIS_HOMING_SPEED_H = 0x22 # R/W
+AXIS_HOMING_BACKOFF_L = 0x23 # R/W (2 bytes total): Back-off distance (steps), 0 = Default
+AXIS_HOMING_BACKOFF_H = 0x24 # R/W
+AXIS_STALL_THRESHOLD = 0x25 # R/W (1 byte): StallGuard2 threshold SGT (signed, -64..63, higher = less sensitive)
+AXIS_HOMING_STATE = 0x26 # R (1 byte): 0=Idle, 1=Seek, 2=Back-off, 3=Latch, 4=Done, 5=Failed, 6=Waiting
+AXIS_ENDSTOP_POS_L = 0x28 # R (4 bytes total): Position at the last press edge (steps)
+AXIS_ENDSTOP_POS_M = 0x29 # R
+AXIS_ENDSTOP_POS_H = 0x2A # R
+AXIS_ENDSTOP_POS_U = 0x2B # R
+AXIS_ENDSTOP_TIME_L = 0x2C # R (4 bytes total): time_us_64() at that edge, low 32 bits (us)
+AXIS_ENDSTOP_TIME_M = 0x2D # R
+AXIS_ENDSTOP_TIME_H = 0x2E # R
+AXIS_ENDSTOP_TIME_U = 0x2F # R
+AXIS_DRIVER_MODE_CONTROL = 0x30 # R/W (1 byte): Bitmask: 0=StealthChop below STEALTH_MAX_SPEED, SpreadCycle above, 1=CoolStep
+AXIS_STEALTH_MAX_SPEED_L = 0x31 # R/W (2 bytes total): StealthChop -> SpreadCycle speed (steps/sec), 0 = Default
+AXIS_STEALTH_MAX_SPEED_H = 0x32 # R/W
+AXIS_COOLSTEP_MIN_SPEED_L = 0x33 # R/W (2 bytes total): CoolStep active above this speed (steps/sec), 0 = Default
+AXIS_COOLSTEP_MIN_SPEED_H = 0x34 # R/W
+AXIS_COOLSTEP_CONFIG_L = 0x35 # R/W (2 bytes total): COOLCONF bits 0-15 (SEMIN, SEUP, SEMAX, SEDN, SEIMIN), 0 = Default
+AXIS_COOLSTEP_CONFIG_H = 0x36 # R/W
+AXIS_DRIVER_MODE = 0x37 # R (1 byte): Mode at the current planned speed: 0=StealthChop, 1=SpreadCycle, 2=CoolStep, 3=StallGuard homing
+AXIS_SG_RESULT_L = 0x38 # R (2 bytes total): DRV_STATUS.SG_RESULT (load, 0 = highest; valid in SpreadCycle above COOLSTEP_MIN_SPEED)
+AXIS_SG_RESULT_H = 0x39 # R
+AXIS_CS_ACTUAL = 0x3A # R (1 byte): DRV_STATUS.CS_ACTUAL (current scale set by CoolStep, 0-31)
+AXIS_DRIVER_FAULTS = 0x3B # R (1 byte): Bitmask, latched until the axis' next move: 0=Stall, 1=Overtemp pre-warning, 2=Overtemp shutdown, 3=Short to GND, 4=Open load, 5=Steps lost (MSCNT), 6=Position corrected
+AXIS_MSCNT_L = 0x3C # R (2 bytes total): Driver microstep counter (0-1023 = 4 full steps), sampled by the DRV_STATUS scan
+AXIS_MSCNT_H = 0x3D # R
+AXIS_STALL_RECOVERY = 0x3E # R/W (1 byte): Bits 0-1 on a stall: 0=Off (no detection), 1=Flag, 2=Flag and stop, 3=Flag, stop and re-home; bit 2=Check MSCNT at standstill, correct lost steps
+AXIS_POS_ADJUST = 0x3F # W (1 byte): Signed steps added to the position while the axis is idle (driver monitor corrections)
+
+# --- Diagnostics Block ---
+REG_DIAG_BASE = 0x90
+REG_DIAG_CONTROL = 0x90 # W (1 byte): Bitmask: 0=Reset all statistics (self-clearing)
+REG_DIAG_CORE0_LOOP_MIN_L = 0x91 # R (4 bytes total): Shortest core 0 (communication) loop pass
+REG_DIAG_CORE0_LOOP_MIN_M = 0x92 # R
+REG_DIAG_CORE0_LOOP_MIN_H = 0x93 # R
+REG_DIAG_CORE0_LOOP_MIN_U = 0x94 # R
+REG_DIAG_CORE0_LOOP_AVG_L = 0x95 # R (4 bytes total): Average pass (moving average, 1/16 weight)
+REG_DIAG_CORE0_LOOP_AVG_M = 0x96 # R
+REG_DIAG_CORE0_LOOP_AVG_H = 0x97 # R
+REG_DIAG_CORE0_LOOP_AVG_U = 0x98 # R
+REG_DIAG_CORE0_LOOP_MAX_L = 0x99 # R (4 bytes total): Longest pass
+REG_DIAG_CORE0_LOOP_MAX_M = 0x9A # R
+REG_DIAG_CORE0_LOOP_MAX_H = 0x9B # R
+REG_DIAG_CORE0_LOOP_MAX_U = 0x9C # R
+REG_DIAG_CORE1_LOOP_MIN_L = 0x9D # R (4 bytes total): Shortest core 1 (motion) loop pass
+REG_DIAG_CORE1_LOOP_MIN_M = 0x9E # R
+REG_DIAG_CORE1_LOOP_MIN_H = 0x9F # R
+REG_DIAG_CORE1_LOOP_MIN_U = 0xA0 # R
+REG_DIAG_CORE1_LOOP_AVG_L = 0xA1 # R (4 bytes total)
+REG_DIAG_CORE1_LOOP_AVG_M = 0xA2 # R
+REG_DIAG_CORE1_LOOP_AVG_H = 0xA3 # R
+REG_DIAG_CORE1_LOOP_AVG_U = 0xA4 # R
+REG_DIAG_CORE1_LOOP_MAX_L = 0xA5 # R (4 bytes total)
+REG_DIAG_CORE1_LOOP_MAX_M = 0xA6 # R
+REG_DIAG_CORE1_LOOP_MAX_H = 0xA7 # R
+REG_DIAG_CORE1_LOOP_MAX_U = 0xA8 # R
+REG_DIAG_UART_FRAMES_OK_L = 0xA9 # R (2 bytes total): Frames with a valid checksum/CRC (wraps)
+REG_DIAG_UART_FRAMES_OK_H = 0xAA # R
+REG_DIAG_UART_CHECKSUM_ERRORS_L = 0xAB # R (2 bytes total): Frames dropped for a bad checksum/CRC (wraps)
+REG_DIAG_UART_CHECKSUM_ERRORS_H = 0xAC # R
+REG_DIAG_UART_NACKS_L = 0xAD # R (2 bytes total): NACK responses sent (wraps)
+REG_DIAG_UART_NACKS_H = 0xAE # R
+REG_DIAG_UART_RX_OVERFLOWS_L = 0xAF # R (2 bytes total): Bytes lost to a full RX ring (wraps)
+REG_DIAG_UART_RX_OVERFLOWS_H = 0xB0 # R
+REG_DIAG_SPI_TIME_LAST_L = 0xB1 # R (2 bytes total): Last blocking TMC SPI transaction (saturates at 0xFFFF)
+REG_DIAG_SPI_TIME_LAST_H = 0xB2 # R
+REG_DIAG_SPI_TIME_MAX_L = 0xB3 # R (2 bytes total): Longest blocking TMC SPI transaction
+REG_DIAG_SPI_TIME_MAX_H = 0xB4 # R
+REG_DIAG_STEP_IRQ_DRY_L = 0xB5 # R (2 bytes total): Step IRQs that found an active axis' FIFO empty (PIO about to stall, wraps)
+REG_DIAG_STEP_IRQ_DRY_H = 0xB6 # R
+REG_DIAG_STEP_IRQ_HIST = 0xB7 # R (16 bytes total): Step IRQ service time histogram, 8 u16 buckets (saturating), see diagnostics.h
+REG_DIAG_STEP_IRQ_HIST_END = 0xC6 # R (last byte)
+REG_DIAG_LOG_CONTROL = 0xC7 # R/W (1 byte): Bitmask: 0=Next record (self-clearing), 1=Host readout instead of stdio, 2=Clear (self-clearing)
+REG_DIAG_LOG_PENDING = 0xC8 # R (1 byte): Records waiting, including the one in the window (saturates at 255)
+REG_DIAG_LOG_DROPPED_L = 0xC9 # R (2 bytes total): Records lost to a full ring since the last clear (wraps)
+REG_DIAG_LOG_DROPPED_H = 0xCA # R
+REG_DIAG_LOG_RECORD = 0xCB # R (16 bytes total): Oldest record with host readout: time u32, event u8, axis u8, arg16 u16, arg0 i32, arg1 i32
+REG_DIAG_LOG_RECORD_END = 0xDA # R (last byte)
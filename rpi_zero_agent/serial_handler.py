@@ -2,22 +2,120 @@ import serial
 import time
 import logging
 import threading
+import queue
+import struct
+import binascii
 from collections import deque
 
+from registers import NUM_AXES, REG_STATUS, REG_LATCH_CONTROL, REG_DIAG_BASE # Generated, see pico_firmware/tools/regmap_gen.py
+
 logger = logging.getLogger("SerialHandler")
 
+# --- Telemetry Push Frames (Mirror from Pico's telemetry.h) ---
+# [MARKER] [LEN] [STATUS] [SWITCHES] [ERRORS] [M1_POS]...[Mn_POS] [M1_SPEED]...[Mn_SPEED] [CHECKSUM]
+TELEMETRY_FRAME_MARKER = 0xFE
+TELEMETRY_PAYLOAD_FORMAT = '<BBB' + 'i' * NUM_AXES + 'H' * NUM_AXES
+TELEMETRY_PAYLOAD_LEN = struct.calcsize(TELEMETRY_PAYLOAD_FORMAT)
+
+# --- Sequenced Commands (Mirror from Pico's uart_protocol.h) ---
+CMD_SEQ_FLAG = 0x80
+RESP_SEQ_MARKER = 0xFD
+DEFAULT_WINDOW_SIZE = 8  # Max sequenced commands in flight (keeps the Pico's RX/TX rings well clear)
+
+# --- 16-bit Register Addresses (Mirror from Pico's uart_protocol.h) ---
+# Addresses from SHORT_ADDR_LIMIT up (maps of 3-4 axes) go out with CMD_ADDR16_FLAG:
+# [CMD | FLAG] [ADDR_L] [ADDR_H] ..., answered with [RESP_ADDR16_MARKER] [ADDR_L] [ADDR_H] ...
+CMD_ADDR16_FLAG = 0x40
+RESP_ADDR16_MARKER = 0xFC
+SHORT_ADDR_LIMIT = 0xFC
+
+# --- Read Latch (Mirror from Pico's uart_protocol.h) ---
+MULTI_READ_MAX_RANGES = 8
+MULTI_READ_MAX_BYTES = 32
+
+# --- Framed Protocol (Mirror from Pico's uart_protocol.h) ---
+# [FRAME_SYNC0] [FRAME_SYNC1] [LEN] [BODY] [CRC_H] [CRC_L], BODY = legacy frame without its XOR byte
+FRAME_SYNC0 = 0xAA
+FRAME_SYNC1 = 0x55
+FRAME_CRC_INIT = 0xFFFF # CRC-16/CCITT-FALSE over LEN + BODY (binascii.crc_hqx)
+FRAME_MAX_BODY = 100
+
+# --- Baud Rate Switching (Mirror from Pico's uart_protocol.h) ---
+CMD_SET_BAUD = 0x04
+UART_DEFAULT_BAUD = 115200
+UART_BAUD_TABLE = [115200, 230400, 460800, 921600, 1000000, 2000000, 3000000] # Index = BAUD_CODE
+UART_BAUD_CONFIRM_TIMEOUT_S = 1.0 # Pico falls back to the default rate after this without a valid frame
+
+# --- Changed Registers (Mirror from Pico's uart_protocol.h) ---
+# [CMD_READ_CHANGES] [0x00] [MAX_LEN] -> [RUNS] [PAYLOAD_LEN] {[ADDR_L] [ADDR_H] [LEN] [DATA...]} [CHECKSUM]
+CMD_READ_CHANGES = 0x05
+RESP_CHANGES_MORE = 0x80
+CHANGES_MAX_LEN = 40
+CHANGES_RUN_HEADER = 3
+
+# --- Staged Bulk Write (Mirror from Pico's uart_protocol.h) ---
+# [CMD_STAGE_WRITE] [RUNS | STAGE_BEGIN] [PAYLOAD_LEN] {[ADDR_L] [ADDR_H] [LEN] [DATA...]} -> [RUNS | STAGE_BEGIN] [ACK/NACK]
+# [CMD_STAGE_COMMIT] [RUNS] [0x02] [CRC_H] [CRC_L] -> [RUNS] [ACK/NACK], CRC-16 over all staged payloads
+CMD_STAGE_WRITE = 0x06
+CMD_STAGE_COMMIT = 0x07
+STAGE_BEGIN = 0x80
+STAGE_MAX_LEN = 96
+STAGE_MAX_TRACKED = REG_DIAG_BASE # Runs must end below the diagnostics block
+
+# Expected response length for frames sized by their second byte: [X] [LEN] [LEN bytes] [CHECKSUM]
+RESP_LEN_FROM_HEADER = -1
+
+def _response_len_ok(response, expected_len):
+    if expected_len == RESP_LEN_FROM_HEADER:
+        return len(response) >= 3 and len(response) == response[1] + 3
+    return len(response) == expected_len
+
+def _addr_field(reg_addr):
+    """(command flag, address bytes) for a READ/WRITE of reg_addr."""
+    if reg_addr < SHORT_ADDR_LIMIT:
+        return 0, bytes([reg_addr])
+    return CMD_ADDR16_FLAG, reg_addr.to_bytes(2, 'little')
+
+def _resp_addr(reg_addr):
+    """Address field the Pico echoes in a READ/WRITE response."""
+    if reg_addr < SHORT_ADDR_LIMIT:
+        return bytes([reg_addr])
+    return bytes([RESP_ADDR16_MARKER]) + reg_addr.to_bytes(2, 'little')
+
+class _Transaction:
+    """A sequenced command awaiting its response, matched by sequence ID."""
+    def __init__(self, seq, body_len):
+        self.seq = seq
+        self.body_len = body_len     # Response length after the [MARKER][SEQ] prefix
+        self.done = threading.Event()
+        self.response = None         # Full frame incl. prefix, set by the reader
+
 class ProtocolError(Exception):
     """Custom exception for serial communication protocol errors."""
     pass
 
 class SerialHandler:
-    def __init__(self, port, baudrate, timeout=0.5, read_timeout=0.2):
+    def __init__(self, port, baudrate, timeout=0.5, read_timeout=0.2, framed=False):
         self.port = port
+        # Framed mode: every frame travels in the CRC-16 envelope. Frames are
+        # still built and validated in the legacy layout (ending in the XOR
+        # checksum); _send_cmd() / _read_frame() convert at the wire.
+        self.framed = framed
         self.baudrate = baudrate
         self.timeout = timeout          # General timeout for operations
         self.read_timeout = read_timeout # Specific timeout for byte reads
         self.ser = None
         self._lock = threading.Lock()   # Lock for ensuring thread-safe serial access
+        # Background reader (telemetry mode): demultiplexes pushed telemetry
+        # frames from command responses, which are handed over via _responses
+        self._reader_thread = None
+        self._reader_stop = threading.Event()
+        self._responses = queue.Queue()
+        self._expected_len = 0          # Length of the response currently awaited (_pending_lock)
+        self._telemetry_callback = None
+        self._pending = {}              # seq -> _Transaction (sequenced commands in flight)
+        self._pending_lock = threading.Lock() # _pending and _expected_len, shared with the reader
+        self._next_seq = 0
         self._connect()
 
     def _connect(self):
@@ -45,6 +143,7 @@ class SerialHandler:
             raise # Re-raise the exception
 
     def close(self):
+        self.stop_reader()
         with self._lock:
             if self.ser and self.ser.is_open:
                 try:
@@ -64,10 +163,49 @@ class SerialHandler:
             checksum ^= byte
         return checksum
 
+    def _frame(self, body):
+        """Wraps a frame body (no XOR byte) in the sync/length/CRC-16 envelope."""
+        header = bytes([len(body)]) + body
+        crc = binascii.crc_hqx(header, FRAME_CRC_INIT)
+        return bytes([FRAME_SYNC0, FRAME_SYNC1]) + header + crc.to_bytes(2, 'big')
+
+    def _read_frame(self):
+        """
+        Reads one framed message: hunts for the sync preamble, then checks the
+        length and CRC. Returns the body in the legacy layout (with its XOR
+        checksum appended), or None on timeout or a bad frame. A bad frame
+        costs nothing more: the next call resyncs on the next preamble.
+        """
+        prev = None
+        while True:
+            byte = self.ser.read(1)
+            if not byte:
+                return None
+            if prev == FRAME_SYNC0 and byte[0] == FRAME_SYNC1:
+                break
+            prev = byte[0]
+        length = self.ser.read(1)
+        if not length or length[0] == 0 or length[0] > FRAME_MAX_BODY:
+            logger.warning(f"Framed message with bad length: {length.hex()}")
+            return None
+        rest = self.ser.read(length[0] + 2)
+        if len(rest) != length[0] + 2:
+            logger.warning(f"Truncated framed message: {rest.hex()}")
+            return None
+        body, crc = rest[:-2], int.from_bytes(rest[-2:], 'big')
+        if binascii.crc_hqx(length + body, FRAME_CRC_INIT) != crc:
+            logger.warning(f"Framed message CRC mismatch: {(length + rest).hex()}")
+            return None
+        return body + bytes([self._calculate_checksum(body)])
+
     def _send_cmd(self, command_bytes):
-        """Sends bytes over serial, handling potential errors."""
+        """Sends bytes over serial, handling potential errors.
+        command_bytes is a legacy frame (ending in its XOR checksum); in framed
+        mode the checksum is replaced by the CRC envelope."""
         if not self.is_open():
             raise ProtocolError("Serial port not open.")
+        if self.framed:
+            command_bytes = self._frame(command_bytes[:-1])
         try:
             written = self.ser.write(command_bytes)
             # self.ser.flush() # Often needed, ensures data is sent immediately
@@ -80,11 +218,54 @@ class SerialHandler:
              self.close() # Close port on potentially fatal error
              raise ProtocolError(f"Serial write error: {e}")
 
+    def _expect_response(self, expected_len):
+        """Announces the length of the next response to the background reader.
+        Must be called (under the lock) before the command is sent."""
+        if self._reader_thread:
+            while not self._responses.empty(): # Drop stale responses
+                self._responses.get_nowait()
+            self._set_expected_len(expected_len)
+
+    def _set_expected_len(self, expected_len):
+        with self._pending_lock:
+            self._expected_len = expected_len
+
+    def _take_expected_len(self):
+        """Reader side: claims the awaited response length (0 if none is awaited)."""
+        with self._pending_lock:
+            expected_len, self._expected_len = self._expected_len, 0
+        return expected_len
+
     def _read_response(self, expected_len):
         """Reads a specific number of bytes, handling timeouts and errors."""
         if not self.is_open():
             raise ProtocolError("Serial port not open.")
+        if self._reader_thread:
+            # The reader thread owns the port: wait for it to hand over the frame
+            try:
+                response = self._responses.get(timeout=self.timeout)
+            except queue.Empty:
+                self._set_expected_len(0)
+                raise ProtocolError(f"Serial read timeout: Expected {expected_len} bytes, got none from reader.")
+            if not _response_len_ok(response, expected_len):
+                raise ProtocolError(f"Serial read error: Expected {expected_len} bytes, got {len(response)}: {response.hex()}")
+            logger.debug(f"Serial RX ({len(response)} bytes): {response.hex()}")
+            return response
         try:
+            if self.framed:
+                response = self._read_frame()
+                if response is None:
+                    raise ProtocolError(f"Serial read error: No valid frame (expected {expected_len} bytes).")
+                if not _response_len_ok(response, expected_len):
+                    raise ProtocolError(f"Serial read error: Expected {expected_len} bytes, got {len(response)}: {response.hex()}")
+                logger.debug(f"Serial RX ({len(response)} bytes): {response.hex()}")
+                return response
+            if expected_len == RESP_LEN_FROM_HEADER:
+                response = self._read_sized()
+                if not _response_len_ok(response, expected_len):
+                    raise ProtocolError(f"Serial read error: Truncated response: {response.hex()}")
+                logger.debug(f"Serial RX ({len(response)} bytes): {response.hex()}")
+                return response
             response = self.ser.read(expected_len)
             if len(response) != expected_len:
                  # Distinguish timeout from other issues
@@ -98,6 +279,14 @@ class SerialHandler:
             self.close() # Close port on potentially fatal error
             raise ProtocolError(f"Serial read error: {e}")
 
+    def _read_sized(self, first=b''):
+        """Reads a response sized by its second byte (RESP_LEN_FROM_HEADER),
+        'first' being the bytes already received."""
+        head = first + self.ser.read(2 - len(first))
+        if len(head) != 2:
+            return head
+        return head + self.ser.read(head[1] + 1)
+
     # --- High-Level Protocol Functions ---
 
     def write_register(self, reg_addr, data_bytes):
@@ -105,6 +294,7 @@ class SerialHandler:
         Sends a write command according to the defined protocol.
         Protocol: [CMD_WRITE] [REG_ADDR] [DATA_LEN] [DATA_0]...[DATA_N] [CHECKSUM]
         Expects ACK: [REG_ADDR] [0x00] [CHECKSUM]
+        (REG_ADDR is [ADDR_L] [ADDR_H] with CMD_ADDR16_FLAG, see _addr_field())
         """
         with self._lock: # Ensure exclusive access to serial port
             if not self.is_open():
@@ -117,7 +307,9 @@ class SerialHandler:
                     raise ValueError("Data length exceeds maximum allowed (16 bytes).")
 
                 # Construct header and calculate checksum for payload part
-                header = bytes([cmd_byte, reg_addr, data_len])
+                flag, addr_bytes = _addr_field(reg_addr)
+                resp_addr = _resp_addr(reg_addr)
+                header = bytes([cmd_byte | flag]) + addr_bytes + bytes([data_len])
                 payload_checksum = self._calculate_checksum(data_bytes)
                 # Total checksum includes header and data checksum byte (or full data?)
                 # Assuming checksum covers: CMD, ADDR, LEN, DATA...
@@ -126,27 +318,30 @@ class SerialHandler:
 
                 # Send command
                 command_to_send = full_payload + bytes([total_checksum])
+                ack_len = len(resp_addr) + 2
+                self._expect_response(ack_len)
                 self._send_cmd(command_to_send)
 
-                # Wait for ACK/NACK: [ADDR] [STATUS] [CHECKSUM] (3 bytes)
-                ack_response = self._read_response(3)
+                # Wait for ACK/NACK: [ADDR] [STATUS] [CHECKSUM] (3 bytes, 5 with a 16-bit address)
+                ack_response = self._read_response(ack_len)
 
                 # Validate ACK checksum
-                ack_checksum_calc = self._calculate_checksum(ack_response[:2])
-                if ack_checksum_calc != ack_response[2]:
+                ack_checksum_calc = self._calculate_checksum(ack_response[:-1])
+                if ack_checksum_calc != ack_response[-1]:
                     raise ProtocolError(f"Write ACK checksum mismatch for reg {reg_addr:#04x}. Got {ack_response.hex()}, calcCS={ack_checksum_calc:#04x}")
 
                 # Check ACK content
-                if ack_response[0] != reg_addr:
-                     raise ProtocolError(f"Write ACK address mismatch for reg {reg_addr:#04x}. Got {ack_response[0]:#04x}.")
-                if ack_response[1] == 0x00: # Success ACK code
+                status = ack_response[-2]
+                if ack_response[:-2] != resp_addr:
+                     raise ProtocolError(f"Write ACK address mismatch for reg {reg_addr:#04x}. Got {ack_response[:-2].hex()}.")
+                if status == 0x00: # Success ACK code
                     logger.debug(f"Write successful for reg {reg_addr:#04x}")
                     return True
-                elif ack_response[1] == 0xFF: # NACK code
+                elif status == 0xFF: # NACK code
                      logger.warning(f"Write NACK received for reg {reg_addr:#04x}.")
                      return False
                 else:
-                     raise ProtocolError(f"Write ACK unknown status code {ack_response[1]:#04x} for reg {reg_addr:#04x}.")
+                     raise ProtocolError(f"Write ACK unknown status code {status:#04x} for reg {reg_addr:#04x}.")
 
             except ProtocolError as e:
                  logger.error(f"Write Register Protocol Error (Reg {reg_addr:#04x}): {e}")
@@ -165,6 +360,7 @@ class SerialHandler:
         Sends a read command and returns the received data bytes.
         Protocol: [CMD_READ] [REG_ADDR] [NUM_BYTES] [CHECKSUM]
         Expects Response: [REG_ADDR] [NUM_BYTES] [DATA_0]...[DATA_N] [CHECKSUM]
+        (REG_ADDR is [ADDR_L] [ADDR_H] with CMD_ADDR16_FLAG, see _addr_field())
         """
         with self._lock: # Ensure exclusive access
             if not self.is_open():
@@ -176,15 +372,18 @@ class SerialHandler:
                      raise ValueError("Requested read length exceeds maximum allowed (16 bytes).")
 
                 # Construct command
-                command_payload = bytes([cmd_byte, reg_addr, num_bytes])
+                flag, addr_bytes = _addr_field(reg_addr)
+                resp_addr = _resp_addr(reg_addr)
+                command_payload = bytes([cmd_byte | flag]) + addr_bytes + bytes([num_bytes])
                 checksum = self._calculate_checksum(command_payload)
                 command_to_send = command_payload + bytes([checksum])
 
+                # Expecting response: [ADDR, LEN, DATA..., CHECKSUM]
+                expected_len = len(resp_addr) + 1 + num_bytes + 1 # Addr, Len, Data, Checksum
+
                 # Send command
+                self._expect_response(expected_len)
                 self._send_cmd(command_to_send)
-
-                # Expecting response: [ADDR, LEN, DATA..., CHECKSUM]
-                expected_len = 2 + num_bytes + 1 # Addr, Len, Data, Checksum
                 response = self._read_response(expected_len)
 
                 # Validate checksum (covers Addr, Len, Data)
@@ -196,13 +395,14 @@ class SerialHandler:
                     raise ProtocolError(f"Read response checksum mismatch for reg {reg_addr:#04x}. Got {response.hex()}, calcCS={checksum_calc:#04x}")
 
                 # Validate header
-                if response[0] != reg_addr:
-                     raise ProtocolError(f"Read response address mismatch for reg {reg_addr:#04x}. Expected {reg_addr:#04x}, got {response[0]:#04x}.")
-                if response[1] != num_bytes:
-                     raise ProtocolError(f"Read response length mismatch for reg {reg_addr:#04x}. Expected {num_bytes}, got {response[1]}.")
+                header_len = len(resp_addr) + 1
+                if response[:len(resp_addr)] != resp_addr:
+                     raise ProtocolError(f"Read response address mismatch for reg {reg_addr:#04x}. Expected {resp_addr.hex()}, got {response[:len(resp_addr)].hex()}.")
+                if response[header_len - 1] != num_bytes:
+                     raise ProtocolError(f"Read response length mismatch for reg {reg_addr:#04x}. Expected {num_bytes}, got {response[header_len - 1]}.")
 
                 # Extract data
-                data = response[2:-1] # Bytes between header and checksum
+                data = response[header_len:-1] # Bytes between header and checksum
                 logger.debug(f"Read successful for reg {reg_addr:#04x}: {data.hex()}")
                 return data
 
@@ -217,8 +417,550 @@ class SerialHandler:
                  logger.error(f"Unexpected error during read_register (Reg {reg_addr:#04x}): {e}", exc_info=True)
                  return None
 
+    def read_registers(self, ranges):
+        """
+        Reads several register ranges in a single transaction.
+        ranges: list of (reg_addr, num_bytes) tuples (max 8 ranges, 32 bytes total).
+        Protocol: [CMD_READ_MULTI] [COUNT] [TOTAL_LEN] [ADDR_0] [LEN_0]...[ADDR_N] [LEN_N] [CHECKSUM]
+        Expects Response: [COUNT] [TOTAL_LEN] [DATA of range 0]...[DATA of range N] [CHECKSUM]
+        With any address above 0xFF every range is [ADDR_L] [ADDR_H] [LEN] (CMD_ADDR16_FLAG).
+        Returns a list of bytes objects (one per range), or None on error.
+        """
+        with self._lock: # Ensure exclusive access
+            if not self.is_open():
+                 logger.error("Attempted multi-read while serial port closed.")
+                 return None
+            try:
+                cmd_byte = 0x03 # CMD_READ_MULTI
+                count = len(ranges)
+                total_len = sum(num_bytes for _, num_bytes in ranges)
+                if count == 0 or count > MULTI_READ_MAX_RANGES: # Safety limit
+                     raise ValueError(f"Multi-read range count {count} out of bounds (1-{MULTI_READ_MAX_RANGES}).")
+                if total_len > MULTI_READ_MAX_BYTES: # Safety limit
+                     raise ValueError(f"Multi-read total length {total_len} exceeds maximum allowed ({MULTI_READ_MAX_BYTES} bytes).")
+
+                # Construct command
+                wide = any(reg_addr > 0xFF for reg_addr, _ in ranges)
+                command_payload = bytes([cmd_byte | (CMD_ADDR16_FLAG if wide else 0), count, total_len])
+                for reg_addr, num_bytes in ranges:
+                    addr_bytes = reg_addr.to_bytes(2, 'little') if wide else bytes([reg_addr])
+                    command_payload += addr_bytes + bytes([num_bytes])
+                checksum = self._calculate_checksum(command_payload)
+                command_to_send = command_payload + bytes([checksum])
+
+                # Expecting response: [COUNT, TOTAL_LEN, DATA..., CHECKSUM]
+                expected_len = 2 + total_len + 1
+
+                # Send command
+                self._expect_response(expected_len)
+                self._send_cmd(command_to_send)
+                response = self._read_response(expected_len)
+
+                checksum_calc = self._calculate_checksum(response[:-1])
+                if checksum_calc != response[-1]:
+                    raise ProtocolError(f"Multi-read response checksum mismatch. Got {response.hex()}, calcCS={checksum_calc:#04x}")
+                if response[0] != count or response[1] != total_len:
+                    raise ProtocolError(f"Multi-read response header mismatch. Expected {count}/{total_len}, got {response[0]}/{response[1]}.")
+
+                # Split the concatenated data back into the requested ranges
+                data = response[2:-1]
+                results = []
+                offset = 0
+                for _, num_bytes in ranges:
+                    results.append(data[offset:offset + num_bytes])
+                    offset += num_bytes
+                logger.debug(f"Multi-read successful ({count} ranges): {data.hex()}")
+                return results
+
+            except ProtocolError as e:
+                 logger.error(f"Read Registers Protocol Error ({ranges}): {e}")
+                 self._flush_input() # Attempt to clear buffer after error
+                 return None
+            except ValueError as e:
+                 logger.error(f"Read Registers Value Error: {e}")
+                 return None
+            except Exception as e:
+                 logger.error(f"Unexpected error during read_registers: {e}", exc_info=True)
+                 return None
+
+    def read_snapshot(self, ranges):
+        """
+        Reads any number of register ranges as one consistent snapshot, even if
+        they need several multi-read frames: the Pico's read latch is set first
+        (reads then come from a frozen copy of the map) and released afterwards.
+        ranges: list of (reg_addr, num_bytes) tuples, each at most 32 bytes.
+        Returns a list of bytes objects (one per range), or None on error.
+        """
+        # Split into frames that fit the multi-read limits
+        frames, current, current_len = [], [], 0
+        for reg_addr, num_bytes in ranges:
+            if current and (len(current) == MULTI_READ_MAX_RANGES or current_len + num_bytes > MULTI_READ_MAX_BYTES):
+                frames.append(current)
+                current, current_len = [], 0
+            current.append((reg_addr, num_bytes))
+            current_len += num_bytes
+        if current:
+            frames.append(current)
+
+        if len(frames) == 1:
+            return self.read_registers(frames[0]) # One frame is consistent on its own
+
+        if not self.write_register(REG_LATCH_CONTROL, bytes([0x01])):
+            logger.error("Failed to set the read latch.")
+            return None
+        try:
+            results = []
+            for frame in frames:
+                data = self.read_registers(frame)
+                if data is None:
+                    return None
+                results.extend(data)
+            return results
+        finally:
+            if not self.write_register(REG_LATCH_CONTROL, bytes([0x00])):
+                logger.warning("Failed to release the read latch (the Pico releases it on timeout).")
+
+    def read_changes(self, max_len=CHANGES_MAX_LEN):
+        """
+        Fetches the registers the Pico changed since the last fetch.
+        Protocol: [CMD_READ_CHANGES] [0x00] [MAX_LEN] [CHECKSUM]
+        Expects Response: [RUNS] [PAYLOAD_LEN] {[ADDR_L] [ADDR_H] [LEN] [DATA...]} [CHECKSUM]
+        Returns (changes, more): changes is a list of (reg_addr, bytes), more is
+        True if changes are left for another fetch. None on error: fetched
+        changes are gone on the Pico's side, so read the registers in full then.
+        """
+        with self._lock: # Ensure exclusive access
+            if not self.is_open():
+                 logger.error("Attempted change fetch while serial port closed.")
+                 return None
+            try:
+                command_payload = bytes([CMD_READ_CHANGES, 0x00, max_len])
+                command_to_send = command_payload + bytes([self._calculate_checksum(command_payload)])
+
+                self._expect_response(RESP_LEN_FROM_HEADER)
+                self._send_cmd(command_to_send)
+                response = self._read_response(RESP_LEN_FROM_HEADER)
+
+                checksum_calc = self._calculate_checksum(response[:-1])
+                if checksum_calc != response[-1]:
+                    raise ProtocolError(f"Change fetch checksum mismatch. Got {response.hex()}, calcCS={checksum_calc:#04x}")
+
+                runs = response[0] & ~RESP_CHANGES_MORE
+                payload = response[2:-1]
+                changes = []
+                offset = 0
+                for _ in range(runs):
+                    if offset + CHANGES_RUN_HEADER > len(payload):
+                        raise ProtocolError(f"Change fetch run header past the payload: {response.hex()}")
+                    reg_addr = int.from_bytes(payload[offset:offset + 2], 'little')
+                    length = payload[offset + 2]
+                    data = payload[offset + CHANGES_RUN_HEADER:offset + CHANGES_RUN_HEADER + length]
+                    if len(data) != length:
+                        raise ProtocolError(f"Change fetch run data past the payload: {response.hex()}")
+                    changes.append((reg_addr, data))
+                    offset += CHANGES_RUN_HEADER + length
+                if offset != len(payload):
+                    raise ProtocolError(f"Change fetch payload length mismatch: {response.hex()}")
+                more = bool(response[0] & RESP_CHANGES_MORE)
+                logger.debug(f"Change fetch: {runs} runs{' (more pending)' if more else ''}: {payload.hex()}")
+                return changes, more
+
+            except ProtocolError as e:
+                 logger.error(f"Read Changes Protocol Error: {e}")
+                 self._flush_input() # Attempt to clear buffer after error
+                 return None
+            except Exception as e:
+                 logger.error(f"Unexpected error during read_changes: {e}", exc_info=True)
+                 return None
+
+    def write_staged(self, writes):
+        """
+        Writes several registers as one transaction: the Pico stages them in a
+        shadow bank and applies all of them at once on a CRC-checked commit.
+        Protocol: [CMD_STAGE_WRITE] [RUNS | STAGE_BEGIN] [PAYLOAD_LEN] {[ADDR_L] [ADDR_H] [LEN] [DATA...]} [CHECKSUM]
+                  (more STAGE_WRITE frames without STAGE_BEGIN if the runs don't fit one)
+                  [CMD_STAGE_COMMIT] [RUNS] [0x02] [CRC_H] [CRC_L] [CHECKSUM]
+        Expects ACK: [RUNS] [0x00] [CHECKSUM] for each frame
+        writes: list of (reg_addr, data_bytes); adjacent ones share a run.
+        Returns True if the commit was acknowledged. On False nothing was written.
+        """
+        runs = []
+        for reg_addr, data_bytes in sorted(writes):
+            if reg_addr + len(data_bytes) > STAGE_MAX_TRACKED:
+                logger.error(f"Staged write to reg {reg_addr:#04x} past the stageable registers.")
+                return False
+            if runs and runs[-1][0] + len(runs[-1][1]) == reg_addr:
+                runs[-1] = (runs[-1][0], runs[-1][1] + data_bytes)
+            else:
+                runs.append((reg_addr, bytes(data_bytes)))
+        if not runs:
+            return True
+
+        # Pack the runs into as few frames as possible (one for a whole config)
+        frames = [[]] # lists of encoded runs
+        for reg_addr, data in runs:
+            for offset in range(0, len(data), STAGE_MAX_LEN - CHANGES_RUN_HEADER):
+                chunk = data[offset:offset + STAGE_MAX_LEN - CHANGES_RUN_HEADER]
+                run = (reg_addr + offset).to_bytes(2, 'little') + bytes([len(chunk)]) + chunk
+                if sum(len(r) for r in frames[-1]) + len(run) > STAGE_MAX_LEN:
+                    frames.append([])
+                frames[-1].append(run)
+
+        with self._lock: # Ensure exclusive access
+            if not self.is_open():
+                 logger.error("Attempted staged write while serial port closed.")
+                 return False
+            try:
+                crc = FRAME_CRC_INIT
+                total_runs = 0
+                for index, frame_runs in enumerate(frames):
+                    payload = b''.join(frame_runs)
+                    runs_byte = len(frame_runs) | (STAGE_BEGIN if index == 0 else 0)
+                    self._send_stage_frame(bytes([CMD_STAGE_WRITE, runs_byte, len(payload)]) + payload, runs_byte)
+                    crc = binascii.crc_hqx(payload, crc)
+                    total_runs += len(frame_runs)
+                self._send_stage_frame(bytes([CMD_STAGE_COMMIT, total_runs & 0xFF, 2]) + crc.to_bytes(2, 'big'),
+                                       total_runs & 0xFF)
+                logger.debug(f"Staged write committed: {total_runs} runs in {len(frames)} frame(s).")
+                return True
+
+            except ProtocolError as e:
+                 logger.error(f"Staged Write Protocol Error: {e}")
+                 self._flush_input() # Attempt to clear buffer after error
+                 return False
+            except Exception as e:
+                 logger.error(f"Unexpected error during write_staged: {e}", exc_info=True)
+                 return False
+
+    def _send_stage_frame(self, frame, runs_byte):
+        """Sends a STAGE_WRITE/STAGE_COMMIT frame and checks its ACK (caller holds the lock)."""
+        self._expect_response(3)
+        self._send_cmd(frame + bytes([self._calculate_checksum(frame)]))
+        ack = self._read_response(3)
+        if self._calculate_checksum(ack[:2]) != ack[2] or ack[0] != runs_byte:
+            raise ProtocolError(f"Bad staged write ACK: {ack.hex()}")
+        if ack[1] != 0x00:
+            raise ProtocolError(f"Staged write NACK for command {frame[0]:#04x} (stage discarded).")
+
+    def write_registers(self, writes, window=DEFAULT_WINDOW_SIZE):
+        """
+        Writes several registers back-to-back using sequenced commands, keeping
+        up to 'window' writes in flight and matching ACK/NACKs by sequence ID.
+        Protocol: [CMD_WRITE | CMD_SEQ_FLAG] [SEQ] [REG_ADDR] [DATA_LEN] [DATA_0]...[DATA_N] [CHECKSUM]
+        Expects:  [RESP_SEQ_MARKER] [SEQ] [REG_ADDR] [STATUS] [CHECKSUM]
+        (REG_ADDR is [ADDR_L] [ADDR_H] with CMD_ADDR16_FLAG, see _addr_field())
+        writes: list of (reg_addr, data_bytes). The Pico applies them in order.
+        Returns a list of bools (True = ACK) in the same order.
+        """
+        results = [False] * len(writes)
+        if not writes:
+            return results
+        self.start_reader(self._telemetry_callback)
+
+        with self._lock: # One batch at a time; the batch itself is pipelined
+            if not self.is_open():
+                 logger.error("Attempted pipelined write while serial port closed.")
+                 return results
+            in_flight = deque()  # (index, reg_addr, txn, deadline)
+            next_index = 0
+            try:
+                while next_index < len(writes) or in_flight:
+                    # Fill the window
+                    while next_index < len(writes) and len(in_flight) < window:
+                        reg_addr, data_bytes = writes[next_index]
+                        if len(data_bytes) > 16: # Safety limit
+                            logger.error(f"Pipelined write to reg {reg_addr:#04x} exceeds 16 bytes, skipped.")
+                            next_index += 1
+                            continue
+                        flag, addr_bytes = _addr_field(reg_addr)
+                        txn = self._new_transaction(body_len=len(_resp_addr(reg_addr)) + 2) # [ADDR, STATUS, CHECKSUM]
+                        frame = bytes([0x02 | CMD_SEQ_FLAG | flag, txn.seq]) + addr_bytes + bytes([len(data_bytes)]) + data_bytes
+                        self._send_cmd(frame + bytes([self._calculate_checksum(frame)]))
+                        in_flight.append((next_index, reg_addr, txn, time.monotonic() + self.timeout))
+                        next_index += 1
+
+                    # Retire the oldest write (responses arrive in order)
+                    index, reg_addr, txn, deadline = in_flight.popleft()
+                    txn.done.wait(max(0.0, deadline - time.monotonic()))
+                    self._finish_transaction(txn)
+                    results[index] = self._check_write_response(txn, reg_addr)
+            except ProtocolError as e:
+                logger.error(f"Pipelined write Protocol Error: {e}")
+            finally:
+                for _, _, txn, _ in in_flight:
+                    self._finish_transaction(txn)
+
+        acked = sum(results)
+        logger.debug(f"Pipelined write finished: {acked}/{len(writes)} acknowledged.")
+        return results
+
+    def _new_transaction(self, body_len):
+        with self._pending_lock:
+            seq = self._next_seq
+            self._next_seq = (self._next_seq + 1) & 0xFF
+            txn = _Transaction(seq, body_len)
+            self._pending[seq] = txn
+        return txn
+
+    def _finish_transaction(self, txn):
+        with self._pending_lock:
+            if self._pending.get(txn.seq) is txn:
+                del self._pending[txn.seq]
+
+    def _check_write_response(self, txn, reg_addr):
+        response = txn.response
+        if response is None:
+            logger.error(f"Pipelined write timeout for reg {reg_addr:#04x} (seq {txn.seq}).")
+            return False
+        if self._calculate_checksum(response[:-1]) != response[-1]:
+            logger.error(f"Pipelined write ACK checksum mismatch for reg {reg_addr:#04x}: {response.hex()}")
+            return False
+        if response[2:-2] != _resp_addr(reg_addr):
+            logger.error(f"Pipelined write ACK address mismatch for reg {reg_addr:#04x}. Got {response[2:-2].hex()}.")
+            return False
+        if response[-2] == 0x00: # Success ACK code
+            return True
+        logger.warning(f"Pipelined write NACK ({response[-2]:#04x}) for reg {reg_addr:#04x}.")
+        return False
+
+    def transact(self, command_bytes, expected_len):
+        """
+        Sends a ready-made legacy frame (ending in its XOR checksum) and returns
+        the response as received, its checksum not checked. expected_len as for
+        _read_response(). For replaying captured traffic (link_test.py); not for
+        sequenced frames. Raises ProtocolError.
+        """
+        with self._lock: # Ensure exclusive access
+            try:
+                self._expect_response(expected_len)
+                self._send_cmd(command_bytes)
+                return self._read_response(expected_len)
+            except ProtocolError:
+                self._flush_input() # Attempt to clear buffer after error
+                raise
+
+    # --- Baud Rate Negotiation ---
+
+    def negotiate_baud(self, target_baud):
+        """
+        Switches both ends of the link to target_baud (one of UART_BAUD_TABLE).
+        Protocol: [CMD_SET_BAUD] [BAUD_CODE] [0x00] [CHECKSUM]
+        Expects ACK (at the current rate): [BAUD_CODE] [0x00] [CHECKSUM]
+        After the ACK both sides change rate and a status read confirms the new
+        one. If it fails the Pico drops back to 115200 on its own after
+        UART_BAUD_CONFIRM_TIMEOUT_S, and so do we. Also recovers a Pico still
+        running at target_baud from an earlier agent run.
+        Over USB CDC the Pico acknowledges and ignores the rate.
+        Returns True if the link runs at target_baud afterwards.
+        """
+        if target_baud not in UART_BAUD_TABLE:
+            logger.error(f"Unsupported baud rate {target_baud}, supported: {UART_BAUD_TABLE}")
+            return False
+        if target_baud == self.baudrate:
+            return True
+
+        # The reader thread must not sit in a read while the port is reconfigured
+        restart_reader = self._reader_thread is not None
+        self.stop_reader()
+        try:
+            code = UART_BAUD_TABLE.index(target_baud)
+            acked = False
+            with self._lock:
+                if not self.is_open():
+                    logger.error("Attempted baud switch while serial port closed.")
+                    return False
+                try:
+                    frame = bytes([CMD_SET_BAUD, code, 0x00])
+                    self._send_cmd(frame + bytes([self._calculate_checksum(frame)]))
+                    ack = self._read_response(3)
+                    if self._calculate_checksum(ack[:2]) != ack[2] or ack[0] != code:
+                        raise ProtocolError(f"Bad set-baud ACK: {ack.hex()}")
+                    if ack[1] != 0x00:
+                        logger.warning(f"Pico rejected baud rate {target_baud} (NACK).")
+                        return False
+                    acked = True
+                except ProtocolError as e:
+                    logger.warning(f"Set-baud handshake failed at {self.baudrate}: {e}")
+                    self._flush_input()
+                # With no ACK the Pico may already run at the target rate (earlier run)
+                time.sleep(0.01) # The Pico switches once its ACK has left the UART
+                self._set_port_baud(target_baud)
+
+            if self._probe_link():
+                logger.info(f"Serial link running at {target_baud} baud.")
+                return True
+
+            logger.warning(f"No response at {target_baud} baud, falling back to {UART_DEFAULT_BAUD}.")
+            with self._lock:
+                self._set_port_baud(UART_DEFAULT_BAUD)
+            if acked:
+                time.sleep(UART_BAUD_CONFIRM_TIMEOUT_S + 0.1) # Let the Pico time out too
+            if not self._probe_link():
+                logger.error(f"No response at {UART_DEFAULT_BAUD} baud either.")
+            return False
+        finally:
+            if restart_reader:
+                self.start_reader(self._telemetry_callback)
+
+    def _set_port_baud(self, baudrate):
+        """Changes the local port rate (caller holds the lock)."""
+        try:
+            self.ser.baudrate = baudrate
+            self.ser.reset_input_buffer()
+            self.baudrate = baudrate
+        except (serial.SerialException, ValueError) as e:
+            logger.error(f"Failed to set port {self.port} to {baudrate} baud: {e}")
+
+    def _probe_link(self):
+        """One status read; True if the Pico answered."""
+        return self.read_register(REG_STATUS, 1) is not None
+
+    # --- Telemetry Push Mode ---
+
+    def start_reader(self, telemetry_callback):
+        """
+        Starts the background reader thread. From then on all serial input is
+        consumed by the reader: telemetry frames are decoded and passed to
+        telemetry_callback(dict), command responses are handed to the waiting
+        read/write call. Sequenced (pipelined) commands need the reader; it is
+        started implicitly by write_registers(). Calling this again while it
+        runs only replaces the callback.
+        """
+        self._telemetry_callback = telemetry_callback
+        if self._reader_thread:
+            return
+        self._reader_stop.clear()
+        self._reader_thread = threading.Thread(target=self._reader_loop, name="SerialReader", daemon=True)
+        self._reader_thread.start()
+        logger.info("Serial background reader started.")
+
+    def stop_reader(self):
+        """Stops the background reader thread (if running)."""
+        if not self._reader_thread:
+            return
+        self._reader_stop.set()
+        self._reader_thread.join(timeout=2.0)
+        self._reader_thread = None
+        logger.info("Serial background reader stopped.")
+
+    def _reader_loop(self):
+        while not self._reader_stop.is_set():
+            if not self.is_open():
+                self._reader_stop.wait(0.5)
+                continue
+            try:
+                if self.framed:
+                    frame = self._read_frame()
+                    if frame:
+                        self._dispatch_frame(frame)
+                    continue
+                first = self.ser.read(1)
+                if not first:
+                    continue # Read timeout, check stop flag
+                if first[0] == TELEMETRY_FRAME_MARKER:
+                    # Never a valid first byte of a response (short addresses stay below SHORT_ADDR_LIMIT)
+                    self._read_telemetry_frame()
+                elif first[0] == RESP_SEQ_MARKER:
+                    self._read_sequenced_response()
+                else:
+                    expected_len = self._take_expected_len()
+                    if expected_len == RESP_LEN_FROM_HEADER:
+                        self._responses.put(self._read_sized(first))
+                    elif expected_len:
+                        self._responses.put(first + self.ser.read(expected_len - 1))
+                    else:
+                        logger.warning(f"Discarding unexpected serial byte: {first.hex()}")
+            except serial.SerialException as e:
+                logger.error(f"Serial reader error: {e}")
+                self._reader_stop.wait(1.0)
+            except Exception as e:
+                logger.error(f"Unexpected error in serial reader: {e}", exc_info=True)
+
+    def _dispatch_frame(self, frame):
+        """Routes one CRC-checked framed message (legacy layout) like the
+        byte-wise reader does: telemetry, sequenced response or plain response."""
+        if frame[0] == TELEMETRY_FRAME_MARKER:
+            if len(frame) != TELEMETRY_PAYLOAD_LEN + 3 or frame[1] != TELEMETRY_PAYLOAD_LEN:
+                logger.warning(f"Telemetry frame with bad length: {frame.hex()}")
+                return
+            self._publish_telemetry(frame[2:-1])
+        elif frame[0] == RESP_SEQ_MARKER and len(frame) > 2:
+            with self._pending_lock:
+                txn = self._pending.get(frame[1])
+            if txn is None:
+                logger.warning(f"Response for unknown sequence ID {frame[1]}")
+                return
+            if len(frame) != 2 + txn.body_len:
+                logger.warning(f"Sequenced response with bad length for seq {txn.seq}: {frame.hex()}")
+                return
+            txn.response = frame
+            txn.done.set()
+        elif self._take_expected_len():
+            self._responses.put(frame)
+        else:
+            logger.warning(f"Discarding unexpected frame: {frame.hex()}")
+
+    def _read_sequenced_response(self):
+        seq_byte = self.ser.read(1)
+        if not seq_byte:
+            logger.warning("Sequenced response truncated after marker.")
+            return
+        with self._pending_lock:
+            txn = self._pending.get(seq_byte[0])
+        if txn is None:
+            # Unknown length: the rest of this frame will be discarded byte by byte
+            logger.warning(f"Response for unknown sequence ID {seq_byte[0]}")
+            return
+        body = self.ser.read(txn.body_len)
+        frame = bytes([RESP_SEQ_MARKER]) + seq_byte + body
+        if len(body) != txn.body_len:
+            logger.warning(f"Truncated response for seq {txn.seq}: {frame.hex()}")
+            return
+        txn.response = frame
+        txn.done.set()
+
+    def _read_telemetry_frame(self):
+        header = self.ser.read(1)
+        if not header or header[0] != TELEMETRY_PAYLOAD_LEN:
+            logger.warning(f"Telemetry frame with bad length: {header.hex()}")
+            return
+        body = self.ser.read(TELEMETRY_PAYLOAD_LEN + 1)
+        if len(body) != TELEMETRY_PAYLOAD_LEN + 1:
+            logger.warning(f"Truncated telemetry frame: {body.hex()}")
+            return
+        frame = bytes([TELEMETRY_FRAME_MARKER]) + header + body
+        if self._calculate_checksum(frame[:-1]) != frame[-1]:
+            logger.warning(f"Telemetry frame checksum mismatch: {frame.hex()}")
+            return
+        self._publish_telemetry(body[:-1])
+
+    def _publish_telemetry(self, payload):
+        values = struct.unpack(TELEMETRY_PAYLOAD_FORMAT, payload)
+        telemetry = {
+            "timestamp": time.time(),
+            "status_flags": values[0],
+            "switch_flags": values[1],
+            "error_flags": values[2],
+        }
+        for axis in range(NUM_AXES):
+            telemetry[f"motor{axis + 1}_pos"] = values[3 + axis]
+            telemetry[f"motor{axis + 1}_speed"] = values[3 + NUM_AXES + axis]
+        logger.debug(f"Telemetry RX: {telemetry}")
+        if self._telemetry_callback:
+            try:
+                self._telemetry_callback(telemetry)
+            except Exception as e:
+                logger.error(f"Error in telemetry callback: {e}", exc_info=True)
+
     def _flush_input(self):
         """Safely attempts to flush the serial input buffer."""
+        if self._reader_thread or self.framed:
+            # The reader (or the frame preamble) keeps the stream in sync; only
+            # forget pending responses, no flush/sleep cycle needed
+            self._set_expected_len(0)
+            while not self._responses.empty():
+                self._responses.get_nowait()
+            return
         if self.is_open():
             try:
                 # Read any remaining bytes with a short timeout
@@ -0,0 +1,92 @@
+import struct
+import threading
+import logging
+
+logger = logging.getLogger("StatusCodec")
+
+# --- Compact Status Format (decoded by backend/status_codec.py and the apps' statusCodec.js) ---
+# One MQTT message carries a batch of status samples:
+#   [MAGIC] [VERSION] [NUM_AXES] [COUNT] [T0 f64]          header, T0 = unix time of sample 0
+#   COUNT x [DT_MS u16] [STATUS] [SWITCHES] [ERRORS] [POS x NUM_AXES] [SPEED u16 x NUM_AXES]
+# The sample layout follows the Pico's register block (REG_STATUS..REG_ERROR_FLAGS,
+# REG_MOTOR_CURRENT_POS, REG_MOTOR_CURRENT_SPEED), little endian. DT_MS is the time
+# since the previous sample. Key samples (DT_KEY_FLAG set; always the first) carry
+# absolute i32 positions, the others i16 deltas to the previous sample.
+# A JSON status always starts with '{', so both formats share the status topic.
+COMPACT_MAGIC = 0xB5
+COMPACT_VERSION = 1
+HEADER_FORMAT = '<BBBBd'
+DT_KEY_FLAG = 0x8000
+DT_MAX_MS = 0x7FFF
+MAX_BATCH_SIZE = 255
+
+def _sample_formats(num_axes):
+    """(key sample, delta sample) struct formats."""
+    key = '<HBBB' + 'i' * num_axes + 'H' * num_axes
+    delta = '<HBBB' + 'h' * num_axes + 'H' * num_axes
+    return key, delta
+
+def encode_status_batch(samples, num_axes):
+    """Packs status dicts (as published in JSON) into one compact message."""
+    key_format, delta_format = _sample_formats(num_axes)
+    t0 = samples[0]["timestamp"]
+    out = bytearray(struct.pack(HEADER_FORMAT, COMPACT_MAGIC, COMPACT_VERSION, num_axes, len(samples), t0))
+    prev_time_ms = round(t0 * 1000)
+    prev_pos = None
+    for sample in samples:
+        time_ms = round(sample["timestamp"] * 1000)
+        dt = min(max(time_ms - prev_time_ms, 0), DT_MAX_MS)
+        prev_time_ms += dt # Accumulate what the decoder sees, so rounding never drifts
+        flags = (sample["status_flags"], sample["switch_flags"], sample["error_flags"])
+        pos = [sample[f"motor{axis + 1}_pos"] for axis in range(num_axes)]
+        speeds = [min(sample[f"motor{axis + 1}_speed"], 0xFFFF) for axis in range(num_axes)]
+        deltas = [p - q for p, q in zip(pos, prev_pos)] if prev_pos else None
+        if deltas and all(-0x8000 <= d <= 0x7FFF for d in deltas):
+            out += struct.pack(delta_format, dt, *flags, *deltas, *speeds)
+        else:
+            out += struct.pack(key_format, dt | DT_KEY_FLAG, *flags, *pos, *speeds)
+        prev_pos = pos
+    return bytes(out)
+
+class StatusBatcher:
+    """
+    Collects status samples and hands them to send(bytes) as one compact
+    message once batch_size samples are in or the oldest is max_age_s old.
+    add() may be called from several threads (telemetry reader, status loop).
+    """
+    def __init__(self, num_axes, batch_size, max_age_s, send):
+        self.num_axes = num_axes
+        self.batch_size = min(max(batch_size, 1), MAX_BATCH_SIZE)
+        self.max_age_s = min(max_age_s, DT_MAX_MS / 1000.0) # Keeps every DT within a batch in range
+        self.send = send
+        self._samples = []
+        self._lock = threading.Lock()
+
+    def add(self, status):
+        with self._lock:
+            batches = []
+            if self._samples and status["timestamp"] - self._samples[0]["timestamp"] > self.max_age_s:
+                batches.append(self._take())
+            self._samples.append(status)
+            if len(self._samples) >= self.batch_size:
+                batches.append(self._take())
+        for batch in batches:
+            self._send(batch)
+
+    def flush_if_stale(self, now):
+        """Sends a partial batch whose oldest sample is older than max_age_s (now: time.time())."""
+        with self._lock:
+            if not self._samples or now - self._samples[0]["timestamp"] <= self.max_age_s:
+                return
+            batch = self._take()
+        self._send(batch)
+
+    def _take(self):
+        batch, self._samples = self._samples, []
+        return batch
+
+    def _send(self, batch):
+        try:
+            self.send(encode_status_batch(batch, self.num_axes))
+        except (KeyError, struct.error) as e:
+            logger.error(f"Failed to encode status batch of {len(batch)} samples: {e}")
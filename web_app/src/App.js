@@ -1,12 +1,15 @@
 import React, { useState, useEffect, useCallback, useRef } from 'react';
 import axios from 'axios';
 import './App.css';
+import { decodeStatusBatch } from './statusCodec';
 
 // --- Config ---
 // Use environment variables for build-time config is best practice
 const API_BASE_URL = process.env.REACT_APP_API_BASE_URL || 'http://localhost:5000/api';
 // Allow overriding device ID via URL parameter or env var, fallback to default
 const DEFAULT_DEVICE_ID = process.env.REACT_APP_DEFAULT_DEVICE_ID || 'RPiStepper_001';
+// 'compact': fetch the device's latest binary status batch (agent StatusFormat = compact) instead of JSON
+const STATUS_FORMAT = process.env.REACT_APP_STATUS_FORMAT || 'json';
 
 // --- Helper Functions ---
 const formatTimestamp = (ts) => {
@@ -25,6 +28,7 @@ function App() {
   const [commandStatus, setCommandStatus] = useState(''); // Feedback on command send
   const [isLoadingConfig, setIsLoadingConfig] = useState(false);
   const [isLoadingStatus, setIsLoadingStatus] = useState(false);
+  const [isStreaming, setIsStreaming] = useState(false); // Live status stream open
   const [isSavingConfig, setIsSavingConfig] = useState(false);
   const [error, setError] = useState(null);
 
@@ -35,7 +39,7 @@ function App() {
   // State for config inputs - reflects the *editing* state
   const [editableConfig, setEditableConfig] = useState({});
 
-  // Ref for status polling interval
+  // Ref for status polling interval (fallback while the live stream is down)
   const statusIntervalRef = useRef(null);
 
   // --- Fetch Config ---
@@ -110,15 +114,22 @@ function App() {
      }
   };
 
-  // --- Fetch Status (Polling) ---
-  // NOTE: WebSockets are strongly recommended for real-time status updates.
-  // This polling approach is simpler but less efficient and real-time.
+  // --- Fetch Status ---
+  // One-shot fetch: initial load, Refresh button and polling fallback.
+  // Live updates come from the status stream (see Effects).
   const fetchStatus = useCallback(async () => {
       setIsLoadingStatus(true); // Indicate loading on manual refresh or initial load
       // setError(null); // Optionally clear error on each poll?
       try {
-         const response = await axios.get(`${API_BASE_URL}/devices/${deviceId}/status`);
-         setStatus(response.data || { timestamp: null });
+         if (STATUS_FORMAT === 'compact') {
+           const response = await axios.get(`${API_BASE_URL}/devices/${deviceId}/status/compact`, { responseType: 'arraybuffer' });
+           const samples = decodeStatusBatch(response.data);
+           // Latest sample; keeps fields only the JSON status has (connection_status)
+           if (samples.length) setStatus(prev => ({ ...prev, ...samples[samples.length - 1] }));
+         } else {
+           const response = await axios.get(`${API_BASE_URL}/devices/${deviceId}/status`);
+           setStatus(response.data || { timestamp: null });
+         }
       } catch (err) {
          console.warn("Error fetching status:", err);
          // Don't necessarily set a major error for failed status poll, could be temporary
@@ -148,20 +159,50 @@ function App() {
     fetchConfig(); // Fetch config on initial load or deviceId change
     fetchStatus(); // Fetch status on initial load or deviceId change
 
-    // Set up polling interval for status
-    // Clear existing interval if deviceId changes
-    if (statusIntervalRef.current) {
+    // Poll every 2 seconds only while the live stream is not connected
+    const startPolling = () => {
+      if (!statusIntervalRef.current) {
+        statusIntervalRef.current = setInterval(fetchStatus, 2000);
+      }
+    };
+    const stopPolling = () => {
+      if (statusIntervalRef.current) {
         clearInterval(statusIntervalRef.current);
+        statusIntervalRef.current = null;
+      }
+    };
+
+    if (typeof EventSource === 'undefined') {
+      startPolling();
+      return stopPolling;
     }
-    // Poll every 2 seconds (adjust interval as needed)
-    statusIntervalRef.current = setInterval(fetchStatus, 2000);
 
-    // Cleanup interval on component unmount or before re-running effect
-    return () => {
-      if (statusIntervalRef.current) {
-        clearInterval(statusIntervalRef.current);
+    // Server-sent events: the backend pushes each status update (coalesced
+    // to at most one every 100 ms) and EventSource reconnects on its own.
+    const source = new EventSource(`${API_BASE_URL}/devices/${deviceId}/status/stream`);
+    source.onopen = () => {
+      setIsStreaming(true);
+      stopPolling();
+    };
+    source.onmessage = (event) => {
+      try {
+        setStatus(JSON.parse(event.data));
+      } catch (e) {
+        console.warn("Bad status stream event:", e);
       }
     };
+    source.onerror = () => {
+      // Reconnecting (or refused, e.g. 503): poll until the stream is back
+      setIsStreaming(false);
+      startPolling();
+    };
+
+    // Close stream and interval on component unmount or before re-running effect
+    return () => {
+      source.close();
+      setIsStreaming(false);
+      stopPolling();
+    };
   }, [fetchConfig, fetchStatus, deviceId]); // Dependencies: functions and deviceId
 
 
@@ -187,6 +228,7 @@ function App() {
         <section className="card status-card">
           <h2>
             Device Status
+            <span className="stream-indicator">{isStreaming ? 'Live' : 'Polling'}</span>
             <button onClick={fetchStatus} disabled={isLoadingStatus} className="refresh-button">
                 {isLoadingStatus ? 'Refreshing...' : 'Refresh'}
             </button>